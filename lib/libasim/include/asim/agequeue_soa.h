@@ -0,0 +1,464 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ *
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the Intel Corporation nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @author Pau Cabre
+ * @brief Age ordered queue with the entry fields kept in separate arrays.
+ */
+
+#ifndef _AGEQUEUE_SOA_H
+#define _AGEQUEUE_SOA_H
+
+// ASIM core
+#include "asim/syntax.h"
+#include "asim/mesg.h"
+#include "asim/agequeue.h"
+
+//
+// agequeue_soa<T,N> is a drop-in replacement for agequeue<T,N>: same methods,
+// same entry states and same indices handed out by Enter(). The difference is
+// in how the entries are stored. agequeue keeps state/next/prev/obj together
+// in one struct per entry and answers OldestReady() by chasing 'next' links,
+// pulling a whole entry into the cache to look at a 2-bit state. After a
+// Rearm() or UnSuspend() that walk starts over from the oldest entry.
+//
+// Here each field lives in its own array, and age is a position: every
+// entered object is appended at the next position of a 2*N position space,
+// and the live entries and the entries in state ENTRY_READY_TO_LAUNCH are two
+// bitmasks over those positions. The lowest position is the oldest entry, so
+// OldestReady(), NextReady(), Next() and the like are find-first-set over 64
+// positions per word instead of list walks. Removing an entry just leaves a
+// hole; when the position space runs out the live entries are compacted to
+// the front, which happens at most once every N Enter() calls.
+//
+
+template<class T, UINT32 N> class agequeue_soa
+{
+  private:
+
+  enum { POSITIONS = 2 * N, WORDS = (2 * N + 63) / 64 };
+
+  //
+  // Entry fields, one array per field, indexed by entry. 'state' holds an
+  // EntryState and 'pos' the age position of the entry
+  //
+  UINT8		state[N];
+  UINT32	pos[N];
+  T		obj[N];
+
+  //
+  // Entry at each position, and the positions holding a live entry and an
+  // entry in state ENTRY_READY_TO_LAUNCH
+  //
+  INT32		order[POSITIONS];
+  UINT64	liveMask[WORDS];
+  UINT64	readyMask[WORDS];
+
+  //
+  // Next position to hand out
+  //
+  UINT32	tail;
+
+  //
+  // Free entries, as a stack so that indices are reused in the same order
+  // as agequeue's free list
+  //
+  INT32		freeStack[N];
+  INT32		freeTop;
+
+  //
+  // Number of items in queue
+  //
+  INT32		count;
+
+  private:
+
+	// Self-diagnosis of the state of the queue
+	bool		SelfCheck() const;
+
+	// Entry at the lowest set position >= 'from', or at the highest set
+	// position < 'before', of 'mask'. -1 if none.
+	INT32		FirstFrom(const UINT64 *mask, UINT32 from) const;
+	INT32		LastBefore(const UINT64 *mask, UINT32 before) const;
+
+	// Move the live entries to the front of the position space
+	void		Compact();
+
+	static void	SetBit(UINT64 *mask, UINT32 p)		{ mask[p / 64] |= (UINT64(1) << (p % 64)); }
+	static void	ClearBit(UINT64 *mask, UINT32 p)	{ mask[p / 64] &= ~(UINT64(1) << (p % 64)); }
+	static bool	TestBit(const UINT64 *mask, UINT32 p)	{ return (mask[p / 64] >> (p % 64)) & 1; }
+
+  public:
+
+	//
+	// Find the index of a given object. If the object is in the queue more than once
+	// the oldest entry is returned, like agequeue does.
+	//
+	INT32		Find(T obj);
+
+  public:
+
+	agequeue_soa();
+
+	UINT32		Enter(T obj);
+
+	void		Launch(UINT32 idx);
+	void		Launch(T obj)		{ Launch(Find(obj)); }
+
+	void		Remove(UINT32 idx);
+	void		Remove(T obj)		{ Remove(Find(obj)); }
+
+	void		Rearm(UINT32 idx);
+	void		Rearm(T obj)		{ Rearm(Find(obj)); }
+
+	void		Suspend(UINT32 idx);
+	void		Suspend(T obj)		{ Suspend(Find(obj)); }
+	void		UnSuspend(UINT32 idx);
+	void		UnSuspend(T obj)	{ UnSuspend(Find(obj)); }
+
+  	UINT32		GetOccupancy() const	{ SELF_CHECK; return count; }
+  	UINT32		GetCapacity() const	{ SELF_CHECK; return N; }
+  	UINT32		GetFreeSpace() const	{ SELF_CHECK; return (N - count); }
+
+	INT32		Oldest() const		{ SELF_CHECK; return FirstFrom(liveMask, 0); }
+	T		OldestObj() const	{ INT32 i = Oldest(); return (i != -1) ? obj[i] : static_cast<T>(NULL); }
+
+	INT32		Youngest() const	{ SELF_CHECK; return LastBefore(liveMask, tail); }
+	T		YoungestObj() const	{ INT32 i = Youngest(); return (i != -1) ? obj[i] : static_cast<T>(NULL); }
+
+	INT32		OldestReady()		{ SELF_CHECK; return FirstFrom(readyMask, 0); }
+	T		OldestReadyObj()	{ INT32 i = OldestReady(); return ((i != -1) ? obj[i] : static_cast<T>(NULL)); }
+
+	INT32		Next(UINT32 idx) const;
+	INT32		Previous(UINT32 idx) const;
+
+	INT32		NextReady(UINT32 idx) const;
+	INT32		PreviousReady(UINT32 idx) const;
+
+	T		GetObject(UINT32 idx) const { ASSERTX(idx < N); ASSERTX(state[idx] != ENTRY_FREE); return obj[idx]; }
+
+	EntryState	GetObjectState(UINT32 idx) const { ASSERTX(idx < N); ASSERTX(state[idx] != ENTRY_FREE); return EntryState(state[idx]); }
+
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////
+/////  IMPLEMENTATION SECTION
+/////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<class T, UINT32 N>
+agequeue_soa<T,N>::agequeue_soa()
+{
+ UINT32 i;
+
+ for (i = 0; i < N; i++ ) {
+  state[i] = ENTRY_FREE;
+  obj[i] = static_cast<T>(NULL);
+  pos[i] = 0;
+  // entry 0 on top of the stack
+  freeStack[i] = N - 1 - i;
+ }
+ freeTop = N;
+
+ for (i = 0; i < POSITIONS; i++ ) {
+  order[i] = -1;
+ }
+ for (i = 0; i < WORDS; i++ ) {
+  liveMask[i] = 0;
+  readyMask[i] = 0;
+ }
+
+ tail = 0;
+ count = 0;
+}
+
+template<class T, UINT32 N>
+INT32
+agequeue_soa<T,N>::FirstFrom(const UINT64 *mask, UINT32 from) const
+{
+ if ( from >= tail ) return -1;
+
+ UINT32 w = from / 64;
+ UINT64 bits = mask[w] & (~UINT64(0) << (from % 64));
+ for (;;) {
+  if ( bits ) return order[w * 64 + __builtin_ctzll(bits)];
+  if ( ++w >= (tail + 63) / 64 ) return -1;
+  bits = mask[w];
+ }
+}
+
+template<class T, UINT32 N>
+INT32
+agequeue_soa<T,N>::LastBefore(const UINT64 *mask, UINT32 before) const
+{
+ if ( before == 0 ) return -1;
+
+ INT32 w = (before - 1) / 64;
+ UINT32 b = before % 64;
+ UINT64 bits = mask[w] & (b ? ((UINT64(1) << b) - 1) : ~UINT64(0));
+ for (;;) {
+  if ( bits ) return order[w * 64 + 63 - __builtin_clzll(bits)];
+  if ( --w < 0 ) return -1;
+  bits = mask[w];
+ }
+}
+
+template<class T, UINT32 N>
+void
+agequeue_soa<T,N>::Compact()
+{
+ UINT32 p = 0;
+
+ for ( UINT32 w = 0; w < WORDS; w++ ) {
+  UINT64 bits = liveMask[w];
+  while ( bits ) {
+   INT32 idx = order[w * 64 + __builtin_ctzll(bits)];
+   bits &= bits - 1;
+   // p never passes the position being read, so order[] can be reused
+   order[p] = idx;
+   pos[idx] = p++;
+  }
+ }
+ for ( UINT32 i = p; i < POSITIONS; i++ ) {
+  order[i] = -1;
+ }
+ for ( UINT32 w = 0; w < WORDS; w++ ) {
+  liveMask[w] = 0;
+  readyMask[w] = 0;
+ }
+ for ( UINT32 i = 0; i < p; i++ ) {
+  SetBit(liveMask, i);
+  if ( state[order[i]] == ENTRY_READY_TO_LAUNCH ) SetBit(readyMask, i);
+ }
+ tail = p;
+}
+
+template<class T, UINT32 N>
+INT32
+agequeue_soa<T,N>::Find(T o)
+{
+ INT32 best = -1;
+
+ SELF_CHECK;
+ for ( UINT32 i = 0; i < N; i++ ) {
+  if ( state[i] != ENTRY_FREE && obj[i] == o && (best == -1 || pos[i] < pos[best]) ) {
+   best = i;
+  }
+ }
+ return best;
+}
+
+template<class T, UINT32 N>
+bool
+agequeue_soa<T,N>::SelfCheck() const
+{
+ bool ok  = true;
+ INT32 live = 0;
+
+ ok &= (count >= 0);
+ ok &= (count <= INT32(N));
+ ok &= (freeTop + count == INT32(N));
+ ok &= (tail <= POSITIONS);
+ ASSERTX(ok);
+
+ //
+ // Every live position must point to an entry that points back to it,
+ // and the ready mask must agree with the entry states
+ //
+ for ( UINT32 p = 0; p < POSITIONS; p++ ) {
+  if ( TestBit(liveMask, p) ) {
+   INT32 idx = order[p];
+   live++;
+   ok &= (p < tail);
+   ok &= (idx >= 0 && idx < INT32(N));
+   ok &= (state[idx] != ENTRY_FREE);
+   ok &= (pos[idx] == p);
+   ok &= (TestBit(readyMask, p) == (state[idx] == ENTRY_READY_TO_LAUNCH));
+  }
+  else {
+   ok &= ! TestBit(readyMask, p);
+  }
+  ASSERTX(ok);
+ }
+ ok &= (live == count);
+ ASSERTX(ok);
+
+ for ( INT32 i = 0; i < freeTop; i++ ) {
+  ok &= (state[freeStack[i]] == ENTRY_FREE);
+  ASSERTX(ok);
+ }
+
+ return ok;
+}
+
+template<class T, UINT32 N>
+UINT32
+agequeue_soa<T,N>::Enter(T o)
+{
+ UINT32 idx;
+
+ ASSERTX(count < INT32(N));
+ ASSERTX(freeTop > 0);
+
+ // Get an entry from the free stack
+ idx = freeStack[--freeTop];
+ ASSERTX(state[idx] == ENTRY_FREE);
+
+ // The new entry goes after every other one
+ if ( tail == POSITIONS ) Compact();
+ pos[idx] = tail;
+ order[tail] = idx;
+ SetBit(liveMask, tail);
+ SetBit(readyMask, tail);
+ tail++;
+
+ state[idx] = ENTRY_READY_TO_LAUNCH;
+ obj[idx] = o;
+
+ count++;
+
+ SELF_CHECK;
+
+ return idx;
+}
+
+template<class T, UINT32 N>
+void
+agequeue_soa<T,N>::Launch(UINT32 idx)
+{
+ ASSERTX(idx < N);
+ ASSERTX(state[idx] == ENTRY_READY_TO_LAUNCH);
+
+ state[idx] = ENTRY_LAUNCHED;
+ ClearBit(readyMask, pos[idx]);
+
+ SELF_CHECK;
+}
+
+template<class T, UINT32 N>
+void
+agequeue_soa<T,N>::Suspend(UINT32 idx)
+{
+ ASSERTX(idx < N);
+ ASSERTX(state[idx] == ENTRY_READY_TO_LAUNCH);
+
+ state[idx] = ENTRY_SUSPENDED;
+ ClearBit(readyMask, pos[idx]);
+
+ SELF_CHECK;
+}
+
+template<class T, UINT32 N>
+void
+agequeue_soa<T,N>::Remove(UINT32 idx)
+{
+ ASSERTX(idx < N);
+ ASSERTX(count > 0);
+ ASSERTX(state[idx] == ENTRY_LAUNCHED);
+
+ state[idx] = ENTRY_FREE;
+ obj[idx] = static_cast<T>(NULL);
+
+ // Leave a hole at its position and give the entry back
+ ClearBit(liveMask, pos[idx]);
+ order[pos[idx]] = -1;
+ freeStack[freeTop++] = idx;
+
+ count--;
+
+ SELF_CHECK;
+}
+
+template<class T, UINT32 N>
+void
+agequeue_soa<T,N>::Rearm(UINT32 idx)
+{
+ ASSERTX(idx < N);
+ ASSERTX(count > 0);
+ ASSERTX(state[idx] == ENTRY_LAUNCHED);
+
+ state[idx] = ENTRY_READY_TO_LAUNCH;
+ SetBit(readyMask, pos[idx]);
+
+ SELF_CHECK;
+}
+
+template<class T, UINT32 N>
+void
+agequeue_soa<T,N>::UnSuspend(UINT32 idx)
+{
+ ASSERTX(idx < N);
+ ASSERTX(state[idx] == ENTRY_SUSPENDED);
+
+ state[idx] = ENTRY_READY_TO_LAUNCH;
+ SetBit(readyMask, pos[idx]);
+
+ SELF_CHECK;
+}
+
+template<class T, UINT32 N>
+inline INT32
+agequeue_soa<T,N>::Previous(UINT32 idx) const
+{
+ ASSERTX(idx < N);
+ ASSERTX(state[idx] != ENTRY_FREE);
+ return LastBefore(liveMask, pos[idx]);
+}
+
+template<class T, UINT32 N>
+inline INT32
+agequeue_soa<T,N>::Next(UINT32 idx) const
+{
+ ASSERTX(idx < N);
+ ASSERTX(state[idx] != ENTRY_FREE);
+ return FirstFrom(liveMask, pos[idx] + 1);
+}
+
+template<class T, UINT32 N>
+inline INT32
+agequeue_soa<T,N>::PreviousReady(UINT32 idx) const
+{
+ ASSERTX(idx < N);
+ ASSERTX(state[idx] != ENTRY_FREE);
+ return LastBefore(readyMask, pos[idx]);
+}
+
+template<class T, UINT32 N>
+inline INT32
+agequeue_soa<T,N>::NextReady(UINT32 idx) const
+{
+ ASSERTX(idx < N);
+ ASSERTX(state[idx] != ENTRY_FREE);
+ return FirstFrom(readyMask, pos[idx] + 1);
+}
+
+#endif // _AGEQUEUE_SOA_H
@@ -0,0 +1,293 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ *
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the Intel Corporation nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @author Pau Cabre
+ * @brief Binary checkpoint/restore of the timing model state.
+ *
+ * A checkpoint file holds the microarchitectural state that the
+ * functional state dump (DumpFunctionalState) does not cover: the
+ * contents of every port buffer, the clock server cycle counters and
+ * the registered statistics of every module.  Restoring it on the same
+ * model configuration resumes the run exactly where it was saved, so a
+ * long warm-up can be paid once and shared by many detailed runs.
+ *
+ * The file is a header (magic + version) followed by named sections.
+ * Every section is closed with an end marker, so a model that does not
+ * match the checkpoint is detected at the section that differs instead
+ * of silently loading garbage.
+ *
+ * Values are serialized through ASIM_CHECKPOINT_TRAITS<T>:
+ *  - builtin scalar types are copied as raw bytes;
+ *  - classes that declare
+ *        void SaveCheckpoint(ASIM_CHECKPOINT ckpt) const;
+ *        void RestoreCheckpoint(ASIM_CHECKPOINT ckpt);
+ *    are serialized through those methods;
+ *  - plain structs can be declared with ASIM_CHECKPOINT_POD(T);
+ *  - mmptr<T> keeps object identity: an MM object referenced from
+ *    several places is stored once and shared again after restore
+ *    (see ASIM_MM_CLASS::SaveCheckpointRef in mm.h);
+ *  - any other type raises an error at run time, but only when a
+ *    value of that type actually has to be written.
+ */
+
+#ifndef _CHECKPOINT_
+#define _CHECKPOINT_
+
+// generic
+#include <stdio.h>
+#include <string>
+#include <map>
+#include <typeinfo>
+
+// ASIM core
+#include "asim/syntax.h"
+#include "asim/mesg.h"
+
+using namespace std;
+
+typedef class ASIM_CHECKPOINT_CLASS *ASIM_CHECKPOINT;
+typedef class ASIM_MODULE_CLASS *ASIM_MODULE;
+
+/**
+ * Binary checkpoint file, opened either for saving or for restoring.
+ */
+class ASIM_CHECKPOINT_CLASS
+{
+  public:
+    enum CKPT_MODE
+    {
+        CKPT_SAVE,
+        CKPT_RESTORE
+    };
+
+    /// Bumped whenever the layout of any section changes
+    static const UINT32 CKPT_VERSION = 2;
+
+  private:
+    FILE *file;
+    const string fileName;
+    const CKPT_MODE mode;
+
+    /// Save side: MM object address -> checkpoint object id
+    map<const void *, UINT64> savedObjects;
+    /// Restore side: checkpoint object id -> restored MM object
+    map<UINT64, void *> restoredObjects;
+    UINT64 nextObjectId;
+
+    /// Name of the section currently open (for error messages)
+    string section;
+
+  public:
+    ASIM_CHECKPOINT_CLASS(const char *fileName, CKPT_MODE mode);
+    ~ASIM_CHECKPOINT_CLASS();
+
+    bool IsSaving(void) const { return mode == CKPT_SAVE; }
+    bool IsRestoring(void) const { return mode == CKPT_RESTORE; }
+    const char *GetFileName(void) const { return fileName.c_str(); }
+
+    // raw access
+    void Write(const void *buf, size_t len);
+    void Read(void *buf, size_t len);
+
+    // typed access
+    template <class T> void Save(const T &val);
+    template <class T> void Restore(T &val);
+
+    /// Save a value that must match exactly on restore (sizes,
+    /// configuration parameters...).  On restore the stored value is
+    /// compared against 'val' and a mismatch is an error.
+    template <class T> void Check(const T &val, const char *what);
+
+    // sections
+    void BeginSection(const char *name);
+    void EndSection(void);
+
+    // MM object identity
+    /// Return the id of 'obj' (0 for NULL).  'isNew' is set when this is
+    /// the first time the object is seen and its contents must follow.
+    UINT64 SaveObjectId(const void *obj, bool &isNew);
+    /// Return the object restored for 'id', or NULL if not seen yet.
+    void *LookupObject(UINT64 id) const;
+    void RegisterObject(UINT64 id, void *obj);
+
+    /// Called when asked to serialize a type that has no traits
+    void Unsupported(const char *typeName);
+
+    // whole model
+    /// Save the clock server, all the ports and the module tree rooted
+    /// at 'root'.  Must be called between two clock server cycles.
+    static void SaveTimingState(const char *fileName, ASIM_MODULE root);
+    /// Restore a checkpoint saved with SaveTimingState on a model built
+    /// with the same configuration.
+    static void RestoreTimingState(const char *fileName, ASIM_MODULE root);
+};
+
+
+/**
+ * Detect whether T declares SaveCheckpoint/RestoreCheckpoint.
+ */
+template <class T>
+class ASIM_CHECKPOINT_HAS_METHODS
+{
+  private:
+    typedef char YES;
+    typedef struct { char c[2]; } NO;
+
+    template <class U, void (U::*)(ASIM_CHECKPOINT) const> struct SAVE_SIG { };
+    template <class U, void (U::*)(ASIM_CHECKPOINT)> struct RESTORE_SIG { };
+
+    template <class U> static YES Test(SAVE_SIG<U, &U::SaveCheckpoint> *,
+                                       RESTORE_SIG<U, &U::RestoreCheckpoint> *);
+    template <class U> static NO Test(...);
+
+  public:
+    enum { value = (sizeof(Test<T>(0, 0)) == sizeof(YES)) };
+};
+
+template <class T, bool HAS_METHODS>
+struct ASIM_CHECKPOINT_MEMBER_TRAITS
+{
+    static void Save(ASIM_CHECKPOINT ckpt, const T &val)
+    { ckpt->Unsupported(typeid(T).name()); }
+
+    static void Restore(ASIM_CHECKPOINT ckpt, T &val)
+    { ckpt->Unsupported(typeid(T).name()); }
+};
+
+template <class T>
+struct ASIM_CHECKPOINT_MEMBER_TRAITS<T, true>
+{
+    static void Save(ASIM_CHECKPOINT ckpt, const T &val)
+    { val.SaveCheckpoint(ckpt); }
+
+    static void Restore(ASIM_CHECKPOINT ckpt, T &val)
+    { val.RestoreCheckpoint(ckpt); }
+};
+
+/**
+ * Serialization of a value of type T.  Specialize it (or use
+ * ASIM_CHECKPOINT_POD) for types without checkpoint methods.
+ */
+template <class T>
+struct ASIM_CHECKPOINT_TRAITS
+  : public ASIM_CHECKPOINT_MEMBER_TRAITS<T, ASIM_CHECKPOINT_HAS_METHODS<T>::value>
+{ };
+
+/**
+ * Declare T as plain old data: it is saved as raw bytes.  Only valid
+ * for types without pointers or non-trivial members.
+ */
+#define ASIM_CHECKPOINT_POD(T) \
+template <> \
+struct ASIM_CHECKPOINT_TRAITS<T> \
+{ \
+    static void Save(ASIM_CHECKPOINT ckpt, const T &val) \
+    { ckpt->Write(&val, sizeof(T)); } \
+    static void Restore(ASIM_CHECKPOINT ckpt, T &val) \
+    { ckpt->Read(&val, sizeof(T)); } \
+};
+
+ASIM_CHECKPOINT_POD(bool)
+ASIM_CHECKPOINT_POD(char)
+ASIM_CHECKPOINT_POD(signed char)
+ASIM_CHECKPOINT_POD(unsigned char)
+ASIM_CHECKPOINT_POD(short)
+ASIM_CHECKPOINT_POD(unsigned short)
+ASIM_CHECKPOINT_POD(int)
+ASIM_CHECKPOINT_POD(unsigned int)
+ASIM_CHECKPOINT_POD(long)
+ASIM_CHECKPOINT_POD(unsigned long)
+ASIM_CHECKPOINT_POD(long long)
+ASIM_CHECKPOINT_POD(unsigned long long)
+ASIM_CHECKPOINT_POD(float)
+ASIM_CHECKPOINT_POD(double)
+
+template <>
+struct ASIM_CHECKPOINT_TRAITS<string>
+{
+    static void Save(ASIM_CHECKPOINT ckpt, const string &val)
+    {
+        UINT32 len = val.size();
+        ckpt->Write(&len, sizeof(len));
+        ckpt->Write(val.data(), len);
+    }
+
+    static void Restore(ASIM_CHECKPOINT ckpt, string &val)
+    {
+        UINT32 len;
+        ckpt->Read(&len, sizeof(len));
+        val.resize(len);
+        if (len)
+        {
+            ckpt->Read(&val[0], len);
+        }
+    }
+};
+
+
+//----------------------------------------------------------------------------
+// implementation
+//----------------------------------------------------------------------------
+
+template <class T>
+inline void
+ASIM_CHECKPOINT_CLASS::Save(const T &val)
+{
+    ASIM_CHECKPOINT_TRAITS<T>::Save(this, val);
+}
+
+template <class T>
+inline void
+ASIM_CHECKPOINT_CLASS::Restore(T &val)
+{
+    ASIM_CHECKPOINT_TRAITS<T>::Restore(this, val);
+}
+
+template <class T>
+inline void
+ASIM_CHECKPOINT_CLASS::Check(const T &val, const char *what)
+{
+    if (IsSaving())
+    {
+        Save(val);
+    }
+    else
+    {
+        T saved;
+        Restore(saved);
+        VERIFY(saved == val, "Checkpoint " << fileName << ", section "
+               << section << ": " << what << " is " << val
+               << " but the checkpoint has " << saved);
+    }
+}
+
+#endif // _CHECKPOINT_
@@ -39,6 +39,7 @@
 // C++/STL
 #include <cstring>
 #include <list>
+#include <vector>
 
 // ASIM core
 #include "asim/clockserver.h"
@@ -90,6 +91,14 @@ class ASIM_CLOCKABLE_CLASS : public TRACEABLE_CLASS
     // List of callbacks created by this clockable just to be able to delete them
     list<CLOCK_CALLBACK_INTERFACE> cbL;
 
+    /** Only clocked when woken up (see SetClockOnDemand) */
+    bool clockOnDemand;
+    /** Clock registry entries to wake up, filled by the clock server */
+    vector< pair<CLOCK_REGISTRY, UINT32> > wakeEntries;
+
+    /** Model partition (see asim/partition.h), -1 = same as the parent */
+    INT32 partition;
+
   protected:
     /*
      * a thread object, if this module wants to run in parallel.
@@ -112,6 +121,8 @@ class ASIM_CLOCKABLE_CLASS : public TRACEABLE_CLASS
         nClocked(0),
         nCyclesWrapAround(0),
         nWrapAround(0),
+        clockOnDemand(false),
+        partition(-1),
         host_thread(NULL)
     { }
 
@@ -396,6 +407,19 @@ class ASIM_CLOCKABLE_CLASS : public TRACEABLE_CLASS
         }
     }
 
+    /**
+     * Clocking thread of this module or of its closest registered
+     * ancestor, NULL if none of them is registered.
+     */
+    ASIM_CLOCKSERVER_THREAD FindClockingThread()
+    {
+        if(registered)
+        {
+            return thread;
+        }
+        return parent ? parent->FindClockingThread() : NULL;
+    }
+
     /** 
      * Method to obtain the current clock server base cycle where this
      * clockable element is going to be clocked
@@ -435,6 +459,82 @@ class ASIM_CLOCKABLE_CLASS : public TRACEABLE_CLASS
         }
     }
 
+    /**
+     * Clock on demand: instead of being clocked every cycle, the module
+     * is only clocked in the cycles it has been woken up for.  Every
+     * write to one of its ReadPort, ReadSkidPort or ReadStallPort
+     * endpoints initialized with the module as owner wakes it up when
+     * the data arrives (write cycle + port latency), and the module can
+     * wake itself up with WakeAt() for any other work (internal queues,
+     * timers, phased ports...).  A 0 latency write is seen one cycle
+     * later than with polling.
+     *
+     * Must be set before BasePort::ConnectAll, which only gives the
+     * ports of modules clocked on demand a module to wake up, and before
+     * InitClockServer.  It is ignored (the module is clocked every cycle)
+     * with threaded or random clocking.
+     **/
+    void SetClockOnDemand(bool onDemand = true) { clockOnDemand = onDemand; }
+    bool IsClockOnDemand(void) const { return clockOnDemand; }
+
+    /**
+     * Module that clocks this one (itself or its closest registered
+     * ancestor, as in WakeAt) if it is clocked on demand, NULL if not.
+     **/
+    ASIM_CLOCKABLE GetOnDemandClockable(void)
+    {
+        if (!registered)
+        {
+            return parent ? parent->GetOnDemandClockable() : NULL;
+        }
+        return clockOnDemand ? this : NULL;
+    }
+
+    /**
+     * Clock the module at 'cycle' of its clock domain (or at the next
+     * cycle if 'cycle' has already been clocked).  No effect on modules
+     * that are not clocked on demand.
+     **/
+    inline void WakeAt(UINT64 cycle)
+    {
+        if (!registered)
+        {
+            if (parent)
+            {
+                parent->WakeAt(cycle);
+            }
+            return;
+        }
+        for (UINT32 i = 0; i < wakeEntries.size(); i++)
+        {
+            wakeEntries[i].first->WakeAt(cycle, wakeEntries[i].second);
+        }
+    }
+
+    /** Clock the module next cycle */
+    void Wake(void) { WakeAt(GetCurrentCycle() + 1); }
+
+    /**
+     * Model partition that clocks this module and its children, when
+     * the model is split across processes (see asim/partition.h).
+     **/
+    void SetPartition(UINT32 p) { partition = p; }
+    UINT32 GetPartition(void) const
+    {
+        if (partition >= 0)
+        {
+            return partition;
+        }
+        return parent ? parent->GetPartition() : 0;
+    }
+
+    /** Used by the clock server to set up the clock on demand */
+    void ClearWakeEntries(void) { wakeEntries.clear(); }
+    void AddWakeEntry(CLOCK_REGISTRY reg, UINT32 pos)
+    {
+        wakeEntries.push_back(make_pair(reg, pos));
+    }
+
     /**
      * Virtual function that must be implemented by all registered 
      * classes to an clock server
@@ -499,6 +599,8 @@ class ASIM_CLOCKABLE_CLASS : public TRACEABLE_CLASS
     UINT64 GetCycles(void) { return nCycles; } 
     UINT64 GetCyclesMin(void) { return nCyclesMin; } 
     UINT64 GetCyclesMax(void) { return nCyclesMax; }
+    // Number of timed calls: with a sampled profile this is only one
+    // out of every ClockCallBackInterface::profilePeriod calls.
     UINT64 GetNumInvocations(void) { return nClocked; }
     UINT64 GetWrapAroundCycles(void) { return nCyclesWrapAround; } 
     UINT64 GetWrapAround(void) { return nWrapAround; }
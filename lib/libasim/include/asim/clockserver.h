@@ -61,6 +61,8 @@
 #include <list>
 #include <vector>
 #include <deque>
+#include <map>
+#include <algorithm>
 
 // Base
 #include <iostream>
@@ -76,6 +78,8 @@
 #include "asim/event.h"
 #include "asim/phase.h"
 #include "asim/dynamic_array.h"
+#include "asim/checkpoint.h"
+#include "asim/timing_wheel.h"
 
 using namespace std;
 
@@ -103,6 +107,14 @@ typedef class ClockCallBackInterface
     virtual void setClkEdge(CLK_EDGE ed) = 0;
     virtual bool withPhases() = 0;
     
+    ClockCallBackInterface()
+      : cReg(NULL),
+        profCycles(0),
+        profSamples(0),
+        profMax(0),
+        profCountdown(1)
+    { };
+
     virtual ~ClockCallBackInterface() { };
 
     void setClockRegistry(CLOCK_REGISTRY _cReg)
@@ -110,8 +122,43 @@ typedef class ClockCallBackInterface
         cReg = _cReg;
     }
 
+    /**
+     * Host time profile of this callback (ASIM_ENABLE_PROFILE builds).
+     * Only one call out of every profilePeriod is timed, so the counters
+     * hold a sample: profCycles * profilePeriod estimates the total.
+     **/
+    UINT64 profCycles;
+    UINT64 profSamples;
+    UINT64 profMax;
+
+    /** Sample one call every profilePeriod calls (0 = profiling off) */
+    static UINT32 profilePeriod;
+
   protected:
 
+    UINT32 profCountdown;
+
+    /** Is the current call one of the sampled ones? */
+    inline bool ProfileSample()
+    {
+        if (profilePeriod == 0 || --profCountdown != 0)
+        {
+            return false;
+        }
+        profCountdown = profilePeriod;
+        return true;
+    }
+
+    inline void ProfileAdd(UINT64 cycles)
+    {
+        profCycles += cycles;
+        profSamples++;
+        if (cycles > profMax)
+        {
+            profMax = cycles;
+        }
+    }
+
     #ifdef HOST_LINUX_X86
 
     /** Profile support methods */
@@ -253,22 +300,25 @@ class ClockCallBack: public ClockCallBackInterface
     {           
         #ifdef ASIM_ENABLE_PROFILE
         #if defined(HOST_DUNIX) | defined(HOST_LINUX_X86)
-        startCounter();
-        #endif
-        #endif
-                  
-        (class_instance->*method)(currentCycle);        
-
-        #ifdef ASIM_ENABLE_PROFILE
-        #if defined(HOST_DUNIX) | defined(HOST_LINUX_X86)
-        UINT64 result = 0;
-        if(getCounter(result)) // Wrapped 
+        if (ProfileSample())
         {
-            class_instance->IncWrapAround(result);
+            startCounter();
+
+            (class_instance->*method)(currentCycle);
+
+            UINT64 result = 0;
+            if(getCounter(result)) // Wrapped 
+            {
+                class_instance->IncWrapAround(result);
+            }
+            class_instance->IncCyclesSpent(result);
+            ProfileAdd(result);
+            return;
         }
-        class_instance->IncCyclesSpent(result);
         #endif
         #endif
+                  
+        (class_instance->*method)(currentCycle);        
     };
 
 };
@@ -333,10 +383,31 @@ class ClockCallBackPhase: public ClockCallBackInterface
     {
         #ifdef ASIM_ENABLE_PROFILE
         #if defined(HOST_DUNIX) | defined(HOST_LINUX_X86)
-        startCounter();
+        if (ProfileSample())
+        {
+            startCounter();
+
+            ClockPhase();
+
+            UINT64 result = 0;
+            if(getCounter(result)) // Wrapped 
+            {
+                class_instance->IncWrapAround(result);
+            }
+            class_instance->IncCyclesSpent(result);
+            ProfileAdd(result);
+            return;
+        }
         #endif
         #endif
-        
+
+        ClockPhase();
+    };
+
+  private:
+
+    inline void ClockPhase()
+    {
         if(type)
         {
             (class_instance->*method_a)(currentCycle, edge);
@@ -346,18 +417,7 @@ class ClockCallBackPhase: public ClockCallBackInterface
             PHASE ph(currentCycle, edge);
             (class_instance->*method_b)(ph);
         }
-
-        #ifdef ASIM_ENABLE_PROFILE
-        #if defined(HOST_DUNIX) | defined(HOST_LINUX_X86)
-        UINT64 result = 0;
-        if(getCounter(result)) // Wrapped 
-        {
-            class_instance->IncWrapAround(result);
-        }
-        class_instance->IncCyclesSpent(result);
-        #endif
-        #endif
-    };
+    }
 
 };
 
@@ -397,6 +457,12 @@ class ASIM_CLOCKSERVER_THREAD_CLASS
     
     // for fuzzy barrier.  Last time point we have committed.
     volatile INT64 localDoneTime;
+
+    // DRAL events of the modules clocked by this thread, if any
+    DRAL_SUBSTREAM dralSubstream;
+
+    // Trace records of the modules clocked by this thread, if buffered
+    TRACE_BUFFER traceBuffer;
     
     // the actual constructor is private, and should only be called from
     // a factory routine.  This allows different versions of the clock server
@@ -410,6 +476,8 @@ class ASIM_CLOCKSERVER_THREAD_CLASS
         threadActive(false),
         threadForceExit(false),
         barrierPhase(false),
+        dralSubstream(NULL),
+        traceBuffer(NULL),
         tasks_completed(true)
     {};
 
@@ -417,10 +485,21 @@ class ASIM_CLOCKSERVER_THREAD_CLASS
     INT64 GetLocalDoneTime() {
         return localDoneTime;
     };
+
+    /** Encodes the DRAL events of this thread in parallel (see DRAL_SUBSTREAM_CLASS) */
+    void SetDralSubstream(DRAL_SUBSTREAM s) { dralSubstream = s; }
+
+    /** Buffers the trace records of this thread (see TRACE_BUFFER_CLASS) */
+    TRACE_BUFFER NewTraceBuffer()
+    {
+        traceBuffer = new TRACE_BUFFER_CLASS();
+        return traceBuffer;
+    }
     
     virtual ~ASIM_CLOCKSERVER_THREAD_CLASS()
     {
         VERIFY(!ThreadActive(), "Thread " << GetThreadId() << " not stopped!");
+        delete traceBuffer;
     }
     
     inline ASIM_SMP_THREAD_HANDLE GetAsimThreadHandle() const
@@ -610,6 +689,71 @@ class ClockRegistry
     /** Identifier for this clock registry. Used for the DRAL events */
     UINT16 clockId;
 
+    /**
+     * Clock on demand.  When some module of the registry is clocked on
+     * demand, or belongs to another model partition, the registry is
+     * selective: lPolled holds the positions in lModules that are
+     * clocked every cycle, and wakeWheel the positions woken up for
+     * each cycle.
+     **/
+    bool onDemand;
+    bool selective;
+    vector<UINT32> lPolled;
+    ASIM_TIMING_WHEEL_CLASS<UINT32> wakeWheel;
+    vector<UINT32> lWoken;
+
+    /** Callbacks of modules clocked on demand invoked */
+    UINT64 nOnDemandClocks;
+
+    inline void WakeAt(UINT64 cycle, UINT32 pos)
+    {
+        wakeWheel.Schedule(cycle, pos);
+    }
+
+    /**
+     * Clock the modules of the current cycle: all of them, or the polled
+     * ones plus the ones woken up, in registration order.
+     **/
+    inline void ClockModules()
+    {
+        if (!selective)
+        {
+            for (UINT32 i = 0; i < lModules.size(); i++)
+            {
+                lModules[i].second->currentCycle = nCycle;
+                lModules[i].second->Clock();
+            }
+            return;
+        }
+
+        const vector<UINT32> &woken = wakeWheel.Expire(nCycle);
+        lWoken.assign(woken.begin(), woken.end());
+        if (lWoken.size() > 1)
+        {
+            sort(lWoken.begin(), lWoken.end());
+            lWoken.erase(unique(lWoken.begin(), lWoken.end()), lWoken.end());
+        }
+        nOnDemandClocks += lWoken.size();
+
+        UINT32 p = 0;
+        UINT32 w = 0;
+        while (p < lPolled.size() || w < lWoken.size())
+        {
+            UINT32 pos;
+            if (w == lWoken.size() ||
+                (p < lPolled.size() && lPolled[p] < lWoken[w]))
+            {
+                pos = lPolled[p++];
+            }
+            else
+            {
+                pos = lWoken[w++];
+            }
+            lModules[pos].second->currentCycle = nCycle;
+            lModules[pos].second->Clock();
+        }
+    }
+
     ClockRegistry(CLOCK_DOMAIN _clockDomain, UINT32 skew, UINT32 _dralSkew,
                   CLK_EDGE _edge, bool create_Dral_clk, bool withPhases)
         : nSkew(skew),
@@ -619,7 +763,10 @@ class ClockRegistry
           nBaseCycle(0),
           nCycle(0),
           clockDomain(_clockDomain),
-          nEventInstances(0)
+          nEventInstances(0),
+          onDemand(false),
+          selective(false),
+          nOnDemandClocks(0)
     {
         nFrequency = clockDomain->currentFrequency;
         EVENT(
@@ -698,6 +845,18 @@ class ASIM_CLOCK_SERVER_CLASS : public TRACEABLE_CLASS
         
     /** Threaded clocking? */
     bool threaded;
+
+    /** Do the threads send their DRAL events in parallel? (set by InitClockServerThreaded) */
+    bool threadedEvents;
+
+    /** Threaded clocking with traces on? And the trace buffers of the threads */
+    bool threadedTrace;
+    vector<TRACE_BUFFER> traceBuffers;
+
+    /** Pages of the port buffers per pinned worker (resident, remote),
+        counted at the first DumpStats after the data is homed */
+    map<ASIM_CLOCKSERVER_THREAD, pair<UINT64, UINT64> > threadPages;
+    bool threadPagesCounted;
         
     /** Clock registry of the reference clock domain */
     CLOCK_REGISTRY referenceClockRegitry;
@@ -746,6 +905,16 @@ class ASIM_CLOCK_SERVER_CLASS : public TRACEABLE_CLASS
     /** parse the fuzzy barrier lookahead parameter string and return base cycles */
     UINT64 LookaheadParam2BaseCycles( const string &lookahead );
 
+    /** Split the modules clocked every cycle from the ones clocked on
+        demand, and leave out the ones of other model partitions */
+    void InitModuleClocking(bool onDemandAllowed);
+
+    /** NUMA placement of the port buffers of the modules clocked by the
+        pinned worker threads (see ASIM_SMP_CLASS::SetAffinity): move them
+        to the node of the worker, or count their pages per worker */
+    void HomeThreadData();
+    void CountThreadData(map<ASIM_CLOCKSERVER_THREAD, pair<UINT64, UINT64> > &pages);
+
     /** Method that produces a random clock order within all the modules that
         belongs to a ClockRegistry */
     UINT64 RandomClock();
@@ -766,6 +935,9 @@ class ASIM_CLOCK_SERVER_CLASS : public TRACEABLE_CLASS
     /** Dump the profile info? */
     bool bDumpProfile;
 
+    /** Flame graph frames of a profiled callback: thread;domain;path */
+    string ProfileFrames(ASIM_CLOCKABLE m, CLOCK_REGISTRY reg);
+
     /**
      * @param a First operand
      * @param b Second operand
@@ -857,16 +1029,31 @@ class ASIM_CLOCK_SERVER_CLASS : public TRACEABLE_CLASS
         return (100*internalBaseCycle/Bf);
     }
 
+    /**
+     * Write the clocking profile: the per clockable report in
+     * clockserver.profile and the sampled host cycles of every callback
+     * in clockserver.folded, one "thread;domain;module;path count" line
+     * per callback as expected by flame graph tools.
+     **/
     void DumpProfile(void);
     void DumpStats(STATE_OUT state_out, UINT64 total_base_cycles);
 
+    /** Save/restore the clocking state in a timing checkpoint */
+    void SaveCheckpoint(ASIM_CHECKPOINT ckpt);
+    void RestoreCheckpoint(ASIM_CHECKPOINT ckpt);
+
     void InitClockServer(void);
     void StopClockServer(void);
 
-    /** Some methods to configure the clockserver */
-    void SetDumpProfile(bool _bDumpProfile)
+    /**
+     * Some methods to configure the clockserver.
+     * The profile samples one out of every samplePeriod clock callbacks
+     * (0 disables it).  It needs ASIM_ENABLE_PROFILE.
+     */
+    void SetDumpProfile(UINT32 samplePeriod)
     {
-        bDumpProfile = _bDumpProfile;
+        bDumpProfile = (samplePeriod != 0);
+        ClockCallBackInterface::profilePeriod = samplePeriod;
     }
 
     void SetRandomClockingSeed(UINT64 _random_seed)
@@ -883,6 +1070,15 @@ class ASIM_CLOCK_SERVER_CLASS : public TRACEABLE_CLASS
         threadLookahead = _lookahead;
     }
 
+    /** Keep the threaded clocking when traces are on (system parameter
+        THREADED_TRACING). The T1/T2, TMSG and TTMSG records of the threads
+        are buffered and written in the order of the serial clocking;
+        TRACE() blocks printing on their own are not. */
+    void SetThreadedTracing(bool active)
+    {
+        threadedTrace = active;
+    }
+
     void SetUniqueDomainOptimization(bool active)
     {
         uniqueDomainOptimization = active;
@@ -0,0 +1,309 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ *
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the Intel Corporation nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @author Pau Cabre
+ * @brief DAMQueue with a bitmask of the occupied entries.
+ */
+
+#ifndef _DAMQUEUE_SOA_H
+#define _DAMQUEUE_SOA_H
+
+// ASIM core
+#include "asim/syntax.h"
+#include "asim/mesg.h"
+
+//
+// DAMQueueSoA<T> has the same interface and returns the same entry numbers
+// as DAMQueue<T>. DAMQueue finds occupied and free entries by testing the
+// Data array one slot at a time for NULL; this version keeps one bit per
+// slot in a separate array and finds the next occupied (or free) slot with a
+// find-first-set over 64 slots at a time.
+//
+template <class T>
+class DAMQueueSoA
+{
+  public:
+    DAMQueueSoA<T>()
+        :  Data(NULL), Valid(NULL), Head(0), Size(0), SearchPtr(0), Dummy(0), MaxSize(0)
+    {}
+
+    void   Init(UINT16 n);
+    bool   Exists(void);
+    bool   IsEmpty(void);
+    bool   IsFull(void);
+    void   Store(T t);
+    T      GetEntry(UINT16 n);
+    void   DelEntry(UINT16 n);
+    UINT16 GetOccupancy(void);
+    UINT16 GetCapacity(void);
+    UINT16 GetFreeSpace(void);
+    INT16  GetNextEntryNum(void);
+    T      GetNextEntry(void);
+    INT16  GetCurrentEntryNum(void);
+    void   ResetSearchPtr(void);
+
+  protected:
+    // first slot in [from, to) whose valid bit equals 'set', -1 if none
+    INT32  FindLinear(UINT16 from, UINT16 to, bool set);
+
+    // same, but the range wraps around the end of the array when from > to.
+    // from == to is an empty range.
+    INT32  FindCircular(UINT16 from, UINT16 to, bool set);
+
+    bool   IsValid(UINT16 n) { return (Valid[n / 64] >> (n % 64)) & 1; }
+
+    T	    *Data;
+    UINT64  *Valid;
+    UINT16  Head;
+    UINT16  Size;
+    UINT16  SearchPtr;
+    UINT16  Dummy;
+    UINT16  MaxSize;
+};
+
+
+
+template <class T>
+void DAMQueueSoA<T>::Init(UINT16 n)
+{
+    if (n != 0)
+    {
+        // allocate one extra buffer for queue management
+        MaxSize = n;
+        Dummy = n+1;
+        Data = new T[Dummy];
+        Valid = new UINT64[(Dummy + 63) / 64];
+        for (UINT16 i=0; i<Dummy; i++)
+            Data[i] = NULL;
+        for (UINT16 i=0; i<(Dummy + 63) / 64; i++)
+            Valid[i] = 0;
+    }
+    else
+    {
+        MaxSize = 0;
+        Dummy = 0;
+        Data = NULL;
+        Valid = NULL;
+    }
+}
+
+
+
+template <class T>
+INT32 DAMQueueSoA<T>::FindLinear(UINT16 from, UINT16 to, bool set)
+{
+    if (from >= to)
+        return -1;
+
+    UINT32 w = from / 64;
+    UINT32 lastw = (to - 1) / 64;
+    UINT64 bits = (set ? Valid[w] : ~Valid[w]) & (~UINT64(0) << (from % 64));
+    for (;;)
+    {
+        if (w == lastw && ((to % 64) != 0))
+            bits &= (UINT64(1) << (to % 64)) - 1;
+        if (bits)
+            return w * 64 + __builtin_ctzll(bits);
+        if (w == lastw)
+            return -1;
+        w++;
+        bits = set ? Valid[w] : ~Valid[w];
+    }
+}
+
+
+
+template <class T>
+INT32 DAMQueueSoA<T>::FindCircular(UINT16 from, UINT16 to, bool set)
+{
+    if (from <= to)
+        return FindLinear(from, to, set);
+
+    INT32 i = FindLinear(from, Dummy, set);
+    return (i != -1) ? i : FindLinear(0, to, set);
+}
+
+
+
+template <class T>
+inline
+bool DAMQueueSoA<T>::Exists(void)
+{
+    return Dummy > 1; // one extra buffer added on
+}
+
+
+
+template <class T>
+inline
+bool DAMQueueSoA<T>::IsFull(void)
+{
+    VERIFY(Exists(), "DAMQueue is not initialized\n");
+    return (Size == MaxSize);
+}
+
+
+
+template <class T>
+inline
+bool DAMQueueSoA<T>::IsEmpty(void)
+{
+    VERIFY(Exists(), "DAMQueue is not initialized\n");
+    return (!Size);
+}
+
+
+
+template <class T>
+inline
+UINT16 DAMQueueSoA<T>::GetOccupancy(void)
+{
+    VERIFY(Exists(), "DAMQueue is not initialized\n");
+    return (Size);
+}
+
+
+
+template <class T>
+inline
+UINT16 DAMQueueSoA<T>::GetCapacity(void)
+{
+    VERIFY(Exists(), "DAMQueue is not initialized\n");
+    return (MaxSize);
+}
+
+
+
+template <class T>
+inline
+UINT16 DAMQueueSoA<T>::GetFreeSpace(void)
+{
+    VERIFY(Exists(), "DAMQueue is not initialized\n");
+    return (MaxSize - Size);
+}
+
+
+
+template <class T>
+INT16 DAMQueueSoA<T>::GetNextEntryNum(void)
+{
+    VERIFY(Exists(), "DAMQueue is not initialized\n");
+    UINT16 mark = (Head + MaxSize) % Dummy; // that is, (Head - 1) % Dummy
+    INT32 i = FindCircular((SearchPtr + 1) % Dummy, mark, true);
+    SearchPtr = (i == -1) ? mark : i;
+    return i;
+}
+
+
+
+template <class T>
+T DAMQueueSoA<T>::GetNextEntry(void)
+{
+    INT16 i = GetNextEntryNum();
+    return (i == -1) ? NULL : Data[i];
+}
+
+
+
+template <class T>
+void DAMQueueSoA<T>::Store(T t)
+{
+    VERIFY(!IsFull(), "DAMQueue is full\n");
+    INT32 i = Head;
+    if (!IsEmpty())
+    {
+        i = FindCircular((Head + 1) % Dummy, Head, false);
+        if (i == -1)
+            ASIMERROR("DAMQueueSoA<T>::Store() could not find a free entry\n");
+        VERIFYX(i != ((Head + MaxSize) % Dummy));  // (Head-1)%Dummy should always be NULL
+    }
+    Data[i] = t;
+    // like in DAMQueue, a NULL entry counts in the occupancy but its slot
+    // stays free
+    if (t)
+        Valid[i / 64] |= UINT64(1) << (i % 64);
+    Size++;
+}
+
+
+
+template <class T>
+void DAMQueueSoA<T>::DelEntry(UINT16 n)
+{
+    VERIFY(Exists(), "DAMQueue is not initialized\n");
+    VERIFY(n < Dummy, "Index exceeds DAMQueue limits\n");
+    VERIFY(IsValid(n), "Entry does not exists\n");
+
+    Data[n] = NULL; //this should be compatible with Smart Pointers
+    Valid[n / 64] &= ~(UINT64(1) << (n % 64));
+    Size--;
+    UINT16 mark = (Head + MaxSize) % Dummy; // that is, (Head - 1) % Dummy
+    INT32 i = FindCircular(Head, mark, true);
+    Head = (i == -1) ? mark : i;
+}
+
+
+
+template <class T>
+inline
+T DAMQueueSoA<T>::GetEntry(UINT16 n)
+{
+    VERIFY(Exists(), "DAMQueue is not initialized\n");
+    VERIFY(n < Dummy, "Index exceeds DAMQueue limits\n");
+    VERIFY(IsValid(n), "Entry 'n' is empty\n");
+    return Data[n];
+}
+
+
+
+template <class T>
+inline
+void DAMQueueSoA<T>::ResetSearchPtr(void)
+{
+    VERIFY(Exists(), "DAMQueue is not initialized\n");
+    SearchPtr = Head;
+}
+
+
+
+template <class T>
+inline
+INT16 DAMQueueSoA<T>::GetCurrentEntryNum(void)
+{
+    if (!IsEmpty())
+        return SearchPtr;
+    else
+        return -1;
+}
+
+
+#endif //_DAMQUEUE_SOA_H
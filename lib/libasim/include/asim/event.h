@@ -94,6 +94,17 @@ class ASIM_DRAL_EVENT_CLASS
     ~ASIM_DRAL_EVENT_CLASS();
 
     static void InitEvent();
+
+    // Keep only the last blocks*cycles cycles of events in memory (see
+    // DRAL_SERVER_CLASS::SetFlightRecorder) and write them when the model
+    // dies on an error or a failed assertion, or gets SIGUSR2. The events
+    // must have been initialized and not turned on yet.
+    static void StartFlightRecorder(UINT64 cycles, UINT32 blocks);
+
+    // Write the events kept by the flight recorder now (the classic
+    // controllers' CMD_DumpFlightRecorder, -frdumpc/-frdumpi). Returns
+    // false if there is no flight recorder.
+    static bool DumpFlightRecorder();
 };
 
 #endif /* _EVENT_ */
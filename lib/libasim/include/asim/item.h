@@ -66,15 +66,22 @@ class ASIM_ITEM_CLASS
     // not present, then the basic types (bool, UINT16, etc.) are casted to
     // ASIM_ITEM_CLASS when traveling trough ports (and then automatic events
     // would be generated).
+    //
+    // The item only takes an id here. Its NewItem event is sent the first
+    // time the id is used (see EnsureAnnounced), so items that never show
+    // up in the event stream do not produce NewItem/DeleteItem events at all.
+    //
     explicit ASIM_ITEM_CLASS(bool generateEvents = true) :
+      itemId(0),
       recId(0),
       threadId(0),
       eventsEnabled(generateEvents),
-      idGenerated(false)
+      idGenerated(false),
+      idAnnounced(false)
     {     
         if (runWithEventsOn && eventsEnabled)
         {
-            EVENT(itemId = DRALEVENT(NewItem()));
+            EVENT(itemId = DRALEVENT(AllocItemId()));
             idGenerated = true;
         }
     }
@@ -88,11 +95,12 @@ class ASIM_ITEM_CLASS
     {
         itemId = i;
         idGenerated = true;
+        idAnnounced = true;
     }
 
     ~ASIM_ITEM_CLASS() 
     { 
-        if (runWithEventsOn && idGenerated)
+        if (runWithEventsOn && idAnnounced)
         {
             DRALEVENT_GUARDED(DeleteItem(itemId));
         }
@@ -112,7 +120,7 @@ class ASIM_ITEM_CLASS
     {
         if (runWithEventsOn)
         {
-            if (idGenerated)
+            if (idAnnounced)
             {
                 // kill the current item because we are going to 
                 // inherit aic's dral/ptv id
@@ -124,12 +132,14 @@ class ASIM_ITEM_CLASS
             // inherit from aic
             itemId = aic.itemId;
             idGenerated = aic.idGenerated;
+            idAnnounced = aic.idAnnounced;
             recId = aic.recId;
             threadId = aic.threadId;
             
             // dissaociate aic from the id's.
             aic.itemId = 0;
             aic.idGenerated = false;
+            aic.idAnnounced = false;
             aic.recId = 0;
             aic.threadId = 0;
         }
@@ -137,6 +147,7 @@ class ASIM_ITEM_CLASS
         {
             itemId = 0;
             idGenerated = false;
+            idAnnounced = false;
             recId = 0;
             threadId = 0;
         }
@@ -165,12 +176,25 @@ class ASIM_ITEM_CLASS
 
         if (eventsEnabled && !idGenerated)
         {
-            EVENT(itemId = DRALEVENT(NewItem()));
+            EVENT(itemId = DRALEVENT(AllocItemId()));
             idGenerated = true;
         }
     }
 
-    UINT64 GetItemId() const { return(itemId);}
+    // Sends the NewItem event of the item, once. Call it before the id is
+    // used in an event: GetItemId alone does not announce the item.
+    void EnsureAnnounced() const
+    {
+        EVENT(
+            if (!idAnnounced && idGenerated && runWithEventsOn)
+            {
+                DRALEVENT(NewItem(UINT32(itemId)));
+                idAnnounced = true;
+            }
+        );
+    }
+
+    UINT64 GetItemId() const { return(itemId); }
 
     bool GetEventsEnabled() const { return eventsEnabled; };
 
@@ -184,6 +208,7 @@ class ASIM_ITEM_CLASS
     {
         if (runWithEventsOn && eventsEnabled)
         {
+            EnsureAnnounced();
             DRALEVENT(SetItemTag(itemId, tag_name, value,persistent));
         }
     }
@@ -193,6 +218,7 @@ class ASIM_ITEM_CLASS
     {
         if (runWithEventsOn && eventsEnabled)
         {
+            EnsureAnnounced();
             DRALEVENT(SetItemTag(itemId, tag_name, value,persistent));
         }
     }
@@ -202,6 +228,7 @@ class ASIM_ITEM_CLASS
     {
         if (runWithEventsOn && eventsEnabled)
         {
+            EnsureAnnounced();
             DRALEVENT(SetItemTag(itemId, tag_name, value, persistent));
         }
     }
@@ -211,6 +238,7 @@ class ASIM_ITEM_CLASS
     {
         if (runWithEventsOn && eventsEnabled)
         {
+            EnsureAnnounced();
             DRALEVENT(SetItemTag(itemId, tag_name, value, persistent));
         }
     }
@@ -221,6 +249,7 @@ class ASIM_ITEM_CLASS
     {
         if (runWithEventsOn && eventsEnabled)
         {
+            EnsureAnnounced();
             DRALEVENT(SetItemTag(itemId, tag_name, str, persistent));
         }
     }
@@ -230,6 +259,7 @@ class ASIM_ITEM_CLASS
     {
         if (runWithEventsOn && eventsEnabled)
         {
+            EnsureAnnounced();
             DRALEVENT(SetItemTag(itemId, tag_name, character, persistent));
         }
     }
@@ -240,6 +270,7 @@ class ASIM_ITEM_CLASS
     {
         if (runWithEventsOn && eventsEnabled)
         {
+            EnsureAnnounced();
             DRALEVENT(SetItemTag(itemId, tag_name, nval, value, persistent));
         }
     }
@@ -413,6 +444,7 @@ class ASIM_ITEM_CLASS
             EVENT(
                   va_list ap;
                   va_start(ap, data);
+                  EnsureAnnounced();
                   DRALEVENT(SetItemTag(itemId, recId, data, ap));
                   va_end(ap);
                   );
@@ -439,6 +471,7 @@ class ASIM_ITEM_CLASS
             EVENT(
                   va_list ap;
                   va_start(ap, data);
+                  EnsureAnnounced();
                   DRALEVENT(SetEvent(itemId, recId, desc, cycle, duration, data, ap));
                   va_end(ap);
                   );
@@ -460,6 +493,7 @@ class ASIM_ITEM_CLASS
                   
                   va_list ap;
                   va_start(ap, data);
+                  EnsureAnnounced();
                   DRALEVENT(SetEvent(itemId, recId, desc, cycle, duration, data, ap));
                   va_end(ap);
                   );
@@ -479,6 +513,9 @@ class ASIM_ITEM_CLASS
     bool eventsEnabled;
 
     bool idGenerated;
+
+    // the NewItem event has been sent
+    mutable bool idAnnounced;
 };
 
 /*
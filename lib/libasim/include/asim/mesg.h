@@ -123,6 +123,11 @@ extern ASIM_MESG_CLASS asim_assert;
 // Global ASIM message mutex for thread safe logging
 extern pthread_mutex_t asim_mesg_mutex;
 
+// Called once, right before an error or a failed assertion terminates the
+// program, to save whatever helps debugging it (NULL by default). A new
+// hook calls the one it replaces.
+extern void (*asim_terminate_hook)(void);
+
 //------------------------------------------------------------------------------
 //
 // Assertion macros
@@ -58,6 +58,7 @@
 #include "asim/atomic.h"
 #include "asim/smp.h"
 #include "asim/freelist.h"
+#include "asim/checkpoint.h"
 
 namespace iof = IoFormat;
 using namespace iof;
@@ -78,6 +79,27 @@ typedef UINT64 MM_UID_TYPE;
 template<> \
 ASIM_MM_CLASS<M>::DATA ASIM_MM_CLASS<M>::data(MAX*ASIM_MM_SCALE, #M);
 
+/**
+ * Same as ASIM_MM_DEFINE for MM classes whose objects can be restored
+ * from a timing checkpoint.  M must have a default constructor and
+ * override SaveCheckpoint() and RestoreCheckpoint().
+ */
+#define ASIM_MM_DEFINE_CHECKPOINTABLE(M, MAX) \
+template<> \
+ASIM_MM_CLASS<M>::DATA ASIM_MM_CLASS<M>::data(MAX*ASIM_MM_SCALE, #M, \
+    ASIM_MM_DEFAULT_MAGIC, &AsimMMCheckpointAlloc<M>);
+
+//                                   magic = 0xf.d.b.9.  -->
+//                                             .0.2.4.6  <--
+#define ASIM_MM_DEFAULT_MAGIC 0xf0d2b496
+
+/// Allocator used to re-create MM objects when restoring a checkpoint
+template <typename M>
+M *AsimMMCheckpointAlloc(void)
+{
+    return new M();
+}
+
 // allocate all memory of the pool at once (rather than each object on demand)
 #define MM_PREALLOC_MEMORY
 
@@ -247,10 +269,13 @@ class ASIM_MM_CLASS : public ASIM_FREE_LIST_ELEMENT_CLASS<MM_TYPE>
 
         bool destructed;        ///< has destructor for this already run
 
+        /// Allocator for objects restored from a checkpoint (NULL if
+        /// the class does not support checkpoints)
+        MM_TYPE *(*checkpointAlloc)(void);
+
         // constructors/destructors
-                                         //   magic = 0xf.d.b.9.  -->
-                                         //             .0.2.4.6  <--
-        DATA (UINT32 max, string name, UINT32 magic = 0xf0d2b496);
+        DATA (UINT32 max, string name, UINT32 magic = ASIM_MM_DEFAULT_MAGIC,
+              MM_TYPE *(*alloc)(void) = NULL);
         ~DATA();
 
         /// Dispose of objects properly at end of run
@@ -337,10 +362,23 @@ class ASIM_MM_CLASS : public ASIM_FREE_LIST_ELEMENT_CLASS<MM_TYPE>
     /// Dump MM info about this object
     virtual void Dump(int count) const;
 
+    // timing checkpoints
+    /// Save the contents of this object (not supported by default)
+    virtual void SaveCheckpoint(ASIM_CHECKPOINT ckpt) const;
+    /// Restore the contents of this object (not supported by default)
+    virtual void RestoreCheckpoint(ASIM_CHECKPOINT ckpt);
+
     // static methods
     /// Reset maximum number of objects in allocation pool to new value
     static void SetMaxObjs(UINT32 max);
 
+    /// Save a reference to 'obj', followed by its contents the first
+    /// time the object is seen in this checkpoint
+    static void SaveCheckpointRef(ASIM_CHECKPOINT ckpt, const MM_TYPE *obj);
+    /// Restore a reference saved with SaveCheckpointRef, re-creating
+    /// the object the first time it is seen
+    static mmptr<MM_TYPE> RestoreCheckpointRef(ASIM_CHECKPOINT ckpt);
+
   private:
 
     /// Put object back on free list if last reference is dropped
@@ -362,7 +400,8 @@ template <typename MM_TYPE>
 ASIM_MM_CLASS<MM_TYPE>::DATA::DATA (
     UINT32 max,   ///< max number of objects of this type
     string name,  ///< name of this MM object type
-    UINT32 magic) ///< magic key for this MM object type (only in debug mode)
+    UINT32 magic, ///< magic key for this MM object type (only in debug mode)
+    MM_TYPE *(*alloc)(void)) ///< allocator for restoring checkpoints
   : className(name),
 #ifdef ASIM_ENABLE_MM_DEBUG
     mmMagicKey(magic),
@@ -372,7 +411,8 @@ ASIM_MM_CLASS<MM_TYPE>::DATA::DATA (
 #ifdef MM_OBJ_DUMP
     mmObjListHead(NULL),
 #endif
-    destructed(false)
+    destructed(false),
+    checkpointAlloc(alloc)
 {
 #ifdef MM_PREALLOC_MEMORY
    // clear "preallocation done" flag initially
@@ -859,6 +899,88 @@ const
     cout << " mmCnt " << mmCnt << endl;
 }
 
+/**
+ * Save the contents of this object in a timing checkpoint.  MM classes
+ * that travel through ports or are referenced from checkpointed state
+ * have to override this.
+ */
+template <typename MM_TYPE>
+void
+ASIM_MM_CLASS<MM_TYPE>::SaveCheckpoint (
+    ASIM_CHECKPOINT ckpt)
+const
+{
+    ASIMERROR("MM class " << data.className
+              << " does not support timing checkpoints");
+}
+
+template <typename MM_TYPE>
+void
+ASIM_MM_CLASS<MM_TYPE>::RestoreCheckpoint (
+    ASIM_CHECKPOINT ckpt)
+{
+    ASIMERROR("MM class " << data.className
+              << " does not support timing checkpoints");
+}
+
+/**
+ * Objects are saved once per checkpoint, the first time they are
+ * referenced, so objects shared by several mmptr's are shared again
+ * after restoring.
+ */
+template <typename MM_TYPE>
+void
+ASIM_MM_CLASS<MM_TYPE>::SaveCheckpointRef (
+    ASIM_CHECKPOINT ckpt,
+    const MM_TYPE *obj)
+{
+    bool isNew;
+    UINT64 id = ckpt->SaveObjectId(obj, isNew);
+
+    ckpt->Save(id);
+    if (isNew)
+    {
+        const ASIM_MM_CLASS<MM_TYPE> *mm = obj;
+        ckpt->Save(mm->mmUid);
+        mm->SaveCheckpoint(ckpt);
+    }
+}
+
+template <typename MM_TYPE>
+mmptr<MM_TYPE>
+ASIM_MM_CLASS<MM_TYPE>::RestoreCheckpointRef (
+    ASIM_CHECKPOINT ckpt)
+{
+    UINT64 id;
+    ckpt->Restore(id);
+    if (id == 0)
+    {
+        return mmptr<MM_TYPE>();
+    }
+
+    MM_TYPE *obj = (MM_TYPE *) ckpt->LookupObject(id);
+    if (obj != NULL)
+    {
+        return mmptr<MM_TYPE>(obj);
+    }
+
+    VERIFY(data.checkpointAlloc != NULL, "MM class " << data.className
+           << " cannot be restored from a checkpoint (not defined with"
+           << " ASIM_MM_DEFINE_CHECKPOINTABLE)");
+
+    // hold a reference while restoring: the contents may point back to
+    // the object itself
+    obj = data.checkpointAlloc();
+    mmptr<MM_TYPE> ref(obj);
+    ckpt->RegisterObject(id, obj);
+
+    ASIM_MM_CLASS<MM_TYPE> *mm = obj;
+    ckpt->Restore(mm->mmUid);
+    mm->RestoreCheckpoint(ckpt);
+
+    return ref;
+}
+
 #ifdef ASIM_ENABLE_MM_DEBUG
 /**
  * Check if this object is legal to access, i.e. if there are known
@@ -991,5 +1113,18 @@ ASIM_MM_CLASS_PER_THREAD_FREE_LISTS<MM_TYPE>::Size(void) const
     return freeListObjs;
 }
 
+/**
+ * mmptr's are checkpointed by reference, preserving object identity.
+ */
+template <class T>
+struct ASIM_CHECKPOINT_TRAITS< mmptr<T> >
+{
+    static void Save(ASIM_CHECKPOINT ckpt, const mmptr<T> &val)
+    { ASIM_MM_CLASS<T>::SaveCheckpointRef(ckpt, val); }
+
+    static void Restore(ASIM_CHECKPOINT ckpt, mmptr<T> &val)
+    { val = ASIM_MM_CLASS<T>::RestoreCheckpointRef(ckpt); }
+};
+
 #endif // _MM_
 
@@ -311,18 +311,20 @@ class ASIM_DRAL_NODE_CLASS
         if (runWithEventsOn && active && item->GetEventsEnabled())
         {
            EVENT(UINT32 positions[1] = {position});
+           item->EnsureAnnounced();
            DRALEVENT(EnterNode(
                           uniqueId, item->GetItemId(),1,positions,persistent));
         }
     }
 
     inline void EnterNode (
-       ASIM_ITEM_CLASS item, UINT32 position,
+       const ASIM_ITEM_CLASS & item, UINT32 position,
        bool persistent=false)
     {
         if (runWithEventsOn && active && item.GetEventsEnabled())
         {
            EVENT(UINT32 positions[1] = {position});
+           item.EnsureAnnounced();
            DRALEVENT(EnterNode(
                           uniqueId, item.GetItemId(),1,positions,persistent));
         }
@@ -335,18 +337,20 @@ class ASIM_DRAL_NODE_CLASS
         if (runWithEventsOn && active && item->GetEventsEnabled())
         {
            EVENT(UINT32 positions[2] = { position1, position2 });
+           item->EnsureAnnounced();
            DRALEVENT(EnterNode(
                           uniqueId, item->GetItemId(), 2, positions, persistent));
         }
     }
 
     inline void EnterNode (
-       ASIM_ITEM_CLASS item, UINT32 position1, UINT32 position2,
+       const ASIM_ITEM_CLASS & item, UINT32 position1, UINT32 position2,
        bool persistent=false)
     {
         if (runWithEventsOn && active && item.GetEventsEnabled())
         {
            EVENT(UINT32 positions[2] = {position1, position2});
+           item.EnsureAnnounced();
            DRALEVENT(EnterNode(
                           uniqueId, item.GetItemId(),2,positions,persistent));
         }
@@ -358,17 +362,19 @@ class ASIM_DRAL_NODE_CLASS
     {
         if (runWithEventsOn && active && item->GetEventsEnabled())
         {
+            item->EnsureAnnounced();
             DRALEVENT(EnterNode(
                           uniqueId, item->GetItemId(),dimensions,position,persistent));
         }
     }
 
     inline void EnterNode (
-       ASIM_ITEM_CLASS item, UINT16 dimensions, UINT32 position[],
+       const ASIM_ITEM_CLASS & item, UINT16 dimensions, UINT32 position[],
        bool persistent=false)
     {
         if (runWithEventsOn && active && item.GetEventsEnabled())
         {
+            item.EnsureAnnounced();
             DRALEVENT(EnterNode(
                           uniqueId, item.GetItemId(),dimensions,position,persistent));
         }
@@ -381,18 +387,20 @@ class ASIM_DRAL_NODE_CLASS
         if (runWithEventsOn && active && item->GetEventsEnabled())
         {
            EVENT(UINT32 positions[1] = {position});
+           item->EnsureAnnounced();
            DRALEVENT(ExitNode(
                           uniqueId, item->GetItemId(),1,positions,persistent));
         }
     }
 
     inline void ExitNode (
-       ASIM_ITEM_CLASS item, UINT32 position,
+       const ASIM_ITEM_CLASS & item, UINT32 position,
        bool persistent=false)
     {
         if (runWithEventsOn && active && item.GetEventsEnabled())
         {
            EVENT(UINT32 positions[1] = {position});
+           item.EnsureAnnounced();
            DRALEVENT(ExitNode(
                           uniqueId, item.GetItemId(),1,positions,persistent));
         }
@@ -405,18 +413,20 @@ class ASIM_DRAL_NODE_CLASS
         if (runWithEventsOn && active && item->GetEventsEnabled())
         {
            EVENT(UINT32 positions[2] = { position1, position2 });
+           item->EnsureAnnounced();
            DRALEVENT(ExitNode(
                           uniqueId, item->GetItemId(), 2, positions, persistent));
         }
     }
 
     inline void ExitNode (
-       ASIM_ITEM_CLASS item, UINT32 position1, UINT32 position2, 
+       const ASIM_ITEM_CLASS & item, UINT32 position1, UINT32 position2, 
        bool persistent=false)
     {
         if (runWithEventsOn && active && item.GetEventsEnabled())
         {
            EVENT(UINT32 positions[2] = {position1, position2});
+           item.EnsureAnnounced();
            DRALEVENT(ExitNode(
                           uniqueId, item.GetItemId(),2,positions,persistent));
         }
@@ -428,17 +438,19 @@ class ASIM_DRAL_NODE_CLASS
     {
         if (runWithEventsOn && active && item->GetEventsEnabled())
         {
+            item->EnsureAnnounced();
             DRALEVENT(ExitNode(
                           uniqueId, item->GetItemId(),dimensions,position,persistent));
         }
     }
 
     inline void ExitNode (
-       ASIM_ITEM_CLASS item, UINT16 dimensions, UINT32 position[],
+       const ASIM_ITEM_CLASS & item, UINT16 dimensions, UINT32 position[],
        bool persistent=false)
     {
         if (runWithEventsOn && active && item.GetEventsEnabled())
         {
+            item.EnsureAnnounced();
             DRALEVENT(ExitNode(
                           uniqueId, item.GetItemId(),dimensions,position,persistent));
         }
@@ -697,6 +709,20 @@ class ASIM_MODULE_CLASS : public ASIM_REGISTRY_CLASS, public ASIM_DRAL_NODE_CLAS
          * the state of all contained modules
          */
         virtual void LoadFunctionalState(istream& in);
+
+        /*
+         * Save the timing state of this module (its registered stats)
+         * in a checkpoint and then recursively the state of all
+         * contained modules.  Modules keeping timing state outside of
+         * ports and stats should override these and call the base.
+         */
+        virtual void SaveCheckpoint(ASIM_CHECKPOINT ckpt);
+
+        /*
+         * Restore the timing state of this module and then recursively
+         * the state of all contained modules.
+         */
+        virtual void RestoreCheckpoint(ASIM_CHECKPOINT ckpt);
         
         /*
          * Clear this module statistics and then recursively the stats
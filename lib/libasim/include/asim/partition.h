@@ -0,0 +1,287 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ *
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the Intel Corporation nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @author Pau Cabre
+ * @brief Split a model across several processes of the same host.
+ *
+ * Every process builds the whole model but only clocks the modules of
+ * its own partition (ASIM_CLOCKABLE_CLASS::SetPartition, inherited by
+ * the children, 0 by default).  The ports that connect modules of two
+ * partitions keep their buffer in a POSIX shared memory segment, named
+ * after the job, as a ring with one row per write cycle.  Their data
+ * type is copied as raw bytes, so it has to be declared with
+ * ASIM_SHARED_PORT_POD.
+ *
+ * The clock servers of the processes synchronize through the segment
+ * with a conservative barrier: a process may clock base cycle t once
+ * every other partition is done with t - lookahead, where lookahead is
+ * the smallest latency of a crossing port (in base cycles).  Data
+ * written to a crossing port is therefore always in the ring before
+ * its reader can look for it.  Crossing ports must be plain ReadPorts,
+ * which read every row in the cycle it becomes visible, with a
+ * latency of at least 1 cycle, and connect modules of the same clock
+ * domain.  Their readers are not woken by the writes of the other
+ * process, so they cannot be clocked on demand.  Threaded and random
+ * clocking are not supported.
+ */
+
+#ifndef _PARTITION_
+#define _PARTITION_
+
+// generic
+#include <string.h>
+#include <string>
+#include <vector>
+
+// ASIM core
+#include "asim/syntax.h"
+#include "asim/mesg.h"
+#include "asim/atomic.h"
+
+using namespace std;
+
+typedef class ASIM_CLOCKABLE_CLASS *ASIM_CLOCKABLE;
+typedef class ClockRegistry *CLOCK_REGISTRY;
+typedef class ASIM_SHARED_PORT_CLASS *ASIM_SHARED_PORT;
+
+/**
+ * Types that can be sent through a port crossing two partitions.
+ */
+template <class T>
+struct ASIM_SHARED_PORT_TRAITS
+{
+    enum { value = false };
+};
+
+#define ASIM_SHARED_PORT_POD(T) \
+template <> \
+struct ASIM_SHARED_PORT_TRAITS<T> \
+{ \
+    enum { value = true }; \
+};
+
+ASIM_SHARED_PORT_POD(bool)
+ASIM_SHARED_PORT_POD(char)
+ASIM_SHARED_PORT_POD(signed char)
+ASIM_SHARED_PORT_POD(unsigned char)
+ASIM_SHARED_PORT_POD(short)
+ASIM_SHARED_PORT_POD(unsigned short)
+ASIM_SHARED_PORT_POD(int)
+ASIM_SHARED_PORT_POD(unsigned int)
+ASIM_SHARED_PORT_POD(long)
+ASIM_SHARED_PORT_POD(unsigned long)
+ASIM_SHARED_PORT_POD(long long)
+ASIM_SHARED_PORT_POD(unsigned long long)
+ASIM_SHARED_PORT_POD(float)
+ASIM_SHARED_PORT_POD(double)
+
+
+/**
+ * Partitioning of the model among processes (a single static instance).
+ */
+class ASIM_PARTITION_CLASS
+{
+  public:
+    enum { MAX_PARTITIONS = 64 };
+
+  private:
+    /// Layout of the start of the shared segment
+    struct CONTROL
+    {
+        UINT64 magic;
+        UINT32 numPartitions;
+        volatile INT32 attached;
+        /// pid of partition 0, set before the magic
+        INT32 creator;
+        char pad[44];
+        /// Per partition: last base time (x100) clocked, one cache line each
+        struct
+        {
+            volatile INT64 done;
+            char pad[56];
+        } part[MAX_PARTITIONS];
+    };
+
+    static UINT32 numPartitions;
+    static UINT32 localPartition;
+    static string segmentName;
+    static char *segment;
+    static UINT64 segmentSize;
+    static UINT64 segmentUsed;
+    static CONTROL *control;
+
+    /// Crossing ports, for the lookahead
+    struct CROSSING
+    {
+        ASIM_CLOCKABLE writer;
+        ASIM_CLOCKABLE reader;
+        UINT32 latency;
+        const char *name;
+    };
+    static vector<CROSSING> crossing;
+    static INT64 lookahead;
+    static INT64 nextDone;
+
+    static const UINT64 MAGIC = 0x6173696d70617274ULL;
+
+    static INT32 LiveCreator(void);
+    static bool AttachFresh(UINT64 size);
+
+  public:
+    /**
+     * Join partition 'local' of 'num' (num <= 1 means no partitioning).
+     * Must be called before the ports are connected.  'job' names the
+     * shared segment and has to be the same in all the processes of
+     * the run, and unique among the runs sharing the host: partition 0
+     * refuses a name whose segment belongs to a live run.  The segment
+     * is sparse: only the memory of the crossing ports is touched.  The
+     * other partitions wait for partition 0 to create it, and ignore a
+     * segment left by a run that crashed.
+     */
+    static void Init(UINT32 num, UINT32 local, const char *job,
+                     UINT64 size = 256ULL << 20);
+
+    /// Leave the partitioned run: the others do not wait for us anymore
+    static void Shutdown(void);
+
+    static bool IsActive(void) { return numPartitions > 1; }
+    static UINT32 GetNumPartitions(void) { return numPartitions; }
+    static UINT32 GetLocalPartition(void) { return localPartition; }
+
+    /// Is the clockable (NULL = partition 0) clocked by this process?
+    static bool IsLocal(ASIM_CLOCKABLE m);
+    /// Does a port from 'writer' to 'reader' cross two partitions?
+    static bool IsCrossing(ASIM_CLOCKABLE writer, ASIM_CLOCKABLE reader);
+
+    /// Shared memory for a crossing port (zero filled, 64B aligned)
+    static void *Allocate(UINT64 bytes);
+    static void AddCrossingPort(ASIM_CLOCKABLE writer, ASIM_CLOCKABLE reader,
+                                UINT32 latency, const char *name);
+
+    /**
+     * Clock server side.  ComputeLookahead() runs at InitClockServer,
+     * once the clock steps are known.  Before clocking base time 't'
+     * (x100, as ClockRegistry::nBaseCycle), WaitFor(t) publishes the
+     * previous time clocked and waits for the other partitions.
+     */
+    static void ComputeLookahead(void);
+    static INT64 GetLookahead(void) { return lookahead; }
+    static void WaitFor(INT64 t);
+};
+
+
+/**
+ * Shared memory ring behind a port crossing two partitions.  Row
+ * (cycle & mask) holds the items written at 'cycle'.  Rows are only
+ * read once the writer partition is done with their cycle, and the
+ * ring is long enough (2 * latency + 2 rows) for the writer never to
+ * reuse a row that can still be read.
+ */
+class ASIM_SHARED_PORT_CLASS
+{
+  private:
+    struct ROW
+    {
+        INT64 cycle;
+        UINT32 count;
+        UINT32 pad;
+    };
+
+    char *rows;
+    UINT32 rowBytes;
+    UINT32 mask;
+    UINT32 elemSize;
+    UINT32 bandwidth;
+    UINT32 latency;
+
+    // reader side, private to the reader process
+    INT64 readCycle;
+    UINT32 readPos;
+
+    ROW *GetRow(UINT64 cycle) const
+    {
+        return reinterpret_cast<ROW *>(rows + (cycle & mask) * rowBytes);
+    }
+
+  public:
+    ASIM_SHARED_PORT_CLASS(UINT32 elemSize, UINT32 bandwidth, UINT32 latency);
+
+    void Write(const void *data, UINT64 cycle, const char *portName)
+    {
+        ROW *row = GetRow(cycle);
+        if (row->cycle != (INT64)cycle)
+        {
+            row->count = 0;
+            row->cycle = cycle;
+        }
+        ASSERT(row->count < bandwidth, "Port " << portName
+               << " exceeded bandwidth (" << bandwidth << ")!");
+        memcpy((char *)(row + 1) + row->count * elemSize, data, elemSize);
+        row->count++;
+    }
+
+    bool Read(void *data, UINT64 cycle)
+    {
+        if (cycle < latency)
+        {
+            return false;
+        }
+        INT64 written = cycle - latency;
+        if (written != readCycle)
+        {
+            readCycle = written;
+            readPos = 0;
+        }
+        ROW *row = GetRow(written);
+        if (row->cycle != written || readPos >= row->count)
+        {
+            return false;
+        }
+        memcpy(data, (char *)(row + 1) + readPos * elemSize, elemSize);
+        readPos++;
+        return true;
+    }
+
+    bool SomethingToRead(UINT64 cycle) const
+    {
+        if (cycle < latency)
+        {
+            return false;
+        }
+        INT64 written = cycle - latency;
+        ROW *row = GetRow(written);
+        return row->cycle == written &&
+               (written != readCycle ? row->count > 0 : readPos < row->count);
+    }
+};
+
+#endif // _PARTITION_
@@ -38,7 +38,9 @@
 #define _POOL_ALLOCATED_OBJECTS_
 
 // generic
-#include <bitset>
+#include <map>
+#include <vector>
+#include <pthread.h>
 
 // ASIM core
 #include "asim/syntax.h"
@@ -60,19 +62,14 @@
 //   using this code.  That would mean resturcturing this code and all users
 //   of it.
 //
-// - The entire storage area is treated like a queue.  The allocator rotates
-//   around the entire area instead of managing a free list.  A free list
-//   implementation would likely improve the cache hit rate.
+// - Pools are separate for each thread and grow by chunks of POOL_SIZE
+//   objects, which are never given back.  An object released by a thread
+//   other than the one that allocated it is queued for its owner, which
+//   takes it back on its next Allocate().
 //
-// - Pools are separate for each thread.  While all threads may access any
-//   object, the thread calling Release() must be the same thread that
-//   called Allocate().  There is an assertion to verify this.
-//
-// - The pool size grows in proportion to MAX_PTHREADS.  Older code used to
-//   keep the pool size the same and spread it across all threads, but that
-//   had its own problems.  The current code uses lazy allocation at the
-//   thread level so no storage is allocated for threads that make no
-//   allocation requests.
+// Every chunk keeps a two level bitmap of its free objects, so that the
+// lowest free object is found with a couple of find-first-set operations
+// however full the chunk is.
 //
 // ***************************************************************************
 
@@ -95,31 +92,181 @@ class ASIM_POOL_ALLOCATED_OBJECT_CLASS
     void Release(POOL_OBJECT_TYPE * ptr);
 
   private:
+    enum
+    {
+        WORDS = (POOL_SIZE + 63) / 64,
+        SUMMARY_WORDS = (WORDS + 63) / 64
+    };
+
     //
-    // Each thread gets a private pool.  This works only if an objected is
-    // allocated and freed by the same pool.  There is a check in the release
-    // code to confirm this requirement.
+    // POOL_SIZE objects.  Bit b of freeMap[w] is set when object w*64+b is
+    // free, and bit w of summary[s] when freeMap[s*64+w] has any bit set.
     //
-    class THREAD_POOL_CLASS {
+    class CHUNK_CLASS {
       public:
         POOL_OBJECT_TYPE data[POOL_SIZE];
 
-        //the last object that was allocated
-        UINT32 last_allocated;
+        UINT64 freeMap[WORDS];
+        UINT64 summary[SUMMARY_WORDS];
+
+        UINT32 nFree;
+        UINT32 firstSummary;   // summary words below are all zero
+        bool inPartial;        // queued in the pool partial list
+
+        CHUNK_CLASS();
+        ~CHUNK_CLASS() {};
+
+        // take the lowest free object (there must be one)
+        UINT32 Take();
+        void Put(UINT32 index);
+    };
+
+    typedef CHUNK_CLASS *CHUNK;
+
+    //
+    // Each thread gets a private pool, which only its thread modifies.
+    // The chunk map is also read by the other threads, holding chunkLock,
+    // to find the owner of the objects they release.
+    //
+    class THREAD_POOL_CLASS {
+      public:
+        // chunks by address of the end of their data
+        map<const POOL_OBJECT_TYPE *, CHUNK> chunks;
+
+        // the chunk objects are allocated from
+        CHUNK current;
+
+        // other chunks that may have free objects
+        vector<CHUNK> partial;
 
-        //the flag to state whether an element is in use
-        bitset<POOL_SIZE> inUse;
+        // objects released by other threads, waiting to be taken back
+        pthread_mutex_t returnLock;
+        vector<POOL_OBJECT_TYPE *> returned;
+        volatile bool anyReturned;
 
-        THREAD_POOL_CLASS() : last_allocated(0) {};
-        ~THREAD_POOL_CLASS() {};
+        THREAD_POOL_CLASS();
+        ~THREAD_POOL_CLASS();
+
+        CHUNK Find(const POOL_OBJECT_TYPE *ptr) const;
     };
 
     typedef THREAD_POOL_CLASS *THREAD_POOL;
     THREAD_POOL thread_pools[MAX_PTHREADS];
+
+    // held to add chunks and to look at the pools of other threads
+    pthread_mutex_t chunkLock;
+
+    CHUNK NewChunk(THREAD_POOL tPool);
+    void Free(THREAD_POOL tPool, CHUNK chunk, POOL_OBJECT_TYPE *ptr);
+    void TakeReturned(THREAD_POOL tPool);
 };
 
 
 
+template <class POOL_OBJECT_TYPE,UINT32 POOL_SIZE>
+ASIM_POOL_ALLOCATED_OBJECT_CLASS<POOL_OBJECT_TYPE,POOL_SIZE>::CHUNK_CLASS::CHUNK_CLASS()
+  : nFree(POOL_SIZE),
+    firstSummary(0),
+    inPartial(false)
+{
+    for (UINT32 w = 0; w < WORDS; w++)
+    {
+        freeMap[w] = ~UINT64(0);
+    }
+    if (POOL_SIZE % 64)
+    {
+        freeMap[WORDS - 1] = (UINT64(1) << (POOL_SIZE % 64)) - 1;
+    }
+
+    for (UINT32 s = 0; s < SUMMARY_WORDS; s++)
+    {
+        summary[s] = 0;
+    }
+    for (UINT32 w = 0; w < WORDS; w++)
+    {
+        summary[w / 64] |= UINT64(1) << (w % 64);
+    }
+}
+
+template <class POOL_OBJECT_TYPE,UINT32 POOL_SIZE>
+inline UINT32
+ASIM_POOL_ALLOCATED_OBJECT_CLASS<POOL_OBJECT_TYPE,POOL_SIZE>::CHUNK_CLASS::Take()
+{
+    ASSERTX(nFree > 0);
+
+    UINT32 s = firstSummary;
+    while (summary[s] == 0)
+    {
+        s++;
+    }
+    firstSummary = s;
+
+    UINT32 w = s * 64 + __builtin_ctzll(summary[s]);
+    UINT32 index = w * 64 + __builtin_ctzll(freeMap[w]);
+
+    freeMap[w] &= freeMap[w] - 1;
+    if (freeMap[w] == 0)
+    {
+        summary[s] &= ~(UINT64(1) << (w % 64));
+    }
+    nFree--;
+
+    return index;
+}
+
+template <class POOL_OBJECT_TYPE,UINT32 POOL_SIZE>
+inline void
+ASIM_POOL_ALLOCATED_OBJECT_CLASS<POOL_OBJECT_TYPE,POOL_SIZE>::CHUNK_CLASS::Put(
+    UINT32 index)
+{
+    UINT32 w = index / 64;
+    UINT64 bit = UINT64(1) << (index % 64);
+    ASSERT(!(freeMap[w] & bit), "Attempt to free object not in use");
+
+    freeMap[w] |= bit;
+    summary[w / 64] |= UINT64(1) << (w % 64);
+    if (w / 64 < firstSummary)
+    {
+        firstSummary = w / 64;
+    }
+    nFree++;
+}
+
+
+template <class POOL_OBJECT_TYPE,UINT32 POOL_SIZE>
+ASIM_POOL_ALLOCATED_OBJECT_CLASS<POOL_OBJECT_TYPE,POOL_SIZE>::THREAD_POOL_CLASS::THREAD_POOL_CLASS()
+  : current(NULL),
+    anyReturned(false)
+{
+    VERIFYX(pthread_mutex_init(&returnLock, NULL) == 0);
+}
+
+template <class POOL_OBJECT_TYPE,UINT32 POOL_SIZE>
+ASIM_POOL_ALLOCATED_OBJECT_CLASS<POOL_OBJECT_TYPE,POOL_SIZE>::THREAD_POOL_CLASS::~THREAD_POOL_CLASS()
+{
+    typename map<const POOL_OBJECT_TYPE *, CHUNK>::iterator i;
+    for (i = chunks.begin(); i != chunks.end(); ++i)
+    {
+        delete i->second;
+    }
+    pthread_mutex_destroy(&returnLock);
+}
+
+template <class POOL_OBJECT_TYPE,UINT32 POOL_SIZE>
+inline typename ASIM_POOL_ALLOCATED_OBJECT_CLASS<POOL_OBJECT_TYPE,POOL_SIZE>::CHUNK
+ASIM_POOL_ALLOCATED_OBJECT_CLASS<POOL_OBJECT_TYPE,POOL_SIZE>::THREAD_POOL_CLASS::Find(
+    const POOL_OBJECT_TYPE *ptr) const
+{
+    typename map<const POOL_OBJECT_TYPE *, CHUNK>::const_iterator i =
+        chunks.upper_bound(ptr);
+    if (i == chunks.end() || ptr < &(i->second->data[0]))
+    {
+        return NULL;
+    }
+    return i->second;
+}
+
+
 template <class POOL_OBJECT_TYPE,UINT32 POOL_SIZE>
 ASIM_POOL_ALLOCATED_OBJECT_CLASS<POOL_OBJECT_TYPE,POOL_SIZE>::ASIM_POOL_ALLOCATED_OBJECT_CLASS()
 {
@@ -127,6 +274,7 @@ ASIM_POOL_ALLOCATED_OBJECT_CLASS<POOL_OBJECT_TYPE,POOL_SIZE>::ASIM_POOL_ALLOCATE
     {
         thread_pools[i] = NULL;
     }
+    VERIFYX(pthread_mutex_init(&chunkLock, NULL) == 0);
 }
 
 template <class POOL_OBJECT_TYPE,UINT32 POOL_SIZE>
@@ -139,41 +287,94 @@ ASIM_POOL_ALLOCATED_OBJECT_CLASS<POOL_OBJECT_TYPE,POOL_SIZE>::~ASIM_POOL_ALLOCAT
             delete thread_pools[i];
         }
     }
+    pthread_mutex_destroy(&chunkLock);
 }
 
 template <class POOL_OBJECT_TYPE,UINT32 POOL_SIZE>
-POOL_OBJECT_TYPE *
-ASIM_POOL_ALLOCATED_OBJECT_CLASS<POOL_OBJECT_TYPE,POOL_SIZE>::Allocate ()
+typename ASIM_POOL_ALLOCATED_OBJECT_CLASS<POOL_OBJECT_TYPE,POOL_SIZE>::CHUNK
+ASIM_POOL_ALLOCATED_OBJECT_CLASS<POOL_OBJECT_TYPE,POOL_SIZE>::NewChunk(
+    THREAD_POOL tPool)
 {
-    if (thread_pools[POOL] == NULL)
+    CHUNK chunk = new CHUNK_CLASS();
+
+    SEQUENTIAL lock(chunkLock);
+    tPool->chunks[&(chunk->data[POOL_SIZE - 1]) + 1] = chunk;
+    return chunk;
+}
+
+template <class POOL_OBJECT_TYPE,UINT32 POOL_SIZE>
+inline void
+ASIM_POOL_ALLOCATED_OBJECT_CLASS<POOL_OBJECT_TYPE,POOL_SIZE>::Free(
+    THREAD_POOL tPool,
+    CHUNK chunk,
+    POOL_OBJECT_TYPE *ptr)
+{
+    chunk->Put(ptr - &(chunk->data[0]));
+    if (chunk != tPool->current && !chunk->inPartial)
     {
-        thread_pools[POOL] = new THREAD_POOL_CLASS();
+        chunk->inPartial = true;
+        tPool->partial.push_back(chunk);
     }
+}
 
+template <class POOL_OBJECT_TYPE,UINT32 POOL_SIZE>
+void
+ASIM_POOL_ALLOCATED_OBJECT_CLASS<POOL_OBJECT_TYPE,POOL_SIZE>::TakeReturned(
+    THREAD_POOL tPool)
+{
+    vector<POOL_OBJECT_TYPE *> returned;
+    {
+        SEQUENTIAL lock(tPool->returnLock);
+        returned.swap(tPool->returned);
+        tPool->anyReturned = false;
+    }
+
+    for (UINT32 i = 0; i < returned.size(); i++)
+    {
+        Free(tPool, tPool->Find(returned[i]), returned[i]);
+    }
+}
+
+template <class POOL_OBJECT_TYPE,UINT32 POOL_SIZE>
+POOL_OBJECT_TYPE *
+ASIM_POOL_ALLOCATED_OBJECT_CLASS<POOL_OBJECT_TYPE,POOL_SIZE>::Allocate ()
+{
     THREAD_POOL tPool = thread_pools[POOL];
+    if (tPool == NULL)
+    {
+        tPool = new THREAD_POOL_CLASS();
+        SEQUENTIAL lock(chunkLock);
+        thread_pools[POOL] = tPool;
+    }
 
-    UINT32 index = tPool->last_allocated;
-    index++;
-    if(index==(POOL_SIZE) )
+    if (tPool->anyReturned)
     {
-        index=0;
+        TakeReturned(tPool);
     }
 
-    while(tPool->inUse[index])
+    CHUNK chunk = tPool->current;
+    if (chunk == NULL || chunk->nFree == 0)
     {
-        //make sure that we didn't wrap around and not find an element
-        ASSERT(index != tPool->last_allocated, "Couldn't find a free element!\n");
-        index++;
-        if(index==(POOL_SIZE) )
+        // Switch to a chunk with free objects, or grow the pool
+        chunk = NULL;
+        while (chunk == NULL && !tPool->partial.empty())
         {
-            index=0;
+            chunk = tPool->partial.back();
+            tPool->partial.pop_back();
+            chunk->inPartial = false;
+            if (chunk->nFree == 0)
+            {
+                chunk = NULL;
+            }
         }
+        if (chunk == NULL)
+        {
+            chunk = NewChunk(tPool);
+        }
+        tPool->current = chunk;
     }
-    tPool->last_allocated = index;
-   
-    tPool->inUse[index] = true;
-    
-    return &(tPool->data[index]);
+
+    return &(chunk->data[chunk->Take()]);
 }
 
 template <class POOL_OBJECT_TYPE,UINT32 POOL_SIZE>
@@ -183,13 +384,30 @@ ASIM_POOL_ALLOCATED_OBJECT_CLASS<POOL_OBJECT_TYPE,POOL_SIZE>::Release (
 {
     THREAD_POOL tPool = thread_pools[POOL];
 
-    POOL_OBJECT_TYPE *base_ptr= &(tPool->data[0]); 
-    UINT32 objIdx = ptr-base_ptr;
+    CHUNK chunk = tPool ? tPool->Find(ptr) : NULL;
+    if (chunk)
+    {
+        Free(tPool, chunk, ptr);
+        return;
+    }
 
-    ASSERT(tPool && (objIdx < POOL_SIZE), "Object does not belong to this pool.  Free by wrong thread?");
-    ASSERT(tPool->inUse[objIdx], "Attempt to free object not in use");
+    // Allocated by another thread: queue it for its owner
+    THREAD_POOL owner = NULL;
+    {
+        SEQUENTIAL lock(chunkLock);
+        for (UINT32 i = 0; i < MAX_PTHREADS && owner == NULL; i++)
+        {
+            if (thread_pools[i] && thread_pools[i]->Find(ptr))
+            {
+                owner = thread_pools[i];
+            }
+        }
+    }
+    ASSERT(owner, "Object does not belong to this pool");
 
-    tPool->inUse[objIdx]=false;
+    SEQUENTIAL lock(owner->returnLock);
+    owner->returned.push_back(ptr);
+    owner->anyReturned = true;
 }
 
 #endif 
@@ -50,8 +50,10 @@
 #include "asim/item.h"
 #include "asim/event.h"
 #include "asim/atomic.h"
+#include "asim/checkpoint.h"
 #include "asim/phase.h"
 #include "asim/module.h"
+#include "asim/partition.h"
 
 extern bool registerPortStats;
 
@@ -96,6 +98,29 @@ private:
   virtual bool CreateStorage(UINT32 latency, UINT32 bandwidth);
   virtual bool DeleteStorage();
 
+  // Timing checkpoints.  Only the endpoint that owns the buffer storage
+  // has anything to save, so the default is to do nothing.
+  virtual void SaveCheckpoint(ASIM_CHECKPOINT ckpt);
+  virtual void RestoreCheckpoint(ASIM_CHECKPOINT ckpt);
+
+  // Move the buffer to shared memory when the port crosses two model
+  // partitions (see asim/partition.h).  Only ReadPort supports it.
+  virtual void ShareStorage();
+
+public:
+  // Memory of a port buffer, with the clockable owning the endpoint
+  // that holds it (for the NUMA placement of the clock server threads).
+  struct STORAGE_RANGE
+  {
+    ASIM_CLOCKABLE owner;
+    const void *start;
+    UINT64 bytes;
+  };
+
+private:
+  // Add the memory of the buffer owned by this endpoint, if any.
+  virtual void GetStorage(vector<STORAGE_RANGE> &ranges);
+
 protected:
   // this is used to ensure the endpoints of a connected port have the same type,
   // and is implemented in derived classes:
@@ -122,11 +147,24 @@ protected:
 
   // For automatic event generation purposes, the node that uses this port must be known 
   int node;
+
+  // Clockable that owns this endpoint (NULL if not given at Init).  A
+  // read endpoint wakes it up on every write when it is clocked on demand.
+  ASIM_CLOCKABLE Owner;
   
   // List of the ports connected to this one
   list<BasePort*> connectedPorts;
   list<BasePort*> getConnectedPorts() { return connectedPorts; }
 
+private:
+  // Endpoints with the same name and instance are gathered in a group as
+  // they are initialized (a hash table indexed by name and instance), so
+  // ConnectAll() finds them without sorting all the ports.  -1 until the
+  // port is initialized.
+  int Group;
+  static void AddToGroup(BasePort *port);
+  static void RemoveFromGroup(BasePort *port);
+
 public:
   // Accessors for bandwidth and latency.
   int GetBandwidth() const;
@@ -161,10 +199,23 @@ public:
   bool InitConfig(ASIM_CLOCKABLE m, const char *name, int bw, int lat, int nodeId = 0 );
 
 public:
+  // Elaboration statistics of the last ConnectAll(): wall time in
+  // microseconds and number of ports connected.  Systems register them.
+  static UINT64 ConnectAllUsecs;
+  static UINT64 ConnectAllPorts;
+
   static void ConnectAll();
   static bool ConnectPorts(int port, int writePort, int index, 
 		      asim::Vector<BasePort*>::Iterator i);
 
+  // Save/restore the contents of every port buffer.  The list of ports
+  // must be the same (it is checked) when restoring.
+  static void SaveAllPorts(ASIM_CHECKPOINT ckpt);
+  static void RestoreAllPorts(ASIM_CHECKPOINT ckpt);
+
+  // Memory of every port buffer, once connected.
+  static void GetAllStorage(vector<STORAGE_RANGE> &ranges);
+
   virtual PortType GetType() const = 0;
   const char *GetTypeName() const;
 };
@@ -221,6 +272,15 @@ protected:
   int PeekStart;
   int PeekReadIndex;
 
+  // Reader clockable woken up at cycle + Latency by every write (see
+  // ASIM_CLOCKABLE_CLASS::SetClockOnDemand).  NULL if the reader is
+  // clocked every cycle.
+  ASIM_CLOCKABLE WakeTarget;
+
+  // Shared memory ring replacing Store when the port crosses two model
+  // partitions (see asim/partition.h).  NULL if not.
+  ASIM_SHARED_PORT Shared;
+
  
 
 private:
@@ -278,6 +338,8 @@ public:
 
   bool IsEnabled() const;
   bool SetEnable(int bw, int lat, const char* portName);
+  void SetWakeTarget(ASIM_CLOCKABLE m) { WakeTarget = m; }
+  void ShareStorage(const char* portName);
 
   bool Read(T& data, UINT64 cycle, const char* portName, bool relaxAsserts = false);
 
@@ -299,6 +361,11 @@ public:
   bool IsActive(){ return active; } 
 
   void Clear(); // empty out all data from the buffer
+
+  void SaveCheckpoint(ASIM_CHECKPOINT ckpt, const char* portName) const;
+  void RestoreCheckpoint(ASIM_CHECKPOINT ckpt, const char* portName);
+
+  void GetStorage(ASIM_CLOCKABLE owner, vector<BasePort::STORAGE_RANGE> &ranges) const;
 };
 
 template <class T, int S = 0>
@@ -456,6 +523,10 @@ class ReadPort : public BasePort
   void SetBufferInfo();
   virtual bool CreateStorage(UINT32 latency, UINT32 bandwidth);
   virtual bool DeleteStorage();
+  virtual void SaveCheckpoint(ASIM_CHECKPOINT ckpt);
+  virtual void RestoreCheckpoint(ASIM_CHECKPOINT ckpt);
+  virtual void ShareStorage();
+  virtual void GetStorage(vector<STORAGE_RANGE> &ranges);
     
 public:
   virtual ~ReadPort() { DeleteStorage(); };
@@ -502,6 +573,9 @@ class ReadSkidPort : public BasePort
   void SetBufferInfo();
   virtual bool CreateStorage(UINT32 latency, UINT32 bandwidth);
   virtual bool DeleteStorage();
+  virtual void SaveCheckpoint(ASIM_CHECKPOINT ckpt);
+  virtual void RestoreCheckpoint(ASIM_CHECKPOINT ckpt);
+  virtual void GetStorage(vector<STORAGE_RANGE> &ranges);
 
 public:
   virtual ~ReadSkidPort() { DeleteStorage(); };
@@ -545,6 +619,9 @@ class ReadStallPort : public BasePort
   void SetBufferInfo();
   virtual bool CreateStorage(UINT32 latency, UINT32 bandwidth);
   virtual bool DeleteStorage();
+  virtual void SaveCheckpoint(ASIM_CHECKPOINT ckpt);
+  virtual void RestoreCheckpoint(ASIM_CHECKPOINT ckpt);
+  virtual void GetStorage(vector<STORAGE_RANGE> &ranges);
 
 public:
   virtual ~ReadStallPort() { DeleteStorage(); };
@@ -678,6 +755,9 @@ class ReadPhasePort : public BasePort
 
   virtual bool CreateStorage(UINT32 latency, UINT32 bandwidth);
   virtual bool DeleteStorage();
+  virtual void SaveCheckpoint(ASIM_CHECKPOINT ckpt);
+  virtual void RestoreCheckpoint(ASIM_CHECKPOINT ckpt);
+  virtual void GetStorage(vector<STORAGE_RANGE> &ranges);
 
 public:
   virtual ~ReadPhasePort() { DeleteStorage(); };
@@ -725,7 +805,7 @@ protected:
 inline
 BasePort::BasePort()
   : Scope(NULL), Name(NULL), Instance(0), Connected(false),
-    Bandwidth(-1), Latency(-1)
+    Bandwidth(-1), Latency(-1), Owner(NULL), Group(-1)
 { 
    AllPorts.Insert(AllPorts.End(), this); 
    my_id = id_count;
@@ -743,6 +823,11 @@ BasePort::~BasePort()
     VERIFYX(i != AllPorts.End());
     AllPorts.Remove(i);
 
+    if (Group >= 0)
+    {
+        RemoveFromGroup(this);
+    }
+
     delete [] Scope;
     delete [] Name;
 }
@@ -854,12 +939,13 @@ BasePort::Init(const char *name, int nodeId, int instance, const char *scope)
   }
 
   node = nodeId;
+  AddToGroup(this);
   return true;
 }
 
 inline bool
 BasePort::Init(ASIM_CLOCKABLE m, const char *name, int nodeId, int instance, const char *scope)
-{ return Init(name, nodeId, instance, scope); }
+{ Owner = m; return Init(name, nodeId, instance, scope); }
 
 inline bool
 BasePort::Config(int bw, int lat)
@@ -871,7 +957,7 @@ BasePort::InitConfig(const char *name, int bw, int lat, int nodeId)
 
 inline bool
 BasePort::InitConfig(ASIM_CLOCKABLE m, const char *name, int bw, int lat, int nodeId)
-{ return BasePort::InitConfig(name, bw, lat, nodeId); }
+{ Owner = m; return BasePort::InitConfig(name, bw, lat, nodeId); }
 
 inline const char*
 BasePort::GetTypeName() const
@@ -896,6 +982,27 @@ BasePort::DeleteStorage()
     return false;
 }
 inline void
+BasePort::SaveCheckpoint(ASIM_CHECKPOINT ckpt)
+{
+    // Do nothing in the general case. Redefined by the ports owning a buffer
+}
+inline void
+BasePort::RestoreCheckpoint(ASIM_CHECKPOINT ckpt)
+{
+    // Do nothing in the general case. Redefined by the ports owning a buffer
+}
+inline void
+BasePort::ShareStorage()
+{
+    VERIFY(false, "Port " << GetName() << " (" << GetTypeName() << ") crosses "
+           "model partitions: only ReadPort endpoints can be shared");
+}
+inline void
+BasePort::GetStorage(vector<STORAGE_RANGE> &ranges)
+{
+    // Nothing in the general case. Redefined by the ports owning a buffer
+}
+inline void
 BasePort::SetBuffer(void *buf, int rdPortNum)
 { ASSERT(false, "You cannot call SetBuffer() on this class type (" << GetName() << ")\n"); }
 
@@ -1071,6 +1178,8 @@ BufferStorage<T,S>::BufferStorage()
     WriteIndex(1), 
     CycleRowRead(-1), 
     PeekReadIndex(0), 
+    WakeTarget(NULL),
+    Shared(NULL),
     LastAccessed(0),
     LastWritten(0),
     SequentialWrites(0)
@@ -1082,6 +1191,43 @@ inline
 BufferStorage<T,S>::~BufferStorage()
 {
     Clear();
+    delete Shared;
+}
+
+template<class T, int S>
+inline void
+BufferStorage<T,S>::ShareStorage(const char* portName)
+{
+    VERIFY(ASIM_SHARED_PORT_TRAITS<T>::value, "Port " << portName
+           << " crosses model partitions but its data type " << typeid(T).name()
+           << " is not declared with ASIM_SHARED_PORT_POD");
+    VERIFYX(Enabled && !Shared);
+
+    Shared = new ASIM_SHARED_PORT_CLASS(sizeof(T), Bandwidth, Latency);
+}
+
+// The row table and the data of every row.  A shared buffer lives in
+// the partition segment and is left out.
+template<class T, int S>
+inline void
+BufferStorage<T,S>::GetStorage(ASIM_CLOCKABLE owner, vector<BasePort::STORAGE_RANGE> &ranges) const
+{
+    if (!Store || Shared)
+    {
+        return;
+    }
+
+    BasePort::STORAGE_RANGE range;
+    range.owner = owner;
+    range.start = Store;
+    range.bytes = BufferSize * sizeof(CycleEntry);
+    ranges.push_back(range);
+    for (int count = 0; count < BufferSize; count++)
+    {
+        range.start = Store[count].Data;
+        range.bytes = Bandwidth * sizeof(T);
+        ranges.push_back(range);
+    }
 }
 
 // clear out everything - releases smart pointers
@@ -1108,6 +1254,91 @@ BufferStorage<T,S>::Clear()
     }
 }
 
+// Only the live part [Start, End) of each row is saved; the rest of
+// the row holds Dummy values, as left behind by Read() and Clear().
+template<class T, int S>
+inline void
+BufferStorage<T,S>::SaveCheckpoint(ASIM_CHECKPOINT ckpt, const char* portName) const
+{
+    VERIFY(!Shared, "Port " << portName << " crosses model partitions: "
+           "timing checkpoints are not supported");
+    ckpt->Check(BufferSize, (string("buffer size of port ") + portName).c_str());
+    ckpt->Check(Bandwidth, (string("bandwidth of port ") + portName).c_str());
+
+    ckpt->Save(Enabled);
+    ckpt->Save(active);
+    ckpt->Save(stalled);
+    ckpt->Save(ReadIndex);
+    ckpt->Save(WriteIndex);
+    ckpt->Save(CycleRowRead);
+    ckpt->Save(PeekStart);
+    ckpt->Save(PeekReadIndex);
+    ckpt->Save(LastAccessed);
+    ckpt->Save(LastWritten);
+    ckpt->Save(SequentialWrites);
+
+    for (int count = 0; count < BufferSize; count++)
+    {
+        const CycleEntry &entry = Store[count];
+        INT32 start = entry.Start;
+        INT32 end = entry.End;
+
+        ckpt->Save(entry.CycleWritten);
+        ckpt->Save(start);
+        ckpt->Save(end);
+        for (INT32 position = start; position < end; position++)
+        {
+            ckpt->Save(entry.Data[position]);
+        }
+    }
+}
+
+template<class T, int S>
+inline void
+BufferStorage<T,S>::RestoreCheckpoint(ASIM_CHECKPOINT ckpt, const char* portName)
+{
+    ckpt->Check(BufferSize, (string("buffer size of port ") + portName).c_str());
+    ckpt->Check(Bandwidth, (string("bandwidth of port ") + portName).c_str());
+
+    ckpt->Restore(Enabled);
+    ckpt->Restore(active);
+    ckpt->Restore(stalled);
+    ckpt->Restore(ReadIndex);
+    ckpt->Restore(WriteIndex);
+    ckpt->Restore(CycleRowRead);
+    ckpt->Restore(PeekStart);
+    ckpt->Restore(PeekReadIndex);
+    ckpt->Restore(LastAccessed);
+    ckpt->Restore(LastWritten);
+    ckpt->Restore(SequentialWrites);
+
+    for (int count = 0; count < BufferSize; count++)
+    {
+        CycleEntry &entry = Store[count];
+        INT32 start, end;
+
+        ckpt->Restore(entry.CycleWritten);
+        ckpt->Restore(start);
+        ckpt->Restore(end);
+        VERIFY(start >= 0 && start <= end && end <= Bandwidth,
+               "Corrupted checkpoint entry for port " << portName);
+
+        for (int position = 0; position < Bandwidth; position++)
+        {
+            if (position >= start && position < end)
+            {
+                ckpt->Restore(entry.Data[position]);
+            }
+            else
+            {
+                entry.Data[position] = Dummy;
+            }
+        }
+        entry.Start = start;
+        entry.End = end;
+    }
+}
+
 template<class T, int S>
 inline int
 BufferStorage<T,S>::GetBandwidth() const
@@ -1201,6 +1432,11 @@ template<class T, int S>
 inline bool
 BufferStorage<T,S>::Read(T& data, UINT64 cycle, const char* portName, bool relaxAsserts)
 {
+    if (Shared)
+    {
+        return Shared->Read(&data, cycle);
+    }
+
     // if no data, return false.  I don't think this first condidtion
     // should ever be true since we're always advancing readindex at t
     // the end when all items are read out.  Maybe upon startup, but
@@ -1341,6 +1577,12 @@ template<class T, int S>
 inline bool
 BufferStorage<T,S>::Write(const T& data, UINT64 cycle, const char* portName)
 {
+    if (Shared)
+    {
+        Shared->Write(&data, cycle, portName);
+        return true;
+    }
+
     if (((UINT64)Store[WriteIndex].CycleWritten) != cycle) 
     {
         // this assert isn't really THAT necessary.  I mean, time always
@@ -1378,6 +1620,13 @@ BufferStorage<T,S>::Write(const T& data, UINT64 cycle, const char* portName)
         LastWritten = (UINT64)cycle;
 
 	++SequentialWrites;
+
+        // Push the delivery to a reader clocked on demand.  Once per
+        // row is enough: all the items of a row arrive in the same cycle.
+        if (WakeTarget)
+        {
+            WakeTarget->WakeAt(cycle + Latency);
+        }
     }
 
     // in order to use entry as a reference to Store[], the compiler
@@ -1440,7 +1689,8 @@ BufferStorage<T,F>::Notify(const ASIM_ITEM& data)
 {
     if (runWithEventsOn && data && data->GetEventsEnabled())
     {
-        DRALEVENT(MoveItem(GetEventEdgeId(), data->GetItemId()));
+        data->EnsureAnnounced();
+        DRALEVENT(QueueMoveItem(GetEventEdgeId(), data->GetItemId()));
     }
 }
 
@@ -1450,7 +1700,8 @@ BufferStorage<T,F>::Notify(const ASIM_ITEM_CLASS& data)
 {
     if (runWithEventsOn && data.GetEventsEnabled())
     {
-        DRALEVENT(MoveItem(GetEventEdgeId(), data.GetItemId()));
+        data.EnsureAnnounced();
+        DRALEVENT(QueueMoveItem(GetEventEdgeId(), data.GetItemId()));
     }
 }
 
@@ -1571,6 +1822,34 @@ ReadPort<T>::DeleteStorage()
     return Buffer.DeleteStorage();
 }
 
+template <class T>
+inline void
+ReadPort<T>::SaveCheckpoint(ASIM_CHECKPOINT ckpt)
+{
+    Buffer.SaveCheckpoint(ckpt, GetName());
+}
+
+template <class T>
+inline void
+ReadPort<T>::RestoreCheckpoint(ASIM_CHECKPOINT ckpt)
+{
+    Buffer.RestoreCheckpoint(ckpt, GetName());
+}
+
+template <class T>
+inline void
+ReadPort<T>::GetStorage(vector<STORAGE_RANGE> &ranges)
+{
+    Buffer.GetStorage(Owner, ranges);
+}
+
+template <class T>
+inline void
+ReadPort<T>::ShareStorage()
+{
+    Buffer.ShareStorage(GetName());
+}
+
 template <class T>
 inline void
 ReadPort<T>::SetBufferInfo()
@@ -1581,6 +1860,7 @@ ReadPort<T>::SetBufferInfo()
     "Port " << GetName() << " latency not set.");
 
   Buffer.SetEnable(Bandwidth, Latency, GetName());
+  Buffer.SetWakeTarget(Owner ? Owner->GetOnDemandClockable() : NULL);
 }
 
 template <class T>
@@ -1633,6 +1913,27 @@ ReadSkidPort<T,S>::DeleteStorage()
     return Buffer.DeleteStorage();
 }
 
+template <class T, int S>
+inline void
+ReadSkidPort<T,S>::SaveCheckpoint(ASIM_CHECKPOINT ckpt)
+{
+    Buffer.SaveCheckpoint(ckpt, GetName());
+}
+
+template <class T, int S>
+inline void
+ReadSkidPort<T,S>::RestoreCheckpoint(ASIM_CHECKPOINT ckpt)
+{
+    Buffer.RestoreCheckpoint(ckpt, GetName());
+}
+
+template <class T, int S>
+inline void
+ReadSkidPort<T,S>::GetStorage(vector<STORAGE_RANGE> &ranges)
+{
+    Buffer.GetStorage(Owner, ranges);
+}
+
 template <class T, int S>
 inline void
 ReadSkidPort<T,S>::SetBufferInfo()
@@ -1643,6 +1944,7 @@ ReadSkidPort<T,S>::SetBufferInfo()
     "Port " << GetName() << " latency not set.");
 
   Buffer.SetEnable(Bandwidth, Latency, GetName());
+  Buffer.SetWakeTarget(Owner ? Owner->GetOnDemandClockable() : NULL);
 }
 
 template <class T, int S>
@@ -1729,6 +2031,27 @@ ReadStallPort<T>::DeleteStorage()
     return Buffer.DeleteStorage();
 }
 
+template <class T>
+inline void
+ReadStallPort<T>::SaveCheckpoint(ASIM_CHECKPOINT ckpt)
+{
+    Buffer.SaveCheckpoint(ckpt, GetName());
+}
+
+template <class T>
+inline void
+ReadStallPort<T>::RestoreCheckpoint(ASIM_CHECKPOINT ckpt)
+{
+    Buffer.RestoreCheckpoint(ckpt, GetName());
+}
+
+template <class T>
+inline void
+ReadStallPort<T>::GetStorage(vector<STORAGE_RANGE> &ranges)
+{
+    Buffer.GetStorage(Owner, ranges);
+}
+
 template <class T>
 inline void
 ReadStallPort<T>::SetBufferInfo()
@@ -1739,6 +2062,7 @@ ReadStallPort<T>::SetBufferInfo()
     "Port " << GetName() << " latency not set.");
 
   Buffer.SetEnable(Bandwidth, Latency, GetName());
+  Buffer.SetWakeTarget(Owner ? Owner->GetOnDemandClockable() : NULL);
 }
 
 template <class T>
@@ -1971,6 +2295,27 @@ ReadPhasePort<T>::DeleteStorage()
     return Buffer.DeleteStorage();
 }
 
+template <class T>
+inline void
+ReadPhasePort<T>::SaveCheckpoint(ASIM_CHECKPOINT ckpt)
+{
+    Buffer.SaveCheckpoint(ckpt, GetName());
+}
+
+template <class T>
+inline void
+ReadPhasePort<T>::RestoreCheckpoint(ASIM_CHECKPOINT ckpt)
+{
+    Buffer.RestoreCheckpoint(ckpt, GetName());
+}
+
+template <class T>
+inline void
+ReadPhasePort<T>::GetStorage(vector<STORAGE_RANGE> &ranges)
+{
+    Buffer.GetStorage(Owner, ranges);
+}
+
 template <class T>
 inline void
 ReadPhasePort<T>::SetBufferInfo()
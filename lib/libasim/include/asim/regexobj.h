@@ -91,6 +91,10 @@ public:
     // return whether the regex is ready for matching 
     bool ok();
 
+    // the source pattern and case sensitivity given to create()
+    const string &getPattern() const { return pattern; }
+    bool isCaseSensitive() const { return caseSensitive; }
+
     ~Regex() {
 	dispose();
     }
@@ -98,6 +102,8 @@ public:
 protected:
     bool initialized;
     regex_t regexPattern;
+    string pattern;
+    bool caseSensitive;
 
     // For pattern substitution, keep an array for reuse.
     unsigned subArraySize;
@@ -57,6 +57,8 @@
 // tend to be more power effective than multiple independent ports, hence
 // then need to be able to track them separately).
 // 
+#include <string.h>
+
 #include "asim/mm.h"
 #include "asim/mpointer.h"
 #include "asim/phase.h"
@@ -74,6 +76,10 @@
 #define ANY_PORT BACKDOOR_PORT 
 #define INVALID_PORT 32
 
+// Largest table a MatchIterator can hold the CAM result of (one bit per entry)
+#define MAX_MATCH_ENTRIES 1024
+#define MATCH_WORDS ((MAX_MATCH_ENTRIES + 63) / 64)
+
 
 
 // This INIT_REGISTER_FILE should be included in one and only one .cpp file as a 
@@ -111,6 +117,68 @@ struct InternalState : public ASIM_MM_CLASS<InternalState>
 };
 typedef class mmptr<InternalState> IS;
 
+//
+// Bits of mask word "w" that fall in positions [from, to)
+//
+inline UINT64
+MatchRangeWord(UINT32 w, UINT32 from, UINT32 to)
+{
+ UINT32 lo = w * 64;
+ if ( from >= to || to <= lo || from >= lo + 64 ) return 0;
+
+ UINT64 m = ~0ULL;
+ if ( from > lo ) m &= ~0ULL << (from - lo);
+ if ( to < lo + 64 ) m &= (1ULL << (to - lo)) - 1;
+ return m;
+}
+
+//
+// One bit per element of col[0..n) (n <= 64) equal to "val". The compare
+// loop writes one byte per element so that the compiler can vectorize it,
+// and each 8 bytes of 0/1 are then packed into 8 bits with a multiply.
+//
+inline UINT64
+MatchEqualWord(const UINT64 *col, UINT32 n, UINT64 val)
+{
+ UINT64 bits = 0;
+ if ( n == 64 ) {
+  UINT8 eq[64];
+  for ( UINT32 b = 0; b < 64; b++ ) {
+   eq[b] = (col[b] == val);
+  }
+  for ( UINT32 k = 0; k < 8; k++ ) {
+   UINT64 x;
+   memcpy(&x, eq + 8 * k, sizeof(x));
+   bits |= ((x * 0x0102040810204080ULL) >> 56) << (8 * k);
+  }
+ }
+ else {
+  for ( UINT32 b = 0; b < n; b++ ) {
+   bits |= UINT64(col[b] == val) << b;
+  }
+ }
+ return bits;
+}
+
+//
+// First set bit in positions [from, to) of a match bitmask, -1 if none
+//
+inline INT32
+MatchFindNext(const UINT64 *bits, UINT32 from, UINT32 to)
+{
+ if ( from >= to ) return -1;
+
+ UINT32 w = from / 64;
+ UINT32 lastw = (to - 1) / 64;
+ UINT64 word = bits[w] & (~0ULL << (from % 64));
+ for (;;) {
+  if ( w == lastw && (to % 64) != 0 ) word &= (1ULL << (to % 64)) - 1;
+  if ( word ) return w * 64 + __builtin_ctzll(word);
+  if ( w == lastw ) return -1;
+  word = bits[++w];
+ }
+}
+
 // Name of the field that holds the object of type T when T is a basic type
 // Used to display in dreams.
 #define ITEM_TAG_NAME "Item"
@@ -159,6 +227,44 @@ class RegisterFile : public ASIM_MODULE_CLASS
          INT32          curr;
     };
 
+    //
+    // Result of FieldCAMMatch(): one bit per table entry, walked in the same
+    // order FieldCAM() returns its matches (from the CAM start point,
+    // wrapping around the table). Everything is held inline, so building,
+    // copying and walking it never allocates.
+    //
+    class  MatchIterator
+    {
+         friend class RegisterFile<T>;
+
+     public:
+
+         MatchIterator();
+
+         void                          operator++();
+
+         UINT64                        operator*();
+         UINT64                        current();
+         INT32                         index();
+         bool                          more();
+         bool                          end();
+         UINT32                        count() const;
+
+     private:
+
+         // Move to the first match at or after "from", in CAM order
+         void                          Seek(UINT32 from);
+
+     private:
+
+         UINT64         bits[MATCH_WORDS];
+         UINT32         capacity;
+         UINT32         start;
+         UINT64         value;
+         INT32          curr;
+         bool           wrapped;
+    };
+
 
 
  ///////////////////////////////////////////////////////////////////////////////////////////
@@ -288,6 +394,18 @@ class RegisterFile : public ASIM_MODULE_CLASS
         FieldIterator   FieldCAM          (UINT32 fld, UINT64 val, UINT32 port = BACKDOOR_PORT, UINT32 disablefld = MAX_FIELDS);
         FieldIterator   FieldCAMRange     (UINT32 fld, UINT64 val, UINT32 start, UINT32 end, UINT32 port = BACKDOOR_PORT, UINT32 disablefld = MAX_FIELDS);
 
+        //
+        // Field CAM returning a bitmask: same matching, port checks and
+        // stats as FieldCAM/FieldCAMRange, but the matches come back in a
+        // MatchIterator instead of a latched FieldIterator, with no MM or
+        // heap allocation. The table can have at most MAX_MATCH_ENTRIES
+        // entries. The MatchIterator variant of FieldWrite() is the
+        // multi-write on its matches.
+        //
+        MatchIterator   FieldCAMMatch     (UINT32 fld, UINT64 val, UINT32 port = BACKDOOR_PORT, UINT32 disablefld = MAX_FIELDS);
+        MatchIterator   FieldCAMMatchRange(UINT32 fld, UINT64 val, UINT32 start, UINT32 end, UINT32 port = BACKDOOR_PORT, UINT32 disablefld = MAX_FIELDS);
+        void            FieldWrite        (UINT32 fld, const MatchIterator& it, UINT64 val, UINT32 port = BACKDOOR_PORT);
+
         //
         // Accessors and Modifiers for Object Fields. Note the lack of
         // Matching on the object fields.
@@ -371,17 +489,16 @@ class RegisterFile : public ASIM_MODULE_CLASS
         FieldDescriptor  fields[MAX_FIELDS];
 
         //
-        //  This structure is a matrix of "MAX_FIELDS x Entries"
+        // Field data is kept column-major: one array of "Entries" values per
+        // field, so that a CAM compares a contiguous array. The object field
+        // has its own arrays for the objects and the occupied flags.
         //
-        typedef struct {
-         UINT64     value;
-         T          obj;
-         bool       occupied;       ///< Boolean that says, it the field is the 
-                                    ///  fieldObj, if the entry is occupied or not
-         STAT2( UINT64 last_read_cycle;)
-         STAT2( UINT64 last_write_cycle;)
-        } FieldData;
-        FieldData *data[MAX_FIELDS];
+        UINT64     *values[MAX_FIELDS];
+        T          *objs;
+        bool       *occupied;       ///< Whether an object has been written
+                                    ///  to the entry
+        STAT2( UINT64 *last_read_cycle[MAX_FIELDS];)
+        STAT2( UINT64 *last_write_cycle[MAX_FIELDS];)
 
         STAT2(UINT64 current_cycle);
         STAT2(UINT64 total_vulnerable_bits_cycle);
@@ -408,6 +525,20 @@ class RegisterFile : public ASIM_MODULE_CLASS
         //
         UINT32 Range(UINT32& start, UINT32& end);
 
+        //
+        // CAM core shared by FieldCAMRange and FieldCAMMatchRange: checks and
+        // marks the CAM port, compares the whole "fld" column against "val"
+        // and leaves in "bits" one bit per matching entry inside the range,
+        // applying the field match policy. "start" is left pointing to the
+        // first entry in CAM order.
+        //
+        void CAMCompare(UINT32 fld, UINT64 val, UINT32& start, UINT32 end, UINT32 port, UINT32 disablefld, UINT64 *bits);
+
+        //
+        // Scratch bitmask used by FieldCAMRange
+        //
+        UINT64 *camBits;
+
         // This functions are used to automatically generate events when an ASIM_ITEM
         // moves through a port
         void NotifyExit(UINT32 idx, const ASIM_ITEM& data);
@@ -434,8 +565,13 @@ RegisterFile<T>::RegisterFile(char *name, UINT32 entries, ASIM_MODULE parent) :
 
  fidx = 0;
  objfld = (UINT32)-1;
+ objs = NULL;
+ occupied = NULL;
+ camBits = new UINT64[(capacity + 63) / 64];
  for ( UINT32 i = 0; i < MAX_FIELDS; i++ ) {
-  data[i] = NULL;
+  values[i] = NULL;
+  STAT2(last_read_cycle[i] = NULL;)
+  STAT2(last_write_cycle[i] = NULL;)
   fields[i].name = NULL;
   fields[i].width = 0;
   fields[i].rdports = 0;
@@ -461,9 +597,14 @@ inline
 RegisterFile<T>::~RegisterFile()
 {
  for ( UINT32 i = 0; i < fidx; i++ ) {
-  VERIFYX(data[i] != NULL);
-  delete []data[i];
+  VERIFYX(values[i] != NULL);
+  delete []values[i];
+  STAT2(delete []last_read_cycle[i];)
+  STAT2(delete []last_write_cycle[i];)
  }
+ delete []objs;
+ delete []occupied;
+ delete []camBits;
  STAT2(if ((current_cycle * array_bits) > 0) (*stat_avf)() = (float)total_vulnerable_bits_cycle / (float)(current_cycle * array_bits);)
 }
 
@@ -550,12 +691,14 @@ RegisterFile<T>::NewField(char *name, UINT32 rdp, UINT32 wrp, UINT32 camp, UINT3
  //
  // Allocate memory for holding this field data
  //
- data[fidx] = new FieldData[capacity];
+ values[fidx] = new UINT64[capacity];
+ STAT2(last_read_cycle[fidx] = new UINT64[capacity];)
+ STAT2(last_write_cycle[fidx] = new UINT64[capacity];)
  for (UINT32 i = 0; i < capacity; i++ )
  {
-  data[fidx][i].value = default_val;
-  STAT2(data[fidx][i].last_read_cycle = 0;)
-  STAT2(data[fidx][i].last_write_cycle = 0;)
+  values[fidx][i] = default_val;
+  STAT2(last_read_cycle[fidx][i] = 0;)
+  STAT2(last_write_cycle[fidx][i] = 0;)
  }
 
  EVENT(stagList.insert(name));
@@ -620,13 +763,17 @@ RegisterFile<T>::NewFieldObj(char *name, UINT32 rdp, UINT32 wrp)
  //
  // Allocate memory for holding this field data
  //
- data[fidx] = new FieldData[capacity];
+ values[fidx] = new UINT64[capacity];
+ objs = new T[capacity];
+ occupied = new bool[capacity];
+ STAT2(last_read_cycle[fidx] = new UINT64[capacity];)
+ STAT2(last_write_cycle[fidx] = new UINT64[capacity];)
  for (UINT32 i = 0; i < capacity; i++ )
  {
-  data[fidx][i].value = 0;
-  data[fidx][i].occupied = false;
-  STAT2(data[fidx][i].last_read_cycle = 0;)
-  STAT2(data[fidx][i].last_write_cycle = 0;)
+  values[fidx][i] = 0;
+  occupied[i] = false;
+  STAT2(last_read_cycle[fidx][i] = 0;)
+  STAT2(last_write_cycle[fidx][i] = 0;)
  }
 
  //
@@ -665,10 +812,10 @@ RegisterFile<T>::FieldWrite(UINT32 fld, UINT32 idx, UINT64 val, UINT32 port)
  )   
  STAT2(
   if (port < BACKDOOR_PORT) {
-   if (data[fld][idx].last_read_cycle >= data[fld][idx].last_write_cycle) {
-    total_vulnerable_bits_cycle += (data[fld][idx].last_read_cycle - data[fld][idx].last_write_cycle + 1);
+   if (last_read_cycle[fld][idx] >= last_write_cycle[fld][idx]) {
+    total_vulnerable_bits_cycle += (last_read_cycle[fld][idx] - last_write_cycle[fld][idx] + 1);
    }
-    data[fld][idx].last_write_cycle = current_cycle;
+    last_write_cycle[fld][idx] = current_cycle;
   }  
  )
  //
@@ -690,9 +837,9 @@ RegisterFile<T>::FieldWrite(UINT32 fld, UINT32 idx, UINT64 val, UINT32 port)
  // Write data: for sanity, we only write the data up to the bit width
  // specified by the user.
  //
- data[fld][idx].value = val & fields[fld].mask;
+ values[fld][idx] = val & fields[fld].mask;
 
- EVENT(SetNodeTag(fields[fld].name, data[fld][idx].value, idx));
+ EVENT(SetNodeTag(fields[fld].name, values[fld][idx], idx));
 }
 
 //
@@ -745,20 +892,76 @@ RegisterFile<T>::FieldWrite(UINT32 fld, FieldIterator& it, UINT64 val, UINT32 po
  myit = it;
  for (  ; myit.more() ; ++myit ) {
   UINT32 idx = myit.index();
-  data[fld][idx].value = val;  
+  values[fld][idx] = val;  
   EVENT(SetNodeTag(fields[fld].name, val, idx));
   STAT2(
     if (port < BACKDOOR_PORT) {
-        if (data[fld][idx].last_read_cycle >= data[fld][idx].last_write_cycle) {
-            total_vulnerable_bits_cycle += (data[fld][idx].last_read_cycle - data[fld][idx].last_write_cycle + 1);
+        if (last_read_cycle[fld][idx] >= last_write_cycle[fld][idx]) {
+            total_vulnerable_bits_cycle += (last_read_cycle[fld][idx] - last_write_cycle[fld][idx] + 1);
         }
-        data[fld][idx].last_write_cycle = current_cycle;
+        last_write_cycle[fld][idx] = current_cycle;
     }  
   )
  }
  // printf("End FieldWrite\n");
 }
 
+//
+// FieldWrite w/ MatchIterator
+//
+// Same multi-write as above, on every entry matched by a FieldCAMMatch.
+//
+template <class T>
+inline void       
+RegisterFile<T>::FieldWrite(UINT32 fld, const MatchIterator& it, UINT64 val, UINT32 port)
+{
+ ASSERT(fld < fidx, "Invalid field number: " << this->name << "[" << fields[fld].name << "]");
+ ASSERT(fields[fld].mask != 0, "Field size improperly defined: " << this->name << "[" << fields[fld].name << "]");
+ ASSERT(port == BACKDOOR_PORT || port < fields[fld].wrports, "Invalid port(" << port << "): " << this->name << "[" << fields[fld].name << "]");
+
+ STAT2(
+  if (port < BACKDOOR_PORT) (*(fields[fld].stat_num_write))(port)++; 
+  else  (*(fields[fld].stat_num_write_backdoor))()++; 
+ )   
+ //
+ // Compute port mask making sure that port "BACKDOOR_PORT" is not considered "used"
+ //
+ UINT32 pmask = (1 << port) & 0x7fffffff;
+
+ //
+ // Check the port has not been used since last "Clock" invocation
+ //
+ VERIFY((pmask & fields[fld].wused) == 0, "Write Port Conflict(" << port << "): " << this->name << "[" << fields[fld].name << "]");
+
+ //
+ // Mark port as now used
+ //
+ fields[fld].wused |= pmask;
+
+ //
+ // For sanity, clean up upper data bits
+ //
+ val &= fields[fld].mask;
+
+ //
+ // Write data for all matches. The order does not matter here, so walk
+ // the mask straight from entry 0.
+ //
+ for ( INT32 i = MatchFindNext(it.bits, 0, it.capacity); i != -1; i = MatchFindNext(it.bits, i + 1, it.capacity) ) {
+  UINT32 idx = i;
+  values[fld][idx] = val;  
+  EVENT(SetNodeTag(fields[fld].name, val, idx));
+  STAT2(
+    if (port < BACKDOOR_PORT) {
+        if (last_read_cycle[fld][idx] >= last_write_cycle[fld][idx]) {
+            total_vulnerable_bits_cycle += (last_read_cycle[fld][idx] - last_write_cycle[fld][idx] + 1);
+        }
+        last_write_cycle[fld][idx] = current_cycle;
+    }  
+  )
+ }
+}
+
 template <class T>
 inline UINT64       
 RegisterFile<T>::FieldRead(UINT32 fld, UINT32 idx, UINT32 port)
@@ -773,7 +976,7 @@ RegisterFile<T>::FieldRead(UINT32 fld, UINT32 idx, UINT32 port)
   else  (*(fields[fld].stat_num_read_backdoor))()++; 
  )   
 
- STAT2(if (port < BACKDOOR_PORT) data[fld][idx].last_read_cycle = current_cycle;)
+ STAT2(if (port < BACKDOOR_PORT) last_read_cycle[fld][idx] = current_cycle;)
  //
  // Compute port mask making sure that port "BACKDOOR_PORT" is not considered "used"
  //
@@ -792,8 +995,8 @@ RegisterFile<T>::FieldRead(UINT32 fld, UINT32 idx, UINT32 port)
  //
  // Return Data. For Sanity we double check that upper bits are all zero.
  //
- ASSERT(((data[fld][idx].value >> fields[fld].width) == 0) || (fields[fld].width == 64), "High bits not zero: " << this->name << "[" << fields[fld].name << "]");
- return data[fld][idx].value;
+ ASSERT(((values[fld][idx] >> fields[fld].width) == 0) || (fields[fld].width == 64), "High bits not zero: " << this->name << "[" << fields[fld].name << "]");
+ return values[fld][idx];
 }
 
 template <class T>
@@ -812,7 +1015,7 @@ RegisterFile<T>::FieldReadLateral(UINT32 fld, UINT32 start, UINT32 end)
   FieldIterator myit(this, fld, start, end);
   for (  ; myit.more() ; ++myit ) {
    UINT32 idx = myit.index();
-   data[fld][idx].last_read_cycle = current_cycle;
+   last_read_cycle[fld][idx] = current_cycle;
   }
  )
 
@@ -831,18 +1034,65 @@ template <class T>
 inline typename RegisterFile<T>::FieldIterator
 RegisterFile<T>::FieldCAMRange(UINT32 fld, UINT64 val, UINT32 start, UINT32 end, UINT32 port, UINT32 disablefld)
 { 
+ FieldIterator it(this);
+
+ CAMCompare(fld, val, start, end, port, disablefld, camBits);
+ val &= fields[fld].mask;
+
+ //
+ // Latch the matches in CAM order: from "start" to the end of the table,
+ // then wrapping around
+ //
+ for ( INT32 i = MatchFindNext(camBits, start, capacity); i != -1; i = MatchFindNext(camBits, i + 1, capacity) ) {
+  it.Add(i, val);
+ }
+ for ( INT32 i = MatchFindNext(camBits, 0, start); i != -1; i = MatchFindNext(camBits, i + 1, start) ) {
+  it.Add(i, val);
+ }
+
+ return it;
+}
+
+template <class T>
+inline typename RegisterFile<T>::MatchIterator
+RegisterFile<T>::FieldCAMMatch(UINT32 fld, UINT64 val, UINT32 port, UINT32 disablefld)
+{
+ return FieldCAMMatchRange(fld,val,0,0,port,disablefld); 
+}
+
+template <class T>
+inline typename RegisterFile<T>::MatchIterator
+RegisterFile<T>::FieldCAMMatchRange(UINT32 fld, UINT64 val, UINT32 start, UINT32 end, UINT32 port, UINT32 disablefld)
+{
+ VERIFY(capacity <= MAX_MATCH_ENTRIES, "Table too large for FieldCAMMatch: " << this->name);
+
+ MatchIterator it;
+
+ CAMCompare(fld, val, start, end, port, disablefld, it.bits);
+
+ it.capacity = capacity;
+ it.start    = start;
+ it.value    = val & fields[fld].mask;
+ it.wrapped  = false;
+ it.Seek(start);
+
+ return it;
+}
+
+template <class T>
+inline void
+RegisterFile<T>::CAMCompare(UINT32 fld, UINT64 val, UINT32& start, UINT32 end, UINT32 port, UINT32 disablefld, UINT64 *bits)
+{
  ASSERT(fld < fidx, "Invalid field number: " << this->name << "[" << fields[fld].name << "]");
  ASSERT(fields[fld].mask != 0, "Field size improperly defined: " << this->name << "[" << fields[fld].name << "]");
  ASSERT(port == BACKDOOR_PORT || port < fields[fld].camports, "Invalid port(" << port << "): " << this->name << "[" << fields[fld].name << "]");
+ ASSERT(disablefld == MAX_FIELDS || disablefld < fidx, "Invalid disable field number: " << this->name);
 
  STAT2(
   if (port < BACKDOOR_PORT) (*(fields[fld].stat_num_cam))(port)++; 
   else  (*(fields[fld].stat_num_cam_backdoor))()++; 
  )   
 
- UINT32 trip = 0;
- FieldIterator it(this);
-
  //
  // Compute port mask making sure that port "BACKDOOR_PORT" is not considered "used"
  //
@@ -862,6 +1112,7 @@ RegisterFile<T>::FieldCAMRange(UINT32 fld, UINT64 val, UINT32 start, UINT32 end,
  // Get policy to be usef for matching
  //
  MATCH_POLICY p = fields[fld].policy;
+ VERIFYX(p == MATCH_FIRST_ONLY || p == MATCH_ALL);
 
  //
  // Clean up value: make sure upper bits are zero
@@ -870,52 +1121,55 @@ RegisterFile<T>::FieldCAMRange(UINT32 fld, UINT64 val, UINT32 start, UINT32 end,
 
  //
  // Establish range to be Matched against. Note function Range() will
- // modifiy the start/end values to fit them into the valid table capacity
+ // modifiy the start/end values to fit them into the valid table capacity.
+ // The range is [start, start + trip), wrapping around the table.
+ //
+ UINT32 trip = Range(start, end);
+ UINT32 wrapEnd = (start + trip > capacity) ? start + trip - capacity : 0;
+ UINT32 linEnd  = (start + trip > capacity) ? capacity : start + trip;
+
+ //
+ // Compare the whole column, 64 entries per mask word. An entry takes
+ // part in the CAM if it is in range and, when there is a disable field,
+ // that field holds this port or ANY_PORT.
+ //
+ const UINT64 *col = values[fld];
+ const UINT64 *dis = (disablefld == MAX_FIELDS) ? NULL : values[disablefld];
+ STAT2(UINT32 detailed = 0;)
+ for ( UINT32 w = 0; w < (capacity + 63) / 64; w++ ) {
+  UINT32 base = w * 64;
+  UINT32 n = (capacity - base < 64) ? capacity - base : 64;
+  UINT64 enabled = MatchRangeWord(w, start, linEnd) | MatchRangeWord(w, 0, wrapEnd);
+  UINT64 match = MatchEqualWord(col + base, n, val);
+  if ( dis != NULL ) {
+   enabled &= MatchEqualWord(dis + base, n, port) | MatchEqualWord(dis + base, n, ANY_PORT);
+  }
+  bits[w] = match & enabled;
+  STAT2(detailed += __builtin_popcountll(enabled);)
+ }
+
  //
- trip = Range(start, end);
- 
+ // MATCH_FIRST_ONLY keeps the first match in CAM order. Like a scan that
+ // stops there, only the entries up to it count as compared.
  //
- // Compare against all values in Table starting at "start". Return indices of all entries
- // that match the given value.
- //
- if ( p == MATCH_FIRST_ONLY ) { // Stop at first match
-  for (UINT32 i = start, j = 0 ; j < trip; j++, i = ((i + 1) % capacity) ) {
-   if (disablefld == MAX_FIELDS) {
-     STAT2((*(fields[fld].stat_num_detailed_cam))()++);
-   } else {
-    if ((data[disablefld][i].value == port) || (data[disablefld][i].value == ANY_PORT)) {
-     STAT2((*(fields[fld].stat_num_detailed_cam))()++);
-    } else {
-     continue;
-    }
-   }
-   if ( data[fld][i].value == val ) {
-    it.Add(i,val);
-    break;
-   }
+ if ( p == MATCH_FIRST_ONLY ) {
+  INT32 first = MatchFindNext(bits, start, linEnd);
+  if ( first == -1 ) first = MatchFindNext(bits, 0, wrapEnd);
+  for ( UINT32 w = 0; w < (capacity + 63) / 64; w++ ) {
+   bits[w] = 0;
   }
- }
- else if ( p == MATCH_ALL ) {  // Scan full trip count for all possible matches
-  for (UINT32 i = start, j = 0 ; j < trip; j++, i = ((i + 1) % capacity) ) {
-   if (disablefld == MAX_FIELDS) {
-     STAT2((*(fields[fld].stat_num_detailed_cam))()++);
-   } else {
-    if ((data[disablefld][i].value == port) || (data[disablefld][i].value == ANY_PORT)) {
-     STAT2((*(fields[fld].stat_num_detailed_cam))()++);
-    } else {
-     continue;
+  if ( first != -1 ) {
+   bits[first / 64] = 1ULL << (first % 64);
+   STAT2(
+    // discount the entries after the match
+    for ( UINT32 j = (first + 1) % capacity; j != (start + trip) % capacity; j = (j + 1) % capacity ) {
+     if (dis == NULL || dis[j] == port || dis[j] == ANY_PORT) detailed--;
     }
-   }
-   if ( data[fld][i].value == val ) {
-    it.Add(i,val);
-   }
+   )
   }
  }
- else {
-  VERIFYX(0);
- }
 
- return it;
+ STAT2((*(fields[fld].stat_num_detailed_cam))() += detailed);
 }
 
 template <class T>
@@ -947,13 +1201,13 @@ RegisterFile<T>::FieldWriteObj(UINT32 idx, T obj, UINT32 port)
  // 
  // Generate the ExitNode Dral event.
  //
- NotifyExit(idx, data[objfld][idx].obj);
+ NotifyExit(idx, objs[idx]);
 
  //
  // Write Object
  //
- data[objfld][idx].obj = obj;
- data[objfld][idx].occupied = true;
+ objs[idx] = obj;
+ occupied[idx] = true;
 
  // 
  // Generate the EnterNode Dral event.
@@ -991,7 +1245,7 @@ RegisterFile<T>::FieldReadObj(UINT32 idx, UINT32 port)
  //
  // Return Object. 
  //
- return data[objfld][idx].obj;
+ return objs[idx];
 }
 
 template <class T>
@@ -1075,7 +1329,7 @@ template <class T>
 inline void
 RegisterFile<T>::NotifyExit(UINT32 idx, const ASIM_ITEM& obj)
 {
- if (data[objfld][idx].occupied && obj->GetEventsEnabled())
+ if (occupied[idx] && obj->GetEventsEnabled())
  {
   // If the entry is occupied, then we perform the exit node of
   // the entry
@@ -1087,7 +1341,7 @@ template <class T>
 inline void
 RegisterFile<T>::NotifyExit(UINT32 idx, const ASIM_ITEM_CLASS& obj)
 {
- if (data[objfld][idx].occupied && obj.GetEventsEnabled())
+ if (occupied[idx] && obj.GetEventsEnabled())
  {
   EVENT(ExitNode(obj, idx));
  }
@@ -1165,7 +1419,7 @@ RegisterFile<T>::NotifyEnter(UINT32 idx, ...)
  // obtain events or inherit from ASIM_SILENT_ITEM_CLASS if you
  // don't want events.
  // This error may also manifest itself by a SEGFLT.
-  EVENT(SetNodeTag(ITEM_TAG_NAME, data[objfld][idx].value, idx));
+  EVENT(SetNodeTag(ITEM_TAG_NAME, values[objfld][idx], idx));
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////
@@ -1348,7 +1602,7 @@ RegisterFile<T>::FieldIterator::current()
  if ( state->data != NULL ) {
   return state->data[curr].value;
  }
- return ((RegisterFile<T> *)state->pt)->data[state->fld][curr].value;
+ return ((RegisterFile<T> *)state->pt)->values[state->fld][curr];
 }
 
 template <class T>
@@ -1402,5 +1656,98 @@ RegisterFile<T>::FieldIterator::dump() const
  // printf("               }\n");
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////
+////////////
+////////////
+////////////  MATCH ITERATOR 
+////////////
+////////////
+///////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////
+template <class T>
+inline
+RegisterFile<T>::MatchIterator::MatchIterator()
+{
+ capacity = 0;
+ start    = 0;
+ value    = 0;
+ curr     = -1;
+ wrapped  = true;
+}
+
+template <class T>
+inline void
+RegisterFile<T>::MatchIterator::Seek(UINT32 from)
+{
+ //
+ // First the entries from "start" to the end of the table, then the ones
+ // before "start"
+ //
+ if ( ! wrapped ) {
+  curr = MatchFindNext(bits, from, capacity);
+  if ( curr != -1 ) return;
+  wrapped = true;
+  from = 0;
+ }
+ curr = MatchFindNext(bits, from, start);
+}
+
+template <class T>
+inline void
+RegisterFile<T>::MatchIterator::operator++()
+{
+ if ( curr != -1 ) Seek(curr + 1);
+}
+
+template <class T>
+inline UINT64 
+RegisterFile<T>::MatchIterator::current()
+{
+ ASSERT(curr != -1, "MatchIterator::current: out of range");
+ return value;
+}
+
+template <class T>
+inline UINT64
+RegisterFile<T>::MatchIterator::operator*()
+{
+ return current();
+}
+
+template <class T>
+inline INT32
+RegisterFile<T>::MatchIterator::index()
+{
+ return curr;
+}
+
+template <class T>
+inline bool
+RegisterFile<T>::MatchIterator::more()
+{
+ return ( curr != -1);
+}
+
+template <class T>
+inline bool
+RegisterFile<T>::MatchIterator::end()
+{
+ return ( curr == -1);
+}
+
+template <class T>
+inline UINT32
+RegisterFile<T>::MatchIterator::count() const
+{
+ UINT32 n = 0;
+ for ( UINT32 w = 0; w < (capacity + 63) / 64; w++ ) {
+  n += __builtin_popcountll(bits[w]);
+ }
+ return n;
+}
+
 #endif // _REGISTER_FILE_H
 
@@ -46,6 +46,8 @@
 #include "asim/resource_stats.h"
 #include "asim/stateout.h"
 #include "asim/stripchart.h"
+#include "asim/checkpoint.h"
+#include "asim/sharded_counter.h"
 
 typedef class ASIM_STATE_CLASS *ASIM_STATE;
 typedef class ASIM_STATELINK_CLASS *ASIM_STATELINK;
@@ -113,6 +115,12 @@ protected:
    */
   virtual void ClearStats ();
 
+  /*
+   * Save/restore registered statistics in a timing checkpoint.
+   */
+  virtual void SaveStatsCheckpoint (ASIM_CHECKPOINT ckpt);
+  virtual void RestoreStatsCheckpoint (ASIM_CHECKPOINT ckpt);
+
   
 public:
 
@@ -136,6 +144,8 @@ public:
 			    const char * const d, bool sus =true);
   ASIM_STATE RegisterState (UINT64 *s, const UINT32 sz, const char * const n,
 			    const char * const d, bool sus =true);
+  ASIM_STATE RegisterState (ASIM_SHARDED_COUNTER s, const char * const n,
+			    const char * const d, bool sus =true);
   ASIM_STATE RegisterState (double *s, const char * const n,
 			    const char * const d, bool sus =true);
   ASIM_STATE RegisterState (double *s, const UINT32 sz, const char * const n,
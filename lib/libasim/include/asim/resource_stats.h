@@ -67,10 +67,13 @@
 #include <stdlib.h>
 #include <iostream>
 #include <sstream>
+#include <vector>
+#include <algorithm>
 
 // ASIM core
 #include "asim/ioformat.h"
 #include "asim/stateout.h"
+#include "asim/checkpoint.h"
 
 namespace iof = IoFormat;
 using namespace iof;
@@ -89,11 +92,18 @@ using namespace std;
 // or non-binned histograms.  A binned histogram will give you data for a 
 // range of values rather than for a unique value. 
 //
+// Histograms with many cells (per PC, per address, latencies with a large
+// range...) start with a sparse storage: a hash of the nonzero cells. When
+// enough cells are used to make the dense matrix cheaper, the counters move
+// there. Dumps and checkpoints are the same with either storage.
+//
 template<bool E = true>
 class HISTOGRAM_TEMPLATE {
  private:
   INT32 rowSize;           // Size of each row for which we accumulate values. 
   INT32 colSize;           // Size of each col for which we accumulate values. 
+  INT32 rowShift;          // log2(rowSize) if it is a power of two, else -1
+  INT32 colShift;          // log2(colSize) if it is a power of two, else -1
   bool rowFlexcap;         // Flexible cap on max entries in row
   bool colFlexcap;         // Flexible cap on max entries in col
                            // pooled into maximum bin. 
@@ -104,6 +114,10 @@ class HISTOGRAM_TEMPLATE {
   UINT32 maxColVal;        // This is the maximum col in histogram.  If
                            // we exceed this number, then pooled data must 
                            // be enabled or we trigger an assertion failure. 
+  UINT64 *sparseKey;       // Sparse storage (when histData is NULL): open
+  UINT64 *sparseVal;       // addressing hash of the nonzero cells, keyed
+  UINT64 sparseMask;       // by row * numCols + col.  Capacity - 1.
+  UINT64 sparseUsed;       // Cells in the hash.
   char *name;              // name of this histogram stat
   bool isSaveObj;          // indicates that this is a 'save'd object and
                            // its destructor needs to be careful not to
@@ -111,7 +125,9 @@ class HISTOGRAM_TEMPLATE {
                            // the 'real' object owns and frees this memory)
 
  protected: 
-  UINT64 **histData;       // histogram structure. 
+  UINT64 *histData;        // histogram structure, numRows x numCols
+                           // stored row-major in a single buffer,
+                           // or NULL while the storage is sparse.
   UINT64 *total;           // Total number of events in histogram
   bool enabled;            // Flag which notes whether this histogram
                            // stat should be collected or not. 
@@ -192,9 +208,11 @@ class HISTOGRAM_TEMPLATE {
           
           ASSERT (row_size > 0, Name());
           rowSize = row_size;
+          rowShift = Log2Exact(row_size);
           
           ASSERT (col_size > 0, Name());
           colSize = col_size;
+          colShift = Log2Exact(col_size);
           
           ASSERT (num_rows > 0, Name());
           numRows = num_rows;
@@ -224,6 +242,12 @@ class HISTOGRAM_TEMPLATE {
       }
   }
 
+  //
+  // Histogram is disabled either at compile time (E == false, where all
+  // the update code is removed) or at run time through Init().
+  //
+  bool IsEnabled() const { return E && enabled; }
+
   /// free what we have allocated
   virtual ~HISTOGRAM_TEMPLATE () {
       if (enabled) {
@@ -261,14 +285,9 @@ class HISTOGRAM_TEMPLATE {
           
           // histData
           if (histData) {
-              for (UINT32 i = 0; i < numRows; i++)
-              {
-                  if (histData[i]) {
-                      delete [] histData[i];
-                  }
-              }
               delete [] histData;
           }
+          FreeSparse();
 
           // total
           if (total) {
@@ -421,11 +440,13 @@ class HISTOGRAM_TEMPLATE {
           //
           numRows = 0;
           rowSize = 0;
+          rowShift = 0;
           rowFlexcap = false;
           maxRowVal = 0;
           maxRowsUsed = 0;
           
           colSize = 0;
+          colShift = 0;
           colFlexcap = false;
           numCols = 0;
           maxColVal = 0;
@@ -443,11 +464,176 @@ class HISTOGRAM_TEMPLATE {
           rowNames = NULL;
           name = NULL;
           histData = NULL;
+          sparseKey = NULL;
+          sparseVal = NULL;
+          sparseMask = 0;
+          sparseUsed = 0;
           total = NULL;
           accumulated = NULL;
       }
   }
   
+  //
+  // Bucket of a value.  Power of two bucket sizes (including the usual
+  // unit size) are computed with a shift.
+  //
+  static INT32 Log2Exact(UINT32 v) {
+      return ((v & (v - 1)) == 0) ? __builtin_ctz(v) : -1;
+  }
+
+  UINT32 RowBin(UINT32 row_val) const {
+      return (rowShift >= 0) ? (row_val >> rowShift) : (row_val / rowSize);
+  }
+
+  UINT32 ColBin(UINT32 col_val) const {
+      return (colShift >= 0) ? (col_val >> colShift) : (col_val / colSize);
+  }
+
+ protected:
+  UINT64 *Row(UINT32 row) const { return histData + (size_t)row * numCols; }
+
+ private:
+  //
+  // Sparse storage.  Histograms with fewer cells than SPARSE_MIN_CELLS are
+  // dense from the start.  The hash is kept at most half full, so an entry
+  // costs at least 32 bytes against 8 for a dense cell: when it has to grow
+  // past 1/8 of the cells, the counters move to the dense matrix.
+  //
+  static const UINT64 SPARSE_MIN_CELLS = 65536;
+  static const UINT64 SPARSE_INITIAL_CAPACITY = 64;
+  static const UINT64 SPARSE_EMPTY = ~UINT64(0);
+
+  UINT64 NumCells() const { return (UINT64)numRows * numCols; }
+
+  static UINT64 SparseHash(UINT64 cell) {
+      UINT64 h = cell * 0x9E3779B97F4A7C15ULL;
+      return h ^ (h >> 29);
+  }
+
+  void AllocSparse(UINT64 capacity) {
+      sparseKey = new UINT64[capacity];
+      sparseVal = new UINT64[capacity];
+      sparseMask = capacity - 1;
+      sparseUsed = 0;
+      for (UINT64 i = 0; i < capacity; i++) {
+          sparseKey[i] = SPARSE_EMPTY;
+      }
+  }
+
+  void FreeSparse() {
+      if (sparseKey) {
+          delete [] sparseKey;
+          delete [] sparseVal;
+      }
+      sparseKey = NULL;
+      sparseVal = NULL;
+      sparseMask = 0;
+      sparseUsed = 0;
+  }
+
+  void MakeDense() {
+      histData = new UINT64[NumCells()];
+      memset(histData, 0, NumCells() * sizeof(UINT64));
+      for (UINT64 i = 0; i <= sparseMask; i++) {
+          if (sparseKey[i] != SPARSE_EMPTY) {
+              histData[sparseKey[i]] = sparseVal[i];
+          }
+      }
+      FreeSparse();
+  }
+
+  // Double the hash, or go dense if the cells are no longer sparse
+  void GrowSparse() {
+      if ((sparseUsed + 1) * 8 > NumCells()) {
+          MakeDense();
+          return;
+      }
+      UINT64 *oldKey = sparseKey;
+      UINT64 *oldVal = sparseVal;
+      UINT64 oldCapacity = sparseMask + 1;
+      AllocSparse(oldCapacity * 2);
+      for (UINT64 i = 0; i < oldCapacity; i++) {
+          if (oldKey[i] != SPARSE_EMPTY) {
+              SparseCell(oldKey[i]) = oldVal[i];
+          }
+      }
+      delete [] oldKey;
+      delete [] oldVal;
+  }
+
+  // Counter of a cell, inserted if it is not in the hash
+  UINT64 &SparseCell(UINT64 cell) {
+      UINT64 i = SparseHash(cell) & sparseMask;
+      while (sparseKey[i] != cell) {
+          if (sparseKey[i] == SPARSE_EMPTY) {
+              if ((sparseUsed + 1) * 2 > sparseMask + 1) {
+                  GrowSparse();
+                  return Cell(cell);
+              }
+              sparseKey[i] = cell;
+              sparseVal[i] = 0;
+              sparseUsed++;
+              return sparseVal[i];
+          }
+          i = (i + 1) & sparseMask;
+      }
+      return sparseVal[i];
+  }
+
+  UINT64 &Cell(UINT64 cell) {
+      return (histData != NULL) ? histData[cell] : SparseCell(cell);
+  }
+
+  UINT64 CellValue(UINT64 cell) const {
+      if (histData != NULL) {
+          return histData[cell];
+      }
+      for (UINT64 i = SparseHash(cell) & sparseMask; sparseKey[i] != SPARSE_EMPTY;
+           i = (i + 1) & sparseMask) {
+          if (sparseKey[i] == cell) {
+              return sparseVal[i];
+          }
+      }
+      return 0;
+  }
+
+  // The cells of the hash, in row-major order
+  void SortedCells(vector<pair<UINT64, UINT64> > &cells) const {
+      cells.clear();
+      if (histData == NULL) {
+          cells.reserve(sparseUsed);
+          for (UINT64 i = 0; i <= sparseMask; i++) {
+              if (sparseKey[i] != SPARSE_EMPTY) {
+                  cells.push_back(make_pair(sparseKey[i], sparseVal[i]));
+              }
+          }
+          sort(cells.begin(), cells.end());
+      }
+  }
+
+  //
+  // Counters of a row, for rows visited in increasing order.  With the
+  // sparse storage they are built in buf from the sorted cells, starting
+  // at cells[pos].
+  //
+  const UINT64 *RowValues(UINT32 row, const vector<pair<UINT64, UINT64> > &cells,
+                          size_t &pos, vector<UINT64> &buf) const {
+      if (histData != NULL) {
+          return Row(row);
+      }
+      buf.assign(numCols, 0);
+      UINT64 first = (UINT64)row * numCols;
+      while (pos < cells.size() && cells[pos].first < first) {
+          pos++;
+      }
+      while (pos < cells.size() && cells[pos].first < first + numCols) {
+          buf[cells[pos].first - first] = cells[pos].second;
+          pos++;
+      }
+      return &buf[0];
+  }
+
+ private:
   //
   // count string names
   //
@@ -492,7 +678,7 @@ class HISTOGRAM_TEMPLATE {
   // 
   void InitializeHistogram() {
       if (enabled == true) {
-          UINT32 i, j;
+          UINT32 i;
           
           // Allocate memory for histogram
           /*
@@ -501,11 +687,11 @@ class HISTOGRAM_TEMPLATE {
             cout << flush;
           */
           ASSERT (histData == NULL, this->Name());
+          ASSERT (sparseKey == NULL, this->Name());
           ASSERT (total == NULL, this->Name());
           ASSERT (accumulated == NULL, this->Name());
           ASSERT (numRows != 0, this->Name());
           ASSERT (numCols != 0, this->Name());
-          histData = new UINT64*[numRows];
           total = new UINT64[numCols];
           accumulated = new UINT64[numCols];
           
@@ -523,14 +709,40 @@ class HISTOGRAM_TEMPLATE {
           // Note we always initialize to maxBins + 1 because
           // we have bins labeled "0" through "maxBins"
           //
-          for (i = 0; i < numRows; i++) {
-              histData[i] = new UINT64[numCols];
-              // cout << "Row: " << i << ", Addr: " << fmt_x(histData[i]) << endl;
-              // cout << flush;
-              for (j = 0; j < numCols; j++) {
-                  histData[i][j] = 0;
-              }
+          if (NumCells() < SPARSE_MIN_CELLS) {
+              histData = new UINT64[(size_t)numRows * numCols];
+              memset(histData, 0, (size_t)numRows * numCols * sizeof(UINT64));
+          }
+          else {
+              AllocSparse(SPARSE_INITIAL_CAPACITY);
+          }
+      }
+  }
+
+  //
+  // Copy the counters of save, with its storage.
+  //
+  void CopyStorage(const HISTOGRAM_TEMPLATE &save) {
+      if (save.histData != NULL) {
+          if (histData == NULL) {
+              FreeSparse();
+              histData = new UINT64[NumCells()];
+          }
+          memcpy(histData, save.histData,
+                 (size_t)numRows * numCols * sizeof(UINT64));
+      }
+      else {
+          if (histData != NULL) {
+              delete [] histData;
+              histData = NULL;
+          }
+          if (sparseKey == NULL || sparseMask != save.sparseMask) {
+              FreeSparse();
+              AllocSparse(save.sparseMask + 1);
           }
+          memcpy(sparseKey, save.sparseKey, (save.sparseMask + 1) * sizeof(UINT64));
+          memcpy(sparseVal, save.sparseVal, (save.sparseMask + 1) * sizeof(UINT64));
+          sparseUsed = save.sparseUsed;
       }
   }
  public:
@@ -555,7 +767,7 @@ class HISTOGRAM_TEMPLATE {
           // size histogram, or the new class has to have a NULL
           // histogram. 
           //
-          UINT32 i, j;
+          UINT32 i;
           
           //
           // This case occurs the first time when we save a snapshot of
@@ -570,25 +782,21 @@ class HISTOGRAM_TEMPLATE {
           //         << ", binSize: " << t->binSize
           //         << ", maxBin: " << t->maxBin << endl;
           //    cout << flush;
-          if (histData == NULL) {
+          if (total == NULL) {
               //
               // We're copying to a uninitialized instance of HISTOGRAM.
               // 
-              histData = new UINT64*[save.numRows];
-              ASSERT (total == NULL, this->Name());
               ASSERT (accumulated == NULL, this->Name());
               total = new UINT64[save.numCols];
               accumulated = new UINT64[save.numCols];
               
-              for (i = 0; i < save.numRows; i++) {
-                  histData[i] = new UINT64[save.numCols];
-              }
-              
               numRows = save.numRows;
               maxRowsUsed = save.maxRowsUsed;
               numCols = save.numCols;
               rowSize = save.rowSize;
               colSize = save.colSize;
+              rowShift = save.rowShift;
+              colShift = save.colShift;
               maxRowVal = save.maxRowVal;
               maxColVal = save.maxColVal;
               rowFlexcap = save.rowFlexcap;
@@ -652,11 +860,7 @@ class HISTOGRAM_TEMPLATE {
           // Copy data which changes while the stats are not being
           // collected.  
           //
-          for (i = 0; i < numRows; i++) {
-              for (j = 0; j < numCols; j++) {
-                  histData[i][j] = save.histData[i][j];
-              }
-          }
+          CopyStorage(save);
           
           for (i = 0; i < numCols; i++) {
               total[i] = save.total[i];
@@ -692,9 +896,11 @@ class HISTOGRAM_TEMPLATE {
   // method because it's faster. 
   //
   void AddEvent(UINT32 row_val, UINT32 col_val = 0, UINT64 value = 1) {
-      if (enabled == true) {
+      if (IsEnabled()) {
           // Profiling showed updating histogram entries to be slow.  Prefetch.
-          __builtin_prefetch(&histData[row_val][col_val], 1, 1);
+          if (histData != NULL) {
+              __builtin_prefetch(histData + (size_t)row_val * numCols + col_val, 1, 1);
+          }
 
           ASSERT ((rowSize == 1) && (colSize == 1), this->Name());
           if (row_val >= numRows) {
@@ -711,7 +917,7 @@ class HISTOGRAM_TEMPLATE {
           }
           total[col_val] += value;
           accumulated[col_val] += row_val;
-          histData[row_val][col_val] += value;
+          Cell((UINT64)row_val * numCols + col_val) += value;
       }
   }
     
@@ -721,17 +927,9 @@ class HISTOGRAM_TEMPLATE {
   // AddEventUnitBins.
   //
   void AddEventWideBins(UINT32 row_val, UINT32 col_val = 0, UINT64 value = 1) {
-      if (enabled == true) {
-          INT32 row_number = row_val;
-          INT32 col_number = col_val;
-          
-          if (rowSize != 1) {
-              row_number = (INT32)(floor((double)(row_number)/(double)(rowSize)));
-          }
-          
-          if (colSize != 1) {
-              col_number = (INT32)(floor((double)(col_number)/(double)(colSize)));
-          }
+      if (IsEnabled()) {
+          INT32 row_number = RowBin(row_val);
+          INT32 col_number = ColBin(col_val);
           
           if (row_number >= INT32(numRows)) {
               if (rowFlexcap == true) {
@@ -755,7 +953,7 @@ class HISTOGRAM_TEMPLATE {
               }
           }
           
-          histData[row_number][col_number] += value;
+          Cell((UINT64)row_number * numCols + col_number) += value;
           total[col_number] += value;
           accumulated[col_val] += row_val;
       }
@@ -875,6 +1073,11 @@ class HISTOGRAM_TEMPLATE {
           // Print out histogram data. 
           //
           stateOut->AddCompound("info", "data");
+
+          vector<pair<UINT64, UINT64> > cells;
+          vector<UINT64> rowBuf;
+          size_t pos = 0;
+          SortedCells(cells);
           
           //
           // If we have non-unit size rows....
@@ -891,8 +1094,9 @@ class HISTOGRAM_TEMPLATE {
                   os.str(""); // clear
                   os << min_size << "-" << max_size;
                   
+                  const UINT64 *row = RowValues(i, cells, pos, rowBuf);
                   stateOut->AddVector("row", os.str().c_str(), NULL,
-                                      & histData[i][0], & histData[i][numCols]);
+                                      row, row + numCols);
                   
                   min_size = max_size + 1;
                   max_size = min_size + rowSize - 1;
@@ -916,8 +1120,9 @@ class HISTOGRAM_TEMPLATE {
                           name = os.str().c_str();
                       }
 
+                      const UINT64 *row = RowValues(i, cells, pos, rowBuf);
                       stateOut->AddVector("row", name, NULL,
-                                          & histData[i][0], & histData[i][numCols]);
+                                          row, row + numCols);
                   }
               }
               
@@ -929,8 +1134,9 @@ class HISTOGRAM_TEMPLATE {
                       os.str(""); // clear
                       os << i;
                       
+                      const UINT64 *row = RowValues(i, cells, pos, rowBuf);
                       stateOut->AddVector("row", os.str().c_str(), NULL,
-                                          & histData[i][0], & histData[i][numCols]);
+                                          row, row + numCols);
                   }
               }
           }
@@ -943,7 +1149,7 @@ class HISTOGRAM_TEMPLATE {
   //
   virtual void ClearValues() {
       if (enabled == true) {          
-          UINT32 i, j;
+          UINT32 i;
           UINT64 count = 0;
           UINT32 nActualRows = numRows;
 
@@ -965,9 +1171,23 @@ class HISTOGRAM_TEMPLATE {
               return;
           }
           
-          for (i = 0; i < nActualRows; i++) {
-              for(j = 0; j < numCols; ++j)
-                 histData[i][j] = 0;
+          if (histData != NULL) {
+              memset(histData, 0, (size_t)nActualRows * numCols * sizeof(UINT64));
+          }
+          else {
+              // same as the dense matrix: only the first nActualRows rows
+              vector<pair<UINT64, UINT64> > keep;
+              for (UINT64 c = 0; c <= sparseMask; c++) {
+                  if (sparseKey[c] != SPARSE_EMPTY &&
+                      sparseKey[c] >= (UINT64)nActualRows * numCols) {
+                      keep.push_back(make_pair(sparseKey[c], sparseVal[c]));
+                  }
+                  sparseKey[c] = SPARSE_EMPTY;
+              }
+              sparseUsed = 0;
+              for (size_t c = 0; c < keep.size(); c++) {
+                  SparseCell(keep[c].first) = keep[c].second;
+              }
           }
       }
   }
@@ -976,16 +1196,8 @@ class HISTOGRAM_TEMPLATE {
     // Return the value of an element at a given row/col
     //
     UINT32 GetValue (UINT32 row_val, UINT32 col_val = 0) {
-        INT32 row_number = row_val;
-        INT32 col_number = col_val;
-          
-        if (rowSize != 1) {
-            row_number = (INT32)(floor((double)(row_number)/(double)(rowSize)));
-        }
-        
-        if (colSize != 1) {
-            col_number = (INT32)(floor((double)(col_number)/(double)(colSize)));
-        }
+        INT32 row_number = RowBin(row_val);
+        INT32 col_number = ColBin(col_val);
         
         if (row_number >= INT32(numRows)) {
             if (rowFlexcap == true) {
@@ -1004,9 +1216,111 @@ class HISTOGRAM_TEMPLATE {
                 VERIFY(false, "Exceeding number of cols of histogram");
             }
         }
-        return (histData[row_number][col_number]);
+        return CellValue((UINT64)row_number * numCols + col_number);
     }
+
+  //
+  // Bytes used by the counters, and whether they are still sparse
+  //
+  UINT64 StorageBytes() const {
+      if (histData != NULL) {
+          return NumCells() * sizeof(UINT64);
+      }
+      return sparseKey ? (sparseMask + 1) * 2 * sizeof(UINT64) : 0;
+  }
+
+  bool IsSparse() const { return histData == NULL && sparseKey != NULL; }
+
+  //
+  // Move the counters to the dense matrix now, e.g. when most of the
+  // cells are known to be used.
+  //
+  void UseDenseStorage() {
+      if (IsSparse()) {
+          MakeDense();
+      }
+  }
     
+  //
+  // Save/restore the histogram counters in a timing checkpoint.  The
+  // shape of the histogram (rows, cols, names) comes from the model
+  // configuration and is only checked, not restored.
+  //
+  // Dense counters are written as the matrix.  Sparse ones as the number
+  // of nonzero cells followed by the (cell, value) pairs, in cell order,
+  // and they are restored into the sparse hash.
+  //
+  void SaveCheckpoint(ASIM_CHECKPOINT ckpt) const {
+      bool hasData = (enabled == true) && (total != NULL);
+      ckpt->Save(hasData);
+      if (hasData) {
+          ckpt->Check(numRows, "histogram rows");
+          ckpt->Check(numCols, "histogram cols");
+          ckpt->Save(maxRowsUsed);
+          bool sparse = IsSparse();
+          ckpt->Save(sparse);
+          if (sparse) {
+              vector<pair<UINT64, UINT64> > cells;
+              SortedCells(cells);
+              UINT64 count = cells.size();
+              ckpt->Save(count);
+              for (UINT64 i = 0; i < count; i++) {
+                  ckpt->Save(cells[i].first);
+                  ckpt->Save(cells[i].second);
+              }
+          }
+          else {
+              ckpt->Write(histData, NumCells() * sizeof(UINT64));
+          }
+          ckpt->Write(total, numCols * sizeof(UINT64));
+          ckpt->Write(accumulated, numCols * sizeof(UINT64));
+      }
+  }
+
+  void RestoreCheckpoint(ASIM_CHECKPOINT ckpt) {
+      bool hasData;
+      ckpt->Restore(hasData);
+      VERIFY(hasData == ((enabled == true) && (total != NULL)),
+             "Histogram " << Name() << " does not match the checkpoint");
+      if (hasData) {
+          ckpt->Check(numRows, "histogram rows");
+          ckpt->Check(numCols, "histogram cols");
+          ckpt->Restore(maxRowsUsed);
+          bool sparse;
+          ckpt->Restore(sparse);
+          if (sparse) {
+              UINT64 count;
+              ckpt->Restore(count);
+              if (histData != NULL) {
+                  memset(histData, 0, NumCells() * sizeof(UINT64));
+              }
+              else {
+                  // room for the cells with the hash at most half full
+                  UINT64 capacity = SPARSE_INITIAL_CAPACITY;
+                  while (capacity < count * 2) {
+                      capacity *= 2;
+                  }
+                  FreeSparse();
+                  AllocSparse(capacity);
+              }
+              for (UINT64 i = 0; i < count; i++) {
+                  UINT64 cell, value;
+                  ckpt->Restore(cell);
+                  ckpt->Restore(value);
+                  VERIFY(cell < NumCells(), "Histogram " << Name()
+                         << " has cell " << cell << " out of range in the checkpoint");
+                  Cell(cell) = value;
+              }
+          }
+          else {
+              // the counters were dense when saved: most cells are used
+              UseDenseStorage();
+              ckpt->Read(histData, NumCells() * sizeof(UINT64));
+          }
+          ckpt->Read(total, numCols * sizeof(UINT64));
+          ckpt->Read(accumulated, numCols * sizeof(UINT64));
+      }
+  }
   
  //
  // HISTOGRAM ACCESS METHODS
@@ -1104,7 +1418,7 @@ class RESOURCE_TEMPLATE : public HISTOGRAM_TEMPLATE<E> {
   // This method specifies a nack for each resource. It can be called a 
   // number of times per cycle. 
   void RequestNacked(UINT64 cycle) {
-      if (this->enabled == true) {
+      if (this->IsEnabled()) {
           ASSERT (hwmEnabledCycles == 0, this->Name());
           
           if (lastCycleNacked != cycle) {
@@ -1120,7 +1434,7 @@ class RESOURCE_TEMPLATE : public HISTOGRAM_TEMPLATE<E> {
   // Here we nack all requests at one time.  Therefore, it is assumed that
   // this method is only called once per cycle. 
   void RequestNacked(UINT64 cycle, UINT32 num_requests) {
-      if (this->enabled == true) {
+      if (this->IsEnabled()) {
           ASSERT (hwmEnabledCycles == 0, this->Name());
           ASSERT (lastCycleNacked != cycle, this->Name());
           
@@ -1143,7 +1457,7 @@ class RESOURCE_TEMPLATE : public HISTOGRAM_TEMPLATE<E> {
   // uses a hwm signal, it is assumed that it DOES NOT also nack requests.  
   //
   void EnableHighWaterMark(UINT64 cycle) {
-      if (this->enabled == true) {
+      if (this->IsEnabled()) {
           ASSERT(hwmEnableTime == 0, this->Name());
           ASSERT(numNacks == 0, this->Name());
           hwmEnableTime = cycle;
@@ -1151,7 +1465,7 @@ class RESOURCE_TEMPLATE : public HISTOGRAM_TEMPLATE<E> {
   }
 
   void DisableHighWaterMark(UINT64 cycle) {
-      if (this->enabled == true) {
+      if (this->IsEnabled()) {
           ASSERT(hwmEnableTime != 0, this->Name());
           ASSERT(hwmEnableTime < cycle, this->Name());
           hwmEnabledCycles += (hwmEnableTime - cycle);
@@ -1175,7 +1489,7 @@ class RESOURCE_TEMPLATE : public HISTOGRAM_TEMPLATE<E> {
   // from the resource.  It may be called multiple times per cycle. 
   // 
   void ModifyResource(UINT64 cycle, bool add_req) {
-    if (this->enabled == true) {
+    if (this->IsEnabled()) {
       ASSERT (lastModifiedCycle <= cycle, this->Name());
       if (lastModifiedCycle < cycle) {
 	//
@@ -1203,7 +1517,7 @@ class RESOURCE_TEMPLATE : public HISTOGRAM_TEMPLATE<E> {
   // per cycle. 
   //
   void ModifyResource(UINT64 cycle, UINT32 num_requests, bool add_req) {
-    if (this->enabled == true) {
+    if (this->IsEnabled()) {
       ASSERT (lastModifiedCycle < cycle, this->Name());
       this->AddEvent(numEntries, 0, (cycle - lastModifiedCycle));
       if (add_req == true) {
@@ -1222,31 +1536,31 @@ class RESOURCE_TEMPLATE : public HISTOGRAM_TEMPLATE<E> {
   // These are the methods the user calls. 
   //
   void AddRequest(UINT64 cycle) {
-    if (this->enabled == true) {
+    if (this->IsEnabled()) {
       ModifyResource(cycle, true);
     }
   }
 
   void AddRequest(UINT64 cycle, UINT32 num_req) {
-    if (this->enabled == true) {
+    if (this->IsEnabled()) {
       ModifyResource(cycle, num_req, true);
     }
   }
 
   void DeleteRequest(UINT64 cycle) {
-    if (this->enabled == true) {
+    if (this->IsEnabled()) {
       ModifyResource(cycle, false);
     }
   }
 
   void DeleteRequest(UINT64 cycle, UINT32 num_req) {
-    if (this->enabled == true) {
+    if (this->IsEnabled()) {
       ModifyResource(cycle, num_req, false);
     }
   }
 
   void CurrentEntries(UINT64 cycle, UINT32 cur_entries) {
-    if (this->enabled == true) {
+    if (this->IsEnabled()) {
       ASSERT (lastModifiedCycle <= cycle, this->Name());
       this->AddEvent(numEntries, 0, (cycle - lastModifiedCycle));
       numEntries = cur_entries;
@@ -1276,6 +1590,36 @@ class RESOURCE_TEMPLATE : public HISTOGRAM_TEMPLATE<E> {
       HISTOGRAM_TEMPLATE<E>::Dump(stateOut);
     }
   }
+
+  //
+  // Unlike operator=, a checkpoint also carries the occupancy state
+  // of the resource, since the model state is restored with it.
+  //
+  void SaveCheckpoint(ASIM_CHECKPOINT ckpt) const {
+    HISTOGRAM_TEMPLATE<E>::SaveCheckpoint(ckpt);
+    if (this->enabled == true) {
+      ckpt->Save(numNacks);
+      ckpt->Save(numRequestsNacked);
+      ckpt->Save(lastCycleNacked);
+      ckpt->Save(hwmEnableTime);
+      ckpt->Save(hwmEnabledCycles);
+      ckpt->Save(numEntries);
+      ckpt->Save(lastModifiedCycle);
+    }
+  }
+
+  void RestoreCheckpoint(ASIM_CHECKPOINT ckpt) {
+    HISTOGRAM_TEMPLATE<E>::RestoreCheckpoint(ckpt);
+    if (this->enabled == true) {
+      ckpt->Restore(numNacks);
+      ckpt->Restore(numRequestsNacked);
+      ckpt->Restore(lastCycleNacked);
+      ckpt->Restore(hwmEnableTime);
+      ckpt->Restore(hwmEnabledCycles);
+      ckpt->Restore(numEntries);
+      ckpt->Restore(lastModifiedCycle);
+    }
+  }
 };
 
 //
@@ -1423,7 +1767,7 @@ class THREE_DIM_HISTOGRAM_TEMPLATE {
 
   void AddEventWideBins(UINT32 array_loc, UINT32 row_number,
 		UINT32 col = 0, UINT64 value = 1) {
-    if (this->enabled == true) {
+    if (E && this->enabled) {
       ASSERT (array_loc < numHist, this->Name());
       histArray[array_loc].AddEventWideBins(row_number, col, value);
     }
@@ -1431,7 +1775,7 @@ class THREE_DIM_HISTOGRAM_TEMPLATE {
 
   void AddEvent(UINT32 array_loc, UINT32 row_number,
 		UINT32 col = 0, UINT64 value = 1) {
-    if (this->enabled == true) {
+    if (E && this->enabled) {
       ASSERT (array_loc < numHist, this->Name());
       histArray[array_loc].AddEvent(row_number, col, value);
     }
@@ -1458,6 +1802,20 @@ class THREE_DIM_HISTOGRAM_TEMPLATE {
       }
     }
   }
+
+  void SaveCheckpoint(ASIM_CHECKPOINT ckpt) const {
+    ckpt->Check(numHist, "number of histograms");
+    for (UINT32 i = 0; i < numHist; i++) {
+      histArray[i].SaveCheckpoint(ckpt);
+    }
+  }
+
+  void RestoreCheckpoint(ASIM_CHECKPOINT ckpt) {
+    ckpt->Check(numHist, "number of histograms");
+    for (UINT32 i = 0; i < numHist; i++) {
+      histArray[i].RestoreCheckpoint(ckpt);
+    }
+  }
   
 };
 
@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ *
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the Intel Corporation nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @author Pau Cabre
+ * @brief Statistic counter sharded across the simulator threads.
+ *
+ * A plain UINT64 stat incremented from several clockserver threads
+ * either races or needs an atomic, and both ways every update pulls the
+ * same cache line between cores.  ASIM_SHARDED_COUNTER keeps one slot
+ * per running thread (ASIM_SMP_CLASS::GetRunningThreadNumber()), each
+ * in its own cache line, so an update is a plain add to memory that no
+ * other thread writes.
+ *
+ * The slots are only added up when the value is read.  Registered with
+ * ASIM_REGISTRY_CLASS::RegisterState it behaves like a UINT64 stat:
+ * dumps, the controller/tarati value queries, ClearStats, suspend and
+ * checkpoints all see the merged value.
+ */
+
+#ifndef _SHARDED_COUNTER_
+#define _SHARDED_COUNTER_
+
+// generic
+#include <stdlib.h>
+#include <string.h>
+
+// ASIM core
+#include "asim/syntax.h"
+#include "asim/mesg.h"
+#include "asim/smp.h"
+
+typedef class ASIM_SHARDED_COUNTER_CLASS *ASIM_SHARDED_COUNTER;
+class ASIM_SHARDED_COUNTER_CLASS
+{
+  public:
+    static const UINT32 CACHE_LINE_SIZE = 64;
+
+  private:
+    struct SHARD
+    {
+        UINT64 value;
+        char pad[CACHE_LINE_SIZE - sizeof(UINT64)];
+    };
+
+    SHARD *shards;
+    UINT32 numShards;
+
+    /// Value not held by the shards (what the registry wrote last)
+    UINT64 base;
+    /// base + sum of the shards, as of the last Merge()
+    UINT64 merged;
+
+    // not copyable, the shards are owned
+    ASIM_SHARDED_COUNTER_CLASS(const ASIM_SHARDED_COUNTER_CLASS &);
+    ASIM_SHARDED_COUNTER_CLASS &operator=(const ASIM_SHARDED_COUNTER_CLASS &);
+
+    UINT64 SumShards() const
+    {
+        UINT64 sum = 0;
+        for (UINT32 i = 0; i < numShards; i++)
+        {
+            sum += shards[i].value;
+        }
+        return sum;
+    }
+
+  public:
+    /// One shard per thread allowed by ASIM_SMP_CLASS::Init(), which
+    /// must have been called already (systems do it before building
+    /// the model).
+    ASIM_SHARDED_COUNTER_CLASS()
+      : base(0),
+        merged(0)
+    {
+        numShards = ASIM_SMP_CLASS::GetMaxThreads();
+        if (numShards == 0)
+        {
+            numShards = 1;
+        }
+
+        void *mem = NULL;
+        int rc = posix_memalign(&mem, CACHE_LINE_SIZE,
+                                numShards * sizeof(SHARD));
+        VERIFY(rc == 0, "ASIM_SHARDED_COUNTER: posix_memalign failed\n");
+        shards = (SHARD *) mem;
+        memset(shards, 0, numShards * sizeof(SHARD));
+    }
+
+    ~ASIM_SHARDED_COUNTER_CLASS()
+    {
+        free(shards);
+    }
+
+    /// Add to the slot of the calling thread.  Threads that were not
+    /// created through ASIM_SMP_CLASS share the main thread slot.
+    void Add(UINT64 n)
+    {
+        UINT32 t = ASIM_SMP_CLASS::GetRunningThreadNumber();
+        if (t >= numShards)
+        {
+            t = 0;
+        }
+        shards[t].value += n;
+    }
+
+    ASIM_SHARDED_COUNTER_CLASS &operator+=(UINT64 n) { Add(n); return *this; }
+    ASIM_SHARDED_COUNTER_CLASS &operator++() { Add(1); return *this; }
+    void operator++(int) { Add(1); }
+
+    /// Current value.  Exact when the writers are stopped (between
+    /// cycles); while they run it may miss the latest updates.
+    UINT64 Value() const { return base + SumShards(); }
+
+    void Clear()
+    {
+        base = 0;
+        merged = 0;
+        memset(shards, 0, numShards * sizeof(SHARD));
+    }
+
+    //
+    // Interface with ASIM_STATE_CLASS, which exposes 'merged' as a
+    // plain UINT64 stat.
+    //
+
+    /// Refresh the merged value before the registry reads it
+    UINT64 *Merge()
+    {
+        merged = Value();
+        return &merged;
+    }
+
+    /// The registry wrote the merged value (restore of a suspended
+    /// value, ClearStats, checkpoint); keep it as the new total
+    void Rebase()
+    {
+        base = merged - SumShards();
+    }
+
+    UINT64 *MergedValue() { return &merged; }
+};
+
+#endif // _SHARDED_COUNTER_
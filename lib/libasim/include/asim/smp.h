@@ -43,6 +43,10 @@
 
 #include "asim/atomic.h"
 #include <pthread.h>
+#include <string>
+#include <vector>
+
+using namespace std;
 
 
 //
@@ -103,6 +107,28 @@ class ASIM_SMP_THREAD_HANDLE_CLASS
 typedef ASIM_SMP_THREAD_HANDLE_CLASS *ASIM_SMP_THREAD_HANDLE;
 
 
+//
+// ASIM_SMP_CPU --
+//   Hardware thread of a CPU, for the compact and scatter affinities.
+//
+struct ASIM_SMP_CPU
+{
+    INT32 node;
+    INT32 package;
+    INT32 core;
+    INT32 sibling;  // n-th hardware thread of its core
+    INT32 cpu;
+
+    bool operator<(const ASIM_SMP_CPU &o) const
+    {
+        if (node != o.node) return node < o.node;
+        if (package != o.package) return package < o.package;
+        if (core != o.core) return core < o.core;
+        return cpu < o.cpu;
+    }
+};
+
+
 #ifdef TLS_AVAILABLE
 //
 // ASIM_SMP_RunningThreadNumber ought to be a static inside ASIM_SMP_CLASS.
@@ -180,7 +206,64 @@ class ASIM_SMP_CLASS
         return ASIM_SMP_THREAD_HANDLE_CLASS::threadUidGen - 1;
     };
 
+    //
+    // SetAffinity --
+    //  Pin the calling (main) thread and every thread created afterwards
+    //  to a CPU, chosen by running thread number:
+    //    "" or "none"  leave the placement to the OS
+    //    "compact"     fill the hardware threads of a core, then the cores
+    //                  of a NUMA node, then the next node
+    //    "scatter"     round robin over the NUMA nodes, using one hardware
+    //                  thread of every core before the second ones
+    //    "0,2,8-11"    explicit CPU list
+    //  Only the CPUs the process is allowed to run on are used, and the
+    //  list wraps around when there are more threads than CPUs.
+    //
+    static void SetAffinity(const string &policy);
+
+    //
+    // CpuOrder --
+    //  CPUs by running thread number of an affinity policy, for the
+    //  given available CPUs (node, package and core filled in, sibling
+    //  is computed).  Empty for "" and "none".  False if the policy is
+    //  a malformed CPU list.  The CPUs of an explicit list are not
+    //  checked against the available ones.
+    //
+    static bool CpuOrder(const string &policy, vector<ASIM_SMP_CPU> cpus,
+                         vector<INT32> &order);
+
+    // Parse a sysfs style CPU list ("0-3,8,10-11"), false if malformed
+    static bool ParseCpuList(const string &list, vector<INT32> &cpus);
+    static bool AffinityActive(void) { return !cpuOrder.empty(); };
+
+    // CPU of a running thread number, -1 if threads are not pinned
+    static INT32 GetThreadCpu(INT32 threadNumber);
+
+    // NUMA node of a CPU (0 if the host does not report nodes), -1 if
+    // the CPU is unknown
+    static INT32 GetCpuNode(INT32 cpu);
+    static UINT32 GetNumNodes(void) { return numNodes; };
+
+    //
+    // NUMA placement of the pages spanned by [start, start + bytes).
+    // MovePages() migrates them to 'node'.  CountPages() adds the number
+    // of them that are resident to 'pages' and the number of those that
+    // are on a node other than 'node' to 'remote'.
+    //
+    static void MovePages(const void *start, UINT64 bytes, INT32 node);
+    static void CountPages(const void *start, UINT64 bytes, INT32 node,
+                           UINT64 &pages, UINT64 &remote);
+
   private:
+    static void PinThread(INT32 threadNumber);
+    static void ReadTopology(void);
+
+    // CPUs by running thread number (empty = no affinity)
+    static vector<INT32> cpuOrder;
+    // NUMA node of every CPU
+    static vector<INT32> cpuNode;
+    static UINT32 numNodes;
+
     static ASIM_SMP_THREAD_HANDLE mainThread;
 
     static pthread_key_t threadLocalKey;
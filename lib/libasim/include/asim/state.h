@@ -49,6 +49,8 @@
 #include "asim/resource_stats.h"
 #include "asim/ioformat.h"
 #include "asim/stateout.h"
+#include "asim/checkpoint.h"
+#include "asim/sharded_counter.h"
 
 namespace iof = IoFormat;
 using namespace iof;
@@ -134,6 +136,31 @@ class ASIM_STATE_CLASS
          */
         bool suspended;
 
+        /*
+         * False for one-shot values (e.g. setup times) that must survive
+         * ClearStats at the end of a warm-up phase.
+         */
+        bool resettable;
+
+        /*
+         * For a sharded counter, u.iPtr points to its merged value,
+         * which must be refreshed before it is read and folded back
+         * into the counter after it is written.
+         */
+        ASIM_SHARDED_COUNTER sharded;
+
+        void PullValue (void) const
+        {
+            if (sharded)
+                sharded->Merge();
+        }
+
+        void PushValue (void)
+        {
+            if (sharded)
+                sharded->Rebase();
+        }
+
         /*
          * Save area to hold the state variable's value at the time
          * when it is suspended. When the variable is un-suspended
@@ -169,6 +196,7 @@ class ASIM_STATE_CLASS
          */
         void SaveValue (void)
         {
+            PullValue();
             if (type == STATE_UINT) { 
                 memcpy(save, u.iPtr, saveSz);
             } else if (type == STATE_FP) {
@@ -194,6 +222,7 @@ class ASIM_STATE_CLASS
         
         void SaveInitialValue (void)
         {
+            PullValue();
             if (type == STATE_UINT) {
                 memcpy(initial_values_save, u.iPtr, saveSz);
             } else if (type == STATE_FP) {
@@ -225,6 +254,7 @@ class ASIM_STATE_CLASS
         {
             if (type == STATE_UINT) { 
                 memcpy(u.iPtr, save, saveSz);
+                PushValue();
             } else if (type == STATE_FP) {
                 memcpy(u.fPtr, save, saveSz);
             } else if (type == STATE_STRING) {
@@ -246,13 +276,58 @@ class ASIM_STATE_CLASS
             }
         }
 
+        /*
+         * Save/restore the value at 'ptr' (either the state variable
+         * itself or its 'save' area) in a timing checkpoint.
+         */
+        void CheckpointValue (ASIM_CHECKPOINT ckpt, void *ptr)
+        {
+            if (type == STATE_UINT || type == STATE_FP) {
+                if (ckpt->IsSaving()) {
+                    ckpt->Write(ptr, saveSz);
+                } else {
+                    ckpt->Read(ptr, saveSz);
+                }
+            } else if (type == STATE_STRING) {
+                if (ckpt->IsSaving()) {
+                    ckpt->Save(*((string *)ptr));
+                } else {
+                    ckpt->Restore(*((string *)ptr));
+                }
+            } else if (type == STATE_HISTOGRAM) {
+                HISTOGRAM_TEMPLATE<true> *h = (HISTOGRAM_TEMPLATE<true> *)ptr;
+                if (ckpt->IsSaving()) {
+                    h->SaveCheckpoint(ckpt);
+                } else {
+                    h->RestoreCheckpoint(ckpt);
+                }
+            } else if (type == STATE_THREE_DIM_HISTOGRAM) {
+                THREE_DIM_HISTOGRAM_TEMPLATE<true> *h =
+                    (THREE_DIM_HISTOGRAM_TEMPLATE<true> *)ptr;
+                if (ckpt->IsSaving()) {
+                    h->SaveCheckpoint(ckpt);
+                } else {
+                    h->RestoreCheckpoint(ckpt);
+                }
+            } else if (type == STATE_RESOURCE) {
+                RESOURCE_TEMPLATE<true> *r = (RESOURCE_TEMPLATE<true> *)ptr;
+                if (ckpt->IsSaving()) {
+                    r->SaveCheckpoint(ckpt);
+                } else {
+                    r->RestoreCheckpoint(ckpt);
+                }
+            } else {
+                ASSERTX(false);
+            }
+        }
+
     public:
         
         ASIM_STATE_CLASS (UINT64 *s, const char * const n,
                           const char * const d, const char * const p, 
                           const bool sus) :
             name(strdup(n)), desc(strdup(d)), path(strdup(p)), 
-            suspendable(sus), size(1), type(STATE_UINT), suspended(false)
+            suspendable(sus), size(1), type(STATE_UINT), suspended(false), resettable(true), sharded(NULL)
         {
             u.iPtr = s;
             saveSz = sizeof(UINT64)*size;
@@ -266,7 +341,7 @@ class ASIM_STATE_CLASS
                           const char * const d, 
                           const char * const p, const bool sus) :
             name(strdup(n)), desc(strdup(d)), path(strdup(p)), 
-            suspendable(sus), size(sz), type(STATE_UINT), suspended(false)
+            suspendable(sus), size(sz), type(STATE_UINT), suspended(false), resettable(true), sharded(NULL)
         {
             u.iPtr = s;
             saveSz = sizeof(UINT64)*size;
@@ -276,9 +351,24 @@ class ASIM_STATE_CLASS
             SaveInitialValue();
         }
 
+        ASIM_STATE_CLASS (ASIM_SHARDED_COUNTER s, const char * const n,
+                          const char * const d, const char * const p,
+                          const bool sus) :
+            name(strdup(n)), desc(strdup(d)), path(strdup(p)),
+            suspendable(sus), size(1), type(STATE_UINT), suspended(false), resettable(true),
+            sharded(s)
+        {
+            u.iPtr = s->MergedValue();
+            saveSz = sizeof(UINT64)*size;
+            save = new char[saveSz];
+            initial_values_save = new char[saveSz];
+            Suspend();
+            SaveInitialValue();
+        }
+
         ASIM_STATE_CLASS (double *s, const char * const n,
                           const char * const d, const char * const p, const bool sus) :
-            name(strdup(n)), desc(strdup(d)), path(strdup(p)), suspendable(sus), size(1), type(STATE_FP), suspended(false)
+            name(strdup(n)), desc(strdup(d)), path(strdup(p)), suspendable(sus), size(1), type(STATE_FP), suspended(false), resettable(true), sharded(NULL)
         {
             u.fPtr = s;
             saveSz = sizeof(double)*size;
@@ -290,7 +380,7 @@ class ASIM_STATE_CLASS
 
         ASIM_STATE_CLASS (double *s, const UINT32 sz, const char * const n,
                           const char * const d, const char * const p, const bool sus) :
-            name(strdup(n)), desc(strdup(d)), path(strdup(p)), suspendable(sus), size(sz), type(STATE_FP), suspended(false)
+            name(strdup(n)), desc(strdup(d)), path(strdup(p)), suspendable(sus), size(sz), type(STATE_FP), suspended(false), resettable(true), sharded(NULL)
         {
             u.fPtr = s;
             saveSz = sizeof(double)*size;
@@ -302,7 +392,7 @@ class ASIM_STATE_CLASS
 
         ASIM_STATE_CLASS (string * s, const char * const n,
                           const char * const d, const char * const p, const bool sus) :
-        name(strdup(n)), desc(strdup(d)), path(strdup(p)), suspendable(sus), size(1), type(STATE_STRING), suspended(false)
+        name(strdup(n)), desc(strdup(d)), path(strdup(p)), suspendable(sus), size(1), type(STATE_STRING), suspended(false), resettable(true), sharded(NULL)
         {
             u.sPtr = s;
             saveSz = sizeof(string)*size;
@@ -319,7 +409,7 @@ class ASIM_STATE_CLASS
                           const char * const d, const char * const p, const bool sus) :
 	    name(strdup(n)), desc(strdup(d)), path(strdup(p)), 
 	    suspendable(sus), size(1), type(STATE_HISTOGRAM), 
-	    suspended(false)
+	    suspended(false), resettable(true), sharded(NULL)
         {
             s->SetName(strdup(n));
             u.hPtr = s;
@@ -339,7 +429,7 @@ class ASIM_STATE_CLASS
 			  const bool sus) :
         name(strdup(n)), desc(strdup(d)), path(strdup(p)), 
         suspendable(sus), size(1), type(STATE_THREE_DIM_HISTOGRAM), 
-        suspended(false)
+        suspended(false), resettable(true), sharded(NULL)
         {
             s->SetName(strdup(n));
             u.tdhPtr = s;
@@ -356,7 +446,7 @@ class ASIM_STATE_CLASS
                           const char * const d, const char * const p, const bool sus) :
 	    name(strdup(n)), desc(strdup(d)), path(strdup(p)), 
 	    suspendable(sus), size(1), type(STATE_RESOURCE), 
-	    suspended(false)
+	    suspended(false), resettable(true), sharded(NULL)
         {
             u.rPtr = s;
             saveSz = sizeof(RESOURCE_TEMPLATE<true>)*size;
@@ -495,6 +585,14 @@ class ASIM_STATE_CLASS
             }
         }
 
+        /*
+         * Mark the state variable as kept (or not) across ClearStats.
+         */
+        void SetResettable (bool r)
+        {
+            resettable = r;
+        }
+
         /* 
          * Dump information about a particuluar state variable.
          * The dump function  is dependent on the type of variable. 
@@ -503,6 +601,7 @@ class ASIM_STATE_CLASS
         {
             if (type == STATE_UINT)
             {
+                PullValue();
                 if (Size() == 1)
                 {
                     stateOut->AddScalar("uint", Name(), Description(),
@@ -562,9 +661,15 @@ class ASIM_STATE_CLASS
          */
         void ClearStats()
         {
+            if (!resettable)
+            {
+                return;
+            }
+
             if (type == STATE_UINT)
             {
                 memcpy(u.iPtr, initial_values_save, saveSz);
+                PushValue();
             }
             else if (type == STATE_FP)
             {
@@ -592,17 +697,63 @@ class ASIM_STATE_CLASS
             }
         }
 
+        /*
+         * Save/restore this state variable in a timing checkpoint. A
+         * suspended variable also carries its saved value, which is the
+         * one that will be reported once the variable is unsuspended.
+         */
+        void SaveCheckpoint(ASIM_CHECKPOINT ckpt)
+        {
+            ASSERTX(ckpt->IsSaving());
+            CheckpointState(ckpt);
+        }
+
+        void RestoreCheckpoint(ASIM_CHECKPOINT ckpt)
+        {
+            ASSERTX(ckpt->IsRestoring());
+            CheckpointState(ckpt);
+        }
+
+    private:
+        void CheckpointState(ASIM_CHECKPOINT ckpt)
+        {
+            ckpt->Check(string(name), "stat name");
+            ckpt->Check((UINT32)type, "stat type");
+            ckpt->Check(size, "stat size");
+
+            if (ckpt->IsSaving())
+            {
+                ckpt->Save(suspended);
+            }
+            else
+            {
+                ckpt->Restore(suspended);
+            }
+
+            PullValue();
+            CheckpointValue(ckpt, (void *)u.iPtr);
+            PushValue();
+            if (suspended)
+            {
+                CheckpointValue(ckpt, save);
+            }
+        }
+
+    public:
+
         /*
           * Return the state's value as either an integer or a float.
           * For an array state, we add all the entries and return that value.
           */
         UINT64 IntValue (void) const
         {
+            PullValue();
             return((type == STATE_UINT) ? SumIntArray(u.iPtr, size) :
                                           (UINT64)SumFpArray(u.fPtr, size));
         }
         double FpValue (void) const
         {
+            PullValue();
             return((type == STATE_UINT) ? (double)SumIntArray(u.iPtr, size) :
                                           SumFpArray(u.fPtr, size));
         }
@@ -619,11 +770,13 @@ class ASIM_STATE_CLASS
         UINT64 IntValue (UINT32 el) const
         {
             ASSERTX(el < size);
+            PullValue();
             return((type == STATE_UINT) ? u.iPtr[el] : (UINT64)(u.fPtr[el]));
         }
         double FpValue (UINT32 el) const
         {
             ASSERTX(el < size);
+            PullValue();
             return((type == STATE_UINT) ? (double)(u.iPtr[el]) : (u.fPtr[el]));
         }
         
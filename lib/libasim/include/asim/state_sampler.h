@@ -0,0 +1,124 @@
+/**************************************************************************
+ * Copyright (c) 2014, Intel Corporation
+ *
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ * 
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright 
+ *   notice, this list of conditions and the following disclaimer in the 
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the Intel Corporation nor the names of its 
+ *   contributors may be used to endorse or promote products derived from 
+ *   this software without specific prior written permission.
+ *  
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @author Pau Cabre
+ * @brief Case insensitive state index and periodic state samples
+ *
+ * Polling clients (Tarati Stats::Lookup and Stats::Read) read the UINT
+ * and FP states from a sample instead of the live model.  The simulation
+ * thread takes a sample every so often into a back buffer and swaps it
+ * with the one being read, so a read always gets the values of a single
+ * cycle, from any thread.
+ */
+
+#ifndef _STATE_SAMPLER_
+#define _STATE_SAMPLER_
+
+// generic
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+// ASIM core
+#include "asim/syntax.h"
+#include "asim/state.h"
+
+using namespace std;
+
+/**
+ * @brief Case insensitive hash of strings to the ids they name
+ *
+ * The ids of a key are kept in the order they were added.
+ */
+class STATE_INDEX_CLASS
+{
+  private:
+    struct Entry {
+        string key;
+        vector<UINT32> ids;
+    };
+    vector< vector<Entry> > buckets;
+
+    static string Lower(const char * key);
+    static UINT32 Hash(const string & key);
+
+  public:
+    STATE_INDEX_CLASS() { Init(0); }
+
+    /// size the hash for this many keys, and empty it
+    void Init(UINT32 keys);
+    void Add(const char * key, UINT32 id);
+    /// ids with this key, NULL if none
+    const vector<UINT32> * Find(const char * key) const;
+};
+
+/**
+ * @brief Samples of the UINT and FP states
+ *
+ * Handles are positions in the sampled states, in the order they were
+ * given.  Values are bit copies of the UINT64 or double of the state.
+ */
+typedef class STATE_SAMPLER_CLASS *STATE_SAMPLER;
+class STATE_SAMPLER_CLASS
+{
+  private:
+    vector<ASIM_STATE> states;   ///< sampled states, by handle
+    vector<UINT32> offset;       ///< first value of each state
+    STATE_INDEX_CLASS index;     ///< handles by Path()/Name()
+    vector<UINT64> back;         ///< sample being taken
+    vector<UINT64> front;        ///< sample being read
+    UINT64 frontCycle;           ///< cycle of the values in 'front'
+    pthread_mutex_t lock;
+
+  public:
+    /// sample the UINT and FP states of 'all', and take a sample at cycle 0
+    STATE_SAMPLER_CLASS(const vector<ASIM_STATE> & all);
+    ~STATE_SAMPLER_CLASS();
+
+    UINT32 NumHandles() const { return states.size(); }
+    ASIM_STATE GetState(INT32 handle) const { return states[handle]; }
+
+    /// handle of the state named "path/name" (any case), -1 if none
+    INT32 Lookup(const char * fullName) const;
+
+    /// read the states into a new sample (simulation thread)
+    void Take(UINT64 cycle);
+
+    /**
+     * Values of the states of 'handles' in the last sample, as doubles.
+     * All of them come from the same sample, and its cycle is returned.
+     */
+    UINT64 Read(const vector<INT32> & handles,
+                vector< vector<double> > & values);
+};
+
+#endif /* _STATE_SAMPLER_ */
@@ -48,6 +48,8 @@
 // generic
 #include <iostream>
 #include <sstream>
+#include <string>
+#include <vector>
 
 // ASIM core
 #include "asim/syntax.h"
@@ -57,6 +59,93 @@
 
 // forward declaration
 typedef class STATE_OUT_CLASS *STATE_OUT;
+typedef class STATE_SNAPSHOT_CLASS *STATE_SNAPSHOT;
+
+/**
+ * @brief Stats output recorded in memory for a background dump
+ *
+ * A background STATE_OUT_CLASS records its output operations here
+ * instead of building the XML document. Integer and floating point
+ * values are copied in binary; only values of other types are
+ * converted to text while recording. The background writer replays
+ * the records into the stats file with the same formatting the direct
+ * output would have used.
+ */
+class STATE_SNAPSHOT_CLASS
+{
+  public:
+    /// Output operations
+    enum OP
+    {
+        OP_COMPOUND,    ///< type, name, desc
+        OP_CLOSE,
+        OP_SCALAR,      ///< type, name, desc, value
+        OP_VECTOR,      ///< type, name, desc, values..., OP_VECTOR_END
+        OP_VECTOR_END,
+        OP_TEXT,        ///< text
+        OP_END
+    };
+
+    STATE_SNAPSHOT_CLASS (const char* filename) : filename(filename) { }
+
+    const char* Filename (void) const { return filename.c_str(); }
+    /// Memory used by the records
+    size_t Bytes (void) const { return data.capacity() + filename.size(); }
+
+    // recording
+    void Op (OP op) { data.push_back(char(op)); }
+    void String (const char* str);
+
+    void Value (bool v)               { Uint(v); }
+    void Value (short v)              { Int(v); }
+    void Value (unsigned short v)     { Uint(v); }
+    void Value (int v)                { Int(v); }
+    void Value (unsigned int v)       { Uint(v); }
+    void Value (long v)               { Int(v); }
+    void Value (unsigned long v)      { Uint(v); }
+    void Value (long long v)          { Int(v); }
+    void Value (unsigned long long v) { Uint(v); }
+    void Value (float v)              { Double(v); }
+    void Value (double v)             { Double(v); }
+    void Value (const char* v)        { Text(v); }
+    /// Any other type is formatted now
+    template <typename Type>
+    void Value (const Type& v)
+    {
+        ostringstream os;
+        os << v;
+        Text(os.str().c_str());
+    }
+
+    // replay
+    OP GetOp (size_t& pos) const { return OP(data[pos++]); }
+    /// Skip the end of a vector, false if a value comes first
+    bool VectorEnd (size_t& pos) const
+    {
+        return data[pos] == char(OP_VECTOR_END) ? (pos++, true) : false;
+    }
+    /// NULL if a NULL string was recorded
+    const char* GetString (size_t& pos) const;
+    /// The value formatted as the direct output does
+    string GetValue (size_t& pos) const;
+
+  private:
+    // value tags do not overlap with OP
+    enum VALUE { VALUE_UINT = 16, VALUE_INT, VALUE_DOUBLE, VALUE_TEXT };
+
+    void Put (const void* p, size_t n)
+    {
+        const char* c = (const char*)p;
+        data.insert(data.end(), c, c + n);
+    }
+    void Uint (unsigned long long v)  { data.push_back(char(VALUE_UINT)); Put(&v, sizeof(v)); }
+    void Int (long long v)            { data.push_back(char(VALUE_INT)); Put(&v, sizeof(v)); }
+    void Double (double v)            { data.push_back(char(VALUE_DOUBLE)); Put(&v, sizeof(v)); }
+    void Text (const char* v)         { data.push_back(char(VALUE_TEXT)); String(v); }
+
+    string filename;
+    vector<char> data;
+};
 
 /**
  * @brief Output class for (well formed, ie. parsable) stats files
@@ -150,20 +239,50 @@ class STATE_OUT_CLASS
 
     // variables
     XMLOut * xmlStats;  ///< the XML output object for the stats
+    STATE_SNAPSHOT snapshot; ///< records of a background dump, else NULL
 
     // methods
     /// Add the common elements type, name, and desc
     void
     AddCommonInfo (const char* type, const char* name, const char* desc);
 
+    /// Record the common elements type, name, and desc
+    void
+    RecordCommonInfo (const char* type, const char* name, const char* desc);
+
+    /// Write the records of a background dump
+    void
+    Replay (const STATE_SNAPSHOT_CLASS& snap);
+
+    /// Create the XML document of the stats file
+    void
+    OpenXML (const char* filename);
+
   public:
     // constructors / destructors / initializers
     /// Create a new STATE_OUT object
     STATE_OUT_CLASS (const char* filename);
 
-    /// Sync output to disk and destroy object
+    /// Create a STATE_OUT object written by a background thread
+    STATE_OUT_CLASS (const char* filename, bool background);
+
+    /// Sync output to disk (or hand it to the background writer)
+    /// and destroy object
     ~STATE_OUT_CLASS ();
 
+    /// Memory that the background dumps in flight may use
+    static void
+    SetBackgroundBudget (UINT64 bytes);
+
+    /// Wait until every background dump is in its file (also done
+    /// when the simulator exits)
+    static void
+    WaitBackgroundDumps (void);
+
+    /// Background writer thread
+    static void *
+    BackgroundWriter (void* arg);
+
     // accessors
 
     // modifiers
@@ -222,6 +341,14 @@ STATE_OUT_CLASS::AddScalar (
     const char* desc,   ///< description of the scalar element
     const Type& value)  ///< value to be printed
 {
+  if (snapshot)
+  {
+      snapshot->Op(STATE_SNAPSHOT_CLASS::OP_SCALAR);
+      RecordCommonInfo(type, name, desc);
+      snapshot->Value(value);
+      return;
+  }
+
   ostringstream os;
 
   // convert value to a string and pass on
@@ -252,6 +379,17 @@ STATE_OUT_CLASS::AddVector (
     InputIterator first, ///< iterator for first element
     InputIterator last)  ///< iterator past last element
 {
+    if (snapshot)
+    {
+        snapshot->Op(STATE_SNAPSHOT_CLASS::OP_VECTOR);
+        RecordCommonInfo(type, name, desc);
+        for ( ; first != last; first++) {
+            snapshot->Value(*first);
+        }
+        snapshot->Op(STATE_SNAPSHOT_CLASS::OP_VECTOR_END);
+        return;
+    }
+
     xmlStats->AddElement(elementVector);
     AddCommonInfo(type, name, desc);
 
@@ -0,0 +1,255 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ *
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the Intel Corporation nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file
+ * @author Pau Cabre
+ * @brief Hierarchical timing wheel of cycle-stamped items.
+ *
+ * Items are scheduled at an absolute cycle and handed back by Expire()
+ * when that cycle comes.  Expire() has to be called once per cycle, in
+ * order, so scheduling and expiring are O(1) whatever the number of
+ * pending items:
+ *  - level 0 has one slot per cycle of the current block of 2^BITS
+ *    cycles;
+ *  - level 1 has one slot per block of the current superblock of
+ *    2^(2*BITS) cycles, and is cascaded into level 0 when its block
+ *    starts;
+ *  - anything further away waits in an ordered overflow list that is
+ *    moved into the wheel when its superblock starts.
+ *
+ * Items are returned in scheduling order and are not deduplicated.
+ */
+
+#ifndef _TIMING_WHEEL_
+#define _TIMING_WHEEL_
+
+// generic
+#include <vector>
+#include <map>
+
+// ASIM core
+#include "asim/syntax.h"
+#include "asim/mesg.h"
+#include "asim/checkpoint.h"
+
+using namespace std;
+
+template <class T, UINT32 BITS = 8>
+class ASIM_TIMING_WHEEL_CLASS
+{
+  private:
+    enum
+    {
+        SLOTS = 1 << BITS,
+        MASK = SLOTS - 1
+    };
+
+    /// Level 0: items of the current block, one slot per cycle
+    vector<T> level0[SLOTS];
+    /// Level 1: items of the current superblock, one slot per block
+    vector< pair<UINT64, T> > level1[SLOTS];
+    /// Items beyond the current superblock
+    multimap<UINT64, T> overflow;
+
+    /// Items returned by the last Expire()
+    vector<T> expired;
+
+    /// Next cycle to expire
+    UINT64 current;
+    UINT64 pending;
+
+    void Insert(UINT64 cycle, const T &item);
+    void Clear(void);
+
+  public:
+    ASIM_TIMING_WHEEL_CLASS(UINT64 start = 0)
+      : current(start),
+        pending(0)
+    { }
+
+    /// Next cycle that Expire() will hand back
+    UINT64 GetCurrent(void) const { return current; }
+    /// Number of items scheduled and not expired yet
+    UINT64 GetPending(void) const { return pending; }
+
+    /**
+     * Schedule 'item' at 'cycle'.  A cycle that has already expired is
+     * delivered at the next Expire().
+     */
+    void Schedule(UINT64 cycle, const T &item)
+    {
+        pending++;
+        Insert(cycle < current ? current : cycle, item);
+    }
+
+    /**
+     * Return the items scheduled at 'cycle', which must be the current
+     * cycle, and advance to the next one.  The vector is valid until
+     * the next call.
+     */
+    const vector<T> &Expire(UINT64 cycle);
+
+    /// Checkpoint the pending items (T must be serializable)
+    void SaveCheckpoint(ASIM_CHECKPOINT ckpt) const;
+    void RestoreCheckpoint(ASIM_CHECKPOINT ckpt);
+};
+
+
+//----------------------------------------------------------------------------
+// implementation
+//----------------------------------------------------------------------------
+
+template <class T, UINT32 BITS>
+inline void
+ASIM_TIMING_WHEEL_CLASS<T, BITS>::Insert(UINT64 cycle, const T &item)
+{
+    if ((cycle >> BITS) == (current >> BITS))
+    {
+        level0[cycle & MASK].push_back(item);
+    }
+    else if ((cycle >> (2 * BITS)) == (current >> (2 * BITS)))
+    {
+        level1[(cycle >> BITS) & MASK].push_back(make_pair(cycle, item));
+    }
+    else
+    {
+        overflow.insert(make_pair(cycle, item));
+    }
+}
+
+template <class T, UINT32 BITS>
+inline const vector<T> &
+ASIM_TIMING_WHEEL_CLASS<T, BITS>::Expire(UINT64 cycle)
+{
+    ASSERT(cycle == current, "Timing wheel expired at cycle " << cycle
+           << " but the next cycle is " << current);
+
+    expired.clear();
+    if (pending == 0)
+    {
+        current++;
+        return expired;
+    }
+
+    if ((current & MASK) == 0)
+    {
+        // a new superblock: pull its items out of the overflow list
+        if ((current & ((UINT64(1) << (2 * BITS)) - 1)) == 0)
+        {
+            typename multimap<UINT64, T>::iterator last =
+                overflow.lower_bound(current + (UINT64(1) << (2 * BITS)));
+            for (typename multimap<UINT64, T>::iterator i = overflow.begin();
+                 i != last; ++i)
+            {
+                Insert(i->first, i->second);
+            }
+            overflow.erase(overflow.begin(), last);
+        }
+
+        // a new block: spread its level 1 slot over level 0
+        vector< pair<UINT64, T> > &slot = level1[(current >> BITS) & MASK];
+        for (UINT32 i = 0; i < slot.size(); i++)
+        {
+            level0[slot[i].first & MASK].push_back(slot[i].second);
+        }
+        slot.clear();
+    }
+
+    expired.swap(level0[current & MASK]);
+    pending -= expired.size();
+    current++;
+    return expired;
+}
+
+template <class T, UINT32 BITS>
+void
+ASIM_TIMING_WHEEL_CLASS<T, BITS>::Clear(void)
+{
+    for (UINT32 i = 0; i < SLOTS; i++)
+    {
+        level0[i].clear();
+        level1[i].clear();
+    }
+    overflow.clear();
+    expired.clear();
+    pending = 0;
+}
+
+template <class T, UINT32 BITS>
+void
+ASIM_TIMING_WHEEL_CLASS<T, BITS>::SaveCheckpoint(ASIM_CHECKPOINT ckpt) const
+{
+    ckpt->Save(current);
+    ckpt->Save(pending);
+
+    UINT64 block = current & ~UINT64(MASK);
+    for (UINT32 i = 0; i < SLOTS; i++)
+    {
+        for (UINT32 j = 0; j < level0[i].size(); j++)
+        {
+            ckpt->Save(block | i);
+            ckpt->Save(level0[i][j]);
+        }
+        for (UINT32 j = 0; j < level1[i].size(); j++)
+        {
+            ckpt->Save(level1[i][j].first);
+            ckpt->Save(level1[i][j].second);
+        }
+    }
+    typename multimap<UINT64, T>::const_iterator i = overflow.begin();
+    for ( ; i != overflow.end(); ++i)
+    {
+        ckpt->Save(i->first);
+        ckpt->Save(i->second);
+    }
+}
+
+template <class T, UINT32 BITS>
+void
+ASIM_TIMING_WHEEL_CLASS<T, BITS>::RestoreCheckpoint(ASIM_CHECKPOINT ckpt)
+{
+    Clear();
+
+    UINT64 n;
+    ckpt->Restore(current);
+    ckpt->Restore(n);
+    for (UINT64 i = 0; i < n; i++)
+    {
+        UINT64 cycle;
+        T item;
+        ckpt->Restore(cycle);
+        ckpt->Restore(item);
+        Schedule(cycle, item);
+    }
+}
+
+#endif // _TIMING_WHEEL_
@@ -32,6 +32,7 @@
 #define TRACE_H
 
 #include <list>
+#include <vector>
 #include <string>
 #include <iostream>
 #include <fstream>
@@ -171,6 +172,69 @@ struct TRACEABLE_REGEX_CLASS
 };
 typedef list<TRACEABLE_REGEX> TRACEABLE_REGEX_LIST;
 
+// A set of trace regexes compiled together, so that a name is matched
+// against all of them in a single pass.  Regexes that are a plain
+// string, optionally anchored and/or surrounded by .* (the usual
+// "^cpu0/.*" or "PORTS" forms), go into one Aho-Corasick automaton and
+// cost O(name length) no matter how many there are.  Anything else is
+// left to regexec, and only tried when it could still change the
+// result.  The matcher does not own the Regex objects.
+class TRACE_REGEX_MATCHER_CLASS;
+typedef TRACE_REGEX_MATCHER_CLASS *TRACE_REGEX_MATCHER;
+class TRACE_REGEX_MATCHER_CLASS
+{
+  private:
+    struct PATTERN
+    {
+        Regex *regex;
+        int level;
+        // only valid for the literal forms
+        std::string literal;
+        bool anchorStart;
+        bool anchorEnd;
+    };
+
+    struct NODE
+    {
+        // sorted by character
+        std::vector<std::pair<unsigned char, int> > next;
+        int fail;
+        // closest node on the fail chain with patterns ending there
+        int outLink;
+        int depth;
+        // literal patterns ending at this node
+        std::vector<int> patterns;
+    };
+
+    std::vector<PATTERN> patterns;
+    std::vector<NODE> nodes;
+    // literal patterns with an empty string (".*", "^", "^$"...)
+    std::vector<int> emptyPatterns;
+    // patterns that need regexec, in increasing order
+    std::vector<int> genericPatterns;
+    bool built;
+
+    static bool ParseLiteral(const Regex *regex, PATTERN &p);
+    int Child(int node, unsigned char c) const;
+    int AddChild(int node, unsigned char c);
+
+  public:
+    TRACE_REGEX_MATCHER_CLASS();
+
+    // Add a regex.  When a name matches several of them the one added
+    // last wins, like when they are applied one after the other.
+    void Add(Regex *regex, int level);
+    void Add(const TRACEABLE_REGEX_LIST *list);
+
+    // Compile the automaton.  Must be called after the last Add().
+    void Build();
+
+    // Index of the last added regex matching name, or -1.
+    int Match(const std::string &name) const;
+    int GetLevel(int idx) const { return patterns[idx].level; }
+    bool Empty() const { return patterns.empty(); }
+};
+
 // Support the functionality of applying some number of
 // regular expression to enable traces, packaging them
 // all up, turning off the traces enabled by those regular
@@ -241,8 +305,10 @@ class TRACEABLE_CLASS
     // this traceable object in the traceables list.
     std::list<TRACEABLE>::iterator myTraceablesEntry;
 
-    // The regular expressions in effect.
+    // The regular expressions in effect, and the same compiled into a
+    // single matcher (built on demand, NULL when out of date).
     static TRACEABLE_REGEX_LIST *regexes;
+    static TRACE_REGEX_MATCHER regexMatcher;
     static pthread_mutex_t regexesMutex;
 
     // Compute the value of traceOnArr.
@@ -251,6 +317,14 @@ class TRACEABLE_CLASS
     // Apply a regex to a trace object.
     void EnableByRegex(Regex *regex, int level);
 
+    // Apply a compiled set of regexes to a trace object, or to all of
+    // them in one walk of the traceables list.
+    void EnableByMatcher(const TRACE_REGEX_MATCHER_CLASS &matcher);
+    static void EnableAllByMatcher(const TRACE_REGEX_MATCHER_CLASS &matcher);
+
+    // Forget the compiled regexMatcher.  Call with regexesMutex held.
+    static void InvalidateRegexMatcher();
+
     // Setting this to false will disable the thread safety features
     // of traceable.
     static bool enableThreadProtection;
@@ -355,6 +429,12 @@ inline void TRACEABLE_CLASS::SetTraceOn(bool enabled)
 
 inline void TRACEABLE_CLASS::Trace(std::ostringstream &out) const
 {
+    if (threadTraceBuffer != NULL && threadTraceBuffer->Buffering())
+    {
+        // merged in serial order by the clock server
+        threadTraceBuffer->Append(TRACEABLE_CLASS::traceStream, out.str());
+        return;
+    }
 #if MAX_PTHREADS > 1
     get_thread_safe_log(TRACEABLE_CLASS::traceStream).ts() << std::dec << pthread_self() << ": " <<  out.str() << endl;
 #else
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ *
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the Intel Corporation nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @author Pau Cabre
+ * @brief Trace records of a thread clocking in parallel with others.
+ */
+
+#ifndef _TRACE_BUFFER_H
+#define _TRACE_BUFFER_H
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <ostream>
+
+// ASIM core
+#include "asim/syntax.h"
+#include "asim/dralChunkList.h"
+
+//
+// A worker thread of the threaded clock server keeps the trace records it
+// writes while clocking in a TRACE_BUFFER_CLASS instead of writing them to
+// the shared stream. Every record is tagged with the key of the clockable
+// being clocked: (time point, event, index of the clockable in the event).
+// The main thread merges the records of every worker in key order, which
+// is the order the serial clock server writes them in, so the trace is the
+// same with any number of threads and any thread timing.
+//
+// Records with the same key are kept together in a chunk. The worker hands
+// the chunks to the main thread through a DRAL_CHUNK_LIST_CLASS, the same
+// lock-free single producer/single consumer list the DRAL substreams use,
+// and reuses the chunks already merged.
+//
+typedef class TRACE_BUFFER_CLASS *TRACE_BUFFER;
+class TRACE_BUFFER_CLASS
+{
+  public:
+    TRACE_BUFFER_CLASS();
+    ~TRACE_BUFFER_CLASS();
+
+    // Records written from now on get this key (worker thread). Keys must
+    // not decrease.
+    inline void SetKey(UINT64 time, UINT32 seq, UINT32 index);
+
+    // Hand the records over to the main thread and write the next ones
+    // directly again (worker thread)
+    void ClearKey();
+
+    // Are the records of the thread buffered?
+    bool Buffering() const { return keyed; }
+
+    // Buffer a record for out (without the end of line)
+    void Append(std::ostream *out, const std::string &record);
+
+    // Write the records of every buffer up to time point 'time', in key
+    // order and, for the same key, in buffer order (main thread)
+    static void Merge(const std::vector<TRACE_BUFFER> &buffers, UINT64 time);
+
+  private:
+    struct RECORD
+    {
+        std::ostream *out;
+        std::string text;
+    };
+
+    struct CHUNK
+    {
+        CHUNK * volatile next;
+        UINT64 time;
+        UINT32 seq;
+        UINT32 index;
+        std::vector<RECORD> records;
+        UINT32 used;
+    };
+
+    void Publish();
+
+    // consumer side: next chunk to merge, NULL if none up to 'time'
+    CHUNK *Peek(UINT64 time);
+
+    DRAL_CHUNK_LIST_CLASS<CHUNK> chunks;
+
+    // producer side
+    bool keyed;
+    UINT64 keyTime;
+    UINT32 keySeq;
+    UINT32 keyIndex;
+    CHUNK *current;     // chunk being filled, NULL if none
+};
+
+// Buffer of the calling thread, NULL if it writes its records directly
+extern __thread TRACE_BUFFER threadTraceBuffer;
+
+inline void
+TRACE_BUFFER_CLASS::SetKey(UINT64 time, UINT32 seq, UINT32 index)
+{
+    keyed = true;
+    keyTime = time;
+    keySeq = seq;
+    keyIndex = index;
+}
+
+//
+// Write the expression 'b' as a record to 'out', or to the buffer of the
+// calling thread if it has one.
+//
+#define TRACE_BUFFER_RECORD(out, b, direct) \
+do { \
+    if (threadTraceBuffer != NULL && threadTraceBuffer->Buffering()) \
+    { \
+        std::ostringstream __traceRecord; \
+        __traceRecord << b; \
+        threadTraceBuffer->Append(out, __traceRecord.str()); \
+    } \
+    else \
+    { \
+        direct; \
+    } \
+} while(0)
+
+#endif // _TRACE_BUFFER_H
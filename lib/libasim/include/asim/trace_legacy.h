@@ -50,6 +50,7 @@
 #include "asim/syntax.h"
 #include "asim/message_handler_log.h"
 #include "asim/threaded_log.h"
+#include "asim/trace_buffer.h"
 
 
 
@@ -79,7 +80,7 @@ inline long  getStartTime(){
 do { \
     if (traceOn && (traceMask & (a))) \
     { \
-	cout << b << endl; \
+	TRACE_BUFFER_RECORD(&cout, b, cout << b << endl); \
     } \
 } while(0)
 
@@ -123,7 +124,8 @@ do { \
 do { \
     if (traceOn && (traceMask & (a))) \
     { \
-	get_thread_safe_log(&cout).ts() << std::dec << pthread_self() << ": "  << b << endl; \
+	TRACE_BUFFER_RECORD(&cout, b, \
+	    get_thread_safe_log(&cout).ts() << std::dec << pthread_self() << ": "  << b << endl); \
     } \
 } while(0)
 
@@ -141,7 +143,7 @@ do { \
 
 #define TTMSG(a, b)  do { \
 if (traceOn && (traceMask & (a))) \
-{ cout << b << endl; } \
+{ TRACE_BUFFER_RECORD(&cout, b, cout << b << endl); } \
 } while(0) 
 
 
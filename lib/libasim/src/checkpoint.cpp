@@ -0,0 +1,246 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ *
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the Intel Corporation nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @author Pau Cabre
+ * @brief Binary checkpoint/restore of the timing model state.
+ */
+
+// generic
+#include <string.h>
+#include <errno.h>
+
+// ASIM core
+#include "asim/checkpoint.h"
+#include "asim/module.h"
+#include "asim/port.h"
+#include "asim/clockable.h"
+
+static const char CKPT_MAGIC[8] = { 'A', 'S', 'I', 'M', 'C', 'K', 'P', 'T' };
+static const UINT32 CKPT_END_OF_SECTION = 0x454e4421; // "END!"
+
+// checkpoints are written in large chunks
+static const size_t CKPT_IO_BUFFER_SIZE = 1 << 20;
+
+
+ASIM_CHECKPOINT_CLASS::ASIM_CHECKPOINT_CLASS(
+    const char *fileName,
+    CKPT_MODE mode)
+  : file(NULL),
+    fileName(fileName),
+    mode(mode),
+    nextObjectId(1),
+    section("header")
+{
+    file = fopen(fileName, (mode == CKPT_SAVE) ? "wb" : "rb");
+    if (file == NULL)
+    {
+        ASIMERROR("Unable to open checkpoint file \"" << fileName
+                  << "\", " << strerror(errno));
+    }
+    setvbuf(file, NULL, _IOFBF, CKPT_IO_BUFFER_SIZE);
+
+    if (IsSaving())
+    {
+        Write(CKPT_MAGIC, sizeof(CKPT_MAGIC));
+        UINT32 version = CKPT_VERSION;
+        Write(&version, sizeof(version));
+    }
+    else
+    {
+        char magic[sizeof(CKPT_MAGIC)];
+        Read(magic, sizeof(magic));
+        VERIFY(memcmp(magic, CKPT_MAGIC, sizeof(CKPT_MAGIC)) == 0,
+               "File " << fileName << " is not an ASIM checkpoint");
+
+        UINT32 version;
+        Read(&version, sizeof(version));
+        VERIFY(version == CKPT_VERSION, "Checkpoint " << fileName
+               << " has version " << version << ", expected " << CKPT_VERSION);
+    }
+}
+
+ASIM_CHECKPOINT_CLASS::~ASIM_CHECKPOINT_CLASS()
+{
+    if (file != NULL)
+    {
+        if (fclose(file) != 0 && IsSaving())
+        {
+            ASIMERROR("Error writing checkpoint file \"" << fileName
+                      << "\", " << strerror(errno));
+        }
+    }
+}
+
+void
+ASIM_CHECKPOINT_CLASS::Write(
+    const void *buf,
+    size_t len)
+{
+    ASSERTX(IsSaving());
+    if (fwrite(buf, 1, len, file) != len)
+    {
+        ASIMERROR("Error writing checkpoint file \"" << fileName
+                  << "\", " << strerror(errno));
+    }
+}
+
+void
+ASIM_CHECKPOINT_CLASS::Read(
+    void *buf,
+    size_t len)
+{
+    ASSERTX(IsRestoring());
+    if (fread(buf, 1, len, file) != len)
+    {
+        ASIMERROR("Checkpoint file \"" << fileName << "\" is truncated"
+                  << " (section " << section << ")");
+    }
+}
+
+/**
+ * Start a named section.  On restore the name must match the one saved.
+ */
+void
+ASIM_CHECKPOINT_CLASS::BeginSection(
+    const char *name)
+{
+    string sname(name);
+
+    if (IsSaving())
+    {
+        Save(sname);
+    }
+    else
+    {
+        string saved;
+        Restore(saved);
+        VERIFY(saved == sname, "Checkpoint " << fileName << " has section "
+               << saved << " where " << sname << " was expected");
+    }
+    section = sname;
+}
+
+/**
+ * Close the current section.  On restore, check that exactly the data
+ * written for this section has been consumed.
+ */
+void
+ASIM_CHECKPOINT_CLASS::EndSection(void)
+{
+    UINT32 marker = CKPT_END_OF_SECTION;
+
+    if (IsSaving())
+    {
+        Save(marker);
+    }
+    else
+    {
+        Restore(marker);
+        VERIFY(marker == CKPT_END_OF_SECTION, "Checkpoint " << fileName
+               << ": section " << section << " does not match the model");
+    }
+}
+
+UINT64
+ASIM_CHECKPOINT_CLASS::SaveObjectId(
+    const void *obj,
+    bool &isNew)
+{
+    isNew = false;
+    if (obj == NULL)
+    {
+        return 0;
+    }
+
+    map<const void *, UINT64>::iterator i = savedObjects.find(obj);
+    if (i != savedObjects.end())
+    {
+        return i->second;
+    }
+
+    isNew = true;
+    UINT64 id = nextObjectId++;
+    savedObjects[obj] = id;
+    return id;
+}
+
+void *
+ASIM_CHECKPOINT_CLASS::LookupObject(
+    UINT64 id) const
+{
+    map<UINT64, void *>::const_iterator i = restoredObjects.find(id);
+    return (i != restoredObjects.end()) ? i->second : NULL;
+}
+
+void
+ASIM_CHECKPOINT_CLASS::RegisterObject(
+    UINT64 id,
+    void *obj)
+{
+    ASSERTX(restoredObjects.find(id) == restoredObjects.end());
+    restoredObjects[id] = obj;
+}
+
+void
+ASIM_CHECKPOINT_CLASS::Unsupported(
+    const char *typeName)
+{
+    ASIMERROR("Checkpoint " << fileName << ", section " << section
+              << ": don't know how to save values of type " << typeName
+              << " (add SaveCheckpoint/RestoreCheckpoint methods or"
+              << " declare it with ASIM_CHECKPOINT_POD)");
+}
+
+
+void
+ASIM_CHECKPOINT_CLASS::SaveTimingState(
+    const char *fileName,
+    ASIM_MODULE root)
+{
+    ASIM_CHECKPOINT_CLASS ckpt(fileName, CKPT_SAVE);
+
+    ASIM_CLOCKABLE_CLASS::GetClockServer()->SaveCheckpoint(&ckpt);
+    BasePort::SaveAllPorts(&ckpt);
+    root->SaveCheckpoint(&ckpt);
+}
+
+void
+ASIM_CHECKPOINT_CLASS::RestoreTimingState(
+    const char *fileName,
+    ASIM_MODULE root)
+{
+    ASIM_CHECKPOINT_CLASS ckpt(fileName, CKPT_RESTORE);
+
+    ASIM_CLOCKABLE_CLASS::GetClockServer()->RestoreCheckpoint(&ckpt);
+    BasePort::RestoreAllPorts(&ckpt);
+    root->RestoreCheckpoint(&ckpt);
+}
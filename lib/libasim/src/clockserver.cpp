@@ -38,12 +38,23 @@
 #include <cstdlib>
 #include <ctime>
 #include <sched.h>
+#include <unistd.h>
+#include <algorithm>
 
 #include "asim/clockserver.h"
 #include "asim/clockable.h"
 #include "asim/module.h"
 #include "asim/smp.h"
 #include "asim/rate_matcher.h"
+#include "asim/partition.h"
+#include "asim/port.h"
+
+
+/******************************************************************************
+*   ClockCallBackInterface
+*******************************************************************************/
+
+UINT32 ClockCallBackInterface::profilePeriod = 0;
 
 
 /******************************************************************************
@@ -158,6 +169,9 @@ ASIM_CLOCK_SERVER_CLASS::ASIM_CLOCK_SERVER_CLASS()
       uniqueClockDomain(false),
       uniqueDomainOptimization(true),
       threaded(false),
+      threadedEvents(false),
+      threadedTrace(false),
+      threadPagesCounted(false),
       referenceClockRegitry(NULL),
       firstClockRegitry(NULL),
       firstClockRegitrySet(false),
@@ -214,6 +228,22 @@ ASIM_CLOCK_SERVER_CLASS::~ASIM_CLOCK_SERVER_CLASS()
 }
 
 
+/**
+ * CPU of the pthread of a worker thread, -1 if it does not have its own
+ * pthread or threads are not pinned.
+ **/
+static INT32
+WorkerCpu(ASIM_CLOCKSERVER_THREAD thread)
+{
+    if (thread == NULL || !thread->ThreadActive())
+    {
+        return -1;
+    }
+    return ASIM_SMP_CLASS::GetThreadCpu(
+        thread->GetAsimThreadHandle()->GetRunningThreadNumber());
+}
+
+
 /** 
  * Dumps some clockserver stats
  *
@@ -245,8 +275,294 @@ ASIM_CLOCK_SERVER_CLASS::DumpStats(STATE_OUT state_out, UINT64 total_base_cycles
             state_out->AddScalar("uint", os.str().c_str(),
                 "current working frequency for this domain in MHz",
                 (*iter_dom)->currentFrequency * 10);
+
+            bool onDemand = false;
+            UINT64 onDemandClocks = 0;
+            list<CLOCK_REGISTRY>::iterator iter = (*iter_dom)->lClock.begin();
+            for( ; iter != (*iter_dom)->lClock.end(); ++iter)
+            {
+                onDemand |= (*iter)->onDemand;
+                onDemandClocks += (*iter)->nOnDemandClocks;
+            }
+            if (onDemand)
+            {
+                os.str("");
+                os << "Domain_" << (*iter_dom)->name << "_on_demand_clocks";
+                state_out->AddScalar("uint", os.str().c_str(),
+                    "clock callbacks of modules clocked on demand invoked",
+                    onDemandClocks);
+            }
+        }
+    }
+
+    if (threaded && ASIM_SMP_CLASS::AffinityActive())
+    {
+        // the buffers do not move after InitClockServer, so one count
+        // (once the model has touched them) is enough
+        if (!threadPagesCounted)
+        {
+            CountThreadData(threadPages);
+            threadPagesCounted = true;
+        }
+        map<ASIM_CLOCKSERVER_THREAD, pair<UINT64, UINT64> > &pages = threadPages;
+
+        UINT64 totalPages = 0;
+        UINT64 totalRemote = 0;
+        list<ASIM_CLOCKSERVER_THREAD>::iterator iter_threads;
+        for(iter_threads = lThreads.begin(); iter_threads != lThreads.end();
+            ++iter_threads)
+        {
+            INT32 cpu = WorkerCpu(*iter_threads);
+            if (cpu < 0)
+            {
+                continue;
+            }
+            UINT32 id = (*iter_threads)->GetThreadId();
+
+            os.str("");
+            os << "Thread_" << id << "_cpu";
+            state_out->AddScalar("uint", os.str().c_str(),
+                "CPU the worker thread is pinned to", cpu);
+
+            os.str("");
+            os << "Thread_" << id << "_numa_node";
+            state_out->AddScalar("uint", os.str().c_str(),
+                "NUMA node of the worker thread",
+                ASIM_SMP_CLASS::GetCpuNode(cpu));
+
+            os.str("");
+            os << "Thread_" << id << "_port_pages";
+            state_out->AddScalar("uint", os.str().c_str(),
+                "memory pages of the port buffers read by its modules",
+                pages[*iter_threads].first);
+
+            os.str("");
+            os << "Thread_" << id << "_remote_port_pages";
+            state_out->AddScalar("uint", os.str().c_str(),
+                "port buffer pages of its modules on another NUMA node",
+                pages[*iter_threads].second);
+
+            totalPages += pages[*iter_threads].first;
+            totalRemote += pages[*iter_threads].second;
+        }
+
+        state_out->AddScalar("double", "Numa_remote_port_pages_ratio",
+            "fraction of the port buffer pages away from the worker reading them",
+            totalPages ? double(totalRemote) / totalPages : 0.0);
+    }
+
+    if (!bDumpProfile)
+    {
+        return;
+    }
+
+    //
+    // Sampled host cycles spent in the clock callbacks, per domain and
+    // per callback.
+    //
+    state_out->AddCompound("clock_profile", "clock_profile",
+        "host cycles spent in the clock callbacks (sampled)");
+    state_out->AddScalar("uint", "sample_period",
+        "one out of this many callbacks is timed",
+        ClockCallBackInterface::profilePeriod);
+
+    for(iter_dom = lDomain.begin(); iter_dom != lDomain.end(); ++iter_dom)
+    {
+        UINT64 samples = 0;
+        UINT64 cycles = 0;
+        list<CLOCK_REGISTRY>::iterator iter = (*iter_dom)->lClock.begin();
+        for( ; iter != (*iter_dom)->lClock.end(); ++iter)
+        {
+            for(UINT32 i = 0; i < (*iter)->lModules.size(); i++)
+            {
+                samples += (*iter)->lModules[i].second->profSamples;
+                cycles += (*iter)->lModules[i].second->profCycles;
+            }
+        }
+        if (samples == 0)
+        {
+            continue;
+        }
+
+        state_out->AddCompound("clock_domain", (*iter_dom)->name.c_str());
+        state_out->AddScalar("uint", "samples",
+            "number of callbacks timed", samples);
+        state_out->AddScalar("uint", "host_cycles_sampled",
+            "host cycles spent in the timed callbacks", cycles);
+        state_out->AddScalar("uint", "host_cycles_estimated",
+            "estimated host cycles spent in all the callbacks",
+            cycles * ClockCallBackInterface::profilePeriod);
+
+        for(iter = (*iter_dom)->lClock.begin(); iter != (*iter_dom)->lClock.end(); ++iter)
+        {
+            for(UINT32 i = 0; i < (*iter)->lModules.size(); i++)
+            {
+                CLOCK_CALLBACK_INTERFACE cb = (*iter)->lModules[i].second;
+                if (cb->profSamples == 0)
+                {
+                    continue;
+                }
+
+                state_out->AddCompound("clock_callback",
+                    (*iter)->lModules[i].first->ProfileId());
+                state_out->AddScalar("uint", "skew",
+                    "skew of the callback within the domain", (*iter)->nSkew);
+                state_out->AddScalar("uint", "samples",
+                    "number of callbacks timed", cb->profSamples);
+                state_out->AddScalar("uint", "host_cycles_sampled",
+                    "host cycles spent in the timed callbacks", cb->profCycles);
+                state_out->AddScalar("uint", "host_cycles_max",
+                    "longest timed callback in host cycles", cb->profMax);
+                state_out->CloseCompound();
+            }
         }
+        state_out->CloseCompound();
     }
+
+    state_out->CloseCompound();
+}
+
+
+/**
+ * Flame graph frames identifying a profiled callback: the clocking
+ * thread, the clock domain and the module path, separated by ';'.
+ **/
+string
+ASIM_CLOCK_SERVER_CLASS::ProfileFrames(ASIM_CLOCKABLE m, CLOCK_REGISTRY reg)
+{
+    ostringstream os;
+    os << "thread_" << m->GetClockingThread()->GetThreadId() << ";"
+       << reg->clockDomain->name << ";";
+
+    // the count is separated by the last space, so none in the frames
+    string path = m->ProfileId();
+    path.erase(0, path.find_first_not_of('/'));
+    for (UINT32 i = 0; i < path.size(); i++)
+    {
+        if (path[i] == '/')
+        {
+            path[i] = ';';
+        }
+        else if (path[i] == ' ' || path[i] == '\t')
+        {
+            path[i] = '_';
+        }
+    }
+    os << path;
+    return os.str();
+}
+
+
+/**
+ * Save the clocking state in a timing checkpoint: the current frequency
+ * of each clock domain, the cycle counters of each clock registry and
+ * the order of the pending clock events.
+ *
+ * Registries are identified by their position when walking the domains
+ * in creation order, which does not change between runs of the same
+ * model.
+ **/
+void
+ASIM_CLOCK_SERVER_CLASS::SaveCheckpoint(ASIM_CHECKPOINT ckpt)
+{
+    VERIFY(!threaded, "Timing checkpoints are not supported with threaded clocking");
+
+    ckpt->BeginSection("clockserver");
+    ckpt->Check(lDomain.size(), "number of clock domains");
+
+    vector<CLOCK_REGISTRY> registries;
+    list<CLOCK_DOMAIN>::iterator iter_dom;
+    for(iter_dom = lDomain.begin(); iter_dom != lDomain.end(); ++iter_dom)
+    {
+        ckpt->Check((*iter_dom)->name, "clock domain name");
+        ckpt->Check((*iter_dom)->lClock.size(), "number of clock registries");
+        ckpt->Save((*iter_dom)->currentFrequency);
+
+        list<CLOCK_REGISTRY>::iterator iter = (*iter_dom)->lClock.begin();
+        for( ; iter != (*iter_dom)->lClock.end(); ++iter)
+        {
+            CLOCK_REGISTRY reg = *iter;
+            ckpt->Check(reg->nSkew, "clock registry skew");
+            ckpt->Save(reg->nFrequency);
+            ckpt->Save(reg->nStep);
+            ckpt->Save(reg->nBaseCycle);
+            ckpt->Save(reg->nCycle);
+            ckpt->Check(reg->onDemand, "clock registry on demand");
+            if (reg->onDemand)
+            {
+                ckpt->Save(reg->wakeWheel);
+            }
+            registries.push_back(reg);
+        }
+    }
+
+    // pending events, as positions in the registry list
+    ckpt->Save(lTimeEvents.size());
+    deque<CLOCK_REGISTRY>::iterator iter_ev = lTimeEvents.begin();
+    for( ; iter_ev != lTimeEvents.end(); ++iter_ev)
+    {
+        UINT32 pos = find(registries.begin(), registries.end(), *iter_ev) -
+                     registries.begin();
+        VERIFYX(pos < registries.size());
+        ckpt->Save(pos);
+    }
+
+    ckpt->Save(internalBaseCycle);
+    ckpt->Write(random_state, sizeof(random_state));
+
+    ckpt->EndSection();
+}
+
+void
+ASIM_CLOCK_SERVER_CLASS::RestoreCheckpoint(ASIM_CHECKPOINT ckpt)
+{
+    VERIFY(!threaded, "Timing checkpoints are not supported with threaded clocking");
+
+    ckpt->BeginSection("clockserver");
+    ckpt->Check(lDomain.size(), "number of clock domains");
+
+    vector<CLOCK_REGISTRY> registries;
+    list<CLOCK_DOMAIN>::iterator iter_dom;
+    for(iter_dom = lDomain.begin(); iter_dom != lDomain.end(); ++iter_dom)
+    {
+        ckpt->Check((*iter_dom)->name, "clock domain name");
+        ckpt->Check((*iter_dom)->lClock.size(), "number of clock registries");
+        ckpt->Restore((*iter_dom)->currentFrequency);
+
+        list<CLOCK_REGISTRY>::iterator iter = (*iter_dom)->lClock.begin();
+        for( ; iter != (*iter_dom)->lClock.end(); ++iter)
+        {
+            CLOCK_REGISTRY reg = *iter;
+            ckpt->Check(reg->nSkew, "clock registry skew");
+            ckpt->Restore(reg->nFrequency);
+            ckpt->Restore(reg->nStep);
+            ckpt->Restore(reg->nBaseCycle);
+            ckpt->Restore(reg->nCycle);
+            ckpt->Check(reg->onDemand, "clock registry on demand");
+            if (reg->onDemand)
+            {
+                ckpt->Restore(reg->wakeWheel);
+            }
+            registries.push_back(reg);
+        }
+    }
+
+    // rebuild the pending events list in the saved order
+    size_t nEvents;
+    ckpt->Restore(nEvents);
+    lTimeEvents.clear();
+    for (size_t i = 0; i < nEvents; i++)
+    {
+        UINT32 pos;
+        ckpt->Restore(pos);
+        VERIFY(pos < registries.size(), "Corrupted clock event list in checkpoint");
+        lTimeEvents.push_back(registries[pos]);
+    }
+
+    ckpt->Restore(internalBaseCycle);
+    ckpt->Read(random_state, sizeof(random_state));
+
+    ckpt->EndSection();
 }
 
 
@@ -291,8 +607,10 @@ void ASIM_CLOCK_SERVER_CLASS::DumpProfile()
                             mCurrent->GetCyclesMax() << endl;
                         ofsProfiling << "\tMin Cycles  : " <<
                             mCurrent->GetCyclesMin() << endl;
-                        ofsProfiling << "\tInvocations : " <<
+                        ofsProfiling << "\tSampled invocations : " <<
                             mCurrent->GetNumInvocations() << endl;
+                        ofsProfiling << "\tSample period : " <<
+                            ClockCallBackInterface::profilePeriod << endl;
                         ofsProfiling << "\tWrap around cycles spent : " <<
                             mCurrent->GetWrapAroundCycles() << endl;
                         ofsProfiling << "\tWrap around : " <<
@@ -303,7 +621,7 @@ void ASIM_CLOCK_SERVER_CLASS::DumpProfile()
                               : 0) << endl;
     
                         ofsProfiling << "\t----------------------------" << endl;
-                        ofsProfiling << "\tCycles/Invocation : " <<
+                        ofsProfiling << "\tCycles/Sampled invocation : " <<
                             (mCurrent->GetCycles() / mCurrent->GetNumInvocations()) <<
                             endl;
                         ofsProfiling << "\t----------------------------" << endl;
@@ -313,6 +631,37 @@ void ASIM_CLOCK_SERVER_CLASS::DumpProfile()
         }
 
         ofsProfiling.close();
+
+        //
+        // Folded stacks.  Several callbacks of the same module in one
+        // domain (skews, phases) are merged into the same line.
+        //
+        map<string, UINT64> folded;
+        for(iter_dom = lDomain.begin(); iter_dom != lDomain.end(); ++iter_dom)
+        {
+            list<CLOCK_REGISTRY>::iterator iterFreq;
+            for(iterFreq = (*iter_dom)->lClock.begin();
+                iterFreq != (*iter_dom)->lClock.end(); ++iterFreq)
+            {
+                for(UINT32 i = 0; i < (*iterFreq)->lModules.size(); i++)
+                {
+                    CLOCK_CALLBACK_INTERFACE cb = (*iterFreq)->lModules[i].second;
+                    if (cb->profSamples != 0)
+                    {
+                        folded[ProfileFrames((*iterFreq)->lModules[i].first, *iterFreq)] +=
+                            cb->profCycles * ClockCallBackInterface::profilePeriod;
+                    }
+                }
+            }
+        }
+
+        ofstream ofsFolded("clockserver.folded");
+        map<string, UINT64>::iterator iterFolded;
+        for(iterFolded = folded.begin(); iterFolded != folded.end(); ++iterFolded)
+        {
+            ofsFolded << iterFolded->first << " " << iterFolded->second << endl;
+        }
+        ofsFolded.close();
     }
 
 #endif
@@ -881,6 +1230,19 @@ void ASIM_CLOCK_SERVER_CLASS::InitClockServer(void)
             AddTimeEvent(pcrCurrent->nBaseCycle, pcrCurrent);
         }
     }
+
+    // e) Set up the modules clocked on demand and the model partitions.
+    //    Only the sequential, non random clocking loops can skip modules.
+    if (ASIM_PARTITION_CLASS::IsActive())
+    {
+        VERIFY(!threaded && random_seed == 0, "Model partitions need "
+               "sequential clocking in a fixed order");
+    }
+    InitModuleClocking(!threaded && random_seed == 0);
+    if (ASIM_PARTITION_CLASS::IsActive())
+    {
+        ASIM_PARTITION_CLASS::ComputeLookahead();
+    }
     
     // Init the random state
     initstate(random_seed, (char*)random_state, CLOCKSERVER_RANDOM_STATE_LENGTH);
@@ -888,13 +1250,188 @@ void ASIM_CLOCK_SERVER_CLASS::InitClockServer(void)
     // initialize multi-threaded clockserver
     if(threaded)
     {
-        VERIFY(!runWithEventsOn, "DRAL Events unavailable in multi-threaded runs");
         InitClockServerThreaded();
+        VERIFY(!runWithEventsOn || threadedEvents,
+               "DRAL Events unavailable with this multi-threaded clock server");
+        VERIFY(!threadedTrace || !traceBuffers.empty(),
+               "Threaded tracing unavailable with this multi-threaded clock server");
+
+        // f) Bring the data of every module next to the worker clocking it
+        if (ASIM_SMP_CLASS::AffinityActive())
+        {
+            HomeThreadData();
+            threadPages.clear();
+            threadPagesCounted = false;
+        }
     }
     
 }
 
 
+/**
+ * Split the modules of every registry in the ones clocked every cycle
+ * and the ones clocked on demand, and tell the latter where to post
+ * their wake ups.  Modules of other model partitions are not clocked.
+ **/
+void ASIM_CLOCK_SERVER_CLASS::InitModuleClocking(bool onDemandAllowed)
+{
+    list<CLOCK_DOMAIN>::iterator iter_dom;
+    list<CLOCK_REGISTRY>::iterator iter;
+    for(iter_dom = lDomain.begin(); iter_dom != lDomain.end(); ++iter_dom)
+    {
+        for(iter = (*iter_dom)->lClock.begin(); iter != (*iter_dom)->lClock.end(); ++iter)
+        {
+            for(UINT32 i = 0; i < (*iter)->lModules.size(); i++)
+            {
+                (*iter)->lModules[i].first->ClearWakeEntries();
+            }
+        }
+    }
+
+    for(iter_dom = lDomain.begin(); iter_dom != lDomain.end(); ++iter_dom)
+    {
+        for(iter = (*iter_dom)->lClock.begin(); iter != (*iter_dom)->lClock.end(); ++iter)
+        {
+            CLOCK_REGISTRY reg = *iter;
+            reg->onDemand = false;
+            reg->selective = false;
+            reg->lPolled.clear();
+            reg->wakeWheel = ASIM_TIMING_WHEEL_CLASS<UINT32>(reg->nCycle);
+
+            for(UINT32 i = 0; i < reg->lModules.size(); i++)
+            {
+                ASIM_CLOCKABLE m = reg->lModules[i].first;
+                if (!ASIM_PARTITION_CLASS::IsLocal(m))
+                {
+                    reg->selective = true;
+                }
+                else if (onDemandAllowed && m->IsClockOnDemand())
+                {
+                    m->AddWakeEntry(reg, i);
+                    reg->onDemand = true;
+                    reg->selective = true;
+                }
+                else
+                {
+                    reg->lPolled.push_back(i);
+                }
+            }
+
+            T1("ASIM_CLOCK_SERVER::InitModuleClocking: domain = " <<
+               (*iter_dom)->name << " skew = " << reg->nSkew <<
+               " not polled = " << reg->lModules.size() - reg->lPolled.size());
+        }
+    }
+}
+
+
+namespace {
+
+/// Port buffer memory clocked by one worker, [start, end)
+struct THREAD_RANGE
+{
+    ASIM_CLOCKSERVER_THREAD thread;
+    UINT64 start;
+    UINT64 end;
+
+    bool operator<(const THREAD_RANGE &r) const { return start < r.start; }
+};
+
+}
+
+/**
+ * The port buffers tagged with the worker clocking their reader.  Every
+ * buffer row is a range of its own, so the ranges of the same worker on
+ * the same or consecutive pages are merged: most ports then take a
+ * single move_pages call instead of one per row.
+ **/
+static void
+GetThreadRanges(vector<THREAD_RANGE> &merged)
+{
+    vector<BasePort::STORAGE_RANGE> ranges;
+    BasePort::GetAllStorage(ranges);
+
+    vector<THREAD_RANGE> sorted;
+    sorted.reserve(ranges.size());
+    for (UINT32 i = 0; i < ranges.size(); i++)
+    {
+        if (ranges[i].owner == NULL || ranges[i].bytes == 0)
+        {
+            continue;
+        }
+        THREAD_RANGE r;
+        r.thread = ranges[i].owner->FindClockingThread();
+        r.start = UINT64(ranges[i].start);
+        r.end = r.start + ranges[i].bytes;
+        sorted.push_back(r);
+    }
+    sort(sorted.begin(), sorted.end());
+
+    const UINT64 pageMask = ~(UINT64(sysconf(_SC_PAGESIZE)) - 1);
+    const UINT64 pageSize = ~pageMask + 1;
+    for (UINT32 i = 0; i < sorted.size(); i++)
+    {
+        if (!merged.empty() && merged.back().thread == sorted[i].thread &&
+            (sorted[i].start & pageMask) <= ((merged.back().end - 1) & pageMask) + pageSize)
+        {
+            merged.back().end = max(merged.back().end, sorted[i].end);
+        }
+        else
+        {
+            merged.push_back(sorted[i]);
+        }
+    }
+}
+
+
+/**
+ * Move the buffers of the ports read by every module to the NUMA node of
+ * the worker that clocks it.  The buffers are allocated by the main
+ * thread while the model is built, so without this they all sit on its
+ * node.  Pages are moved whole: small buffers of modules clocked by
+ * different workers may share a page, which ends up with the last one.
+ **/
+void ASIM_CLOCK_SERVER_CLASS::HomeThreadData()
+{
+    vector<THREAD_RANGE> ranges;
+    GetThreadRanges(ranges);
+
+    for (UINT32 i = 0; i < ranges.size(); i++)
+    {
+        INT32 node = ASIM_SMP_CLASS::GetCpuNode(WorkerCpu(ranges[i].thread));
+        if (node >= 0)
+        {
+            ASIM_SMP_CLASS::MovePages((const void *)ranges[i].start,
+                                      ranges[i].end - ranges[i].start, node);
+        }
+    }
+}
+
+
+/**
+ * Count, per worker, the resident pages of the port buffers read by its
+ * modules (first) and how many of them are on another NUMA node (second).
+ **/
+void ASIM_CLOCK_SERVER_CLASS::CountThreadData(
+    map<ASIM_CLOCKSERVER_THREAD, pair<UINT64, UINT64> > &pages)
+{
+    vector<THREAD_RANGE> ranges;
+    GetThreadRanges(ranges);
+
+    for (UINT32 i = 0; i < ranges.size(); i++)
+    {
+        ASIM_CLOCKSERVER_THREAD thread = ranges[i].thread;
+        INT32 node = ASIM_SMP_CLASS::GetCpuNode(WorkerCpu(thread));
+        if (node >= 0)
+        {
+            ASIM_SMP_CLASS::CountPages((const void *)ranges[i].start,
+                                       ranges[i].end - ranges[i].start, node,
+                                       pages[thread].first, pages[thread].second);
+        }
+    }
+}
+
+
 /**
  * Stop the clock server running.
  *
@@ -953,12 +1490,21 @@ UINT64 ASIM_CLOCK_SERVER_CLASS::Clock()
     // Check some basic conditions to execute specialized clock methods
     // and avoid unnecessary work
     
+    if(ASIM_PARTITION_CLASS::IsActive())
+    {
+        // Conservative barrier with the other model partitions, up to
+        // the last event clocked by this call
+        ASIM_PARTITION_CLASS::WaitFor(uniqueClockDomain ?
+                                      lTimeEvents.back()->nBaseCycle :
+                                      lTimeEvents.front()->nBaseCycle);
+    }
+
     if(random_seed > 0)
     {
         return RandomClock();        
     }
     
-    if(threaded && !eventsOn && !traceOn)
+    if(threaded && (threadedEvents || !eventsOn) && (threadedTrace || !traceOn))
     {
         return ThreadedClock();
     }
@@ -990,15 +1536,7 @@ UINT64 ASIM_CLOCK_SERVER_CLASS::Clock()
         EVENT( currentEvent->DralNewCycle(); );
         
         // We clock all the modules that must be clocked at current time
-        vector< pair<ASIM_CLOCKABLE, CLOCK_CALLBACK_INTERFACE> >::iterator
-            endM = currentEvent->lModules.end();
-        vector< pair<ASIM_CLOCKABLE, CLOCK_CALLBACK_INTERFACE> >::iterator
-            iter = currentEvent->lModules.begin();            
-        for( ; iter != endM; ++iter)
-        {
-            (*iter).second->currentCycle = currentEvent->nCycle;
-            (*iter).second->Clock();
-        }
+        currentEvent->ClockModules();
         
     }
     
@@ -1060,20 +1598,13 @@ UINT64 ASIM_CLOCK_SERVER_CLASS::UniqueDomainClock()
         EVENT( currentEvent->DralNewCycle(); );
         
         // We clock all the modules that must be clocked at current time
-        vector< pair<ASIM_CLOCKABLE, CLOCK_CALLBACK_INTERFACE> >::iterator
-            endM = currentEvent->lModules.end();
-        vector< pair<ASIM_CLOCKABLE, CLOCK_CALLBACK_INTERFACE> >::iterator
-            iter = currentEvent->lModules.begin();            
-        for( ; iter != endM; ++iter)
-        {
-            (*iter).second->currentCycle = currentEvent->nCycle;
-            (*iter).second->Clock();
-        }
+        currentEvent->ClockModules();
 
         // We clock all the WriterRateMatcher that must be clocked at current time
         vector< pair<ASIM_CLOCKABLE, CLOCK_CALLBACK_INTERFACE> >::iterator
             endRM = currentEvent->lWriterRM.end();
-        iter = currentEvent->lWriterRM.begin();
+        vector< pair<ASIM_CLOCKABLE, CLOCK_CALLBACK_INTERFACE> >::iterator
+            iter = currentEvent->lWriterRM.begin();
             
         for( ; iter != endRM; ++iter)
         {
@@ -121,6 +121,33 @@ void ASIM_CLOCK_SERVER_CLASS::InitClockServerThreaded()
         GlobalTimeRing.insert( *iter_ev );
     }
 
+    // each thread encodes the DRAL events of its modules, and the chunks
+    // are merged into the trace by ThreadedClock()
+    EVENT
+    (
+        if (runWithEventsOn && ASIM_DRAL_EVENT_CLASS::event)
+        {
+            threadedEvents = true;
+            CLOCKSERVER_THREADS_ITERATOR it = lThreads.begin();
+            for ( ; it != lThreads.end() && threadedEvents; ++it)
+            {
+                DRAL_SUBSTREAM s = ASIM_DRAL_EVENT_CLASS::event->NewSubstream();
+                (*it)->SetDralSubstream(s);
+                threadedEvents = (s != NULL);
+            }
+        }
+    );
+
+    // each thread buffers its trace records, merged by ThreadedClock()
+    if (threadedTrace)
+    {
+        CLOCKSERVER_THREADS_ITERATOR it = lThreads.begin();
+        for ( ; it != lThreads.end(); ++it)
+        {
+            traceBuffers.push_back((*it)->NewTraceBuffer());
+        }
+    }
+
     // Create the pthreads if requested
     list<ASIM_CLOCKSERVER_THREAD>::iterator iter_threads = lThreads.begin();
     for( ; iter_threads != lThreads.end(); ++iter_threads)
@@ -142,6 +169,11 @@ void * ASIM_CLOCKSERVER_THREAD_CLASS::ThreadWork(void* param)
     parent->localDoneTime  = -1;            // we have not finished any work yet
     TIME_EVENTS_RING_CLASS::ITERATOR
         myNextEvent( &GlobalTimeRing );     // start a persistent index into event list
+    if (parent->dralSubstream)
+    {
+        DRAL_SERVER_CLASS::AttachSubstream(parent->dralSubstream);
+    }
+    threadTraceBuffer = parent->traceBuffer;
    
     while(1)
     {      
@@ -180,38 +212,57 @@ void * ASIM_CLOCKSERVER_THREAD_CLASS::ThreadWork(void* param)
         // for each event at the current time point, run through all the modules
         // that must be clocked for this event, and execute it if it belongs to this thread.
         //
+        // The DRAL events of event k go to chunk k of this time point (and
+        // those of its writer rate matchers to chunk nEvents + k), which
+        // is where ThreadedClock() expects them. Trace records are also
+        // keyed with the index of the module in the event.
+        //
+        UINT32 nEvents = lClockedEvents.size();
+        UINT32 k = 0;
         TIME_EVENT_INSTANCE_ITERATOR it_event;
-        for( it_event = lClockedEvents.begin(); it_event != lClockedEvents.end(); ++it_event )
+        for( it_event = lClockedEvents.begin(); it_event != lClockedEvents.end(); ++it_event, ++k )
         {   
+            EVENT(if (parent->dralSubstream) DRALEVENT(BeginChunk(localReadyTime, k)));
             CLOCK_REGISTRY_MODULES_ITERATOR endM = (*it_event)->GetModuleList()->end();
             CLOCK_REGISTRY_MODULES_ITERATOR iter = (*it_event)->GetModuleList()->begin();
-            for( ; iter != endM; ++iter)
+            for( UINT32 i = 0; iter != endM; ++iter, ++i)
             {
                 if ( parent == (*iter).first->GetClockingThread() ) {
+                    if (parent->traceBuffer) parent->traceBuffer->SetKey(localReadyTime, k, i);
                     (*iter).second->currentCycle = (*it_event)->GetCycle();
                     (*iter).second->Clock();
                 }
             }
+            EVENT(if (parent->dralSubstream) DRALEVENT(EndChunk()));
         }
 
         //
         // Do the same for the write rate matcher ports, execute them if they belong to me.
         //
-        for( it_event = lClockedEvents.begin(); it_event != lClockedEvents.end(); ++it_event )
+        k = 0;
+        for( it_event = lClockedEvents.begin(); it_event != lClockedEvents.end(); ++it_event, ++k )
         {   
+            EVENT(if (parent->dralSubstream) DRALEVENT(BeginChunk(localReadyTime, nEvents + k)));
             CLOCK_REGISTRY_MODULES_ITERATOR endM = (*it_event)->GetWriterRMList()->end();
             CLOCK_REGISTRY_MODULES_ITERATOR iter = (*it_event)->GetWriterRMList()->begin();
-            for( ; iter != endM; ++iter)
+            for( UINT32 i = 0; iter != endM; ++iter, ++i)
             {
                 // !!$#@!!! RATE_MATCHER and ASIM_CLOCKABLE both have different
                 // GetClockingThread() routines, that do not inherit from one another.
                 // We need to do this cast here to make sure we call the RATE_MATCHER one
                 RATE_MATCHER wrm = (RATE_MATCHER)(*iter).first;
                 if ( parent == wrm->GetClockingThread() ) {
+                    if (parent->traceBuffer) parent->traceBuffer->SetKey(localReadyTime, nEvents + k, i);
                     (*iter).second->currentCycle = (*it_event)->GetCycle();
                     (*iter).second->Clock();
                 }
             }
+            EVENT(if (parent->dralSubstream) DRALEVENT(EndChunk()));
+        }
+
+        if (parent->traceBuffer)
+        {
+            parent->traceBuffer->ClearKey();
         }
 
         //
@@ -262,14 +313,52 @@ UINT64 ASIM_CLOCK_SERVER_CLASS::ThreadedClock()
     // the workers traverse the events list themselves, and also since the
     // step may have been modified by setDomainFrequency during the clocking.
     //
+    deque<TIME_EVENT_INSTANCE> lClockedEvents;
     while ( currentBaseCycle == (INT64)GlobalTimeRing.front()->GetBaseCycle() )
     {
-        TIME_EVENT_INSTANCE currentEvent = GlobalTimeRing.pop_front();
-        currentEvent->AdvanceCycle();
-        GlobalTimeRing.insert( currentEvent );
+        lClockedEvents.push_back( GlobalTimeRing.pop_front() );
     }
 
-    // FIX FIX FIX !?! generate DRAL new cycle event if necessary.
+    //
+    // write the trace records of the workers in the order of the serial clocking
+    //
+    if (threadedTrace)
+    {
+        TRACE_BUFFER_CLASS::Merge(traceBuffers, currentBaseCycle);
+    }
+
+    //
+    // write the DRAL events of the workers in the same order as the
+    // sequential clocking: the new cycle of each event followed by the
+    // events of its modules, and then the same for the writer rate matchers.
+    //
+    EVENT
+    (
+        if (threadedEvents)
+        {
+            UINT32 nEvents = lClockedEvents.size();
+            for ( UINT32 k = 0; k < nEvents; k++ )
+            {
+                lClockedEvents[k]->GetParent()->DralNewCycle();
+                DRALEVENT(MergeSubstreams(currentBaseCycle, k));
+            }
+            for ( UINT32 k = 0; k < nEvents; k++ )
+            {
+                if ( ! lClockedEvents[k]->GetWriterRMList()->empty() )
+                {
+                    lClockedEvents[k]->GetParent()->DralNewCycle();
+                }
+                DRALEVENT(MergeSubstreams(currentBaseCycle, nEvents + k));
+            }
+        }
+    );
+
+    TIME_EVENT_INSTANCE_ITERATOR it_event;
+    for ( it_event = lClockedEvents.begin(); it_event != lClockedEvents.end(); ++it_event )
+    {
+        (*it_event)->AdvanceCycle();
+        GlobalTimeRing.insert( *it_event );
+    }
 
     //
     // Return the number of base cycles forwarded                       
@@ -33,8 +33,11 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <signal.h>
+
 #include "asim/event.h"
 #include "asim/smp.h"
+#include "asim/mesg.h"
 
 // what is this for?
 bool eventsOn = false;
@@ -79,6 +82,59 @@ ASIM_DRAL_EVENT_CLASS::InitEvent()
     // a fake node with number 0. This is necessary because port.h will connect to node 0
     // those ports whose origin or destination is unknown to "Fake Node".
     event->NewNode("Fake_Node", 0);
+
+    if (event->IsFlightRecorder())
+    {
+        // requested with DRAL_FLIGHT_RECORDER
+        StartFlightRecorder(0, 0);
+    }
+}
+
+static void (*nextTerminateHook)(void) = NULL;
+
+static void
+FlightRecorderTerminate()
+{
+    ASIM_DRAL_EVENT_CLASS::DumpFlightRecorder();
+    if (nextTerminateHook)
+    {
+        nextTerminateHook();
+    }
+}
+
+static void
+FlightRecorderSignal(int)
+{
+    // not safe to write the trace here: do it at the next cycle
+    if (ASIM_DRAL_EVENT_CLASS::event)
+    {
+        ASIM_DRAL_EVENT_CLASS::event->DumpFlightRecorderAtNextCycle();
+    }
+}
+
+void
+ASIM_DRAL_EVENT_CLASS::StartFlightRecorder(UINT64 cycles, UINT32 blocks)
+{
+    VERIFY(event, "The events must be initialized before the flight recorder");
+    if (!event->IsFlightRecorder())
+    {
+        event->SetFlightRecorder(cycles, blocks);
+    }
+    if (event->IsFlightRecorder())
+    {
+        if (asim_terminate_hook != FlightRecorderTerminate)
+        {
+            nextTerminateHook = asim_terminate_hook;
+            asim_terminate_hook = FlightRecorderTerminate;
+        }
+        signal(SIGUSR2, FlightRecorderSignal);
+    }
+}
+
+bool
+ASIM_DRAL_EVENT_CLASS::DumpFlightRecorder()
+{
+    return event && event->DumpFlightRecorder();
 }
 
 /*
@@ -69,6 +69,8 @@ ASIM_MESG_CLASS asim_assert(cout, "ASSERTION FAILURE: ", print_location, doexit)
 
 pthread_mutex_t asim_mesg_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+void (*asim_terminate_hook)(void) = NULL;
+
 /**
  * Create a message object and connect it to an existing ostream.
  */
@@ -155,6 +157,14 @@ ASIM_MESG_CLASS::Finish(void)
         
     if (terminate)
     {
+        if (asim_terminate_hook)
+        {
+            // the hook may fail an assertion itself
+            void (*hook)(void) = asim_terminate_hook;
+            asim_terminate_hook = NULL;
+            hook();
+        }
+
         if (ASIM_SMP_CLASS::GetRunningThreadNumber() > 0)
         {
             // Thread attempting to exit is a child thread.  exit() may
@@ -34,6 +34,10 @@
  * @brief Base class for ASIM module abstraction.
  */
 
+// generic
+#include <vector>
+#include <string>
+
 // ASIM core
 #include "asim/syntax.h"
 #include "asim/module.h"
@@ -275,6 +279,74 @@ ASIM_MODULE_CLASS::LoadFunctionalState (istream& loadFuncState)
 }
 
 
+// Timing checkpoints
+void
+ASIM_MODULE_CLASS::SaveCheckpoint (ASIM_CHECKPOINT ckpt)
+/*
+ * Save the timing state of this module and of all contained modules.
+ * Each contained module is preceded by its name, so restoring does not
+ * depend on the order the modules were built in.
+ */
+{
+    ckpt->BeginSection(Name());
+    SaveStatsCheckpoint(ckpt);
+
+    UINT32 nContained = 0;
+    ASIM_MODULELINK scan;
+    for (scan = contained; scan != NULL; scan = scan->next)
+    {
+        nContained++;
+    }
+    ckpt->Check(nContained, "number of contained modules");
+    ckpt->EndSection();
+
+    for (scan = contained; scan != NULL; scan = scan->next)
+    {
+        ckpt->Save(string(scan->module->Name()));
+        scan->module->SaveCheckpoint(ckpt);
+    }
+}
+
+void
+ASIM_MODULE_CLASS::RestoreCheckpoint (ASIM_CHECKPOINT ckpt)
+/*
+ * Restore the timing state of this module and of all contained modules.
+ * Contained modules with the same name are matched in order.
+ */
+{
+    ckpt->BeginSection(Name());
+    RestoreStatsCheckpoint(ckpt);
+
+    vector<ASIM_MODULE> pending;
+    ASIM_MODULELINK scan;
+    for (scan = contained; scan != NULL; scan = scan->next)
+    {
+        pending.push_back(scan->module);
+    }
+    ckpt->Check((UINT32) pending.size(), "number of contained modules");
+    ckpt->EndSection();
+
+    for (UINT32 n = pending.size(); n > 0; n--)
+    {
+        string name;
+        ckpt->Restore(name);
+
+        vector<ASIM_MODULE>::iterator m = pending.begin();
+        while (m != pending.end() && name != (*m)->Name())
+        {
+            m++;
+        }
+        VERIFY(m != pending.end(), "Checkpoint " << ckpt->GetFileName()
+               << " has module " << name << " in " << Path()
+               << ", which is not in the model");
+
+        ASIM_MODULE module = *m;
+        pending.erase(m);
+        module->RestoreCheckpoint(ckpt);
+    }
+}
+
+
 // Function to create a new thread handle when necessary.
 bool ASIM_MODULE_CLASS::SetThreadHandle()
 {
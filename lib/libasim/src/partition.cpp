@@ -0,0 +1,390 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ *
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the Intel Corporation nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @author Pau Cabre
+ * @brief Model partitioning across processes: shared segment and clock barrier.
+ */
+
+// generic
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// ASIM core
+#include "asim/partition.h"
+#include "asim/clockable.h"
+
+UINT32 ASIM_PARTITION_CLASS::numPartitions = 1;
+UINT32 ASIM_PARTITION_CLASS::localPartition = 0;
+string ASIM_PARTITION_CLASS::segmentName;
+char *ASIM_PARTITION_CLASS::segment = NULL;
+UINT64 ASIM_PARTITION_CLASS::segmentSize = 0;
+UINT64 ASIM_PARTITION_CLASS::segmentUsed = 0;
+ASIM_PARTITION_CLASS::CONTROL *ASIM_PARTITION_CLASS::control = NULL;
+vector<ASIM_PARTITION_CLASS::CROSSING> ASIM_PARTITION_CLASS::crossing;
+INT64 ASIM_PARTITION_CLASS::lookahead = INT64_MAX;
+INT64 ASIM_PARTITION_CLASS::nextDone = -1;
+
+// how long the other partitions wait for partition 0 to create the segment
+static const UINT32 PARTITION_ATTACH_TIMEOUT_MS = 60000;
+
+
+void
+ASIM_PARTITION_CLASS::Init(
+    UINT32 num,
+    UINT32 local,
+    const char *job,
+    UINT64 size)
+{
+    VERIFY(!segment, "Model partitioning initialized twice");
+    if (num <= 1)
+    {
+        return;
+    }
+
+    VERIFY(num <= MAX_PARTITIONS, "At most " << MAX_PARTITIONS
+           << " model partitions are supported");
+    VERIFY(local < num, "Partition " << local << " out of " << num);
+    VERIFY(job && *job, "A partitioned run needs a job name, unique on the "
+           "host, to name its shared memory segment");
+
+    numPartitions = num;
+    localPartition = local;
+    segmentName = string("/") + job;
+    segmentSize = size;
+    segmentUsed = (sizeof(CONTROL) + 63) & ~63ULL;
+
+    if (local == 0)
+    {
+        // Partition 0 owns the segment.  A stale one, left by a run that
+        // did not finish, is replaced, but never the one of a live run.
+        INT32 owner = LiveCreator();
+        VERIFY(owner == 0, "Shared memory segment " << segmentName
+               << " is in use by the running simulation " << owner
+               << ": give each run a unique job name");
+        shm_unlink(segmentName.c_str());
+        int fd = shm_open(segmentName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        VERIFY(fd >= 0, "Cannot create shared memory segment " << segmentName
+               << ": " << strerror(errno));
+        VERIFY(ftruncate(fd, size) == 0, "Cannot size shared memory segment "
+               << segmentName << ": " << strerror(errno));
+
+        segment = (char *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        VERIFY(segment != MAP_FAILED, "Cannot map shared memory segment "
+               << segmentName << ": " << strerror(errno));
+        control = reinterpret_cast<CONTROL *>(segment);
+
+        control->numPartitions = num;
+        control->creator = getpid();
+        for (UINT32 i = 0; i < MAX_PARTITIONS; i++)
+        {
+            control->part[i].done = -1;
+        }
+        MemBarrier();
+        control->magic = MAGIC;
+    }
+    else
+    {
+        // A stale segment looks set up (magic, and maybe partitions done
+        // with INT64_MAX) but its creator is gone, or partition 0 of this
+        // run has already unlinked it.  Keep opening the name until it
+        // is the fresh segment of a live partition 0.
+        UINT32 waited = 0;
+        while (!AttachFresh(size))
+        {
+            VERIFY(waited++ < PARTITION_ATTACH_TIMEOUT_MS, "Partition " << local
+                   << " timed out waiting for partition 0 in " << segmentName);
+            usleep(1000);
+        }
+        VERIFY(control->numPartitions == num, "Shared memory segment "
+               << segmentName << " is set up for " << control->numPartitions
+               << " partitions, not " << num);
+    }
+    __sync_fetch_and_add(&control->attached, 1);
+}
+
+
+/**
+ * Pid of the live partition 0 that set up the segment named after the
+ * job, or 0 if there is no such segment or its creator is gone.
+ **/
+INT32
+ASIM_PARTITION_CLASS::LiveCreator(void)
+{
+    int fd = shm_open(segmentName.c_str(), O_RDONLY, 0600);
+    if (fd < 0)
+    {
+        return 0;
+    }
+
+    struct stat st;
+    char *p = (char *)MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (UINT64)st.st_size >= sizeof(CONTROL))
+    {
+        p = (char *)mmap(NULL, sizeof(CONTROL), PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (p == MAP_FAILED)
+    {
+        return 0;
+    }
+
+    CONTROL *c = reinterpret_cast<CONTROL *>(p);
+    INT32 pid = 0;
+    if (*(volatile UINT64 *)&c->magic == MAGIC)
+    {
+        MemBarrier();
+        if (kill(c->creator, 0) == 0 || errno == EPERM)
+        {
+            pid = c->creator;
+        }
+    }
+    munmap(p, sizeof(CONTROL));
+    return pid;
+}
+
+
+/**
+ * Map the segment if it is set up by a partition 0 that is still
+ * running, and it is still the one named after the job.
+ **/
+bool
+ASIM_PARTITION_CLASS::AttachFresh(UINT64 size)
+{
+    int fd = shm_open(segmentName.c_str(), O_RDWR, 0600);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat st;
+    char *p = (char *)MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (UINT64)st.st_size == size)
+    {
+        p = (char *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (p == MAP_FAILED)
+    {
+        close(fd);
+        return false;
+    }
+
+    CONTROL *c = reinterpret_cast<CONTROL *>(p);
+    bool fresh = false;
+    if (*(volatile UINT64 *)&c->magic == MAGIC)
+    {
+        MemBarrier();
+        fresh = (kill(c->creator, 0) == 0 || errno == EPERM) &&
+                fstat(fd, &st) == 0 && st.st_nlink > 0;
+    }
+    close(fd);
+
+    if (!fresh)
+    {
+        munmap(p, size);
+        return false;
+    }
+    segment = p;
+    control = c;
+    return true;
+}
+
+
+void
+ASIM_PARTITION_CLASS::Shutdown(void)
+{
+    if (!segment)
+    {
+        return;
+    }
+
+    // nobody waits for a partition that is gone
+    MemBarrier();
+    control->part[localPartition].done = INT64_MAX;
+    MemBarrier();
+
+    if (__sync_sub_and_fetch(&control->attached, 1) == 0)
+    {
+        shm_unlink(segmentName.c_str());
+    }
+    munmap(segment, segmentSize);
+
+    segment = NULL;
+    control = NULL;
+    numPartitions = 1;
+    localPartition = 0;
+    crossing.clear();
+    lookahead = INT64_MAX;
+    nextDone = -1;
+}
+
+
+bool
+ASIM_PARTITION_CLASS::IsLocal(ASIM_CLOCKABLE m)
+{
+    return (m ? m->GetPartition() : 0) == localPartition;
+}
+
+
+bool
+ASIM_PARTITION_CLASS::IsCrossing(ASIM_CLOCKABLE writer, ASIM_CLOCKABLE reader)
+{
+    if (!IsActive())
+    {
+        return false;
+    }
+    return (writer ? writer->GetPartition() : 0) !=
+           (reader ? reader->GetPartition() : 0);
+}
+
+
+void *
+ASIM_PARTITION_CLASS::Allocate(UINT64 bytes)
+{
+    VERIFYX(segment);
+    VERIFY(segmentUsed + bytes <= segmentSize, "Shared memory segment "
+           << segmentName << " too small for the ports crossing partitions ("
+           << segmentSize << " bytes)");
+
+    void *p = segment + segmentUsed;
+    segmentUsed = (segmentUsed + bytes + 63) & ~63ULL;
+    return p;
+}
+
+
+void
+ASIM_PARTITION_CLASS::AddCrossingPort(
+    ASIM_CLOCKABLE writer,
+    ASIM_CLOCKABLE reader,
+    UINT32 latency,
+    const char *name)
+{
+    VERIFY(latency > 0, "Port " << name << " crosses model partitions "
+           "and needs a latency of at least 1 cycle");
+
+    CROSSING c;
+    c.writer = writer;
+    c.reader = reader;
+    c.latency = latency;
+    c.name = name;
+    crossing.push_back(c);
+}
+
+
+/**
+ * The lookahead is the shortest time, in base cycles x100, between a
+ * write to a crossing port and the read of the data.  Both ends have to
+ * be clocked by the same clock registry for it to be exact.
+ **/
+void
+ASIM_PARTITION_CLASS::ComputeLookahead(void)
+{
+    lookahead = INT64_MAX;
+    nextDone = -1;
+    for (UINT32 i = 0; i < crossing.size(); i++)
+    {
+        VERIFY(crossing[i].writer && crossing[i].reader, "Port "
+               << crossing[i].name << " crosses model partitions and both "
+               "endpoints must be initialized with their module");
+
+        CLOCK_REGISTRY w = crossing[i].writer->GetClockInfo();
+        CLOCK_REGISTRY r = crossing[i].reader->GetClockInfo();
+        VERIFY(w && r && w->nStep == r->nStep && w->nSkew == r->nSkew,
+               "Port " << crossing[i].name << " crosses model partitions "
+               "and both endpoints must be clocked by the same clock domain and skew");
+
+        INT64 l = (INT64)crossing[i].latency * r->nStep;
+        if (l < lookahead)
+        {
+            lookahead = l;
+        }
+    }
+}
+
+
+void
+ASIM_PARTITION_CLASS::WaitFor(INT64 t)
+{
+    // everything up to the previous call has been clocked
+    MemBarrier();
+    control->part[localPartition].done = nextDone;
+    nextDone = t;
+
+    if (lookahead == INT64_MAX)
+    {
+        return;
+    }
+
+    INT64 need = t - lookahead;
+    for (UINT32 i = 0; i < numPartitions; i++)
+    {
+        if (i == localPartition)
+        {
+            continue;
+        }
+        UINT32 spins = 0;
+        while (control->part[i].done < need)
+        {
+            if (++spins > 1000)
+            {
+                sched_yield();
+            }
+        }
+    }
+    MemBarrier();
+}
+
+
+ASIM_SHARED_PORT_CLASS::ASIM_SHARED_PORT_CLASS(
+    UINT32 elemSize,
+    UINT32 bandwidth,
+    UINT32 latency)
+  : elemSize(elemSize),
+    bandwidth(bandwidth),
+    latency(latency),
+    readCycle(-1),
+    readPos(0)
+{
+    UINT32 n = 1;
+    while (n < 2 * latency + 2)
+    {
+        n <<= 1;
+    }
+    mask = n - 1;
+    rowBytes = (sizeof(ROW) + bandwidth * elemSize + 7) & ~7U;
+    rows = (char *)ASIM_PARTITION_CLASS::Allocate((UINT64)n * rowBytes);
+}
@@ -35,8 +35,13 @@
  */
 
 // generic
+#include <sys/time.h>
 #include <typeinfo>
 #include <iostream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <map>
 
 // ASIM core
 #include "asim/port.h"
@@ -116,34 +121,126 @@ QuickSort(C& Container, T* dummy_for_broken_cxxV6_1 = NULL)
 }
 
 
-// sort needs to be one that doesn't swap elements, because that
-// screws up the ordering of port names (which rules out QuickSort
-// and HeapSort)
-// MergeSort and InsertionSort are 2 options.  The advantage of
-// Insertion Sort is that it doesn't need additional storage space to
-// do the sorting, unlike Merge Sort.  Merge Sort could certainly be
-// made to work, but we only do this sort once, so the fact that
-// Insertion Sort is slower really doesn't matter.
-template <class T, class C >
+//
+// Port groups: all the endpoints with the same name and instance, kept in
+// a chained hash table that is filled as ports are initialized.  Groups are
+// never removed (a group may become empty), so their order is the order in
+// which their first endpoint was initialized.
+//
+namespace {
+
+struct PORT_GROUP
+{
+    string name;
+    int instance;
+    UINT32 hash;
+    int next;                   // next group in the same bucket
+    vector<BasePort*> ports;    // in Init() order
+};
+
+struct PORT_GROUP_TABLE
+{
+    vector<PORT_GROUP> groups;
+    vector<int> buckets;        // first group of each bucket, -1 if none
+};
+
+// Allocated on first use and never destroyed: ports are global objects
+// too, initialized and destroyed in any order with respect to this file
+PORT_GROUP_TABLE &
+PortGroupTable()
+{
+    static PORT_GROUP_TABLE *table = new PORT_GROUP_TABLE;
+    return *table;
+}
+
+UINT32
+PortGroupHash(const char *name, int instance)
+{
+    // FNV-1a
+    UINT32 h = 2166136261U;
+    for (const char *c = name; *c; c++)
+    {
+        h = (h ^ (unsigned char)*c) * 16777619U;
+    }
+    return (h ^ (UINT32)instance) * 16777619U;
+}
+
 void
-InsertionSort(C& Container, T* dummy_for_broken_cxxV6_1 = NULL)
+RehashPortGroups()
 {
-    typename C::Iterator array = Container.Begin();
-    int len = Container.GetOccupancy();
-    T key;
-    int i;
-    
-    for (int j = 1; j < len; j++)
+    vector<PORT_GROUP> &portGroups = PortGroupTable().groups;
+    vector<int> &portGroupBuckets = PortGroupTable().buckets;
+    portGroupBuckets.assign(portGroupBuckets.empty() ? 1024 : portGroupBuckets.size() * 2, -1);
+    UINT32 mask = portGroupBuckets.size() - 1;
+    for (UINT32 g = 0; g < portGroups.size(); g++)
     {
-        key = array[j];
-        i = j - 1;
-        while ((i >= 0) && (*(array[i]) > *key))
+        portGroups[g].next = portGroupBuckets[portGroups[g].hash & mask];
+        portGroupBuckets[portGroups[g].hash & mask] = g;
+    }
+}
+
+// Order of the endpoints inside a group: by type (write before read
+// before peek) and by declaration for the same type
+bool
+PortGroupOrder(const BasePort *l, const BasePort *r)
+{
+    return l->GetType() < r->GetType() ||
+           (l->GetType() == r->GetType() && l->GetUid() < r->GetUid());
+}
+
+}
+
+UINT64 BasePort::ConnectAllUsecs = 0;
+UINT64 BasePort::ConnectAllPorts = 0;
+
+void
+BasePort::AddToGroup(BasePort *port)
+{
+    vector<PORT_GROUP> &portGroups = PortGroupTable().groups;
+    vector<int> &portGroupBuckets = PortGroupTable().buckets;
+    UINT32 hash = PortGroupHash(port->Name, port->Instance);
+    if (portGroupBuckets.empty())
+    {
+        RehashPortGroups();
+    }
+
+    int g = portGroupBuckets[hash & (portGroupBuckets.size() - 1)];
+    while (g >= 0 &&
+           (portGroups[g].hash != hash ||
+            portGroups[g].instance != port->Instance ||
+            portGroups[g].name != port->Name))
+    {
+        g = portGroups[g].next;
+    }
+
+    if (g < 0)
+    {
+        if (portGroups.size() >= portGroupBuckets.size())
         {
-            array[i+1] = array[i];
-            i--;
+            RehashPortGroups();
         }
-        array[i+1] = key;
-    }    
+        g = portGroups.size();
+        portGroups.push_back(PORT_GROUP());
+        PORT_GROUP &group = portGroups.back();
+        group.name = port->Name;
+        group.instance = port->Instance;
+        group.hash = hash;
+        group.next = portGroupBuckets[hash & (portGroupBuckets.size() - 1)];
+        portGroupBuckets[hash & (portGroupBuckets.size() - 1)] = g;
+    }
+
+    portGroups[g].ports.push_back(port);
+    port->Group = g;
+}
+
+void
+BasePort::RemoveFromGroup(BasePort *port)
+{
+    vector<BasePort*> &ports = PortGroupTable().groups[port->Group].ports;
+    vector<BasePort*>::iterator i = find(ports.begin(), ports.end(), port);
+    VERIFYX(i != ports.end());
+    ports.erase(i);
+    port->Group = -1;
 }
 
 bool
@@ -213,6 +310,15 @@ BasePort::ConnectPorts(int rdPort, int port, int index,
     {
         i[rdPort]->SetBufferInfo();
         i[port]->SetBuffer(i[rdPort]->GetBuffer(), index);
+
+        // A port between two model partitions keeps its buffer in the
+        // memory shared by their processes
+        if (ASIM_PARTITION_CLASS::IsCrossing(i[port]->Owner, i[rdPort]->Owner))
+        {
+            i[rdPort]->ShareStorage();
+            ASIM_PARTITION_CLASS::AddCrossingPort(i[port]->Owner, i[rdPort]->Owner,
+                                                  i[rdPort]->Latency, i[rdPort]->GetName());
+        }
         
         if (runWithEventsOn)
         {
@@ -230,6 +336,8 @@ BasePort::ConnectPorts(int rdPort, int port, int index,
 void
 BasePort::ConnectAll()
 {
+    struct timeval startTime;
+    gettimeofday(&startTime, NULL);
 
     asim::Vector<BasePort*>::Iterator i = AllPorts.Begin();
     asim::Vector<BasePort*>::Iterator end = AllPorts.End();
@@ -282,12 +390,25 @@ BasePort::ConnectAll()
         ++next;
     }
     
-    // sort needs to be one that doesn't swap elements, because that
-    // screws up the ordering of port names (which rules out QuickSort
-    // and HeapSort)
-    InsertionSort<BasePort*, asim::Vector<BasePort*> >(AllPorts);
-    
-    // cout << __FILE__ << ":" << __LINE__ << endl;
+    // Lay the ports out group after group, each group ordered by type and
+    // declaration (PortGroupOrder), which is what the connection loop below
+    // expects: the endpoints of a group are contiguous, write ports first.
+    // Every port with a name is in a group, so they are all placed again.
+    vector<PORT_GROUP> &portGroups = PortGroupTable().groups;
+    i = AllPorts.Begin();
+    for (UINT32 g = 0; g < portGroups.size(); g++)
+    {
+        vector<BasePort*> &ports = portGroups[g].ports;
+        sort(ports.begin(), ports.end(), PortGroupOrder);
+        for (UINT32 p = 0; p < ports.size(); p++)
+        {
+            VERIFYX(i != end);
+            *i = ports[p];
+            ++i;
+        }
+    }
+    VERIFYX(i == end);
+
     i = AllPorts.Begin();
     if(i != end) {
         T1_AS((*i), "Connect All Ports." << endl);
@@ -472,5 +593,99 @@ BasePort::ConnectAll()
     
         i += num;
     }
+
+    struct timeval endTime;
+    gettimeofday(&endTime, NULL);
+    ConnectAllUsecs = (endTime.tv_sec - startTime.tv_sec) * 1000000ULL +
+                      endTime.tv_usec - startTime.tv_usec;
+    ConnectAllPorts = AllPorts.GetOccupancy();
 }
 
+
+
+/**
+ * Save the contents of all the port buffers in a timing checkpoint.
+ *
+ * Every port is tagged with its name, instance and type, which is how
+ * RestoreAllPorts() finds it again, so the checkpoint does not depend on
+ * the order the ports were constructed in.
+ */
+void
+BasePort::SaveAllPorts(ASIM_CHECKPOINT ckpt)
+{
+    ckpt->BeginSection("ports");
+    ckpt->Check(AllPorts.GetOccupancy(), "number of ports");
+
+    asim::Vector<BasePort*>::Iterator i = AllPorts.Begin();
+    asim::Vector<BasePort*>::Iterator end = AllPorts.End();
+    for ( ; i != end; ++i)
+    {
+        ckpt->Save(string((*i)->GetName()));
+        ckpt->Save((*i)->GetInstance());
+        ckpt->Save((int)(*i)->GetType());
+
+        (*i)->SaveCheckpoint(ckpt);
+    }
+
+    ckpt->EndSection();
+}
+
+/**
+ * Restore the port buffers saved by SaveAllPorts().  Ports with the same
+ * name, instance and type are matched in AllPorts order.  Every port of
+ * the model must be in the checkpoint, and the other way round.
+ */
+void
+BasePort::RestoreAllPorts(ASIM_CHECKPOINT ckpt)
+{
+    typedef pair<pair<string, int>, int> PORT_KEY;
+    map<PORT_KEY, vector<BasePort*> > ports;
+
+    asim::Vector<BasePort*>::Iterator i = AllPorts.Begin();
+    asim::Vector<BasePort*>::Iterator end = AllPorts.End();
+    for ( ; i != end; ++i)
+    {
+        PORT_KEY key(make_pair(string((*i)->GetName()), (*i)->GetInstance()),
+                     (int)(*i)->GetType());
+        ports[key].push_back(*i);
+    }
+
+    ckpt->BeginSection("ports");
+    ckpt->Check(AllPorts.GetOccupancy(), "number of ports");
+
+    map<PORT_KEY, UINT32> restored;
+    for (int n = 0; n < AllPorts.GetOccupancy(); n++)
+    {
+        PORT_KEY key;
+        ckpt->Restore(key.first.first);
+        ckpt->Restore(key.first.second);
+        ckpt->Restore(key.second);
+
+        map<PORT_KEY, vector<BasePort*> >::iterator p = ports.find(key);
+        UINT32 &next = restored[key];
+        VERIFY(p != ports.end() && next < p->second.size(),
+               "Checkpoint " << ckpt->GetFileName() << " has port "
+               << key.first.first << " instance " << key.first.second
+               << " type " << key.second << ", which is not in the model");
+
+        p->second[next++]->RestoreCheckpoint(ckpt);
+    }
+
+    ckpt->EndSection();
+}
+
+
+/**
+ * Memory of all the port buffers, tagged with the clockable owning each
+ * one, so that the clock server can place it near the thread clocking it.
+ */
+void
+BasePort::GetAllStorage(vector<STORAGE_RANGE> &ranges)
+{
+    asim::Vector<BasePort*>::Iterator i = AllPorts.Begin();
+    asim::Vector<BasePort*>::Iterator end = AllPorts.End();
+    for ( ; i != end; ++i)
+    {
+        (*i)->GetStorage(ranges);
+    }
+}
@@ -52,6 +52,7 @@ Regex::Regex(const char *pattern, bool caseSensitive)
 {
     subArraySize = 0;
     subArray = NULL;
+    this->caseSensitive = true;
 
     initialized = false;
     
@@ -72,6 +73,7 @@ Regex::Regex()
 {
     subArraySize = 0;
     subArray = NULL;
+    this->caseSensitive = true;
 
     initialized = false;
 }
@@ -79,6 +81,9 @@ Regex::Regex()
 int
 Regex::create(const char *pattern, bool caseSensitive)
 {
+    this->pattern = pattern;
+    this->caseSensitive = caseSensitive;
+
     int flags = REG_EXTENDED;
     if (! caseSensitive)
     {
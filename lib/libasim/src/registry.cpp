@@ -70,6 +70,16 @@ ASIM_REGISTRY_CLASS::RegisterState (UINT64 *s, const UINT32 sz,
     return(ns);
 }
 
+ASIM_STATE
+ASIM_REGISTRY_CLASS::RegisterState (ASIM_SHARDED_COUNTER s, 
+				    const char * const n,
+				    const char * const d, bool sus)
+{
+    ASIM_STATE ns = new ASIM_STATE_CLASS(s, n, d, regPath, sus);
+    states = new ASIM_STATELINK_CLASS(ns, states, true);
+    return(ns);
+}
+
 ASIM_STATE
 ASIM_REGISTRY_CLASS::RegisterState (double *s, const char * const n, 
 				    const char * const d, bool sus)
@@ -238,6 +248,48 @@ ASIM_REGISTRY_CLASS::ClearStats ()
     }
 }
 
+void
+ASIM_REGISTRY_CLASS::SaveStatsCheckpoint (ASIM_CHECKPOINT ckpt)
+/*
+ * Save stats in a timing checkpoint
+ */
+{
+    UINT32 nStates = 0;
+    for (ASIM_STATELINK sscan = states; sscan != NULL; sscan = sscan->next)
+    {
+        nStates++;
+    }
+    ckpt->Check(nStates, "number of registered stats");
+
+    ASIM_STATELINK sscan = states;
+    while (sscan != NULL) 
+    {
+        sscan->state->SaveCheckpoint(ckpt);
+        sscan = sscan->next;
+    }
+}
+
+void
+ASIM_REGISTRY_CLASS::RestoreStatsCheckpoint (ASIM_CHECKPOINT ckpt)
+/*
+ * Restore stats from a timing checkpoint
+ */
+{
+    UINT32 nStates = 0;
+    for (ASIM_STATELINK sscan = states; sscan != NULL; sscan = sscan->next)
+    {
+        nStates++;
+    }
+    ckpt->Check(nStates, "number of registered stats");
+
+    ASIM_STATELINK sscan = states;
+    while (sscan != NULL) 
+    {
+        sscan->state->RestoreCheckpoint(ckpt);
+        sscan = sscan->next;
+    }
+}
+
 void
 ASIM_REGISTRY_CLASS::RegisterStripChart (const char *description, UINT64 frequency, UINT64 *data, UINT64 threads, UINT64 max_elems, UINT32 cpunum)
 {
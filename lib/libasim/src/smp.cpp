@@ -37,8 +37,20 @@
 #include "asim/smp.h"
 #include "asim/atomic.h"
 #include <iostream>
+#include <fstream>
+#include <stdio.h>
+#include <sstream>
+#include <algorithm>
+#include <sched.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/syscall.h>
 #include "asim/mesg.h"
 
+#ifndef MPOL_MF_MOVE
+#define MPOL_MF_MOVE (1 << 1)
+#endif
+
 
 ATOMIC32_CLASS ASIM_SMP_THREAD_HANDLE_CLASS::threadUidGen = 0;
 
@@ -46,6 +58,9 @@ ASIM_SMP_THREAD_HANDLE ASIM_SMP_CLASS::mainThread;
 pthread_key_t ASIM_SMP_CLASS::threadLocalKey;
 UINT32 ASIM_SMP_CLASS::maxThreads = 0;
 ATOMIC32_CLASS ASIM_SMP_CLASS::activeThreads = 0;
+vector<INT32> ASIM_SMP_CLASS::cpuOrder;
+vector<INT32> ASIM_SMP_CLASS::cpuNode;
+UINT32 ASIM_SMP_CLASS::numNodes = 1;
 
 #ifdef TLS_AVAILABLE
 __thread INT32 ASIM_SMP_RunningThreadNumber = 0;
@@ -143,6 +158,7 @@ ASIM_SMP_CLASS::ThreadEntry(void *arg)
     ASIM_SMP_THREAD_HANDLE threadHandle = ASIM_SMP_THREAD_HANDLE(arg);
 
     SetThreadHandle(threadHandle);
+    PinThread(threadHandle->threadNumber);
 
     cout << "Thread " << GetRunningThreadNumber() << " created." << endl;
     
@@ -178,3 +194,323 @@ ASIM_SMP_CLASS::SetThreadHandle(ASIM_SMP_THREAD_HANDLE threadHandle)
 
     VERIFYX(0 == pthread_setspecific(threadLocalKey, threadHandle));
 }
+
+
+//
+// Parse a sysfs style CPU list ("0-3,8,10-11").
+//
+bool
+ASIM_SMP_CLASS::ParseCpuList(const string &list, vector<INT32> &cpus)
+{
+    istringstream is(list);
+    string range;
+    while (getline(is, range, ','))
+    {
+        if (range.find_first_not_of(" \t\n") == string::npos)
+        {
+            continue;
+        }
+
+        INT32 first, last;
+        char dash;
+        istringstream rs(range);
+        if (!(rs >> first))
+        {
+            return false;
+        }
+        last = first;
+        if (rs >> dash)
+        {
+            if (dash != '-' || !(rs >> last) || last < first)
+            {
+                return false;
+            }
+        }
+        for (INT32 cpu = first; cpu <= last; cpu++)
+        {
+            cpus.push_back(cpu);
+        }
+    }
+    return true;
+}
+
+
+static INT32
+ReadSysInt(const string &path, INT32 dflt)
+{
+    ifstream is(path.c_str());
+    INT32 val;
+    return (is >> val) ? val : dflt;
+}
+
+
+//
+// NUMA node of every CPU, from /sys/devices/system/node.
+//
+void
+ASIM_SMP_CLASS::ReadTopology(void)
+{
+    cpuNode.assign(CPU_SETSIZE, 0);
+    numNodes = 1;
+
+    DIR *dir = opendir("/sys/devices/system/node");
+    if (dir == NULL)
+    {
+        return;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        INT32 node;
+        char rest;
+        if (sscanf(entry->d_name, "node%d%c", &node, &rest) != 1)
+        {
+            continue;
+        }
+
+        ifstream is((string("/sys/devices/system/node/") + entry->d_name +
+                     "/cpulist").c_str());
+        string list;
+        getline(is, list);
+
+        vector<INT32> cpus;
+        ParseCpuList(list, cpus);
+        for (UINT32 i = 0; i < cpus.size(); i++)
+        {
+            if (cpus[i] < CPU_SETSIZE)
+            {
+                cpuNode[cpus[i]] = node;
+            }
+        }
+        numNodes = max(numNodes, UINT32(node + 1));
+    }
+    closedir(dir);
+}
+
+
+bool
+ASIM_SMP_CLASS::CpuOrder(
+    const string &policy,
+    vector<ASIM_SMP_CPU> cpus,
+    vector<INT32> &order)
+{
+    order.clear();
+    if (policy == "" || policy == "none")
+    {
+        return true;
+    }
+
+    if (policy != "compact" && policy != "scatter")
+    {
+        return ParseCpuList(policy, order);
+    }
+
+    UINT32 nodes = 1;
+    sort(cpus.begin(), cpus.end());
+    for (UINT32 i = 0; i < cpus.size(); i++)
+    {
+        nodes = max(nodes, UINT32(cpus[i].node + 1));
+        cpus[i].sibling = 0;
+        if (i > 0 &&
+            cpus[i].node == cpus[i-1].node &&
+            cpus[i].package == cpus[i-1].package &&
+            cpus[i].core == cpus[i-1].core)
+        {
+            cpus[i].sibling = cpus[i-1].sibling + 1;
+        }
+    }
+
+    if (policy == "compact")
+    {
+        for (UINT32 i = 0; i < cpus.size(); i++)
+        {
+            order.push_back(cpus[i].cpu);
+        }
+    }
+    else
+    {
+        // Per node, the first hardware thread of every core, then the
+        // second ones...  and then take one CPU of each node in turn.
+        vector<vector<INT32> > perNode(nodes);
+        UINT32 placed = 0;
+        for (INT32 sibling = 0; placed < cpus.size(); sibling++)
+        {
+            for (UINT32 i = 0; i < cpus.size(); i++)
+            {
+                if (cpus[i].sibling == sibling)
+                {
+                    perNode[cpus[i].node].push_back(cpus[i].cpu);
+                    placed++;
+                }
+            }
+        }
+        for (UINT32 n = 0; order.size() < cpus.size(); n++)
+        {
+            for (UINT32 node = 0; node < nodes; node++)
+            {
+                if (n < perNode[node].size())
+                {
+                    order.push_back(perNode[node][n]);
+                }
+            }
+        }
+    }
+    return true;
+}
+
+
+void
+ASIM_SMP_CLASS::SetAffinity(const string &policy)
+{
+    cpuOrder.clear();
+    if (policy == "" || policy == "none")
+    {
+        return;
+    }
+
+    ReadTopology();
+
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    VERIFYX(sched_getaffinity(0, sizeof(allowed), &allowed) == 0);
+
+    vector<ASIM_SMP_CPU> cpus;
+    for (INT32 cpu = 0; cpu < CPU_SETSIZE; cpu++)
+    {
+        if (!CPU_ISSET(cpu, &allowed))
+        {
+            continue;
+        }
+        ostringstream topo;
+        topo << "/sys/devices/system/cpu/cpu" << cpu << "/topology/";
+
+        ASIM_SMP_CPU c;
+        c.node = cpuNode[cpu];
+        c.package = ReadSysInt(topo.str() + "physical_package_id", 0);
+        c.core = ReadSysInt(topo.str() + "core_id", cpu);
+        c.sibling = 0;
+        c.cpu = cpu;
+        cpus.push_back(c);
+    }
+
+    VERIFY(CpuOrder(policy, cpus, cpuOrder), "Bad thread affinity: " << policy);
+    VERIFY(!cpuOrder.empty(), "Thread affinity " << policy
+           << ": no CPU available");
+    for (UINT32 i = 0; i < cpuOrder.size(); i++)
+    {
+        VERIFY(cpuOrder[i] < CPU_SETSIZE && CPU_ISSET(cpuOrder[i], &allowed),
+               "Thread affinity " << policy << ": CPU " << cpuOrder[i]
+               << " is not available");
+    }
+
+    // The threads already running are the calling one and maybe some
+    // dormant ones, which share its pthread.
+    PinThread(GetRunningThreadNumber());
+}
+
+
+INT32
+ASIM_SMP_CLASS::GetThreadCpu(INT32 threadNumber)
+{
+    if (cpuOrder.empty() || threadNumber < 0)
+    {
+        return -1;
+    }
+    return cpuOrder[threadNumber % cpuOrder.size()];
+}
+
+
+INT32
+ASIM_SMP_CLASS::GetCpuNode(INT32 cpu)
+{
+    if (cpu < 0 || UINT32(cpu) >= cpuNode.size())
+    {
+        return -1;
+    }
+    return cpuNode[cpu];
+}
+
+
+void
+ASIM_SMP_CLASS::PinThread(INT32 threadNumber)
+{
+    INT32 cpu = GetThreadCpu(threadNumber);
+    if (cpu < 0)
+    {
+        return;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    VERIFY(pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0,
+           "Cannot pin thread " << threadNumber << " to CPU " << cpu);
+}
+
+
+//
+// Pages are moved and queried with the move_pages system call, so that
+// no NUMA library is needed.  Failures (no NUMA support in the kernel,
+// not allowed...) only mean that the pages stay where they are.
+//
+static void
+PagesOf(const void *start, UINT64 bytes, vector<void *> &pages)
+{
+    const UINT64 pageSize = sysconf(_SC_PAGESIZE);
+    UINT64 first = UINT64(start) & ~(pageSize - 1);
+    for (UINT64 page = first; page < UINT64(start) + bytes; page += pageSize)
+    {
+        pages.push_back((void *)page);
+    }
+}
+
+
+void
+ASIM_SMP_CLASS::MovePages(const void *start, UINT64 bytes, INT32 node)
+{
+#ifdef SYS_move_pages
+    vector<void *> pages;
+    PagesOf(start, bytes, pages);
+    if (pages.empty() || node < 0)
+    {
+        return;
+    }
+
+    vector<int> nodes(pages.size(), node);
+    vector<int> status(pages.size());
+    syscall(SYS_move_pages, 0, pages.size(), &pages[0], &nodes[0],
+            &status[0], MPOL_MF_MOVE);
+#endif
+}
+
+
+void
+ASIM_SMP_CLASS::CountPages(const void *start, UINT64 bytes, INT32 node,
+                           UINT64 &pages, UINT64 &remote)
+{
+#ifdef SYS_move_pages
+    vector<void *> addrs;
+    PagesOf(start, bytes, addrs);
+    if (addrs.empty())
+    {
+        return;
+    }
+
+    // without target nodes, move_pages reports where every page is
+    vector<int> status(addrs.size(), -1);
+    if (syscall(SYS_move_pages, 0, addrs.size(), &addrs[0], NULL,
+                &status[0], 0) != 0)
+    {
+        return;
+    }
+    for (UINT32 i = 0; i < status.size(); i++)
+    {
+        if (status[i] >= 0)
+        {
+            pages++;
+            remote += (status[i] != node);
+        }
+    }
+#endif
+}
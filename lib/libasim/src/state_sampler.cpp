@@ -0,0 +1,204 @@
+/**************************************************************************
+ * Copyright (c) 2014, Intel Corporation
+ *
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ * 
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright 
+ *   notice, this list of conditions and the following disclaimer in the 
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the Intel Corporation nor the names of its 
+ *   contributors may be used to endorse or promote products derived from 
+ *   this software without specific prior written permission.
+ *  
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @author Pau Cabre
+ * @brief Case insensitive state index and periodic state samples
+ */
+
+// generic
+#include <string.h>
+#include <ctype.h>
+
+// ASIM core
+#include "asim/state_sampler.h"
+#include "asim/mesg.h"
+
+
+//----------------------------------------------------------------------------
+// Index
+//----------------------------------------------------------------------------
+void
+STATE_INDEX_CLASS::Init(
+    UINT32 keys)
+{
+    // a power of two with at most one key per bucket on average
+    UINT32 size = 16;
+    while (size < keys) {
+        size <<= 1;
+    }
+    buckets.clear();
+    buckets.resize(size);
+}
+
+string
+STATE_INDEX_CLASS::Lower(
+    const char * key)
+{
+    string lower(key);
+    for (UINT32 i = 0; i < lower.size(); i++) {
+        lower[i] = tolower(lower[i]);
+    }
+    return lower;
+}
+
+UINT32
+STATE_INDEX_CLASS::Hash(
+    const string & key)
+{
+    // FNV-1a
+    UINT32 h = 2166136261U;
+    for (UINT32 i = 0; i < key.size(); i++) {
+        h = (h ^ (unsigned char) key[i]) * 16777619U;
+    }
+    return h;
+}
+
+void
+STATE_INDEX_CLASS::Add(
+    const char * key,
+    UINT32 id)
+{
+    string lower = Lower(key);
+    vector<Entry> & bucket = buckets[Hash(lower) & (buckets.size() - 1)];
+    for (UINT32 i = 0; i < bucket.size(); i++) {
+        if (bucket[i].key == lower) {
+            bucket[i].ids.push_back(id);
+            return;
+        }
+    }
+    bucket.push_back(Entry());
+    bucket.back().key = lower;
+    bucket.back().ids.push_back(id);
+}
+
+const vector<UINT32> *
+STATE_INDEX_CLASS::Find(
+    const char * key) const
+{
+    string lower = Lower(key);
+    const vector<Entry> & bucket = buckets[Hash(lower) & (buckets.size() - 1)];
+    for (UINT32 i = 0; i < bucket.size(); i++) {
+        if (bucket[i].key == lower) {
+            return &bucket[i].ids;
+        }
+    }
+    return NULL;
+}
+
+//----------------------------------------------------------------------------
+// Sampler
+//----------------------------------------------------------------------------
+STATE_SAMPLER_CLASS::STATE_SAMPLER_CLASS(
+    const vector<ASIM_STATE> & all)
+  : frontCycle(0)
+{
+    index.Init(all.size());
+    UINT32 nValues = 0;
+    for (UINT32 i = 0; i < all.size(); i++) {
+        ASIM_STATE state = all[i];
+        if (state->Type() == STATE_UINT || state->Type() == STATE_FP) {
+            index.Add((string(state->Path()) + "/" + state->Name()).c_str(),
+                      states.size());
+            states.push_back(state);
+            offset.push_back(nValues);
+            nValues += state->Size();
+        }
+    }
+    back.resize(nValues);
+    front.resize(nValues);
+    pthread_mutex_init(&lock, NULL);
+    Take(0);
+}
+
+STATE_SAMPLER_CLASS::~STATE_SAMPLER_CLASS()
+{
+    pthread_mutex_destroy(&lock);
+}
+
+INT32
+STATE_SAMPLER_CLASS::Lookup(
+    const char * fullName) const
+{
+    const vector<UINT32> * ids = index.Find(fullName);
+    return (ids != NULL) ? (INT32) ids->front() : -1;
+}
+
+void
+STATE_SAMPLER_CLASS::Take(
+    UINT64 cycle)
+{
+    for (UINT32 s = 0; s < states.size(); s++) {
+        ASIM_STATE state = states[s];
+        UINT64 * v = &back[offset[s]];
+        if (state->Type() == STATE_UINT) {
+            for (UINT32 i = 0; i < state->Size(); i++) {
+                v[i] = state->IntValue(i);
+            }
+        } else {
+            for (UINT32 i = 0; i < state->Size(); i++) {
+                double d = state->FpValue(i);
+                memcpy(&v[i], &d, sizeof(d));
+            }
+        }
+    }
+
+    pthread_mutex_lock(&lock);
+    back.swap(front);
+    frontCycle = cycle;
+    pthread_mutex_unlock(&lock);
+}
+
+UINT64
+STATE_SAMPLER_CLASS::Read(
+    const vector<INT32> & handles,
+    vector< vector<double> > & values)
+{
+    values.resize(handles.size());
+    pthread_mutex_lock(&lock);
+    for (UINT32 i = 0; i < handles.size(); i++) {
+        INT32 h = handles[i];
+        ASSERT(h >= 0 && h < (INT32) states.size(), "invalid state handle " << h);
+        ASIM_STATE state = states[h];
+        const UINT64 * v = &front[offset[h]];
+        values[i].resize(state->Size());
+        for (UINT32 j = 0; j < state->Size(); j++) {
+            if (state->Type() == STATE_UINT) {
+                values[i][j] = (double) v[j];
+            } else {
+                memcpy(&values[i][j], &v[j], sizeof(double));
+            }
+        }
+    }
+    UINT64 cycle = frontCycle;
+    pthread_mutex_unlock(&lock);
+    return cycle;
+}
@@ -41,9 +41,13 @@
 #include <string>
 #include <string.h>
 #include <cerrno>
+#include <deque>
+#include <pthread.h>
+#include <stdlib.h>
 
 // ASIM core
 #include "asim/stateout.h"
+#include "asim/mesg.h"
 
 
 // initialize class constants
@@ -56,6 +60,142 @@ const char * const STATE_OUT_CLASS::elementType     = "type";
 const char * const STATE_OUT_CLASS::elementName     = "name";
 const char * const STATE_OUT_CLASS::elementDesc     = "desc";
 
+//
+// Background dumps. The snapshots are written in order by a single writer
+// thread, started with the first one. A snapshot stays in the queue until
+// its file is complete. However the simulator exits, the writer drains the
+// queue and stops before the static objects are destroyed.
+//
+static pthread_mutex_t bgLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t bgQueued = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t bgWritten = PTHREAD_COND_INITIALIZER;
+static deque<STATE_SNAPSHOT> bgQueue;
+static UINT64 bgBytes = 0;                      // memory of the queue
+static UINT64 bgLastBytes = 0;                  // size of the last snapshot
+static UINT64 bgBudget = UINT64(256) << 20;
+static bool bgWriterRunning = false;
+static bool bgWriterStop = false;               // exit when the queue is empty
+static bool bgExitHandlers = false;             // registered with the writer
+static pthread_t bgWriter;
+static void (*bgNextTerminateHook)(void) = NULL;
+
+/**
+ * Write the queued dumps and stop the writer thread. Dumps started after
+ * this write their files directly.
+ */
+static void
+StopBackgroundWriter (void)
+{
+    pthread_mutex_lock(&bgLock);
+    bgBudget = 0;
+    bool join = bgWriterRunning && ! pthread_equal(pthread_self(), bgWriter);
+    if (join)
+    {
+        bgWriterStop = true;
+        pthread_cond_signal(&bgQueued);
+    }
+    pthread_mutex_unlock(&bgLock);
+
+    if (join)
+    {
+        pthread_join(bgWriter, NULL);
+        pthread_mutex_lock(&bgLock);
+        bgWriterRunning = false;
+        bgWriterStop = false;
+        pthread_mutex_unlock(&bgLock);
+    }
+}
+
+/**
+ * An error or a failed assertion may end the simulator with _exit, which
+ * skips the atexit handlers.
+ */
+static void
+BackgroundTerminate (void)
+{
+    StopBackgroundWriter();
+    if (bgNextTerminateHook)
+    {
+        bgNextTerminateHook();
+    }
+}
+
+// A forked child has no writer thread: the parent writes the queued dumps
+static void BackgroundForkPrepare (void) { pthread_mutex_lock(&bgLock); }
+static void BackgroundForkParent (void) { pthread_mutex_unlock(&bgLock); }
+static void
+BackgroundForkChild (void)
+{
+    bgQueue.clear();
+    bgBytes = 0;
+    bgWriterRunning = false;
+    pthread_mutex_unlock(&bgLock);
+}
+
+/**
+ * Record a string (or NULL) of a snapshot, with its terminating null
+ * character so that the replay can use it in place.
+ */
+void
+STATE_SNAPSHOT_CLASS::String (
+    const char* str)    ///< string to record, can be NULL
+{
+    data.push_back(str ? 1 : 0);
+    if (str)
+    {
+        Put(str, strlen(str) + 1);
+    }
+}
+
+const char*
+STATE_SNAPSHOT_CLASS::GetString (
+    size_t& pos) const  ///< position of the string, moved past it
+{
+    if (data[pos++] == 0)
+    {
+        return NULL;
+    }
+    const char* str = &data[pos];
+    pos += strlen(str) + 1;
+    return str;
+}
+
+string
+STATE_SNAPSHOT_CLASS::GetValue (
+    size_t& pos) const  ///< position of the value, moved past it
+{
+    ostringstream os;
+    VALUE tag = VALUE(data[pos++]);
+    if (tag == VALUE_TEXT)
+    {
+        const char* str = GetString(pos);
+        return str ? str : "";
+    }
+
+    unsigned long long u;
+    long long i;
+    double d;
+    switch (tag)
+    {
+      case VALUE_UINT:
+        memcpy(&u, &data[pos], sizeof(u));
+        os << u;
+        break;
+      case VALUE_INT:
+        memcpy(&i, &data[pos], sizeof(i));
+        os << i;
+        break;
+      case VALUE_DOUBLE:
+        memcpy(&d, &data[pos], sizeof(d));
+        os << d;
+        break;
+      default:
+        ASIMERROR("Corrupt stats snapshot for \"" << filename << "\"");
+    }
+    pos += 8;
+    return os.str();
+}
+
 /**
  * Create a new stats ouput object and associate it with output
  * filename. We also perform all necessary setup for the underlying
@@ -63,6 +203,49 @@ const char * const STATE_OUT_CLASS::elementDesc     = "desc";
  */
 STATE_OUT_CLASS::STATE_OUT_CLASS (
     const char* filename)
+  : xmlStats(NULL),
+    snapshot(NULL)
+{
+    OpenXML(filename);
+}
+
+/**
+ * Create a stats output object whose file is written by a background
+ * thread. The output is only recorded in memory (see
+ * STATE_SNAPSHOT_CLASS), so the simulation can go on as soon as this
+ * object is deleted. The snapshots in flight use at most the memory
+ * budget, assuming that a dump is as large as the previous one: if
+ * there is no room, we first wait for older dumps to be written.
+ *
+ * With no budget the output is written directly.
+ */
+STATE_OUT_CLASS::STATE_OUT_CLASS (
+    const char* filename,   ///< stats file name
+    bool background)        ///< write it in a background thread
+  : xmlStats(NULL),
+    snapshot(NULL)
+{
+    pthread_mutex_lock(&bgLock);
+    background = background && bgBudget > 0;
+    while (background && !bgQueue.empty() && bgBytes + bgLastBytes > bgBudget)
+    {
+        pthread_cond_wait(&bgWritten, &bgLock);
+    }
+    pthread_mutex_unlock(&bgLock);
+
+    if (background)
+    {
+        snapshot = new STATE_SNAPSHOT_CLASS(filename);
+    }
+    else
+    {
+        OpenXML(filename);
+    }
+}
+
+void
+STATE_OUT_CLASS::OpenXML (
+    const char* filename)
 {
     // create an XMLOut object for the stats file
     xmlStats = new XMLOut(
@@ -104,6 +287,145 @@ STATE_OUT_CLASS::~STATE_OUT_CLASS ()
         // dump stats to file and delete object
         delete xmlStats;
     }
+
+    if (snapshot)
+    {
+        snapshot->Op(STATE_SNAPSHOT_CLASS::OP_END);
+
+        pthread_mutex_lock(&bgLock);
+        bgLastBytes = snapshot->Bytes();
+        bgBytes += bgLastBytes;
+        bgQueue.push_back(snapshot);
+        if (! bgWriterRunning)
+        {
+            VERIFY(pthread_create(&bgWriter, NULL, BackgroundWriter, NULL) == 0,
+                   "Unable to create the stats writer thread");
+            bgWriterRunning = true;
+            if (! bgExitHandlers)
+            {
+                bgExitHandlers = true;
+                atexit(StopBackgroundWriter);
+                bgNextTerminateHook = asim_terminate_hook;
+                asim_terminate_hook = BackgroundTerminate;
+                pthread_atfork(BackgroundForkPrepare, BackgroundForkParent,
+                               BackgroundForkChild);
+            }
+        }
+        pthread_cond_signal(&bgQueued);
+        pthread_mutex_unlock(&bgLock);
+    }
+}
+
+/**
+ * Set the memory that the snapshots of background dumps in flight may
+ * use. A budget of 0 makes background dumps write their files directly.
+ */
+void
+STATE_OUT_CLASS::SetBackgroundBudget (
+    UINT64 bytes)   ///< memory budget
+{
+    pthread_mutex_lock(&bgLock);
+    bgBudget = bytes;
+    pthread_mutex_unlock(&bgLock);
+}
+
+/**
+ * Wait until the files of all the background dumps are complete.
+ */
+void
+STATE_OUT_CLASS::WaitBackgroundDumps (void)
+{
+    pthread_mutex_lock(&bgLock);
+    while (! bgQueue.empty())
+    {
+        pthread_cond_wait(&bgWritten, &bgLock);
+    }
+    pthread_mutex_unlock(&bgLock);
+}
+
+void *
+STATE_OUT_CLASS::BackgroundWriter (void* arg)
+{
+    pthread_mutex_lock(&bgLock);
+    while (true)
+    {
+        while (bgQueue.empty() && ! bgWriterStop)
+        {
+            pthread_cond_wait(&bgQueued, &bgLock);
+        }
+        if (bgQueue.empty())
+        {
+            break;
+        }
+        STATE_SNAPSHOT snap = bgQueue.front();
+        pthread_mutex_unlock(&bgLock);
+
+        STATE_OUT_CLASS* out = new STATE_OUT_CLASS(snap->Filename());
+        out->Replay(*snap);
+        delete out;
+
+        pthread_mutex_lock(&bgLock);
+        bgBytes -= snap->Bytes();
+        bgQueue.pop_front();
+        delete snap;
+        pthread_cond_broadcast(&bgWritten);
+    }
+    pthread_mutex_unlock(&bgLock);
+    return NULL;
+}
+
+/**
+ * Write the recorded output of a background dump to the XML document.
+ */
+void
+STATE_OUT_CLASS::Replay (
+    const STATE_SNAPSHOT_CLASS& snap)   ///< records to write
+{
+    size_t pos = 0;
+    while (true)
+    {
+        STATE_SNAPSHOT_CLASS::OP op = snap.GetOp(pos);
+        if (op == STATE_SNAPSHOT_CLASS::OP_END)
+        {
+            return;
+        }
+        if (op == STATE_SNAPSHOT_CLASS::OP_CLOSE)
+        {
+            CloseCompound();
+            continue;
+        }
+        if (op == STATE_SNAPSHOT_CLASS::OP_TEXT)
+        {
+            AddText(snap.GetString(pos));
+            continue;
+        }
+
+        const char* type = snap.GetString(pos);
+        const char* name = snap.GetString(pos);
+        const char* desc = snap.GetString(pos);
+        switch (op)
+        {
+          case STATE_SNAPSHOT_CLASS::OP_COMPOUND:
+            AddCompound(type, name, desc);
+            break;
+          case STATE_SNAPSHOT_CLASS::OP_SCALAR:
+            AddScalar(type, name, desc, snap.GetValue(pos).c_str());
+            break;
+          case STATE_SNAPSHOT_CLASS::OP_VECTOR:
+            xmlStats->AddElement(elementVector);
+            AddCommonInfo(type, name, desc);
+            while (! snap.VectorEnd(pos))
+            {
+                xmlStats->AddElement(elementValue);
+                xmlStats->AddText(snap.GetValue(pos).c_str());
+                xmlStats->CloseElement();
+            }
+            xmlStats->CloseElement();
+            break;
+          default:
+            ASIMERROR("Corrupt stats snapshot for \"" << snap.Filename() << "\"");
+        }
+    }
 }
 
 /**
@@ -116,6 +438,12 @@ STATE_OUT_CLASS::AddCompound (
     const char* name,   ///< name of the compound element
     const char* desc)   ///< description of the compound element
 {
+    if (snapshot)
+    {
+        snapshot->Op(STATE_SNAPSHOT_CLASS::OP_COMPOUND);
+        RecordCommonInfo(type, name, desc);
+        return;
+    }
 
     xmlStats->AddElement(elementCompound);
     AddCommonInfo(type, name, desc);
@@ -128,6 +456,12 @@ STATE_OUT_CLASS::AddCompound (
 void
 STATE_OUT_CLASS::CloseCompound (void)
 {
+    if (snapshot)
+    {
+        snapshot->Op(STATE_SNAPSHOT_CLASS::OP_CLOSE);
+        return;
+    }
+
     xmlStats->CloseElement(); // compound
 }
 
@@ -142,15 +476,24 @@ STATE_OUT_CLASS::AddScalar (
     const char* desc,   ///< description of the scalar element
     const char* value)  ///< value of the scalar element
 {
-    xmlStats->AddElement(elementScalar);
-    AddCommonInfo(type, name, desc);
-
-    // add the value
     ASSERT(value, "missing value in scalar stats output for "
         << "type: " << (type ? type : "(NULL)") << ", "
         << "name: " << (name ? name : "(NULL)") << ", "
         << "desc: " << (desc ? desc : "(NULL)")
     );
+
+    if (snapshot)
+    {
+        snapshot->Op(STATE_SNAPSHOT_CLASS::OP_SCALAR);
+        RecordCommonInfo(type, name, desc);
+        snapshot->Value(value);
+        return;
+    }
+
+    xmlStats->AddElement(elementScalar);
+    AddCommonInfo(type, name, desc);
+
+    // add the value
     xmlStats->AddText(value);
 
     xmlStats->CloseElement(); // scalar
@@ -174,6 +517,13 @@ void
 STATE_OUT_CLASS::AddText (
     const char* text)   ///< text to be printed
 {
+    if (snapshot)
+    {
+        snapshot->Op(STATE_SNAPSHOT_CLASS::OP_TEXT);
+        snapshot->String(text);
+        return;
+    }
+
     xmlStats->AddElement(elementText);
     if (text)
     {
@@ -229,3 +579,18 @@ STATE_OUT_CLASS::AddCommonInfo (
         xmlStats->CloseElement(); // desc
     }
 }
+
+/**
+ * Record the common elements "type", "name", and "desc" of a background
+ * dump. NULL ones are recorded too and skipped on replay.
+ */
+void
+STATE_OUT_CLASS::RecordCommonInfo (
+    const char* type,    ///< type of current element
+    const char* name,    ///< name of current element
+    const char* desc)    ///< description of current element
+{
+    snapshot->String(type);
+    snapshot->String(name);
+    snapshot->String(desc);
+}
@@ -28,6 +28,10 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <string.h>
+#include <ctype.h>
+#include <algorithm>
+
 #include <asim/trace.h>
 
 // Include support for the old trace format.
@@ -47,6 +51,7 @@ UNCONDITIONAL_TRACEABLE_CLASS _unconditionalTraceable;
 UNCONDITIONAL_TRACEABLE unconditionalTraceable = &_unconditionalTraceable;
 
 TRACEABLE_REGEX_LIST *TRACEABLE_CLASS::regexes = 0;
+TRACE_REGEX_MATCHER TRACEABLE_CLASS::regexMatcher = 0;
 pthread_mutex_t TRACEABLE_CLASS::regexesMutex = PTHREAD_MUTEX_INITIALIZER;
 
 bool TRACEABLE_CLASS::enableThreadProtection = true;
@@ -121,11 +126,17 @@ void TRACEABLE_CLASS::SetTraceableName(string name)
     if(regexes) 
     {
         LOCK_MUTEX(regexesMutex);
-        // replay any regexes that have already been applied
-        for(list<TRACEABLE_REGEX>::iterator iter = regexes->begin(); iter != regexes->end(); iter++) 
+        // replay any regexes that have already been applied, all of
+        // them in a single pass over the name
+        if(regexes && !regexMatcher) 
         {
-            TRACEABLE_REGEX r = *iter;
-            EnableByRegex(r->regex, r->level);
+            regexMatcher = new TRACE_REGEX_MATCHER_CLASS();
+            regexMatcher->Add(regexes);
+            regexMatcher->Build();
+        }
+        if(regexMatcher) 
+        {
+            EnableByMatcher(*regexMatcher);
         }
         UNLOCK_MUTEX(regexesMutex);
     }
@@ -141,6 +152,37 @@ void TRACEABLE_CLASS::EnableByRegex(Regex *regex, int level)
     }
 }
 
+void TRACEABLE_CLASS::EnableByMatcher(const TRACE_REGEX_MATCHER_CLASS &matcher) 
+{
+    int idx = matcher.Match(objectName);
+    if(idx >= 0) 
+    {
+        SetTraceOn(true);
+        SetTraceLevel(matcher.GetLevel(idx));
+    }
+}
+
+void TRACEABLE_CLASS::EnableAllByMatcher(const TRACE_REGEX_MATCHER_CLASS &matcher) 
+{
+    assert(traceables);
+
+    // Walk through the list of traceable objects.
+    LOCK_MUTEX(traceablesMutex);
+    for(list<TRACEABLE>::iterator iter = TRACEABLE_CLASS::traceables->begin(); 
+        iter != TRACEABLE_CLASS::traceables->end(); iter++) 
+    {
+        TRACEABLE t = *iter;
+        t->EnableByMatcher(matcher);
+    }
+    UNLOCK_MUTEX(traceablesMutex);
+}
+
+void TRACEABLE_CLASS::InvalidateRegexMatcher() 
+{
+    delete regexMatcher;
+    regexMatcher = 0;
+}
+
 bool TRACEABLE_CLASS::EnableTraceByRegex(string regexStr, int level, bool saveRegex) 
 {
     // build a regular expression for regex
@@ -171,18 +213,14 @@ bool TRACEABLE_CLASS::EnableTraceByRegex(Regex *regex, int level, bool saveRegex
         }
         LOCK_MUTEX(regexesMutex);
         regexes->push_back(new TRACEABLE_REGEX_CLASS(regex, level));
+        InvalidateRegexMatcher();
         UNLOCK_MUTEX(regexesMutex);
     }
     
-    // Walk through the list of traceable objects.
-    LOCK_MUTEX(traceablesMutex);
-    for(list<TRACEABLE>::iterator iter = TRACEABLE_CLASS::traceables->begin(); 
-        iter != TRACEABLE_CLASS::traceables->end(); iter++) 
-    {
-        TRACEABLE t = *iter;
-        t->EnableByRegex(regex, level);
-    }
-    UNLOCK_MUTEX(traceablesMutex);
+    TRACE_REGEX_MATCHER_CLASS matcher;
+    matcher.Add(regex, level);
+    matcher.Build();
+    EnableAllByMatcher(matcher);
     return(true);
 }
 
@@ -208,6 +246,246 @@ void TRACEABLE_CLASS::PrintNames()
     }
 }
 
+/////////////////////////////////////////////////////////////////////////////////
+//
+// TRACE_REGEX_MATCHER_CLASS
+//
+/////////////////////////////////////////////////////////////////////////////////
+
+TRACE_REGEX_MATCHER_CLASS::TRACE_REGEX_MATCHER_CLASS() 
+    : built(false)
+{
+    // root of the automaton
+    nodes.push_back(NODE());
+    nodes[0].fail = 0;
+    nodes[0].outLink = 0;
+    nodes[0].depth = 0;
+}
+
+// Recognize [^][.*]string[.*][$], where string has no special
+// characters other than escaped ones.  Anything else (alternatives,
+// brackets, repetitions...) is left to regexec.
+bool TRACE_REGEX_MATCHER_CLASS::ParseLiteral(const Regex *regex, PATTERN &p) 
+{
+    static const char *special = ".[]()*+?{}|^$\\";
+
+    // the automaton is case-folded, like the regexes built for -tr
+    if(regex->isCaseSensitive()) 
+    {
+        return(false);
+    }
+
+    const string &str = regex->getPattern();
+    size_t begin = 0;
+    size_t end = str.size();
+
+    p.anchorStart = false;
+    p.anchorEnd = false;
+    if(begin < end && str[begin] == '^') 
+    {
+        p.anchorStart = true;
+        begin++;
+    }
+    if(end - begin >= 2 && str.compare(begin, 2, ".*") == 0) 
+    {
+        p.anchorStart = false;
+        begin += 2;
+    }
+    // an escaped '$' or '.' leaves a lone backslash, rejected below
+    if(end > begin && str[end - 1] == '$') 
+    {
+        p.anchorEnd = true;
+        end--;
+    }
+    if(end - begin >= 2 && str.compare(end - 2, 2, ".*") == 0) 
+    {
+        p.anchorEnd = false;
+        end -= 2;
+    }
+
+    p.literal.clear();
+    for(size_t i = begin; i < end; i++) 
+    {
+        char c = str[i];
+        if(c == '\\') 
+        {
+            i++;
+            if(i == end || !strchr(special, str[i])) 
+            {
+                return(false);
+            }
+            c = str[i];
+        }
+        else if(strchr(special, c)) 
+        {
+            return(false);
+        }
+        p.literal += (char) tolower(c);
+    }
+    return(true);
+}
+
+int TRACE_REGEX_MATCHER_CLASS::Child(int node, unsigned char c) const 
+{
+    const vector<pair<unsigned char, int> > &next = nodes[node].next;
+    vector<pair<unsigned char, int> >::const_iterator it =
+        lower_bound(next.begin(), next.end(), make_pair(c, 0));
+    return((it != next.end() && it->first == c) ? it->second : -1);
+}
+
+int TRACE_REGEX_MATCHER_CLASS::AddChild(int node, unsigned char c) 
+{
+    int child = Child(node, c);
+    if(child < 0) 
+    {
+        child = nodes.size();
+        nodes.push_back(NODE());
+        nodes[child].fail = 0;
+        nodes[child].outLink = 0;
+        nodes[child].depth = nodes[node].depth + 1;
+
+        vector<pair<unsigned char, int> > &next = nodes[node].next;
+        next.insert(lower_bound(next.begin(), next.end(), make_pair(c, 0)),
+                    make_pair(c, child));
+    }
+    return(child);
+}
+
+void TRACE_REGEX_MATCHER_CLASS::Add(Regex *regex, int level) 
+{
+    assert(!built);
+
+    PATTERN p;
+    p.regex = regex;
+    p.level = level;
+    int idx = patterns.size();
+    bool literal = ParseLiteral(regex, p);
+    patterns.push_back(p);
+
+    if(!literal) 
+    {
+        genericPatterns.push_back(idx);
+    }
+    else if(p.literal.empty()) 
+    {
+        emptyPatterns.push_back(idx);
+    }
+    else 
+    {
+        int node = 0;
+        for(size_t i = 0; i < p.literal.size(); i++) 
+        {
+            node = AddChild(node, p.literal[i]);
+        }
+        nodes[node].patterns.push_back(idx);
+    }
+}
+
+void TRACE_REGEX_MATCHER_CLASS::Add(const TRACEABLE_REGEX_LIST *list) 
+{
+    for(TRACEABLE_REGEX_LIST::const_iterator iter = list->begin(); iter != list->end(); iter++) 
+    {
+        Add((*iter)->regex, (*iter)->level);
+    }
+}
+
+void TRACE_REGEX_MATCHER_CLASS::Build() 
+{
+    assert(!built);
+    built = true;
+
+    // breadth first, so the fail node of a parent is always done
+    vector<int> queue;
+    queue.push_back(0);
+    for(size_t q = 0; q < queue.size(); q++) 
+    {
+        int node = queue[q];
+        for(size_t i = 0; i < nodes[node].next.size(); i++) 
+        {
+            unsigned char c = nodes[node].next[i].first;
+            int child = nodes[node].next[i].second;
+            queue.push_back(child);
+
+            int fail = 0;
+            if(node != 0) 
+            {
+                fail = nodes[node].fail;
+                while(fail != 0 && Child(fail, c) < 0) 
+                {
+                    fail = nodes[fail].fail;
+                }
+                int f = Child(fail, c);
+                fail = (f >= 0) ? f : 0;
+            }
+            nodes[child].fail = fail;
+            nodes[child].outLink = nodes[fail].patterns.empty() ? nodes[fail].outLink : fail;
+        }
+    }
+}
+
+int TRACE_REGEX_MATCHER_CLASS::Match(const string &name) const 
+{
+    assert(built);
+
+    int best = -1;
+    size_t len = name.size();
+
+    if(nodes.size() > 1) 
+    {
+        int node = 0;
+        for(size_t i = 0; i < len; i++) 
+        {
+            unsigned char c = tolower((unsigned char) name[i]);
+            int child;
+            while((child = Child(node, c)) < 0 && node != 0) 
+            {
+                node = nodes[node].fail;
+            }
+            node = (child >= 0) ? child : 0;
+
+            int out = nodes[node].patterns.empty() ? nodes[node].outLink : node;
+            while(out != 0) 
+            {
+                const NODE &n = nodes[out];
+                for(size_t j = 0; j < n.patterns.size(); j++) 
+                {
+                    int idx = n.patterns[j];
+                    const PATTERN &p = patterns[idx];
+                    if(idx > best &&
+                       (!p.anchorStart || i + 1 == (size_t) n.depth) &&
+                       (!p.anchorEnd || i + 1 == len)) 
+                    {
+                        best = idx;
+                    }
+                }
+                out = n.outLink;
+            }
+        }
+    }
+
+    for(size_t j = 0; j < emptyPatterns.size(); j++) 
+    {
+        int idx = emptyPatterns[j];
+        const PATTERN &p = patterns[idx];
+        if(idx > best && (!p.anchorStart || !p.anchorEnd || len == 0)) 
+        {
+            best = idx;
+        }
+    }
+
+    // only a later regex can change the result
+    for(int j = genericPatterns.size() - 1; j >= 0 && genericPatterns[j] > best; j--) 
+    {
+        if(patterns[genericPatterns[j]].regex->match(name)) 
+        {
+            best = genericPatterns[j];
+            break;
+        }
+    }
+
+    return(best);
+}
+
 UNCONDITIONAL_TRACEABLE_CLASS::UNCONDITIONAL_TRACEABLE_CLASS() 
 {
     SetTraceableName("_UNCONDITIONAL_");
@@ -220,17 +498,21 @@ TRACEABLE_DELAYED_ACTION_CLASS::TRACEABLE_DELAYED_ACTION_CLASS()
     LOCK_MUTEX(TRACEABLE_CLASS::regexesMutex);
     savedRegexes = TRACEABLE_CLASS::regexes;
     TRACEABLE_CLASS::regexes = 0;
+    TRACEABLE_CLASS::InvalidateRegexMatcher();
     UNLOCK_MUTEX(TRACEABLE_CLASS::regexesMutex);
     
     // reapply the saved regexes with trace level 0 but
     // don't save the regex
     if(savedRegexes) 
     {
+        TRACE_REGEX_MATCHER_CLASS matcher;
         for(list<TRACEABLE_REGEX>::iterator iter = savedRegexes->begin(); iter != savedRegexes->end(); iter++) 
         {
             TRACEABLE_REGEX r = *iter;
-            TRACEABLE_CLASS::EnableTraceByRegex(r->regex, 0, false);
+            matcher.Add(r->regex, 0);
         }
+        matcher.Build();
+        TRACEABLE_CLASS::EnableAllByMatcher(matcher);
     }
 }
 
@@ -249,10 +531,23 @@ void TRACEABLE_DELAYED_ACTION_CLASS::go()
 {
     if(savedRegexes) 
     {
+        // save them all and apply them together in a single walk
+        LOCK_MUTEX(TRACEABLE_CLASS::regexesMutex);
+        if(!TRACEABLE_CLASS::regexes) 
+        {
+            TRACEABLE_CLASS::regexes = new TRACEABLE_REGEX_LIST();
+        }
         for(list<TRACEABLE_REGEX>::iterator iter = savedRegexes->begin(); iter != savedRegexes->end(); iter++) 
         {
             TRACEABLE_REGEX r = *iter;
-            TRACEABLE_CLASS::EnableTraceByRegex(r);
+            TRACEABLE_CLASS::regexes->push_back(new TRACEABLE_REGEX_CLASS(r->regex, r->level));
         }
+        TRACEABLE_CLASS::InvalidateRegexMatcher();
+        UNLOCK_MUTEX(TRACEABLE_CLASS::regexesMutex);
+
+        TRACE_REGEX_MATCHER_CLASS matcher;
+        matcher.Add(savedRegexes);
+        matcher.Build();
+        TRACEABLE_CLASS::EnableAllByMatcher(matcher);
     }
 }
@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ *
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the Intel Corporation nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @author Pau Cabre
+ * @brief Trace records of a thread clocking in parallel with others.
+ */
+
+// ASIM core
+#include "asim/syntax.h"
+#include "asim/trace.h"
+#include "asim/trace_buffer.h"
+#include "asim/threaded_log.h"
+
+using namespace std;
+
+__thread TRACE_BUFFER threadTraceBuffer = NULL;
+
+TRACE_BUFFER_CLASS::TRACE_BUFFER_CLASS()
+    : keyed(false),
+      keyTime(0),
+      keySeq(0),
+      keyIndex(0),
+      current(NULL)
+{
+}
+
+TRACE_BUFFER_CLASS::~TRACE_BUFFER_CLASS()
+{
+    delete current;
+}
+
+void
+TRACE_BUFFER_CLASS::Publish()
+{
+    chunks.Push(current);
+    current = NULL;
+}
+
+void
+TRACE_BUFFER_CLASS::ClearKey()
+{
+    if (current != NULL)
+    {
+        Publish();
+    }
+    keyed = false;
+}
+
+void
+TRACE_BUFFER_CLASS::Append(ostream *out, const string &record)
+{
+    if (current != NULL &&
+        (current->time != keyTime || current->seq != keySeq ||
+         current->index != keyIndex))
+    {
+        Publish();
+    }
+    if (current == NULL)
+    {
+        current = chunks.Alloc();
+        current->time = keyTime;
+        current->seq = keySeq;
+        current->index = keyIndex;
+        current->used = 0;
+    }
+
+    // keep the strings of a reused chunk, and their storage
+    if (current->used == current->records.size())
+    {
+        current->records.push_back(RECORD());
+    }
+    RECORD &r = current->records[current->used++];
+    r.out = out;
+    r.text = record;
+}
+
+TRACE_BUFFER_CLASS::CHUNK *
+TRACE_BUFFER_CLASS::Peek(UINT64 time)
+{
+    CHUNK *c = chunks.Front();
+    return (c == NULL || c->time > time) ? NULL : c;
+}
+
+void
+TRACE_BUFFER_CLASS::Merge(const vector<TRACE_BUFFER> &buffers, UINT64 time)
+{
+    for (;;)
+    {
+        TRACE_BUFFER min = NULL;
+        CHUNK *minChunk = NULL;
+        for (UINT32 i = 0; i < buffers.size(); i++)
+        {
+            CHUNK *c = buffers[i]->Peek(time);
+            if (c != NULL &&
+                (minChunk == NULL || c->time < minChunk->time ||
+                 (c->time == minChunk->time &&
+                  (c->seq < minChunk->seq ||
+                   (c->seq == minChunk->seq && c->index < minChunk->index)))))
+            {
+                min = buffers[i];
+                minChunk = c;
+            }
+        }
+        if (min == NULL)
+        {
+            return;
+        }
+
+        for (UINT32 i = 0; i < minChunk->used; i++)
+        {
+            const RECORD &r = minChunk->records[i];
+#if MAX_PTHREADS > 1
+            get_thread_safe_log(r.out).ts() << r.text << endl;
+#else
+            *r.out << r.text << endl;
+#endif
+        }
+        min->chunks.Pop();
+    }
+}
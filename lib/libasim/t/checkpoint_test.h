@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ *
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ * 
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright 
+ *   notice, this list of conditions and the following disclaimer in the 
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the Intel Corporation nor the names of its 
+ *   contributors may be used to endorse or promote products derived from 
+ *   this software without specific prior written permission.
+ *  
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __CHECKPOINT_TEST_H__
+#define __CHECKPOINT_TEST_H__
+
+#include <cxxtest/FTestSuite.h>
+
+#include <unistd.h>
+#include <vector>
+
+#define MAX_PTHREADS 1
+
+#include "asim/syntax.h"
+#include "asim/module.h"
+#include "asim/port.h"
+#include "asim/clockserver.h"
+#include "asim/smp.h"
+#include "asim/mm.h"
+#include "asim/mmptr.h"
+#include "asim/checkpoint.h"
+
+using namespace std;
+
+// a module to serve as the top of the module hierarchy
+class ASIM_SYSTEM_CLASS  : public ASIM_MODULE_CLASS {
+    ASIM_CLOCK_SERVER server;                // clock server
+public:
+    void Clock(UINT64 cycle) { }
+    ASIM_SYSTEM_CLASS(ASIM_CLOCK_SERVER cs)  // constructor registers for a clock callback
+    : ASIM_MODULE_CLASS(NULL, "system"), server(cs)
+    { RegisterClock("CLOCK"); }
+    void Run(UINT64 cycles)                  // run a number of clock cycles
+    { for (UINT64 i = 0; i < cycles; i++) server->Clock(); }
+} *asimSystem = NULL;
+
+// a module class with a single port of a templated class
+template <class PORTCLASS>
+class X_MODULE_CLASS : public ASIM_MODULE_CLASS {
+public:
+    PORTCLASS port;
+    X_MODULE_CLASS(ASIM_MODULE parent, const char *iname)
+      : ASIM_MODULE_CLASS(parent, iname) {}
+};
+
+// an MM object that can be restored from a checkpoint
+class CKPT_INT_CLASS : public ASIM_MM_CLASS<CKPT_INT_CLASS>
+{
+public:
+    UINT32 value;
+    CKPT_INT_CLASS() : value(0) {}
+    CKPT_INT_CLASS(UINT32 x) : value(x) {}
+    void SaveCheckpoint(ASIM_CHECKPOINT ckpt) const { ckpt->Save(value); }
+    void RestoreCheckpoint(ASIM_CHECKPOINT ckpt) { ckpt->Restore(value); }
+};
+typedef class mmptr<CKPT_INT_CLASS> CKPT_INT;
+ASIM_MM_DEFINE_CHECKPOINTABLE(CKPT_INT_CLASS, 64);
+
+// port latency
+static const int CKPT_PORT_LATENCY = 3;
+
+static const char *CKPT_FILE = "checkpoint_test.ckpt";
+
+//
+// A writer and a reader connected by a port of values and a port of MM
+// objects, and a stat counting the reads.  The reader can be built before
+// the writer, which changes the order of the ports in the model.
+//
+class CKPT_MODEL_CLASS : public ASIM_MODULE_CLASS
+{
+  public:
+    X_MODULE_CLASS< WritePort<UINT64> > *wv;
+    X_MODULE_CLASS< WritePort<CKPT_INT> > *wo;
+    X_MODULE_CLASS< ReadPort<UINT64> > *rv;
+    X_MODULE_CLASS< ReadPort<CKPT_INT> > *ro;
+    UINT64 reads;
+    vector<UINT64> log;     // everything read, in order
+
+    CKPT_MODEL_CLASS(ASIM_CLOCK_SERVER cs, bool readerFirst)
+      : ASIM_MODULE_CLASS(asimSystem, "model"), reads(0)
+    {
+        if (readerFirst)
+        {
+            NewReader();
+            NewWriter();
+        }
+        else
+        {
+            NewWriter();
+            NewReader();
+        }
+        RegisterState(&reads, "reads", "values read");
+        RegisterClock("CLOCK");
+        TS_ASSERT_THROWS_NOTHING(BasePort::ConnectAll());
+        TS_ASSERT_THROWS_NOTHING(cs->InitClockServer());
+    }
+
+    ~CKPT_MODEL_CLASS()
+    {
+        delete wv;
+        delete wo;
+        delete rv;
+        delete ro;
+    }
+
+    void NewWriter()
+    {
+        wv = new X_MODULE_CLASS< WritePort<UINT64> >(this, "wv");
+        wo = new X_MODULE_CLASS< WritePort<CKPT_INT> >(this, "wo");
+        TS_ASSERT(wv->port.InitConfig(wv, "ckpt_val", 1, CKPT_PORT_LATENCY));
+        TS_ASSERT(wo->port.InitConfig(wo, "ckpt_obj", 1, CKPT_PORT_LATENCY));
+    }
+
+    void NewReader()
+    {
+        rv = new X_MODULE_CLASS< ReadPort<UINT64> >(this, "rv");
+        ro = new X_MODULE_CLASS< ReadPort<CKPT_INT> >(this, "ro");
+        TS_ASSERT(rv->port.Init(rv, "ckpt_val"));
+        TS_ASSERT(ro->port.Init(ro, "ckpt_obj"));
+    }
+
+    void Clock(UINT64 cycle)
+    {
+        UINT64 v;
+        CKPT_INT o;
+        if (rv->port.Read(v, cycle))
+        {
+            log.push_back(v);
+            reads++;
+        }
+        if (ro->port.Read(o, cycle))
+        {
+            log.push_back(o->value);
+        }
+        TS_ASSERT(wv->port.Write(cycle + 100, cycle));
+        TS_ASSERT(wo->port.Write(new CKPT_INT_CLASS(cycle * 7), cycle));
+    }
+};
+
+class CheckpointTestSuite : public CxxTest::TestSuite
+{
+    ASIM_CLOCK_SERVER cs;  // the clock server
+    static bool first;     // the clock server is static, initialize it once
+public:
+    void setUp() {
+        cs = ASIM_CLOCKABLE_CLASS::GetClockServer();
+        if (first) {
+            first = false;
+            ASIM_SMP_CLASS::Init(1,1);
+            list<float> freqs; freqs.push_back(1.0);
+            cs->NewClockDomain("CLOCK", freqs);
+        }
+        asimSystem = new ASIM_SYSTEM_CLASS(cs);
+    }
+    void tearDown() {
+        cs->StopClockServer();
+        cs->UnregisterAll();
+        delete asimSystem;
+        unlink(CKPT_FILE);
+    }
+
+    // save in the middle of a run, restore on a model whose ports were
+    // built in the other order and check that it runs on the same way
+    void testSaveRestore() {
+        vector<UINT64> expected;
+        UINT64 expectedReads;
+        {
+            CKPT_MODEL_CLASS model(cs, false);
+            asimSystem->Run(10);
+            ASIM_CHECKPOINT_CLASS::SaveTimingState(CKPT_FILE, asimSystem);
+            UINT32 saved = model.log.size();
+            asimSystem->Run(10);
+            expected.assign(model.log.begin() + saved, model.log.end());
+            expectedReads = model.reads;
+        }
+        TS_ASSERT_EQUALS(expected.size(), (size_t) 20);
+
+        cs->StopClockServer();
+        cs->UnregisterAll();
+        delete asimSystem;
+        asimSystem = new ASIM_SYSTEM_CLASS(cs);
+
+        CKPT_MODEL_CLASS model(cs, true);
+        ASIM_CHECKPOINT_CLASS::RestoreTimingState(CKPT_FILE, asimSystem);
+        TS_ASSERT_EQUALS(model.reads, expectedReads - 10);
+        asimSystem->Run(10);
+        TS_ASSERT(model.log == expected);
+        TS_ASSERT_EQUALS(model.reads, expectedReads);
+    }
+};
+
+// first-time-through flag
+bool CheckpointTestSuite::first = true;
+
+#endif // __CHECKPOINT_TEST_H__
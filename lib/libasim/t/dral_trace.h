@@ -0,0 +1,271 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ *
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ * 
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright 
+ *   notice, this list of conditions and the following disclaimer in the 
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the Intel Corporation nor the names of its 
+ *   contributors may be used to endorse or promote products derived from 
+ *   this software without specific prior written permission.
+ *  
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __DRAL_TRACE_H__
+#define __DRAL_TRACE_H__
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "asim/dralClient.h"
+#include "asim/dralListener.h"
+
+using namespace std;
+
+
+// A dral listener that writes down the item, node and cycle events of a
+// trace as one string each, so the unit tests can compare decoded traces.
+// The graph and the descriptions are not recorded.  With renameItems the
+// items are numbered in the order they show up, so traces that only
+// differ in the item ids compare equal.
+class DRAL_TRACE_LISTENER_CLASS : public DRAL_LISTENER_CLASS {
+public:
+    vector<string> events;
+    UINT32 errors;
+
+    DRAL_TRACE_LISTENER_CLASS(bool renameItems = false)
+      : errors(0),
+        rename(renameItems)
+    {}
+
+    // Decode a whole trace file into events.  Returns false if the file
+    // cannot be opened or the client reported errors.
+    bool Read(const char *fileName)
+    {
+        int fd = open(fileName, O_RDONLY);
+        if (fd == -1)
+        {
+            return false;
+        }
+        bool ok = Read(fd);
+        close(fd);
+        return ok;
+    }
+
+    // Same, from an open file descriptor (that is not closed).
+    bool Read(int fd)
+    {
+        DRAL_CLIENT_CLASS client(fd, this, 4096);
+        while (client.ProcessNextEvent(true, 1000) > 0)
+            ;
+        return errors == 0;
+    }
+
+    void Cycle (UINT64 cycle) { Add("Cycle %llu", cycle); }
+    void Cycle (UINT16 clockId, UINT64 cycle, UINT16 phase)
+    {
+        Add("Cycle %llu", cycle, clockId, phase);
+    }
+    void NewItem (UINT32 item_id) { Add("NewItem %llu", Item(item_id)); }
+    void DeleteItem (UINT32 item_id) { Add("DeleteItem %llu", Item(item_id)); }
+    void MoveItems (UINT16 edge_id, UINT32 numOfItems, UINT32 * items)
+    {
+        Add("MoveItems %llu", edge_id, Items(items, numOfItems), numOfItems);
+    }
+    void MoveItemsWithPositions (
+        UINT16 edge_id, UINT32 numOfItems,
+        UINT32 * items, UINT32 * positions)
+    {
+        Add("MoveItems %llu", edge_id, Items(items, numOfItems), numOfItems);
+        Add("  at", 0, positions, numOfItems);
+    }
+    void EnterNode (
+        UINT16 node_id, UINT32 item_id, UINT16 dim, UINT32 position [])
+    {
+        Add("EnterNode %llu", node_id, Item(item_id));
+        Add("  at", 0, position, dim);
+    }
+    void ExitNode (
+        UINT16 node_id, UINT32 item_id, UINT16 dim, UINT32 position [])
+    {
+        Add("ExitNode %llu", node_id, Item(item_id));
+        Add("  at", 0, position, dim);
+    }
+    void SetItemTag(UINT32 item_id, UINT32 tag_idx, UINT64 value)
+    {
+        Add(("SetItemTag %llu " + tags[tag_idx]).c_str(), Item(item_id), value);
+    }
+    void SetItemTagString(UINT32 item_id, UINT32 tag_idx, UINT32 str_idx)
+    {
+        Add(("SetItemTag %llu " + tags[tag_idx] + " " + strings[str_idx]).c_str(),
+            Item(item_id));
+    }
+    void SetItemTagSet(
+        UINT32 item_id, UINT32 tag_idx, UINT32 nval, UINT64 set [])
+    {
+        Add(("SetItemTag %llu " + tags[tag_idx]).c_str(), Item(item_id));
+        for (UINT32 i = 0; i < nval; i++)
+        {
+            Add("  value %llu", set[i]);
+        }
+    }
+    void NewTag (UINT32 tag_idx, const char * tag_name, INT32 tag_name_len)
+    {
+        tags[tag_idx] = string(tag_name);
+    }
+    void NewString (UINT32 string_idx, const char * str, INT32 str_len)
+    {
+        strings[string_idx] = string(str);
+    }
+    void Error (const char * error) { errors++; Add(error, 0); }
+    void NonCriticalError (const char * error) { errors++; Add(error, 0); }
+
+    void EndSimulation (void) {}
+    void Version (UINT16 version) {}
+    void NewNode (
+        UINT16 node_id, const char * node_name,UINT16 parent_id, UINT16 instance) {}
+    void NewEdge (
+        UINT16 sourceNode, UINT16 destNode, UINT16 edge_id,
+        UINT32 bandwidth, UINT32 latency, const char * name) {}
+    void SetNodeLayout (
+        UINT16 node_id, UINT32 capacity, UINT16 dim, UINT32 capacities []) {}
+    void SetCycleTag(UINT32 tag_idx, UINT64 value) {}
+    void SetCycleTagString(UINT32 tag_idx, UINT32 str_idx) {}
+    void SetCycleTagSet(UINT32 tag_idx, UINT32 nval, UINT64 set []) {}
+    void SetNodeTag(
+        UINT16 node_id, UINT32 tag_idx, UINT64 value,
+        UINT16 level, UINT32 list []) {}
+    void SetNodeTagString(
+        UINT16 node_id, UINT32 tag_idx, UINT32 str_idx,
+        UINT16 level, UINT32 list []) {}
+    void SetNodeTagSet(
+        UINT16 node_id, UINT32 tag_idx, UINT16 n, UINT64 set [],
+        UINT16 level, UINT32 list []) {}
+    void Comment (UINT32 magic_num, const char * cont) {}
+    void CommentBin (UINT16 magic_num, const char * cont, UINT32 length) {}
+    void SetNodeInputBandwidth(UINT16 node_id, UINT32 bandwidth) {}
+    void SetNodeOutputBandwidth(UINT16 node_id, UINT32 bandwidth) {}
+    void StartActivity (UINT64 start_activity_cycle) {}
+    void SetTagDescription (UINT32 tag_idx, const char description []) {}
+    void SetNodeClock (UINT16 nodeId, UINT16 clockId) {}
+    void NewClock (
+        UINT16 clockId, UINT64 freq, UINT16 skew,
+        UINT16 divisions, const char name []) {}
+
+    // dral 1.0 only commands, never written by the current server
+    void SetTagSingleValue (
+        UINT32 item_id, UINT32 tag_idx,
+        UINT64 value, UBYTE time_span_flags) {}
+    void SetTagString (
+        UINT32 item_id, UINT32 tag_idx,
+        UINT32 str_idx, UBYTE time_span_flags) {}
+    void SetTagSet (
+        UINT32 item_id, UINT32 tag_idx, UINT32 set_size,
+        UINT64 * set, UBYTE time_span_flags) {}
+    void EnterNode (UINT16 node_id, UINT32 item_id, UINT32 slot) {}
+    void ExitNode (UINT16 node_id, UINT32 slot) {}
+    void SetCapacity (
+        UINT16 node_id, UINT32 capacity,
+        UINT32 capacities [], UINT16 dimensions) {}
+    void SetHighWaterMark (UINT16 node_id, UINT32 mark) {}
+    void Comment (const char * comment) {}
+    void AddNode (
+        UINT16 node_id, const char * node_name,UINT16 parent_id, UINT16 instance) {}
+    void AddEdge (
+        UINT16 sourceNode, UINT16 destNode, UINT16 edge_id,
+        UINT32 bandwidth, UINT32 latency, const char * name) {}
+
+private:
+    map<UINT32, string> tags;
+    map<UINT32, string> strings;
+    bool rename;
+    map<UINT32, UINT32> itemNames;
+    vector<UINT32> itemList;
+
+    UINT32 Item(UINT32 item_id)
+    {
+        if (!rename)
+        {
+            return item_id;
+        }
+        map<UINT32, UINT32>::iterator it = itemNames.find(item_id);
+        if (it == itemNames.end())
+        {
+            it = itemNames.insert(make_pair(item_id, itemNames.size() + 1)).first;
+        }
+        return it->second;
+    }
+
+    UINT32 *Items(UINT32 *items, UINT32 n)
+    {
+        itemList.resize(n);
+        for (UINT32 i = 0; i < n; i++)
+        {
+            itemList[i] = Item(items[i]);
+        }
+        return (n == 0 ? items : &itemList[0]);
+    }
+
+    // Formats the event with its first value and appends the rest.
+    void Add(const char *format, UINT64 value)
+    {
+        char buf[32];
+        string event(format);
+        size_t at = event.find("%llu");
+        if (at != string::npos)
+        {
+            snprintf(buf, sizeof(buf), "%llu", (unsigned long long)value);
+            event.replace(at, 4, buf);
+        }
+        events.push_back(event);
+    }
+
+    void Add(const char *format, UINT64 value, UINT64 more)
+    {
+        Add(format, value);
+        char buf[32];
+        snprintf(buf, sizeof(buf), " %llu", (unsigned long long)more);
+        events.back() += buf;
+    }
+
+    void Add(const char *format, UINT64 value, UINT64 more, UINT64 last)
+    {
+        Add(format, value, more);
+        char buf[32];
+        snprintf(buf, sizeof(buf), " %llu", (unsigned long long)last);
+        events.back() += buf;
+    }
+
+    void Add(const char *format, UINT64 value, UINT32 *list, UINT32 n)
+    {
+        Add(format, value);
+        for (UINT32 i = 0; i < n; i++)
+        {
+            char buf[32];
+            snprintf(buf, sizeof(buf), " %u", list[i]);
+            events.back() += buf;
+        }
+    }
+};
+
+#endif // __DRAL_TRACE_H__
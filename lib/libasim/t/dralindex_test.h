@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ *
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ * 
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright 
+ *   notice, this list of conditions and the following disclaimer in the 
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the Intel Corporation nor the names of its 
+ *   contributors may be used to endorse or promote products derived from 
+ *   this software without specific prior written permission.
+ *  
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __DRALINDEX_TEST_H__
+#define __DRALINDEX_TEST_H__
+
+#include <cxxtest/FTestSuite.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <algorithm>
+
+#include "asim/syntax.h"
+#include "asim/dralServer.h"
+#include "asim/dralClient.h"
+
+#include "dral_trace.h"
+
+using namespace std;
+
+
+class DralIndexTestSuite : public CxxTest::TestSuite
+{
+    static const UINT64 BLOCK_CYCLES = 100;
+    static const UINT64 CYCLES = 1000;
+
+    // Write a trace split in blocks of BLOCK_CYCLES cycles, one item per
+    // cycle. Some tags and strings are first used in late blocks, so a
+    // client that seeks there must still know them.
+    void Generate(const char *name, bool compressed)
+    {
+        DRAL_SERVER_CLASS server(name, 4096, false, compressed, false);
+        server.SetBlockCycles(BLOCK_CYCLES);
+        UINT16 a = server.NewNode("a", 0);
+        UINT16 b = server.NewNode("b", 0);
+        UINT16 edge = server.NewEdge(a, b, 1, 1, "e");
+        server.TurnOn();
+        for (UINT64 cycle = 0; cycle < CYCLES; cycle++)
+        {
+            server.Cycle(cycle);
+            UINT32 item = server.NewItem();
+            server.MoveItems(edge, 1, &item);
+            server.SetItemTag(item, "val", cycle * 3);
+            char str[32];
+            sprintf(str, "s%llu", (unsigned long long)(cycle % (cycle < CYCLES / 2 ? 7 : 13)));
+            server.SetItemTag(item, "str", str);
+            if (cycle >= CYCLES / 4)
+            {
+                server.SetItemTag(item, "late", cycle);
+            }
+            if (cycle > 3)
+            {
+                server.DeleteItem(item - 3);
+            }
+        }
+    }
+
+    // The events of the full trace from the beginning of 'cycle' on.
+    static vector<string>::const_iterator
+    From(const vector<string> &events, UINT64 cycle)
+    {
+        char name[32];
+        sprintf(name, "Cycle %llu", (unsigned long long)cycle);
+        return find(events.begin(), events.end(), string(name));
+    }
+
+    struct RANGE
+    {
+        const char *file;
+        UINT32 first;   // first block decoded
+        UINT32 end;     // first block not decoded
+        DRAL_TRACE_LISTENER_CLASS listener;
+        bool ok;
+    };
+
+    // Decode the blocks [first, end) of a trace with a client of its own.
+    static void *DecodeRange(void *arg)
+    {
+        RANGE *range = (RANGE *)arg;
+        range->ok = false;
+        int fd = open(range->file, O_RDONLY);
+        if (fd == -1)
+        {
+            return NULL;
+        }
+        {
+            DRAL_CLIENT_CLASS client(fd, &range->listener, 4096);
+            UINT32 blocks = client.GetNumBlocks();
+            if (range->first < blocks && client.SeekToBlock(range->first))
+            {
+                // the events before the first block are not in any range
+                range->listener.events.clear();
+                UINT64 endCycle = (range->end < blocks ?
+                                   client.GetBlockCycle(range->end) : (UINT64)-1);
+                vector<string> &events = range->listener.events;
+                unsigned long long cycle;
+                while (client.ProcessNextEvent(true, 1) > 0)
+                {
+                    if (!events.empty() &&
+                        sscanf(events.back().c_str(), "Cycle %llu", &cycle) == 1 &&
+                        cycle >= endCycle)
+                    {
+                        events.pop_back();
+                        break;
+                    }
+                }
+                range->ok = (range->listener.errors == 0);
+            }
+        }
+        close(fd);
+        return NULL;
+    }
+
+    void Run(bool compressed)
+    {
+        Generate("dralindex", compressed);
+        const char *file = "dralindex.drl.gz";
+        DRAL_TRACE_LISTENER_CLASS all;
+        TS_ASSERT(all.Read(file));
+
+        // the index has one block per BLOCK_CYCLES cycles
+        DRAL_TRACE_LISTENER_CLASS seeked;
+        int fd = open(file, O_RDONLY);
+        TS_ASSERT(fd != -1);
+        {
+            DRAL_CLIENT_CLASS client(fd, &seeked, 4096);
+            TS_ASSERT_EQUALS(client.GetNumBlocks(), (UINT32)(CYCLES / BLOCK_CYCLES));
+            for (UINT32 i = 0; i < client.GetNumBlocks(); i++)
+            {
+                TS_ASSERT_EQUALS(client.GetBlockCycle(i), i * BLOCK_CYCLES);
+            }
+
+            // a seek to the middle of a block starts at the block
+            UINT64 cycle = CYCLES / 2 + BLOCK_CYCLES + BLOCK_CYCLES / 2;
+            TS_ASSERT(client.SeekToCycle(cycle));
+            seeked.events.clear();
+            while (client.ProcessNextEvent(true, 1000) > 0)
+                ;
+        }
+        close(fd);
+        TS_ASSERT_EQUALS(seeked.errors, 0u);
+        UINT64 blockCycle = CYCLES / 2 + BLOCK_CYCLES;
+        vector<string>::const_iterator from = From(all.events, blockCycle);
+        TS_ASSERT(!seeked.events.empty() && from != all.events.end());
+        if (!seeked.events.empty() && from != all.events.end())
+        {
+            TS_ASSERT_EQUALS(seeked.events[0], *from);
+            TS_ASSERT_EQUALS(seeked.events.size(), (size_t)(all.events.end() - from));
+            TS_ASSERT(equal(from, (vector<string>::const_iterator)all.events.end(),
+                            seeked.events.begin()));
+        }
+
+        // two threads decode disjoint ranges of blocks, that together
+        // are the whole trace
+        UINT32 blocks = CYCLES / BLOCK_CYCLES;
+        RANGE ranges[2];
+        ranges[0].file = ranges[1].file = file;
+        ranges[0].first = 0;
+        ranges[0].end = ranges[1].first = blocks / 2 - 1;
+        ranges[1].end = blocks;
+        pthread_t tid[2];
+        for (int i = 0; i < 2; i++)
+        {
+            pthread_create(&tid[i], NULL, DecodeRange, &ranges[i]);
+        }
+        for (int i = 0; i < 2; i++)
+        {
+            pthread_join(tid[i], NULL);
+            TS_ASSERT(ranges[i].ok);
+        }
+        vector<string> joined(ranges[0].listener.events);
+        joined.insert(joined.end(), ranges[1].listener.events.begin(),
+                      ranges[1].listener.events.end());
+        from = From(all.events, 0);
+        TS_ASSERT(from != all.events.end());
+        TS_ASSERT_EQUALS(joined.size(), (size_t)(all.events.end() - from));
+        if (joined.size() == (size_t)(all.events.end() - from))
+        {
+            TS_ASSERT(equal(from, (vector<string>::const_iterator)all.events.end(),
+                            joined.begin()));
+            TS_ASSERT_EQUALS(ranges[1].listener.events[0],
+                             *From(all.events, ranges[1].first * BLOCK_CYCLES));
+        }
+    }
+
+public:
+    void testSeekUncompressed()
+    {
+        Run(false);
+    }
+
+    void testSeekCompressed()
+    {
+        Run(true);
+    }
+};
+
+#endif // __DRALINDEX_TEST_H__
@@ -0,0 +1,345 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ *
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ * 
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright 
+ *   notice, this list of conditions and the following disclaimer in the 
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the Intel Corporation nor the names of its 
+ *   contributors may be used to endorse or promote products derived from 
+ *   this software without specific prior written permission.
+ *  
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __DRALREAD_TEST_H__
+#define __DRALREAD_TEST_H__
+
+#include <cxxtest/FTestSuite.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <zlib.h>
+#include <string>
+#include <vector>
+
+#include "asim/syntax.h"
+#include "asim/dralServer.h"
+#include "asim/dralRead.h"
+
+#include "dral_trace.h"
+
+using namespace std;
+
+
+class DralReadTestSuite : public CxxTest::TestSuite
+{
+    // Write a trace of 'cycles' cycles, one item per cycle.
+    void Generate(const char *name, bool compressed, UINT64 cycles)
+    {
+        DRAL_SERVER_CLASS server(name, 4096, false, compressed, false);
+        UINT16 a = server.NewNode("a", 0);
+        UINT16 b = server.NewNode("b", 0);
+        UINT16 edge = server.NewEdge(a, b, 1, 1, "e");
+        server.TurnOn();
+        for (UINT64 cycle = 0; cycle < cycles; cycle++)
+        {
+            server.Cycle(cycle);
+            UINT32 item = server.NewItem();
+            server.MoveItems(edge, 1, &item);
+            server.SetItemTag(item, "val", cycle * 0x10001);
+            char str[32];
+            sprintf(str, "s%llu", (unsigned long long)(cycle % 13));
+            server.SetItemTag(item, "str", str);
+            if (cycle > 3)
+            {
+                server.DeleteItem(item - 3);
+            }
+        }
+    }
+
+    string Contents(const char *file)
+    {
+        string data;
+        FILE *f = fopen(file, "rb");
+        TS_ASSERT(f != NULL);
+        if (f != NULL)
+        {
+            char buf[4096];
+            size_t n;
+            while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+            {
+                data.append(buf, n);
+            }
+            fclose(f);
+        }
+        return data;
+    }
+
+    void WriteFile(const char *file, const string &data, const char *mode = "wb")
+    {
+        FILE *f = fopen(file, mode);
+        TS_ASSERT(f != NULL);
+        if (f != NULL)
+        {
+            TS_ASSERT_EQUALS(fwrite(data.data(), 1, data.size(), f), data.size());
+            fclose(f);
+        }
+    }
+
+    struct PIPE_WRITER
+    {
+        int fd;
+        string data;
+    };
+
+    static void *PipeWriter(void *arg)
+    {
+        PIPE_WRITER *w = (PIPE_WRITER *)arg;
+        size_t done = 0;
+        while (done < w->data.size())
+        {
+            ssize_t n = write(w->fd, w->data.data() + done, w->data.size() - done);
+            if (n <= 0)
+            {
+                break;
+            }
+            done += n;
+        }
+        close(w->fd);
+        return NULL;
+    }
+
+    // Decode the trace through a pipe: it is neither mapped nor read
+    // ahead, so it gives the events to compare with.
+    void ReadPipe(const char *file, DRAL_TRACE_LISTENER_CLASS &listener)
+    {
+        int fds[2];
+        TS_ASSERT_EQUALS(pipe(fds), 0);
+        PIPE_WRITER writer;
+        writer.fd = fds[1];
+        writer.data = Contents(file);
+        pthread_t tid;
+        pthread_create(&tid, NULL, PipeWriter, &writer);
+        TS_ASSERT(listener.Read(fds[0]));
+        pthread_join(tid, NULL);
+        close(fds[0]);
+    }
+
+    void CheckSameEvents(const char *file)
+    {
+        DRAL_TRACE_LISTENER_CLASS piped, read;
+        ReadPipe(file, piped);
+        TS_ASSERT(read.Read(file));
+        TS_ASSERT(piped.events.size() > 1000);
+        TS_ASSERT(read.events == piped.events);
+    }
+
+    // The decoded events of a truncated trace are a prefix of the whole
+    // trace and the truncation is reported.
+    void CheckTruncated(const char *file, size_t size)
+    {
+        DRAL_TRACE_LISTENER_CLASS all, cut;
+        TS_ASSERT(all.Read(file));
+        WriteFile("dralread_cut.drl.gz", Contents(file).substr(0, size));
+        TS_ASSERT(!cut.Read("dralread_cut.drl.gz"));
+        TS_ASSERT(cut.errors > 0);
+        TS_ASSERT(cut.events.size() > cut.errors);
+        size_t decoded = cut.events.size() - cut.errors;
+        TS_ASSERT(decoded < all.events.size());
+        if (decoded < all.events.size())
+        {
+            TS_ASSERT(equal(all.events.begin(), all.events.begin() + decoded,
+                            cut.events.begin()));
+        }
+    }
+
+    // Read a file in chunks of 'n' bytes through a DRAL_BUFFERED_READ_CLASS.
+    // Returns the bytes read up to the first short read.
+    size_t ReadBytes(const char *file, UINT32 n, DRAL_TRACE_LISTENER_CLASS &listener)
+    {
+        int fd = open(file, O_RDONLY);
+        TS_ASSERT(fd != -1);
+        size_t total = 0;
+        {
+            DRAL_BUFFERED_READ_CLASS reader(fd, &listener, 64);
+            INT64 r = n;
+            while (r == (INT64)n)
+            {
+                TS_ASSERT(reader.Read(n, &r) != NULL || r == 0);
+                if (r == (INT64)n)
+                {
+                    total += n;
+                }
+            }
+            TS_ASSERT_EQUALS(r, 0);
+        }
+        close(fd);
+        return total;
+    }
+
+    void WriteGzip(const char *file, const string &data)
+    {
+        gzFile gz = gzopen(file, "wb");
+        TS_ASSERT(gz != NULL);
+        TS_ASSERT_EQUALS(gzwrite(gz, data.data(), data.size()), (int)data.size());
+        gzclose(gz);
+    }
+
+    // The first offset from 'from' where a copy of the trace cut there
+    // ends in the middle of an event (it reports an error) or, if not
+    // midEvent, right after one.
+    size_t FindCut(const string &data, size_t from, bool midEvent)
+    {
+        for (size_t cut = from; cut < data.size(); cut++)
+        {
+            DRAL_TRACE_LISTENER_CLASS listener;
+            WriteFile("dralread_cut.drl.gz", data.substr(0, cut));
+            listener.Read("dralread_cut.drl.gz");
+            if ((listener.errors > 0) == midEvent)
+            {
+                return cut;
+            }
+        }
+        TS_FAIL("no cut found");
+        return from;
+    }
+
+    struct FILE_WRITER
+    {
+        const char *file;
+        string data;
+        vector<size_t> cuts;
+    };
+
+    // Append the data to the file in pieces ending at each of the cuts,
+    // giving the reader time to catch up with every piece.
+    static void *FileWriter(void *arg)
+    {
+        FILE_WRITER *w = (FILE_WRITER *)arg;
+        size_t done = 0;
+        for (size_t i = 0; i <= w->cuts.size(); i++)
+        {
+            size_t end = i < w->cuts.size() ? w->cuts[i] : w->data.size();
+            usleep(50000);
+            FILE *f = fopen(w->file, "ab");
+            fwrite(w->data.data() + done, 1, end - done, f);
+            fclose(f);
+            done = end;
+        }
+        return NULL;
+    }
+
+public:
+    // Uncompressed traces are mapped in memory.
+    void testMapped()
+    {
+        Generate("dralread_plain", false, 2000);
+        CheckSameEvents("dralread_plain.drl.gz");
+
+        // a mapped file has all of its unread bytes available
+        string data = Contents("dralread_plain.drl.gz");
+        DRAL_TRACE_LISTENER_CLASS listener;
+        int fd = open("dralread_plain.drl.gz", O_RDONLY);
+        {
+            DRAL_BUFFERED_READ_CLASS reader(fd, &listener, 4096);
+            INT64 r;
+            reader.Read(8, &r);
+            TS_ASSERT_EQUALS(r, 8);
+            TS_ASSERT_EQUALS(reader.AvailableBytes(), data.size() - 8);
+        }
+        close(fd);
+    }
+
+    // Compressed regular files are inflated by the read-ahead thread, in
+    // chunks of 1 MB.
+    void testReadAhead()
+    {
+        Generate("dralread_gz", true, 200000);
+        CheckSameEvents("dralread_gz.drl.gz");
+    }
+
+    // A file that ends in the middle of the bytes asked for is an error,
+    // one that ends right after them is a clean end of file.
+    void testTruncated()
+    {
+        string data(100, 'x');
+        const char *file = "dralread_raw";
+        for (int compressed = 0; compressed < 2; compressed++)
+        {
+            if (compressed)
+            {
+                WriteGzip(file, data);
+            }
+            else
+            {
+                WriteFile(file, data);
+            }
+            DRAL_TRACE_LISTENER_CLASS exact;
+            TS_ASSERT_EQUALS(ReadBytes(file, 10, exact), 100u);
+            TS_ASSERT_EQUALS(exact.errors, 0u);
+            DRAL_TRACE_LISTENER_CLASS cut;
+            TS_ASSERT_EQUALS(ReadBytes(file, 8, cut), 96u);
+            TS_ASSERT_EQUALS(cut.errors, 1u);
+        }
+
+        Generate("dralread_plain", false, 2000);
+        CheckTruncated("dralread_plain.drl.gz",
+                       Contents("dralread_plain.drl.gz").size() - 1);
+        Generate("dralread_gz", true, 2000);
+        CheckTruncated("dralread_gz.drl.gz",
+                       Contents("dralread_gz.drl.gz").size() / 2);
+    }
+
+    // A mapped trace that is still being written is followed, also when
+    // the reader catches up with the writer in the middle of an event.
+    void testFollow()
+    {
+        Generate("dralread_plain", false, 2000);
+        string data = Contents("dralread_plain.drl.gz");
+        DRAL_TRACE_LISTENER_CLASS all, followed;
+        TS_ASSERT(all.Read("dralread_plain.drl.gz"));
+
+        // the reader reaches the writer in the middle of an event, then
+        // in the middle of another one once the file has grown, and then
+        // right after an event
+        FILE_WRITER writer;
+        writer.file = "dralread_follow.drl.gz";
+        size_t first = FindCut(data, data.size() / 4, true);
+        writer.data = data.substr(first);
+        writer.cuts.push_back(FindCut(data, data.size() / 2, true) - first);
+        writer.cuts.push_back(FindCut(data, data.size() / 4 * 3, false) - first);
+        WriteFile(writer.file, data.substr(0, first));
+
+        int fd = open(writer.file, O_RDONLY);
+        pthread_t tid;
+        pthread_create(&tid, NULL, FileWriter, &writer);
+        {
+            DRAL_CLIENT_CLASS client(fd, &followed, 4096);
+            while (client.ProcessNextEvent(true, 1000) > 0)
+                ;
+        }
+        pthread_join(tid, NULL);
+        close(fd);
+        TS_ASSERT_EQUALS(followed.errors, 0u);
+        TS_ASSERT(followed.events == all.events);
+    }
+};
+
+#endif // __DRALREAD_TEST_H__
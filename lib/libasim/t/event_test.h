@@ -32,6 +32,8 @@
 #define __EVENTTEST_H__
 
 #include <cxxtest/FTestSuite.h>
+#include <sstream>
+#include <algorithm>
 
 // HACK ALERT! normally these would be asim static parameters or compiler -D flags:
 #define MAX_PTHREADS       1
@@ -46,6 +48,8 @@
 #include "asim/item.h"
 #include "asim/event.h"
 
+#include "dral_trace.h"
+
 using namespace std;
 
 //
@@ -590,8 +594,190 @@ public:
         TS_ASSERT_EQUALS(reader2.success, true);
         EndEvents();
     }
-      
-    
+
+    // Items take their ids when they are built, but only send NewItem when
+    // the id is first used. Assigning an item hands its id over.
+    void testItemIds() {
+        StartEvents("testItemIds");
+        A_NORMAL_ITEM_CLASS a(1), b(2);
+        UINT32 next = DRALEVENT(AllocItemId());
+        TS_ASSERT_DIFFERS(a.GetItemId(), (UINT64)0);
+        TS_ASSERT_DIFFERS(a.GetItemId(), b.GetItemId());
+        TS_ASSERT_EQUALS(DRALEVENT(AllocItemId()), next + 1);
+        UINT64 id = b.GetItemId();
+        A_NORMAL_ITEM_CLASS c;
+        c.ASIM_ITEM_CLASS::operator=(b);
+        TS_ASSERT_EQUALS(c.GetItemId(), id);
+        TS_ASSERT_EQUALS(b.GetItemId(), (UINT64)0);
+        EndEvents();
+    }
+
+    // Port moves are queued and sent when the next cycle starts, so in the
+    // trace they follow the node and tag events of the cycle they were
+    // written in, whatever the order of the calls.  Nodes taking the item
+    // by value must not announce a copy of it.
+    void testMoveOrder() {
+        StartEvents("testMoveOrder");
+        NewClockDomain("clkM");
+        class Runner : public ASIM_MODULE_CLASS {
+          public:
+                        A_NORMAL_ITEM_CLASS item;    // item moved through the edge
+                        UINT16              edge;    // edge from the runner to the system
+            Runner(ASIM_CLOCK_SERVER cs) : ASIM_MODULE_CLASS(asimSystem, "runner"),
+                        item(1)
+            {
+                        SetNodeLayout(1);
+                        edge = DRALEVENT(NewEdge(GetUniqueId(), asimSystem->GetUniqueId(),
+                                                 1, 1, "runner_out"));
+                        RegisterClock("clkM");
+                        TS_ASSERT_THROWS_NOTHING(cs->InitClockServer());
+            }
+            void Clock(UINT64 cycle) {
+                if (cycle == 0) {
+                        EnterNode((const ASIM_ITEM_CLASS &)item, 0);
+                        // what a port write of the item does
+                        item.EnsureAnnounced();
+                        DRALEVENT(QueueMoveItem(edge, item.GetItemId()));
+                        item.SetItemTag("tag", UINT64(7));
+                }
+            }
+        } runner(cs);
+        asimSystem->RunUntil(2);
+        UINT64 id = runner.item.GetItemId();
+        UINT16 node = runner.GetUniqueId();
+        UINT16 edge = runner.edge;
+        EndEvents();
+        delete ASIM_DRAL_EVENT_CLASS::event;
+        ASIM_DRAL_EVENT_CLASS::event = NULL;
+
+        DRAL_TRACE_LISTENER_CLASS trace;
+        TS_ASSERT(trace.Read("testMoveOrder.drl.gz"));
+        ostringstream newItem, deleteItem, enter, tag, move;
+        newItem << "NewItem " << id;
+        deleteItem << "DeleteItem " << id;
+        enter << "EnterNode " << node << " " << id;
+        tag << "SetItemTag " << id << " tag 7";
+        move << "MoveItems " << edge << " " << id;
+        vector<string>::iterator begin = trace.events.begin();
+        vector<string>::iterator end = trace.events.end();
+        TS_ASSERT_EQUALS(count(begin, end, newItem.str()), 1);
+        TS_ASSERT_EQUALS(count(begin, end, move.str()), 1);
+        TS_ASSERT(find(begin, end, newItem.str()) < find(begin, end, enter.str()));
+        TS_ASSERT(find(begin, end, enter.str()) < find(begin, end, tag.str()));
+        TS_ASSERT(find(begin, end, tag.str()) < find(begin, end, move.str()));
+        TS_ASSERT(find(begin, end, move.str()) < find(begin, end, "Cycle 1 0 0"));
+        TS_ASSERT(find(begin, end, move.str()) < find(begin, end, deleteItem.str()));
+    }
+
+    // Send the same events either one by one (batch == NULL) or recorded
+    // in a batch and committed: before the server is turned on (dropped
+    // or, if persistent, remembered), with new tag names, with more than
+    // 31 items moved through an edge in a cycle and entering an auto-flush
+    // node (the batch is replayed as single events then).
+    static void BatchTrace(const char *name, DRAL_EVENT_BATCH batch) {
+        DRAL_SERVER_CLASS server(name, 4096, false, false, false);
+        UINT16 a = server.NewNode("a", 0);
+        UINT16 b = server.NewNode("b", 0);
+        UINT16 f = server.NewNode("f", 0, 0, true, true);
+        server.SetNodeLayout(a, 64);
+        server.SetNodeLayout(f, 64);
+        UINT16 e = server.NewEdge(a, b, 64, 1, "e");
+        UINT32 items[40], positions[40], slot;
+        for (UINT32 i = 0; i < 40; i++) {
+            items[i] = server.NewItem(true);
+            positions[i] = 39 - i;
+        }
+        for (int off = 0; off < 2; off++) {
+            bool persistent = (off == 0);
+            slot = off;
+            if (batch) {
+                batch->MoveItems(e, 3, items, positions);
+                batch->EnterNode(a, items[off], 1, &slot);
+                batch->SetItemTag(items[off], persistent ? "kept" : "lost", UINT64(off));
+                server.Commit(batch, persistent);
+            } else {
+                server.MoveItems(e, 3, items, positions, persistent);
+                server.EnterNode(a, items[off], 1, &slot, persistent);
+                server.SetItemTag(items[off], persistent ? "kept" : "lost", UINT64(off), persistent);
+            }
+        }
+        server.TurnOn();
+        char tags[8][8];
+        for (UINT64 cycle = 0; cycle < 40; cycle++) {
+            server.Cycle(cycle);
+            // a new tag name every few cycles, some of them first used by
+            // a single event between the batches
+            sprintf(tags[cycle % 8], "t%llu", (unsigned long long)cycle / 5);
+            if (cycle % 5 == 3) {
+                server.SetItemTag(items[cycle], tags[cycle % 8], cycle);
+            }
+            UINT32 n = (cycle % 2 ? 40 : 9);
+            UINT64 big = (UINT64(1) << (cycle % 64)) + cycle;
+            if (batch) {
+                for (UINT32 first = 0; first < n; first += 31) {
+                    UINT32 m = (n - first < 31 ? n - first : 31);
+                    batch->MoveItems(e, m, items + first, cycle % 3 ? NULL : positions + first);
+                }
+                slot = cycle % 64;
+                batch->EnterNode(a, items[39 - cycle], 1, &slot);
+                if (cycle >= 30) {
+                    batch->EnterNode(f, items[cycle], slot);
+                }
+                batch->SetItemTag(items[cycle], tags[cycle % 8], big);
+                batch->SetItemTag(items[39 - cycle], "val", cycle);
+                server.Commit(batch);
+            } else {
+                for (UINT32 first = 0; first < n; first += 31) {
+                    UINT32 m = (n - first < 31 ? n - first : 31);
+                    server.MoveItems(e, m, items + first, cycle % 3 ? NULL : positions + first);
+                }
+                slot = cycle % 64;
+                server.EnterNode(a, items[39 - cycle], 1, &slot);
+                if (cycle >= 30) {
+                    server.EnterNode(f, items[cycle], slot);
+                }
+                server.SetItemTag(items[cycle], tags[cycle % 8], big);
+                server.SetItemTag(items[39 - cycle], "val", cycle);
+            }
+        }
+        TS_ASSERT(batch == NULL || batch->Empty());
+    }
+
+    static string FileContents(const char *name) {
+        string data;
+        FILE *file = fopen(name, "rb");
+        TS_ASSERT(file != NULL);
+        if (file) {
+            char buf[4096];
+            size_t n;
+            while ((n = fread(buf, 1, sizeof(buf), file)) > 0) {
+                data.append(buf, n);
+            }
+            fclose(file);
+        }
+        return data;
+    }
+
+    // Committing a batch writes the same bytes as the single events.
+    void testBatchCommit() {
+        DRAL_EVENT_BATCH_CLASS batch;
+        BatchTrace("testBatchSingle", NULL);
+        BatchTrace("testBatchCommit", &batch);
+        string single = FileContents("testBatchSingle.drl.gz");
+        string committed = FileContents("testBatchCommit.drl.gz");
+        TS_ASSERT(single.size() > 1000);
+        TS_ASSERT_EQUALS(committed.size(), single.size());
+        TS_ASSERT(committed == single);
+
+        DRAL_TRACE_LISTENER_CLASS trace;
+        TS_ASSERT(trace.Read("testBatchCommit.drl.gz"));
+        vector<string>::iterator begin = trace.events.begin();
+        vector<string>::iterator end = trace.events.end();
+        TS_ASSERT(find(begin, end, "SetItemTag 1 kept 0") != end);
+        TS_ASSERT(find(begin, end, "SetItemTag 2 lost 1") == end);
+    }
+
+
 };
 
 // first-time-through flag
@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ *
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ * 
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright 
+ *   notice, this list of conditions and the following disclaimer in the 
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the Intel Corporation nor the names of its 
+ *   contributors may be used to endorse or promote products derived from 
+ *   this software without specific prior written permission.
+ *  
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __FLIGHTRECORDER_TEST_H__
+#define __FLIGHTRECORDER_TEST_H__
+
+#include <cxxtest/FTestSuite.h>
+#include <stdio.h>
+#include <algorithm>
+
+#include "asim/syntax.h"
+#include "asim/dralServer.h"
+
+#include "dral_trace.h"
+
+using namespace std;
+
+
+class FlightRecorderTestSuite : public CxxTest::TestSuite
+{
+    static const UINT64 BLOCK_CYCLES = 100;
+    static const UINT32 BLOCKS = 3;
+    static const UINT64 CYCLES = 1000;
+
+    // Write a trace of CYCLES cycles, one item per cycle, either to the
+    // file or to a flight recorder that is dumped at cycle dumpAt and at
+    // the end.
+    void Generate(const char *name, bool compressed, bool recorder,
+                  const char *dumpName, UINT64 dumpAt)
+    {
+        DRAL_SERVER_CLASS server(name, 4096, false, compressed, false);
+        if (recorder)
+        {
+            server.SetFlightRecorder(BLOCK_CYCLES, BLOCKS);
+        }
+        else
+        {
+            server.SetBlockCycles(BLOCK_CYCLES);
+        }
+        UINT16 a = server.NewNode("a", 0);
+        UINT16 b = server.NewNode("b", 0);
+        UINT16 edge = server.NewEdge(a, b, 1, 1, "e");
+        server.TurnOn();
+        for (UINT64 cycle = 0; cycle < CYCLES; cycle++)
+        {
+            server.Cycle(cycle);
+            if (cycle == CYCLES / 2)
+            {
+                // the graph of the dump must include late nodes too
+                UINT16 late = server.NewNode("late", 0);
+                server.NewEdge(late, a, 1, 1, "late_e");
+            }
+            UINT32 item = server.NewItem();
+            server.MoveItems(edge, 1, &item);
+            server.SetItemTag(item, "val", cycle * 3);
+            char str[32];
+            sprintf(str, "s%llu", (unsigned long long)(cycle % 7));
+            server.SetItemTag(item, "str", str);
+            if (cycle > 3)
+            {
+                server.DeleteItem(item - 3);
+            }
+            if (recorder && cycle == dumpAt)
+            {
+                TS_ASSERT(server.DumpFlightRecorder(dumpName));
+            }
+        }
+        if (recorder)
+        {
+            TS_ASSERT(server.DumpFlightRecorder());
+        }
+    }
+
+    // The dump must decode, start with the first cycle of the oldest
+    // block kept and match the full trace from there on.
+    void CheckDump(const char *full, const char *dump, UINT64 firstCycle)
+    {
+        DRAL_TRACE_LISTENER_CLASS all, recorded;
+        TS_ASSERT(all.Read(full));
+        TS_ASSERT(recorded.Read(dump));
+        TS_ASSERT(!recorded.events.empty());
+        if (recorded.events.empty())
+        {
+            return;
+        }
+
+        char first[32];
+        sprintf(first, "Cycle %llu", (unsigned long long)firstCycle);
+        TS_ASSERT_EQUALS(recorded.events[0], string(first));
+
+        vector<string>::iterator from =
+            find(all.events.begin(), all.events.end(), recorded.events[0]);
+        TS_ASSERT(all.events.end() - from >= (INT64)recorded.events.size());
+        if (all.events.end() - from >= (INT64)recorded.events.size())
+        {
+            TS_ASSERT(equal(recorded.events.begin(), recorded.events.end(), from));
+        }
+    }
+
+    void Run(bool compressed)
+    {
+        Generate("flightrecorder_full", compressed, false, NULL, 0);
+        Generate("flightrecorder", compressed, true,
+                 "flightrecorder_early", BLOCK_CYCLES + BLOCK_CYCLES / 2);
+        // the recorder has not filled all its blocks yet
+        CheckDump("flightrecorder_full.drl.gz",
+                  "flightrecorder_early.drl.gz", 0);
+        Generate("flightrecorder", compressed, true,
+                 "flightrecorder_mid", CYCLES / 2 + BLOCK_CYCLES + 50);
+        // the current block, partly filled, is one of the blocks kept
+        CheckDump("flightrecorder_full.drl.gz",
+                  "flightrecorder_mid.drl.gz", CYCLES / 2 - BLOCK_CYCLES);
+        CheckDump("flightrecorder_full.drl.gz",
+                  "flightrecorder_flight.drl.gz",
+                  CYCLES - BLOCKS * BLOCK_CYCLES);
+    }
+
+public:
+    void testDumpUncompressed()
+    {
+        Run(false);
+    }
+
+    void testDumpCompressed()
+    {
+        Run(true);
+    }
+};
+
+#endif // __FLIGHTRECORDER_TEST_H__
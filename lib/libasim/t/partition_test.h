@@ -0,0 +1,262 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ *
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ * 
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright 
+ *   notice, this list of conditions and the following disclaimer in the 
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the Intel Corporation nor the names of its 
+ *   contributors may be used to endorse or promote products derived from 
+ *   this software without specific prior written permission.
+ *  
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PARTITION_TEST_H__
+#define __PARTITION_TEST_H__
+
+#include <cxxtest/FTestSuite.h>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <sstream>
+
+#include "asim/syntax.h"
+#include "asim/module.h"
+#include "asim/port.h"
+#include "asim/clockserver.h"
+#include "asim/partition.h"
+
+using namespace std;
+
+//
+// The test forks: the parent clocks partition 0 and the child partition 1
+// of the same model, connected by two ports crossing the partitions, one
+// in each direction.  Every check is counted in the modules, so that the
+// child can report its result through its exit status.
+//
+
+// top of the module hierarchy, clocked by both processes
+class ASIM_SYSTEM_CLASS  : public ASIM_MODULE_CLASS {
+    UINT64            last_cycle;            // last cycle executed
+    ASIM_CLOCK_SERVER server;                // clock server
+public:
+    void Clock(UINT64 cycle)
+    { last_cycle = cycle; }
+    ASIM_SYSTEM_CLASS(ASIM_CLOCK_SERVER cs, UINT32 partition)
+    : ASIM_MODULE_CLASS(NULL, "system"), last_cycle(0), server(cs)
+    { SetPartition(partition); RegisterClock("CLOCK"); }
+    void RunUntil(UINT64 end)
+    { while (last_cycle < end) server->Clock(); }
+} *asimSystem = NULL;
+
+// partition 0: writes the cycle to 'fwd' and checks what comes back
+class PING_CLASS : public ASIM_MODULE_CLASS {
+public:
+    WritePort<UINT64> out;
+    ReadPort<UINT64>  in;
+    UINT64            nread;
+    UINT64            errors;
+    PING_CLASS() : ASIM_MODULE_CLASS(asimSystem, "ping"), nread(0), errors(0)
+    {
+        SetPartition(0);
+        out.InitConfig(this, "fwd", 1, 2);
+        in.Init(this, "back");
+        RegisterClock("CLOCK");
+    }
+    void Clock(UINT64 cycle)
+    {
+        UINT64 data;
+        out.Write(cycle, cycle);
+        while (in.Read(data, cycle))
+        {
+            // pong sent back at cycle c - 3 what it got at c - 3 (+1)
+            errors += (data != cycle - 4);
+            nread++;
+        }
+    }
+};
+
+// partition 1: returns what it gets on 'fwd', plus one
+class PONG_CLASS : public ASIM_MODULE_CLASS {
+public:
+    ReadPort<UINT64>  in;
+    WritePort<UINT64> out;
+    UINT64            nread;
+    UINT64            errors;
+    PONG_CLASS() : ASIM_MODULE_CLASS(asimSystem, "pong"), nread(0), errors(0)
+    {
+        SetPartition(1);
+        in.Init(this, "fwd");
+        out.InitConfig(this, "back", 1, 3);
+        RegisterClock("CLOCK");
+    }
+    void Clock(UINT64 cycle)
+    {
+        UINT64 data;
+        while (in.Read(data, cycle))
+        {
+            errors += (data != cycle - 2);
+            nread++;
+            out.Write(data + 1, cycle);
+        }
+    }
+};
+
+class PartitionTestSuite : public CxxTest::TestSuite
+{
+    static bool first;     // the clock server is statically allocated,
+                           // so its domains are only created once
+
+    // Fork and run the model in two partitions.  With 'late' set,
+    // partition 0 starts after partition 1.
+    void RunPingPong(const string &job, bool late)
+    {
+        pid_t child = fork();
+        TS_ASSERT(child >= 0);
+        UINT32 rank = child == 0 ? 1 : 0;
+
+        ASIM_CLOCK_SERVER cs = ASIM_CLOCKABLE_CLASS::GetClockServer();
+        if (first)
+        {
+            first = false;
+            ASIM_SMP_CLASS::Init(1,1);
+            list<float> freqs; freqs.push_back(1.0);
+            cs->NewClockDomain("CLOCK", freqs);
+        }
+
+        asimSystem = new ASIM_SYSTEM_CLASS(cs, rank);
+        PING_CLASS ping;
+        PONG_CLASS pong;
+
+        if (late && rank == 0)
+        {
+            usleep(200000);
+        }
+        ASIM_PARTITION_CLASS::Init(2, rank, job.c_str());
+        BasePort::ConnectAll();
+        cs->InitClockServer();
+        asimSystem->RunUntil(1000);
+        ASIM_PARTITION_CLASS::Shutdown();
+
+        if (child == 0)
+        {
+            // the pong reads cycles 2..1000
+            _exit(pong.errors == 0 && pong.nread == 999 ? 0 : 1);
+        }
+
+        int status;
+        TS_ASSERT_EQUALS(waitpid(child, &status, 0), child);
+        TS_ASSERT(WIFEXITED(status));
+        TS_ASSERT_EQUALS(WEXITSTATUS(status), 0);
+        // the ping reads cycles 5..1000
+        TS_ASSERT_EQUALS(ping.errors, 0U);
+        TS_ASSERT_EQUALS(ping.nread, 996U);
+        TS_ASSERT_EQUALS(pong.nread, 0U);
+
+        cs->StopClockServer();
+        cs->UnregisterAll();
+        delete asimSystem;
+    }
+
+public:
+    void testPingPong() {
+        ostringstream job;
+        job << "partition_test_" << getpid();
+        RunPingPong(job.str(), false);
+    }
+
+    // Partition 1 starts first and finds the segment of a run whose
+    // partition 0 got to the end and then died without unlinking it.
+    // It must wait for the new partition 0 instead of running on it.
+    void testStaleSegment() {
+        ostringstream job;
+        job << "partition_test_stale_" << getpid();
+
+        pid_t crashed = fork();
+        TS_ASSERT(crashed >= 0);
+        if (crashed == 0)
+        {
+            ASIM_PARTITION_CLASS::Init(2, 0, job.str().c_str());
+            // publish a done time of INT64_MAX, as Shutdown does
+            ASIM_PARTITION_CLASS::WaitFor(INT64_MAX);
+            ASIM_PARTITION_CLASS::WaitFor(INT64_MAX);
+            _exit(0);
+        }
+        int status;
+        TS_ASSERT_EQUALS(waitpid(crashed, &status, 0), crashed);
+
+        RunPingPong(job.str(), true);
+    }
+
+    // A second run given the job name of a live run must stop instead
+    // of replacing the segment of the live run.
+    void testLiveSegment() {
+        ostringstream job;
+        job << "partition_test_live_" << getpid();
+
+        int ready[2];
+        TS_ASSERT_EQUALS(pipe(ready), 0);
+        pid_t live = fork();
+        TS_ASSERT(live >= 0);
+        if (live == 0)
+        {
+            ASIM_PARTITION_CLASS::Init(2, 0, job.str().c_str());
+            char c = 1;
+            ssize_t n = write(ready[1], &c, 1);
+            (void)n;
+            pause();
+            _exit(0);
+        }
+        char c;
+        TS_ASSERT_EQUALS(read(ready[0], &c, 1), 1);
+
+        pid_t other = fork();
+        TS_ASSERT(other >= 0);
+        if (other == 0)
+        {
+            ASIM_PARTITION_CLASS::Init(2, 0, job.str().c_str());
+            _exit(0);
+        }
+        int status;
+        TS_ASSERT_EQUALS(waitpid(other, &status, 0), other);
+        TS_ASSERT(!WIFEXITED(status) || WEXITSTATUS(status) != 0);
+
+        // the segment of the live run is still there
+        string name = "/" + job.str();
+        int fd = shm_open(name.c_str(), O_RDONLY, 0600);
+        TS_ASSERT(fd >= 0);
+        close(fd);
+
+        kill(live, SIGKILL);
+        TS_ASSERT_EQUALS(waitpid(live, &status, 0), live);
+        shm_unlink(name.c_str());
+        close(ready[0]);
+        close(ready[1]);
+    }
+};
+
+// first-time-through flag
+bool PartitionTestSuite::first = true;
+
+#endif // __PARTITION_TEST_H__
@@ -0,0 +1,1282 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ *
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the Intel Corporation nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @author Pau Cabre
+ * @brief Performance suite for the libasim core primitives.
+ *
+ * Every benchmark is run with an increasing number of iterations until
+ * it takes at least ASIM_PERF_MIN_TIME seconds (default 0.2), and its
+ * result is written as one JSON object per line to ASIM_PERF_OUT
+ * (default perf_bench.json):
+ *
+ *   {"name":"port/UINT64/bw:1/lat:1","iters":..,"ops":..,"seconds":..,
+ *    "ns_per_op":..,"ops_per_s":..}
+ *
+ * When ASIM_PERF_BASELINE names a file produced by an earlier run, each
+ * result is compared with the baseline entry of the same name and the
+ * test fails if it is more than ASIM_PERF_TOLERANCE (default 0.10)
+ * slower.  ASIM_PERF_FILTER restricts the run to the benchmarks whose
+ * name contains the given string.
+ */
+
+#ifndef __PERF_BENCH_H__
+#define __PERF_BENCH_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <map>
+#include <string>
+#include <vector>
+#include <deque>
+#include <sstream>
+#include <cxxtest/FTestSuite.h>
+
+#define MAX_PTHREADS 32
+
+#include "asim/syntax.h"
+#include "asim/module.h"
+#include "asim/port.h"
+#include "asim/clockserver.h"
+#include "asim/smp.h"
+#include "asim/mm.h"
+#include "asim/mmptr.h"
+#include "asim/pool_allocated_object.h"
+#include "asim/agequeue_soa.h"
+#include "asim/damqueue.h"
+#include "asim/damqueue_soa.h"
+#include "asim/orderedDAMQueue.h"
+#include "asim/orderedDAMQueue_soa.h"
+#include "asim/registerfile.h"
+#include "asim/cache_mesi.h"
+#include "asim/resource_stats.h"
+#include "asim/dralServer.h"
+#include "asim/dralClient.h"
+
+using namespace std;
+
+//
+// Timing harness
+//
+
+// a benchmark body: run 'iters' iterations and return the number of
+// operations performed (the unit the results are normalized to)
+class PERF_BENCHMARK_CLASS
+{
+  public:
+    virtual ~PERF_BENCHMARK_CLASS() { }
+    virtual UINT64 Run(UINT64 iters) = 0;
+};
+
+class PERF_HARNESS_CLASS
+{
+  private:
+    FILE *out;
+    map<string, double> baseline;   // name -> ns per op
+    double tolerance;
+    double minTime;
+    const char *filter;
+
+    // absolute slack of the baseline check, so that operations that are
+    // almost free do not fail on timer noise
+    static const double NS_SLACK;
+
+    static double Now(void)
+    {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        return tv.tv_sec + tv.tv_usec * 1e-6;
+    }
+
+    static double EnvDouble(const char *name, double dflt)
+    {
+        const char *v = getenv(name);
+        return v ? atof(v) : dflt;
+    }
+
+    void LoadBaseline(const char *fileName)
+    {
+        FILE *f = fopen(fileName, "r");
+        TS_ASSERT(f != NULL);
+        if (f == NULL)
+        {
+            return;
+        }
+
+        char line[1024];
+        while (fgets(line, sizeof(line), f))
+        {
+            char name[512];
+            const char *ns = strstr(line, "\"ns_per_op\":");
+            if (sscanf(line, "{\"name\":\"%511[^\"]\"", name) == 1 && ns)
+            {
+                baseline[name] = atof(ns + strlen("\"ns_per_op\":"));
+            }
+        }
+        fclose(f);
+    }
+
+  public:
+    PERF_HARNESS_CLASS()
+      : out(NULL),
+        tolerance(EnvDouble("ASIM_PERF_TOLERANCE", 0.10)),
+        minTime(EnvDouble("ASIM_PERF_MIN_TIME", 0.2)),
+        filter(getenv("ASIM_PERF_FILTER"))
+    {
+        const char *outName = getenv("ASIM_PERF_OUT");
+        out = fopen(outName ? outName : "perf_bench.json", "w");
+        TS_ASSERT(out != NULL);
+
+        const char *base = getenv("ASIM_PERF_BASELINE");
+        if (base)
+        {
+            LoadBaseline(base);
+        }
+    }
+
+    ~PERF_HARNESS_CLASS()
+    {
+        if (out)
+        {
+            fclose(out);
+        }
+    }
+
+    bool Selected(const string &name) const
+    {
+        return filter == NULL || name.find(filter) != string::npos;
+    }
+
+    // time 'bench', scaling the number of iterations until the run is
+    // long enough to be meaningful, then report and check the result
+    void Run(const string &name, PERF_BENCHMARK_CLASS &bench)
+    {
+        const UINT64 maxIters = UINT64(1) << 40;
+        UINT64 iters = 1;
+        UINT64 ops;
+        double elapsed;
+        while (true)
+        {
+            double start = Now();
+            ops = bench.Run(iters);
+            elapsed = Now() - start;
+            if (elapsed >= minTime || iters >= maxIters)
+            {
+                break;
+            }
+
+            // aim 40% over the minimum time, growing at most 100x per step
+            double mult = elapsed > 0 ? 1.4 * minTime / elapsed : 100;
+            mult = mult < 2 ? 2 : (mult > 100 ? 100 : mult);
+            iters = UINT64(iters * mult);
+            iters = iters > maxIters ? maxIters : iters;
+        }
+
+        // operations compiled away entirely can take no measurable time
+        ops = ops ? ops : 1;
+        elapsed = elapsed > 1e-9 ? elapsed : 1e-9;
+        double nsPerOp = elapsed * 1e9 / ops;
+
+        if (out)
+        {
+            fprintf(out, "{\"name\":\"%s\",\"iters\":%llu,\"ops\":%llu,"
+                    "\"seconds\":%.6f,\"ns_per_op\":%.3f,\"ops_per_s\":%.1f}\n",
+                    name.c_str(), (unsigned long long)iters,
+                    (unsigned long long)ops, elapsed, nsPerOp, ops / elapsed);
+            fflush(out);
+        }
+        printf("%-48s %12.3f ns/op %14.0f ops/s\n",
+               name.c_str(), nsPerOp, ops / elapsed);
+
+        map<string, double>::const_iterator b = baseline.find(name);
+        if (b != baseline.end() &&
+            nsPerOp > b->second * (1 + tolerance) + NS_SLACK)
+        {
+            ostringstream msg;
+            msg << name << " regressed: " << nsPerOp << " ns/op, baseline "
+                << b->second << " ns/op";
+            TS_FAIL(msg.str().c_str());
+        }
+    }
+};
+
+//
+// Ports
+//
+
+// an opaque payload of the given size
+template <int SIZE>
+struct PERF_PAYLOAD
+{
+    UINT64 data[SIZE / sizeof(UINT64)];
+    PERF_PAYLOAD() { data[0] = 0; }
+    PERF_PAYLOAD(UINT64 v) { data[0] = v; }
+};
+
+// writes 'bw' items per cycle through a port and reads all arrivals
+template <class T>
+class PERF_PORT_MODULE_CLASS : public ASIM_MODULE_CLASS
+{
+  public:
+    WritePort<T> wp;
+    ReadPort<T> rp;
+    UINT32 bw;
+    UINT64 moved;
+
+    PERF_PORT_MODULE_CLASS(ASIM_MODULE parent, const char *portName,
+                           UINT32 bandwidth, UINT32 latency)
+      : ASIM_MODULE_CLASS(parent, "perf_port"),
+        bw(bandwidth),
+        moved(0)
+    {
+        wp.InitConfig(this, portName, bandwidth, latency);
+        rp.Init(this, portName);
+        RegisterClock("PERF_D0");
+    }
+
+    void Clock(UINT64 cycle)
+    {
+        for (UINT32 i = 0; i < bw; i++)
+        {
+            wp.Write(T(cycle), cycle);
+        }
+        T data;
+        while (rp.Read(data, cycle))
+        {
+            moved++;
+        }
+    }
+};
+
+template <class T>
+class PERF_PORT_BENCH_CLASS : public PERF_BENCHMARK_CLASS
+{
+    ASIM_CLOCK_SERVER cs;
+    PERF_PORT_MODULE_CLASS<T> *m;
+
+  public:
+    PERF_PORT_BENCH_CLASS(ASIM_CLOCK_SERVER c, ASIM_MODULE root,
+                          const char *portName, UINT32 bw, UINT32 lat)
+      : cs(c)
+    {
+        m = new PERF_PORT_MODULE_CLASS<T>(root, portName, bw, lat);
+        BasePort::ConnectAll();
+        cs->InitClockServer();
+    }
+
+    ~PERF_PORT_BENCH_CLASS()
+    {
+        cs->StopClockServer();
+        cs->UnregisterAll();
+        delete m;
+    }
+
+    UINT64 Run(UINT64 iters)
+    {
+        UINT64 start = m->moved;
+        for (UINT64 i = 0; i < iters; i++)
+        {
+            cs->Clock();
+        }
+        return m->moved - start;
+    }
+};
+
+//
+// Clock server
+//
+
+// the cheapest possible clockable, so that the server overhead dominates
+class PERF_CLOCKABLE_CLASS : public ASIM_CLOCKABLE_CLASS
+{
+  public:
+    UINT64 *calls;
+
+    PERF_CLOCKABLE_CLASS(const char *domain, UINT64 *c)
+      : ASIM_CLOCKABLE_CLASS(NULL),
+        calls(c)
+    {
+        RegisterClock(domain);
+    }
+
+    void Clock(UINT64 cycle) { (*calls)++; }
+    const char *ProfileId(void) const { return "perf_clockable"; }
+};
+
+class PERF_CLOCK_BENCH_CLASS : public PERF_BENCHMARK_CLASS
+{
+    ASIM_CLOCK_SERVER cs;
+    vector<PERF_CLOCKABLE_CLASS *> clockables;
+    UINT64 calls;
+
+  public:
+    PERF_CLOCK_BENCH_CLASS(ASIM_CLOCK_SERVER c, UINT32 domains, UINT32 n)
+      : cs(c),
+        calls(0)
+    {
+        clockables.reserve(n);
+        for (UINT32 i = 0; i < n; i++)
+        {
+            ostringstream domain;
+            domain << "PERF_D" << (i % domains);
+            clockables.push_back(new PERF_CLOCKABLE_CLASS(domain.str().c_str(), &calls));
+        }
+        cs->InitClockServer();
+    }
+
+    ~PERF_CLOCK_BENCH_CLASS()
+    {
+        cs->StopClockServer();
+        cs->UnregisterAll();
+        for (UINT32 i = 0; i < clockables.size(); i++)
+        {
+            delete clockables[i];
+        }
+    }
+
+    // one op is one clockable callback
+    UINT64 Run(UINT64 iters)
+    {
+        UINT64 start = calls;
+        for (UINT64 i = 0; i < iters; i++)
+        {
+            cs->Clock();
+        }
+        return calls - start;
+    }
+};
+
+//
+// Memory manager
+//
+
+class PERF_MM_OBJECT_CLASS : public ASIM_MM_CLASS<PERF_MM_OBJECT_CLASS>
+{
+  public:
+    UINT64 payload[8];
+};
+typedef class mmptr<PERF_MM_OBJECT_CLASS> PERF_MM_OBJECT;
+
+// objects kept live by each thread between frees
+static const UINT32 PERF_MM_LIVE = 16;
+ASIM_MM_DEFINE(PERF_MM_OBJECT_CLASS, PERF_MM_LIVE * MAX_PTHREADS * 2);
+
+class PERF_MM_BENCH_CLASS : public PERF_BENCHMARK_CLASS
+{
+    struct WORKER
+    {
+        PERF_MM_BENCH_CLASS *bench;
+        ASIM_SMP_THREAD_HANDLE handle;
+        pthread_t thread;
+    };
+
+    const UINT32 nThreads;
+    ASIM_SMP_THREAD_HANDLE *handles;
+    pthread_barrier_t barrier;
+    UINT64 iters;
+
+    // each iteration allocates and frees PERF_MM_LIVE objects
+    static void Work(UINT64 iters)
+    {
+        PERF_MM_OBJECT live[PERF_MM_LIVE];
+        for (UINT64 i = 0; i < iters; i++)
+        {
+            for (UINT32 j = 0; j < PERF_MM_LIVE; j++)
+            {
+                live[j] = new PERF_MM_OBJECT_CLASS;
+            }
+            for (UINT32 j = 0; j < PERF_MM_LIVE; j++)
+            {
+                live[j] = NULL;
+            }
+        }
+    }
+
+    static void *Entry(void *arg)
+    {
+        WORKER *w = (WORKER *)arg;
+        ASIM_SMP_CLASS::SetThreadHandle(w->handle);
+        pthread_barrier_wait(&w->bench->barrier);
+        Work(w->bench->iters);
+        return NULL;
+    }
+
+  public:
+    PERF_MM_BENCH_CLASS(UINT32 n, ASIM_SMP_THREAD_HANDLE *h)
+      : nThreads(n),
+        handles(h),
+        iters(0)
+    { }
+
+    UINT64 Run(UINT64 i)
+    {
+        iters = i;
+        pthread_barrier_init(&barrier, NULL, nThreads);
+
+        vector<WORKER> workers(nThreads);
+        for (UINT32 t = 1; t < nThreads; t++)
+        {
+            workers[t].bench = this;
+            workers[t].handle = handles[t];
+            VERIFYX(pthread_create(&workers[t].thread, NULL, Entry, &workers[t]) == 0);
+        }
+
+        // the main thread is worker 0
+        pthread_barrier_wait(&barrier);
+        Work(iters);
+        for (UINT32 t = 1; t < nThreads; t++)
+        {
+            pthread_join(workers[t].thread, NULL);
+        }
+        pthread_barrier_destroy(&barrier);
+
+        // one op is an allocation plus its free
+        return iters * PERF_MM_LIVE * nThreads;
+    }
+};
+
+//
+// Pool allocator
+//
+
+static const UINT32 PERF_POOL_SIZE = 4096;
+typedef ASIM_POOL_ALLOCATED_OBJECT_CLASS<PERF_PAYLOAD<64>, PERF_POOL_SIZE> PERF_POOL;
+
+// allocations and frees in a chunk kept at a given occupancy, with the
+// live objects scattered over it
+class PERF_POOL_BENCH_CLASS : public PERF_BENCHMARK_CLASS
+{
+    PERF_POOL pool;
+    vector<PERF_PAYLOAD<64> *> live;
+    UINT32 next;
+
+  public:
+    PERF_POOL_BENCH_CLASS(UINT32 occupancy)
+      : next(0)
+    {
+        vector<PERF_PAYLOAD<64> *> all;
+        for (UINT32 i = 0; i < PERF_POOL_SIZE; i++)
+        {
+            all.push_back(pool.Allocate());
+        }
+        // keep every object whose position falls in the occupancy
+        for (UINT32 i = 0; i < PERF_POOL_SIZE; i++)
+        {
+            if ((i * 37 % 100) < occupancy)
+            {
+                live.push_back(all[i]);
+            }
+            else
+            {
+                pool.Release(all[i]);
+            }
+        }
+        if (live.empty())
+        {
+            live.push_back(pool.Allocate());
+        }
+    }
+
+    UINT64 Run(UINT64 iters)
+    {
+        for (UINT64 i = 0; i < iters; i++)
+        {
+            // replace the live objects round robin
+            pool.Release(live[next]);
+            live[next] = pool.Allocate();
+            next = (next + 1 == live.size()) ? 0 : next + 1;
+        }
+        return iters;
+    }
+};
+
+//
+// Queues: agequeue/DAMQueue/OrderedDAMQueue next to their SoA variants
+//
+
+typedef PERF_PAYLOAD<64> *PERF_QUEUE_OBJ;
+
+// a full miss queue where every other entry waits suspended on an older
+// one and launched entries complete in order after a quarter of the queue
+// has been launched behind them: each op unsuspends the oldest waiter,
+// launches the oldest ready entry and retires one completed entry
+template <class Q>
+class PERF_AGEQUEUE_BENCH_CLASS : public PERF_BENCHMARK_CLASS
+{
+    Q queue;
+    deque<UINT32> suspended;
+    deque<UINT32> launched;
+    PERF_PAYLOAD<64> obj;
+    UINT64 entered;
+
+    void Enter()
+    {
+        UINT32 idx = queue.Enter(&obj);
+        if (entered++ & 1)
+        {
+            queue.Suspend(idx);
+            suspended.push_back(idx);
+        }
+    }
+
+  public:
+    PERF_AGEQUEUE_BENCH_CLASS()
+      : entered(0)
+    {
+        while (queue.GetFreeSpace())
+        {
+            Enter();
+        }
+    }
+
+    UINT64 Run(UINT64 iters)
+    {
+        for (UINT64 i = 0; i < iters; i++)
+        {
+            if (!suspended.empty())
+            {
+                queue.UnSuspend(suspended.front());
+                suspended.pop_front();
+            }
+            INT32 r = queue.OldestReady();
+            if (r != -1)
+            {
+                queue.Launch(UINT32(r));
+                launched.push_back(r);
+            }
+            if (launched.size() > queue.GetCapacity() / 4)
+            {
+                queue.Remove(launched.front());
+                launched.pop_front();
+                Enter();
+            }
+        }
+        return iters;
+    }
+};
+
+// a half full queue with scattered holes: each op scans all the entries
+// and replaces one of them
+template <class Q>
+class PERF_DAMQUEUE_BENCH_CLASS : public PERF_BENCHMARK_CLASS
+{
+    Q queue;
+    PERF_PAYLOAD<64> obj;
+    UINT64 sum;
+
+  public:
+    PERF_DAMQUEUE_BENCH_CLASS(UINT16 n)
+      : sum(0)
+    {
+        queue.Init(n);
+        for (UINT16 i = 0; i < n; i++)
+        {
+            queue.Store(&obj);
+        }
+        for (UINT16 i = 0; i < n; i++)
+        {
+            if ((i * 37 % 100) >= 50)
+            {
+                queue.DelEntry(i);
+            }
+        }
+    }
+
+    UINT64 Run(UINT64 iters)
+    {
+        for (UINT64 i = 0; i < iters; i++)
+        {
+            INT16 victim = -1;
+            UINT32 k = 0;
+            queue.ResetSearchPtr();
+            for (INT16 e = queue.GetNextEntryNum(); e != -1; e = queue.GetNextEntryNum())
+            {
+                if ((k++ & 7) == (i & 7))
+                {
+                    victim = e;
+                }
+            }
+            sum += k;
+            if (victim != -1)
+            {
+                queue.DelEntry(victim);
+                queue.Store(&obj);
+            }
+        }
+        return iters;
+    }
+};
+
+// a half full queue: each op stores an entry with a pseudo random key,
+// walks the queue in key order and deletes the smallest key
+template <class Q>
+class PERF_ORDERED_DAMQUEUE_BENCH_CLASS : public PERF_BENCHMARK_CLASS
+{
+    Q queue;
+    PERF_PAYLOAD<64> obj;
+    UINT64 seed;
+    UINT64 sum;
+
+    UINT64 NextKey()
+    {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        return seed >> 40;
+    }
+
+  public:
+    PERF_ORDERED_DAMQUEUE_BENCH_CLASS(UINT16 n)
+      : seed(1), sum(0)
+    {
+        queue.Init(n);
+        for (UINT16 i = 0; i < n / 2; i++)
+        {
+            queue.Store(&obj, NextKey());
+        }
+    }
+
+    UINT64 Run(UINT64 iters)
+    {
+        for (UINT64 i = 0; i < iters; i++)
+        {
+            queue.Store(&obj, NextKey());
+            queue.ResetSearchPtr();
+            INT16 head = queue.GetCurrentEntryNum();
+            while (queue.GetNextEntry() != NULL)
+            {
+                sum++;
+            }
+            queue.DelEntry(head);
+        }
+        return iters;
+    }
+};
+
+//
+// Register files
+//
+
+INIT_REGISTER_FILE
+
+// a ROB-like table with a 6-bit tag field: each op clocks the table, CAMs
+// one tag and walks the matching entries, either through the latched
+// FieldIterator of FieldCAM or the MatchIterator of FieldCAMMatch
+template <bool MATCH>
+class PERF_REGFILE_CAM_BENCH_CLASS : public PERF_BENCHMARK_CLASS
+{
+    RegisterFile<UINT64> *rf;
+    UINT32 tag;
+    UINT64 sum;
+
+  public:
+    PERF_REGFILE_CAM_BENCH_CLASS(ASIM_MODULE parent, UINT32 entries)
+      : sum(0)
+    {
+        static char name[] = "perf_rf";
+        static char tagName[] = "tag";
+        rf = new RegisterFile<UINT64>(name, entries, parent);
+        tag = rf->NewField(tagName, 1, 1, 1, 6, 0, MATCH_ALL);
+        for (UINT32 i = 0; i < entries; i++)
+        {
+            rf->FieldWrite(tag, i, (i * 37) & 63);
+        }
+    }
+
+    ~PERF_REGFILE_CAM_BENCH_CLASS()
+    {
+        delete rf;
+    }
+
+    UINT64 Run(UINT64 iters)
+    {
+        PHASE phase;
+        for (UINT64 i = 0; i < iters; i++)
+        {
+            rf->Clock(phase);
+            if (MATCH)
+            {
+                RegisterFile<UINT64>::MatchIterator it = rf->FieldCAMMatch(tag, i & 63, 0);
+                for ( ; it.more(); ++it)
+                {
+                    sum += it.index();
+                }
+            }
+            else
+            {
+                RegisterFile<UINT64>::FieldIterator it = rf->FieldCAM(tag, i & 63, 0);
+                for ( ; it.more(); ++it)
+                {
+                    sum += it.index();
+                }
+            }
+        }
+        return iters;
+    }
+};
+
+//
+// Caches
+//
+
+template <UINT8 WAYS>
+class PERF_CACHE_BENCH_CLASS : public PERF_BENCHMARK_CLASS
+{
+    static const UINT32 LINES = 256;
+    static const UINT32 OBJS = 8;
+    typedef gen_cache_class<WAYS, LINES, OBJS> CACHE;
+
+    CACHE *cache;
+    UINT64 seed;
+    UINT64 footprint;     // in lines
+    UINT64 hits;
+
+  public:
+    PERF_CACHE_BENCH_CLASS()
+      : cache(new CACHE),
+        seed(1),
+        footprint(UINT64(WAYS) * LINES * 2),
+        hits(0)
+    { }
+
+    ~PERF_CACHE_BENCH_CLASS() { delete cache; }
+
+    // one op is a lookup, plus the fill of the LRU way on a miss
+    UINT64 Run(UINT64 iters)
+    {
+        for (UINT64 i = 0; i < iters; i++)
+        {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            UINT64 addr = ((seed >> 33) % footprint) * OBJS * 8;
+            UINT64 index = cache->Index(addr);
+            UINT64 tag = cache->Tag(addr);
+
+            line_state<OBJS> *line = cache->GetLineState(index, tag);
+            if (line)
+            {
+                hits++;
+            }
+            else
+            {
+                line = cache->GetLRUState(index);
+                line->SetTag(tag);
+                line->SetStatus(S_EXCLUSIVE_CLEAN);
+            }
+            cache->MakeMRU(index, line->GetWay());
+        }
+        return iters;
+    }
+};
+
+//
+// Histograms
+//
+
+template <bool E>
+class PERF_HISTOGRAM_BENCH_CLASS : public PERF_BENCHMARK_CLASS
+{
+    HISTOGRAM_TEMPLATE<E> unitBins;
+    HISTOGRAM_TEMPLATE<E> wideBins;
+
+  public:
+    PERF_HISTOGRAM_BENCH_CLASS()
+      : unitBins(64, 4, 1, true),
+        wideBins(64, 4, 4, true)
+    { }
+
+    // one op is one unit-bin and one wide-bin update
+    UINT64 Run(UINT64 iters)
+    {
+        for (UINT64 i = 0; i < iters; i++)
+        {
+            unitBins.AddEvent(i & 63, i & 3);
+            wideBins.AddEventWideBins(i & 255, i & 3);
+        }
+        return iters;
+    }
+};
+
+// updates spread over a large histogram, most of its cells unused
+template <bool DENSE>
+class PERF_LARGE_HISTOGRAM_BENCH_CLASS : public PERF_BENCHMARK_CLASS
+{
+    HISTOGRAM_TEMPLATE<true> hist;
+
+  public:
+    PERF_LARGE_HISTOGRAM_BENCH_CLASS()
+      : hist(1 << 20, 4)
+    {
+        if (DENSE)
+        {
+            hist.UseDenseStorage();
+        }
+    }
+
+    ~PERF_LARGE_HISTOGRAM_BENCH_CLASS()
+    {
+        printf("%-48s %12llu bytes\n", DENSE ? "  storage (dense)" : "  storage (sparse)",
+               (unsigned long long)hist.StorageBytes());
+    }
+
+    // one op is one update, to one of 4096 rows
+    UINT64 Run(UINT64 iters)
+    {
+        for (UINT64 i = 0; i < iters; i++)
+        {
+            hist.AddEvent(((i * 0x9E3779B1) & 4095) << 8, i & 3);
+        }
+        return iters;
+    }
+};
+
+//
+// DRAL
+//
+
+static const char *PERF_DRAL_FILE = "perf_bench_dral";
+
+// emits the event mix of a typical pipeline: a new item per cycle that
+// moves through an edge, gets a tag and dies a few cycles later
+class PERF_DRAL_WRITE_BENCH_CLASS : public PERF_BENCHMARK_CLASS
+{
+    bool compressed;
+
+  public:
+    PERF_DRAL_WRITE_BENCH_CLASS(bool compressed = true)
+      : compressed(compressed)
+    { }
+
+    // one op is one DRAL event
+    UINT64 Run(UINT64 iters)
+    {
+        DRAL_SERVER_CLASS server(PERF_DRAL_FILE, 4096, false, compressed, false);
+        UINT16 a = server.NewNode("a", 0);
+        UINT16 b = server.NewNode("b", 0);
+        UINT16 e = server.NewEdge(a, b, 1, 1, "e");
+        server.TurnOn();
+
+        UINT64 events = 0;
+        for (UINT64 c = 0; c < iters; c++)
+        {
+            server.Cycle(c);
+            UINT32 item = server.NewItem();
+            server.MoveItems(e, 1, &item);
+            server.SetItemTag(item, "val", c * 3);
+            events += 4;
+            if (c > 3)
+            {
+                server.DeleteItem(item - 3);
+                events++;
+            }
+        }
+        return events;
+    }
+};
+
+// counts the events decoded from a trace
+class PERF_DRAL_COUNTER_CLASS : public DRAL_LISTENER_CLASS
+{
+  public:
+    UINT64 events;
+    UINT64 errors;
+
+    PERF_DRAL_COUNTER_CLASS() : events(0), errors(0) { }
+
+    void Cycle(UINT64 cycle) { events++; }
+    void NewItem(UINT32 item_id) { events++; }
+    void MoveItems(UINT16 edge_id, UINT32 numOfItems, UINT32 * items) { events++; }
+    void MoveItemsWithPositions(UINT16 edge_id, UINT32 numOfItems,
+                                UINT32 * items, UINT32 * positions) { events++; }
+    void DeleteItem(UINT32 item_id) { events++; }
+    void EndSimulation(void) { }
+    void Error(const char * error) { errors++; }
+    void NonCriticalError(const char * error) { }
+    void Version(UINT16 version) { events++; }
+    void NewNode(UINT16 node_id, const char * node_name, UINT16 parent_id,
+                 UINT16 instance) { events++; }
+    void NewEdge(UINT16 sourceNode, UINT16 destNode, UINT16 edge_id,
+                 UINT32 bandwidth, UINT32 latency, const char * name) { events++; }
+    void SetNodeLayout(UINT16 node_id, UINT32 capacity, UINT16 dim,
+                       UINT32 capacities []) { events++; }
+    void EnterNode(UINT16 node_id, UINT32 item_id, UINT16 dim,
+                   UINT32 position []) { events++; }
+    void ExitNode(UINT16 node_id, UINT32 item_id, UINT16 dim,
+                  UINT32 position []) { events++; }
+    void SetCycleTag(UINT32 tag_idx, UINT64 value) { events++; }
+    void SetCycleTagString(UINT32 tag_idx, UINT32 str_idx) { events++; }
+    void SetCycleTagSet(UINT32 tag_idx, UINT32 nval, UINT64 set []) { events++; }
+    void SetItemTag(UINT32 item_id, UINT32 tag_idx, UINT64 value) { events++; }
+    void SetItemTagString(UINT32 item_id, UINT32 tag_idx,
+                          UINT32 str_idx) { events++; }
+    void SetItemTagSet(UINT32 item_id, UINT32 tag_idx, UINT32 nval,
+                       UINT64 set []) { events++; }
+    void SetNodeTag(UINT16 node_id, UINT32 tag_idx, UINT64 value, UINT16 level,
+                    UINT32 list []) { events++; }
+    void SetNodeTagString(UINT16 node_id, UINT32 tag_idx, UINT32 str_idx,
+                          UINT16 level, UINT32 list []) { events++; }
+    void SetNodeTagSet(UINT16 node_id, UINT32 tag_idx, UINT16 n, UINT64 set [],
+                       UINT16 level, UINT32 list []) { events++; }
+    void Comment(UINT32 magic_num, const char * cont) { events++; }
+    void CommentBin(UINT16 magic_num, const char * cont,
+                    UINT32 length) { events++; }
+    void SetNodeInputBandwidth(UINT16 node_id, UINT32 bandwidth) { events++; }
+    void SetNodeOutputBandwidth(UINT16 node_id, UINT32 bandwidth) { events++; }
+    void StartActivity(UINT64 start_activity_cycle) { events++; }
+    void SetTagDescription(UINT32 tag_idx, const char description []) { events++; }
+    void SetNodeClock(UINT16 nodeId, UINT16 clockId) { events++; }
+    void NewClock(UINT16 clockId, UINT64 freq, UINT16 skew, UINT16 divisions,
+                  const char name []) { events++; }
+    void Cycle(UINT16 clockId, UINT64 cycle, UINT16 phase) { events++; }
+    void SetTagSingleValue(UINT32 item_id, UINT32 tag_idx, UINT64 value,
+                           UBYTE time_span_flags) { events++; }
+    void SetTagString(UINT32 item_id, UINT32 tag_idx, UINT32 str_idx,
+                      UBYTE time_span_flags) { events++; }
+    void SetTagSet(UINT32 item_id, UINT32 tag_idx, UINT32 set_size,
+                   UINT64 * set, UBYTE time_span_flags) { events++; }
+    void EnterNode(UINT16 node_id, UINT32 item_id, UINT32 slot) { events++; }
+    void ExitNode(UINT16 node_id, UINT32 slot) { events++; }
+    void SetCapacity(UINT16 node_id, UINT32 capacity, UINT32 capacities [],
+                     UINT16 dimensions) { events++; }
+    void SetHighWaterMark(UINT16 node_id, UINT32 mark) { events++; }
+    void Comment(const char * comment) { events++; }
+    void AddNode(UINT16 node_id, const char * node_name, UINT16 parent_id,
+                 UINT16 instance) { events++; }
+    void AddEdge(UINT16 sourceNode, UINT16 destNode, UINT16 edge_id,
+                 UINT32 bandwidth, UINT32 latency, const char * name) { events++; }
+    void NewTag(UINT32 tag_idx, const char * tag_name,
+                INT32 tag_name_len) { events++; }
+    void NewString(UINT32 string_idx, const char * str, INT32 str_len) { events++; }
+};
+
+// decodes a compressed trace (inflated by the read-ahead thread) or an
+// uncompressed one (mapped in memory)
+class PERF_DRAL_READ_BENCH_CLASS : public PERF_BENCHMARK_CLASS
+{
+  public:
+    PERF_DRAL_READ_BENCH_CLASS(bool compressed)
+    {
+        PERF_DRAL_WRITE_BENCH_CLASS(compressed).Run(200000);
+    }
+
+    ~PERF_DRAL_READ_BENCH_CLASS()
+    {
+        unlink((string(PERF_DRAL_FILE) + ".drl.gz").c_str());
+    }
+
+    // one op is one decoded event; every iteration decodes the whole trace
+    UINT64 Run(UINT64 iters)
+    {
+        PERF_DRAL_COUNTER_CLASS counter;
+        for (UINT64 i = 0; i < iters; i++)
+        {
+            int fd = open((string(PERF_DRAL_FILE) + ".drl.gz").c_str(), O_RDONLY);
+            TS_ASSERT(fd >= 0);
+            DRAL_CLIENT_CLASS client(fd, &counter, 65536);
+            while (client.ProcessNextEvent(true, 1000) > 0)
+            {
+            }
+            close(fd);
+        }
+        TS_ASSERT_EQUALS(counter.errors, 0U);
+        return counter.events;
+    }
+};
+
+//
+// the suite.
+// The clock server, the SMP layer and the clock domains are global and
+// cannot be torn down, so they are set up once for all the benchmarks.
+//
+class PerfBenchSuite : public CxxTest::TestSuite
+{
+    static const UINT32 MAX_DOMAINS = 16;
+
+    ASIM_CLOCK_SERVER cs;
+    ASIM_MODULE root;
+
+    static bool first;
+    static PERF_HARNESS_CLASS *harness;    // results of the whole suite
+    static ASIM_SMP_THREAD_HANDLE handles[MAX_PTHREADS];
+
+  public:
+    void setUp()
+    {
+        cs = ASIM_CLOCKABLE_CLASS::GetClockServer();
+        if (first)
+        {
+            first = false;
+            ASIM_SMP_CLASS::Init(MAX_PTHREADS, MAX_PTHREADS);
+            handles[0] = ASIM_SMP_CLASS::GetMainThreadHandle();
+            for (UINT32 t = 1; t < MAX_PTHREADS; t++)
+            {
+                handles[t] = new ASIM_SMP_THREAD_HANDLE_CLASS();
+                ASIM_SMP_CLASS::CreateThread(handles[t]);
+            }
+            for (UINT32 d = 0; d < MAX_DOMAINS; d++)
+            {
+                ostringstream name;
+                name << "PERF_D" << d;
+                list<float> freqs;
+                freqs.push_back(1.0 + 0.25 * d);
+                cs->NewClockDomain(name.str(), freqs);
+            }
+            harness = new PERF_HARNESS_CLASS();
+        }
+        root = new ASIM_MODULE_CLASS(NULL, "perf");
+    }
+
+    void tearDown()
+    {
+        delete root;
+    }
+
+    template <class T>
+    void PortBench(const char *typeName)
+    {
+        static const UINT32 bws[] = { 1, 2, 4 };
+        static const UINT32 lats[] = { 1, 4 };
+        for (UINT32 b = 0; b < 3; b++)
+        {
+            for (UINT32 l = 0; l < 2; l++)
+            {
+                ostringstream name;
+                name << "port/" << typeName << "/bw:" << bws[b] << "/lat:" << lats[l];
+                if (harness->Selected(name.str()))
+                {
+                    PERF_PORT_BENCH_CLASS<T> bench(cs, root, name.str().c_str(),
+                                                   bws[b], lats[l]);
+                    harness->Run(name.str(), bench);
+                }
+            }
+        }
+    }
+
+    void testPorts()
+    {
+        PortBench<UINT64>("UINT64");
+        PortBench<PERF_PAYLOAD<64> >("64B");
+        PortBench<PERF_PAYLOAD<256> >("256B");
+    }
+
+    void testClockServer()
+    {
+        static const UINT32 domains[] = { 1, 4, 16 };
+        static const UINT32 clockables[] = { 1000, 10000, 100000 };
+        for (UINT32 d = 0; d < 3; d++)
+        {
+            for (UINT32 c = 0; c < 3; c++)
+            {
+                ostringstream name;
+                name << "clockserver/domains:" << domains[d]
+                     << "/clockables:" << clockables[c];
+                if (harness->Selected(name.str()))
+                {
+                    PERF_CLOCK_BENCH_CLASS bench(cs, domains[d], clockables[c]);
+                    harness->Run(name.str(), bench);
+                }
+            }
+        }
+    }
+
+    void testMM()
+    {
+        // preallocate the pool from the main thread
+        PERF_MM_OBJECT warm = new PERF_MM_OBJECT_CLASS;
+        warm = NULL;
+
+        for (UINT32 n = 1; n <= MAX_PTHREADS; n *= 2)
+        {
+            ostringstream name;
+            name << "mm/alloc_free/threads:" << n;
+            if (harness->Selected(name.str()))
+            {
+                PERF_MM_BENCH_CLASS bench(n, handles);
+                harness->Run(name.str(), bench);
+            }
+        }
+    }
+
+    void testPool()
+    {
+        static const UINT32 occupancy[] = { 0, 50, 90, 99 };
+        for (UINT32 o = 0; o < 4; o++)
+        {
+            ostringstream name;
+            name << "pool/alloc_free/occupancy:" << occupancy[o];
+            if (harness->Selected(name.str()))
+            {
+                PERF_POOL_BENCH_CLASS bench(occupancy[o]);
+                harness->Run(name.str(), bench);
+            }
+        }
+    }
+
+    template <UINT32 N>
+    void QueueBench()
+    {
+        ostringstream aos, soa;
+        aos << "/aos/n:" << N;
+        soa << "/soa/n:" << N;
+        if (harness->Selected("agequeue" + aos.str()))
+        {
+            PERF_AGEQUEUE_BENCH_CLASS<agequeue<PERF_QUEUE_OBJ, N> > bench;
+            harness->Run("agequeue" + aos.str(), bench);
+        }
+        if (harness->Selected("agequeue" + soa.str()))
+        {
+            PERF_AGEQUEUE_BENCH_CLASS<agequeue_soa<PERF_QUEUE_OBJ, N> > bench;
+            harness->Run("agequeue" + soa.str(), bench);
+        }
+        if (harness->Selected("damqueue" + aos.str()))
+        {
+            PERF_DAMQUEUE_BENCH_CLASS<DAMQueue<PERF_QUEUE_OBJ> > bench(N);
+            harness->Run("damqueue" + aos.str(), bench);
+        }
+        if (harness->Selected("damqueue" + soa.str()))
+        {
+            PERF_DAMQUEUE_BENCH_CLASS<DAMQueueSoA<PERF_QUEUE_OBJ> > bench(N);
+            harness->Run("damqueue" + soa.str(), bench);
+        }
+        if (harness->Selected("ordered_damqueue" + aos.str()))
+        {
+            PERF_ORDERED_DAMQUEUE_BENCH_CLASS<OrderedDAMQueue<PERF_QUEUE_OBJ> > bench(N);
+            harness->Run("ordered_damqueue" + aos.str(), bench);
+        }
+        if (harness->Selected("ordered_damqueue" + soa.str()))
+        {
+            PERF_ORDERED_DAMQUEUE_BENCH_CLASS<OrderedDAMQueueSoA<PERF_QUEUE_OBJ> > bench(N);
+            harness->Run("ordered_damqueue" + soa.str(), bench);
+        }
+    }
+
+    void testQueues()
+    {
+        QueueBench<32>();
+        QueueBench<64>();
+        QueueBench<128>();
+        QueueBench<256>();
+    }
+
+    void testRegisterFile()
+    {
+        static const UINT32 entries[] = { 64, 256 };
+        for (UINT32 e = 0; e < 2; e++)
+        {
+            ostringstream latched, match;
+            latched << "registerfile/cam/latched/entries:" << entries[e];
+            match << "registerfile/cam/match/entries:" << entries[e];
+            if (harness->Selected(latched.str()))
+            {
+                PERF_REGFILE_CAM_BENCH_CLASS<false> bench(root, entries[e]);
+                harness->Run(latched.str(), bench);
+            }
+            if (harness->Selected(match.str()))
+            {
+                PERF_REGFILE_CAM_BENCH_CLASS<true> bench(root, entries[e]);
+                harness->Run(match.str(), bench);
+            }
+        }
+    }
+
+    template <UINT8 WAYS>
+    void CacheBench()
+    {
+        ostringstream name;
+        name << "cache/lookup_fill/ways:" << UINT32(WAYS);
+        if (harness->Selected(name.str()))
+        {
+            PERF_CACHE_BENCH_CLASS<WAYS> bench;
+            harness->Run(name.str(), bench);
+        }
+    }
+
+    void testCache()
+    {
+        CacheBench<1>();
+        CacheBench<4>();
+        CacheBench<8>();
+        CacheBench<16>();
+    }
+
+    void testHistogram()
+    {
+        if (harness->Selected("histogram/enabled"))
+        {
+            PERF_HISTOGRAM_BENCH_CLASS<true> bench;
+            harness->Run("histogram/enabled", bench);
+        }
+        if (harness->Selected("histogram/disabled"))
+        {
+            PERF_HISTOGRAM_BENCH_CLASS<false> bench;
+            harness->Run("histogram/disabled", bench);
+        }
+        if (harness->Selected("histogram/large/sparse"))
+        {
+            PERF_LARGE_HISTOGRAM_BENCH_CLASS<false> bench;
+            harness->Run("histogram/large/sparse", bench);
+        }
+        if (harness->Selected("histogram/large/dense"))
+        {
+            PERF_LARGE_HISTOGRAM_BENCH_CLASS<true> bench;
+            harness->Run("histogram/large/dense", bench);
+        }
+    }
+
+    void testDral()
+    {
+        if (harness->Selected("dral/write"))
+        {
+            PERF_DRAL_WRITE_BENCH_CLASS bench;
+            harness->Run("dral/write", bench);
+        }
+        if (harness->Selected("dral/read/gz"))
+        {
+            PERF_DRAL_READ_BENCH_CLASS bench(true);
+            harness->Run("dral/read/gz", bench);
+        }
+        if (harness->Selected("dral/read/mmap"))
+        {
+            PERF_DRAL_READ_BENCH_CLASS bench(false);
+            harness->Run("dral/read/mmap", bench);
+        }
+    }
+};
+
+// first-time-through flag
+const double PERF_HARNESS_CLASS::NS_SLACK = 0.1;
+bool PerfBenchSuite::first = true;
+PERF_HARNESS_CLASS *PerfBenchSuite::harness = NULL;
+ASIM_SMP_THREAD_HANDLE PerfBenchSuite::handles[MAX_PTHREADS];
+
+#endif // __PERF_BENCH_H__
@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ *
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ * 
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright 
+ *   notice, this list of conditions and the following disclaimer in the 
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the Intel Corporation nor the names of its 
+ *   contributors may be used to endorse or promote products derived from 
+ *   this software without specific prior written permission.
+ *  
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __POOL_TEST_H__
+#define __POOL_TEST_H__
+
+#include <set>
+#include <vector>
+#include <pthread.h>
+#include <cxxtest/FTestSuite.h>
+
+#define MAX_PTHREADS 2
+
+#include "asim/syntax.h"
+#include "asim/module.h"
+#include "asim/smp.h"
+#include "asim/pool_allocated_object.h"
+
+using namespace std;
+
+//
+// some classes used in testing
+//
+struct POOLED_OBJECT
+{
+    UINT64 value;
+    POOLED_OBJECT() : value(7) {}
+};
+
+// small chunks, so that the tests go through several of them
+static const UINT32 POOL_TEST_CHUNK = 8;
+typedef ASIM_POOL_ALLOCATED_OBJECT_CLASS<POOLED_OBJECT, POOL_TEST_CHUNK> POOL_TEST_POOL;
+
+// work for the second thread: release some objects, allocate others
+struct POOL_TEST_WORK
+{
+    POOL_TEST_POOL *pool;
+    ASIM_SMP_THREAD_HANDLE handle;
+    vector<POOLED_OBJECT *> release;
+    vector<POOLED_OBJECT *> allocated;
+    UINT32 nAllocate;
+};
+
+static void *
+PoolTestThread(void *arg)
+{
+    POOL_TEST_WORK *work = (POOL_TEST_WORK *)arg;
+    ASIM_SMP_CLASS::SetThreadHandle(work->handle);
+
+    for (UINT32 i = 0; i < work->release.size(); i++)
+    {
+        work->pool->Release(work->release[i]);
+    }
+    for (UINT32 i = 0; i < work->nAllocate; i++)
+    {
+        work->allocated.push_back(work->pool->Allocate());
+    }
+    return NULL;
+}
+
+class PoolTestSuite : public CxxTest::TestSuite
+{
+    static bool first;
+
+    // Run 'work' in a thread of its own, with its own pool.
+    void RunThread(POOL_TEST_WORK &work)
+    {
+        pthread_t thread;
+        work.handle = new ASIM_SMP_THREAD_HANDLE_CLASS();
+        ASIM_SMP_CLASS::CreateThread(work.handle);
+        TS_ASSERT_EQUALS(pthread_create(&thread, NULL, PoolTestThread, &work), 0);
+        TS_ASSERT_EQUALS(pthread_join(thread, NULL), 0);
+    }
+
+    // Are the objects all different?
+    bool Distinct(const vector<POOLED_OBJECT *> &objs)
+    {
+        set<POOLED_OBJECT *> s(objs.begin(), objs.end());
+        return s.size() == objs.size();
+    }
+
+public:
+    void setUp() {
+        if (first) {
+            first = false;
+            ASIM_SMP_CLASS::Init(MAX_PTHREADS, MAX_PTHREADS);
+        }
+    }
+
+    // Fill several chunks, and check that released objects are reused
+    // before the pool grows again.
+    void testChunkGrowth() {
+        POOL_TEST_POOL pool;
+        vector<POOLED_OBJECT *> objs;
+
+        // four full chunks and part of a fifth
+        for (UINT32 i = 0; i < 4 * POOL_TEST_CHUNK + 3; i++)
+        {
+            POOLED_OBJECT *o = pool.Allocate();
+            TS_ASSERT_EQUALS(o->value, 7U);
+            o->value = i;
+            objs.push_back(o);
+        }
+        TS_ASSERT(Distinct(objs));
+        for (UINT32 i = 0; i < objs.size(); i++)
+        {
+            TS_ASSERT_EQUALS(objs[i]->value, i);
+        }
+
+        // fill the fifth chunk, then free objects of the first two
+        set<POOLED_OBJECT *> known(objs.begin(), objs.end());
+        for (UINT32 i = 3; i < POOL_TEST_CHUNK; i++)
+        {
+            POOLED_OBJECT *o = pool.Allocate();
+            TS_ASSERT(known.insert(o).second);
+            objs.push_back(o);
+        }
+        pool.Release(objs[1]);
+        pool.Release(objs[POOL_TEST_CHUNK + 2]);
+
+        POOLED_OBJECT *a = pool.Allocate();
+        POOLED_OBJECT *b = pool.Allocate();
+        TS_ASSERT(a != b);
+        TS_ASSERT(a == objs[1] || a == objs[POOL_TEST_CHUNK + 2]);
+        TS_ASSERT(b == objs[1] || b == objs[POOL_TEST_CHUNK + 2]);
+
+        // the pool is full again: the next object comes from a new chunk
+        POOLED_OBJECT *c = pool.Allocate();
+        TS_ASSERT(known.find(c) == known.end());
+
+        // releasing everything makes the six chunks available again, and
+        // the objects not seen yet are the rest of the chunk of 'c'
+        pool.Release(c);
+        for (UINT32 i = 0; i < objs.size(); i++)
+        {
+            pool.Release(objs[i]);
+        }
+        vector<POOLED_OBJECT *> again;
+        for (UINT32 i = 0; i < 6 * POOL_TEST_CHUNK; i++)
+        {
+            POOLED_OBJECT *o = pool.Allocate();
+            TS_ASSERT(known.find(o) != known.end() ||
+                      (o >= c - (POOL_TEST_CHUNK - 1) && o < c + POOL_TEST_CHUNK));
+            again.push_back(o);
+        }
+        TS_ASSERT(Distinct(again));
+    }
+
+    // Objects released by a thread other than the one that allocated
+    // them go back to the pool of their owner.
+    void testCrossThreadRelease() {
+        POOL_TEST_POOL pool;
+
+        vector<POOLED_OBJECT *> objs;
+        for (UINT32 i = 0; i < 3 * POOL_TEST_CHUNK; i++)
+        {
+            objs.push_back(pool.Allocate());
+        }
+        set<POOLED_OBJECT *> mine(objs.begin(), objs.end());
+
+        // the other thread releases ours and allocates from its own pool
+        POOL_TEST_WORK work;
+        work.pool = &pool;
+        work.release = objs;
+        work.nAllocate = 2 * POOL_TEST_CHUNK;
+        RunThread(work);
+
+        TS_ASSERT(Distinct(work.allocated));
+        for (UINT32 i = 0; i < work.allocated.size(); i++)
+        {
+            TS_ASSERT(mine.find(work.allocated[i]) == mine.end());
+        }
+
+        // we get our objects back, and none of the other thread
+        set<POOLED_OBJECT *> theirs(work.allocated.begin(), work.allocated.end());
+        vector<POOLED_OBJECT *> again;
+        for (UINT32 i = 0; i < objs.size(); i++)
+        {
+            again.push_back(pool.Allocate());
+            TS_ASSERT(mine.find(again.back()) != mine.end());
+        }
+        TS_ASSERT(Distinct(again));
+
+        // and we can release the objects of the other thread
+        for (UINT32 i = 0; i < work.allocated.size(); i++)
+        {
+            pool.Release(work.allocated[i]);
+        }
+        POOLED_OBJECT *o = pool.Allocate();
+        TS_ASSERT(theirs.find(o) == theirs.end());
+    }
+};
+
+// first-time-through flag
+bool PoolTestSuite::first = true;
+
+#endif // __POOL_TEST_H__
@@ -33,11 +33,16 @@
 
 #include <cxxtest/FTestSuite.h>
 
+#include <unistd.h>
+#include <algorithm>
+
 #include "asim/syntax.h"
 #include "asim/module.h"
 #include "asim/port.h"
 #include "asim/clockserver.h"
 #include "asim/rate_matcher.h"
+#include "asim/timing_wheel.h"
+#include "asim/checkpoint.h"
 
 using namespace std;
 
@@ -358,7 +363,71 @@ public:
         asimSystem->RunUntil(5);
         TS_ASSERT_EQUALS(runner.ok, true);
     }
-    
+
+    // connection order: the read ports of a group are declared before its
+    // write ports and interleaved with other groups and instances.  Write
+    // ports still pair with the read ports in declaration order (w1 with
+    // r1, w2 with r2, the fanout port wf with rA and rB), and the data
+    // written in one cycle is read in the next.
+    void testConnectOrder() {
+        class Runner : public ASIM_MODULE_CLASS {
+          public:
+                        ReadPort<int>     r1, rA, r2, rB, r1i;
+                        WritePort<int>    w1, w1i;
+                        WritePort<int,2>  wf;
+                        WritePort<int>    w2;
+                        int               data;
+                        bool              ok;
+            Runner(ASIM_CLOCK_SERVER cs) : ASIM_MODULE_CLASS(asimSystem, "runner"), ok(false)
+            {
+                        TS_ASSERT_EQUALS(r1.InitConfig(this, "co", 1, 1), true);
+                        TS_ASSERT_EQUALS(rA.InitConfig(this, "cf", 1, 1), true);
+                        TS_ASSERT_EQUALS(r2.InitConfig(this, "co", 1, 1), true);
+                        TS_ASSERT_EQUALS(rB.InitConfig(this, "cf", 1, 1), true);
+                        TS_ASSERT_EQUALS(r1i.Init(this, "co", 0, 1),      true);
+                        TS_ASSERT_EQUALS(r1i.SetLatency(1),              true);
+                        TS_ASSERT_EQUALS(w1.InitConfig(this, "co", 1, 1), true);
+                        TS_ASSERT_EQUALS(w1i.Init(this, "co", 0, 1),      true);
+                        TS_ASSERT_EQUALS(w1i.SetBandwidth(1),            true);
+                        TS_ASSERT_EQUALS(wf.Init(this, "cf"),             true);
+                        TS_ASSERT_EQUALS(wf.SetBandwidth(1),             true);
+                        TS_ASSERT_EQUALS(w2.InitConfig(this, "co", 1, 1), true);
+                        RegisterClock("CLOCK");
+                        TS_ASSERT_THROWS_NOTHING(BasePort::ConnectAll());
+                        TS_ASSERT_THROWS_NOTHING(cs->InitClockServer());
+            }
+            void Clock(UINT64 cycle) {
+                switch (cycle) {
+                case 1: // write each port, nothing to read in the same cycle
+                        TS_ASSERT_EQUALS(w1.Write(0x1010101, cycle), true);
+                        TS_ASSERT_EQUALS(w2.Write(0x2020202, cycle), true);
+                        TS_ASSERT_EQUALS(w1i.Write(0x3030303, cycle), true);
+                        TS_ASSERT_EQUALS(wf.Write(0x4040404, cycle), true);
+                        TS_ASSERT_EQUALS(r1.Read(data, cycle), false);
+                        TS_ASSERT_EQUALS(r2.Read(data, cycle), false);
+                        TS_ASSERT_EQUALS(r1i.Read(data, cycle), false);
+                        TS_ASSERT_EQUALS(rA.Read(data, cycle), false);
+                        break;
+                case 2: // each read port sees the data of its own write port
+                        TS_ASSERT_EQUALS(r1.Read(data, cycle), true);
+                        TS_ASSERT_EQUALS(data, 0x1010101);
+                        TS_ASSERT_EQUALS(r2.Read(data, cycle), true);
+                        TS_ASSERT_EQUALS(data, 0x2020202);
+                        TS_ASSERT_EQUALS(r1i.Read(data, cycle), true);
+                        TS_ASSERT_EQUALS(data, 0x3030303);
+                        TS_ASSERT_EQUALS(rA.Read(data, cycle), true);
+                        TS_ASSERT_EQUALS(data, 0x4040404);
+                        TS_ASSERT_EQUALS(rB.Read(data, cycle), true);
+                        TS_ASSERT_EQUALS(data, 0x4040404);
+                        TS_ASSERT_EQUALS(r1.Read(data, cycle), false);
+                        ok = true;
+                }
+            }
+        } runner(cs);
+        asimSystem->RunUntil(3);
+        TS_ASSERT_EQUALS(runner.ok, true);
+    }
+
     // stall port: basic port operation
     void testStallPortBasic() {
         class Runner : public ASIM_MODULE_CLASS {
@@ -1020,6 +1089,166 @@ public:
         TS_ASSERT_EQUALS(runner.ok, true);
     }
 
+    // a reader clocked on demand is only clocked when data arrives
+    // or when it wakes itself up
+    void testClockOnDemand() {
+        class Reader : public ASIM_MODULE_CLASS {
+          public:
+                        ReadPort<int>  port;
+                        vector<UINT64> clocked;  // cycles clocked
+                        int            nread;
+            Reader() : ASIM_MODULE_CLASS(asimSystem, "reader"), nread(0)
+            {
+                        TS_ASSERT_EQUALS(port.Init(this, "od"), true);
+                        SetClockOnDemand();
+                        RegisterClock("CLOCK");
+            }
+            void Clock(UINT64 cycle) {
+                        int data;
+                        clocked.push_back(cycle);
+                        while (port.Read(data, cycle))
+                        {
+                            TS_ASSERT_EQUALS(data, (int)cycle - 3);
+                            nread++;
+                        }
+                        if (cycle == 13) WakeAt(40);
+            }
+        } reader;
+        class Writer : public ASIM_MODULE_CLASS {
+          public:
+                        WritePort<int> port;
+            Writer() : ASIM_MODULE_CLASS(asimSystem, "writer")
+            {
+                        TS_ASSERT_EQUALS(port.InitConfig(this, "od", 2, 3), true);
+                        RegisterClock("CLOCK");
+            }
+            void Clock(UINT64 cycle) {
+                        if (cycle == 2 || cycle == 10)
+                        {
+                            TS_ASSERT_EQUALS(port.Write(cycle, cycle), true);
+                            TS_ASSERT_EQUALS(port.Write(cycle, cycle), true);
+                        }
+            }
+        } writer;
+        TS_ASSERT_THROWS_NOTHING(BasePort::ConnectAll());
+        TS_ASSERT_THROWS_NOTHING(cs->InitClockServer());
+        asimSystem->RunUntil(50);
+        TS_ASSERT_EQUALS(reader.nread, 4);
+        TS_ASSERT_EQUALS(reader.clocked.size(), 3U);
+        TS_ASSERT_EQUALS(reader.clocked[0], 5U);
+        TS_ASSERT_EQUALS(reader.clocked[1], 13U);
+        TS_ASSERT_EQUALS(reader.clocked[2], 40U);
+    }
+
+    // clock on demand: wake ups past the first block of the timing wheel
+    // (256 cycles) and past the level 1 horizon (65536 cycles)
+    void testClockOnDemandFar() {
+        class Reader : public ASIM_MODULE_CLASS {
+          public:
+                        ReadPort<int>  port;
+                        vector<UINT64> clocked;  // cycles clocked
+                        int            nread;
+            Reader() : ASIM_MODULE_CLASS(asimSystem, "reader"), nread(0)
+            {
+                        TS_ASSERT_EQUALS(port.Init(this, "odf"), true);
+                        SetClockOnDemand();
+                        RegisterClock("CLOCK");
+            }
+            void Clock(UINT64 cycle) {
+                        int data;
+                        clocked.push_back(cycle);
+                        while (port.Read(data, cycle))
+                        {
+                            nread++;
+                        }
+                        if (cycle == 5) { WakeAt(300); WakeAt(600); }
+                        if (cycle == 300) { WakeAt(70000); WakeAt(70000); WakeAt(65536); }
+            }
+        } reader;
+        class Writer : public ASIM_MODULE_CLASS {
+          public:
+                        WritePort<int> port;
+            Writer() : ASIM_MODULE_CLASS(asimSystem, "writer")
+            {
+                        TS_ASSERT_EQUALS(port.InitConfig(this, "odf", 1, 3), true);
+                        RegisterClock("CLOCK");
+            }
+            void Clock(UINT64 cycle) {
+                        if (cycle == 2 || cycle == 65600)
+                        {
+                            TS_ASSERT_EQUALS(port.Write(cycle, cycle), true);
+                        }
+            }
+        } writer;
+        TS_ASSERT_THROWS_NOTHING(BasePort::ConnectAll());
+        TS_ASSERT_THROWS_NOTHING(cs->InitClockServer());
+        asimSystem->RunUntil(70010);
+        TS_ASSERT_EQUALS(reader.nread, 2);
+        TS_ASSERT_EQUALS(reader.clocked.size(), 6U);
+        if (reader.clocked.size() == 6U)
+        {
+            TS_ASSERT_EQUALS(reader.clocked[0], 5U);
+            TS_ASSERT_EQUALS(reader.clocked[1], 300U);
+            TS_ASSERT_EQUALS(reader.clocked[2], 600U);
+            TS_ASSERT_EQUALS(reader.clocked[3], 65536U);
+            TS_ASSERT_EQUALS(reader.clocked[4], 65603U);
+            TS_ASSERT_EQUALS(reader.clocked[5], 70000U);
+        }
+    }
+
+    // timing wheel with 4 cycle blocks: items in level 0, level 1 and the
+    // overflow list, checkpointed in the middle of the run
+    void testTimingWheel() {
+        const char *ckptFile = "port_test_wheel.ckpt";
+        ASIM_TIMING_WHEEL_CLASS<UINT32, 2> wheel, restored;
+        UINT64 cycles[] = { 1, 3, 6, 15, 16, 17, 40, 40, 300, 12 };
+        for (UINT32 i = 0; i < sizeof(cycles) / sizeof(cycles[0]); i++)
+        {
+            wheel.Schedule(cycles[i], i);
+        }
+        TS_ASSERT_EQUALS(wheel.GetPending(), 10U);
+
+        vector<UINT32> log;
+        UINT64 cycle = 0;
+        for ( ; cycle < 14; cycle++)
+        {
+            const vector<UINT32> &items = wheel.Expire(cycle);
+            for (UINT32 i = 0; i < items.size(); i++)
+            {
+                TS_ASSERT_EQUALS(cycles[items[i]], cycle);
+                log.push_back(items[i]);
+            }
+        }
+        // an expired cycle is delivered right away
+        wheel.Schedule(2, 10);
+        {
+            ASIM_CHECKPOINT_CLASS ckpt(ckptFile, ASIM_CHECKPOINT_CLASS::CKPT_SAVE);
+            ckpt.Save(wheel);
+        }
+        {
+            ASIM_CHECKPOINT_CLASS ckpt(ckptFile, ASIM_CHECKPOINT_CLASS::CKPT_RESTORE);
+            ckpt.Restore(restored);
+        }
+        unlink(ckptFile);
+        TS_ASSERT_EQUALS(restored.GetCurrent(), 14U);
+        TS_ASSERT_EQUALS(restored.GetPending(), 7U);
+
+        vector<UINT32> rlog(log);
+        for ( ; cycle < 400; cycle++)
+        {
+            const vector<UINT32> &items = wheel.Expire(cycle);
+            log.insert(log.end(), items.begin(), items.end());
+            const vector<UINT32> &ritems = restored.Expire(cycle);
+            rlog.insert(rlog.end(), ritems.begin(), ritems.end());
+        }
+        UINT32 expected[] = { 0, 1, 2, 9, 10, 3, 4, 5, 6, 7, 8 };
+        TS_ASSERT_EQUALS(log.size(), 11U);
+        TS_ASSERT(equal(log.begin(), log.end(), expected));
+        TS_ASSERT(rlog == log);
+        TS_ASSERT_EQUALS(wheel.GetPending(), 0U);
+        TS_ASSERT_EQUALS(restored.GetPending(), 0U);
+    }
+
     // TODO: phase ports, config ports, peek ports
     
 };
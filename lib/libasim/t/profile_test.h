@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ *
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ * 
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright 
+ *   notice, this list of conditions and the following disclaimer in the 
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the Intel Corporation nor the names of its 
+ *   contributors may be used to endorse or promote products derived from 
+ *   this software without specific prior written permission.
+ *  
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PROFILE_TEST_H__
+#define __PROFILE_TEST_H__
+
+// the clock callbacks only time themselves in profiling builds
+#ifndef ASIM_ENABLE_PROFILE
+#define ASIM_ENABLE_PROFILE
+#endif
+
+#include <cxxtest/FTestSuite.h>
+
+#include "asim/syntax.h"
+#include "asim/module.h"
+#include "asim/clockserver.h"
+
+using namespace std;
+
+
+// A module that counts its clock callbacks.  The callback is built
+// here, so it is compiled with ASIM_ENABLE_PROFILE even if the library
+// was not.
+class COUNTER_MODULE_CLASS : public ASIM_MODULE_CLASS {
+public:
+    UINT64 calls;
+
+    COUNTER_MODULE_CLASS(ASIM_MODULE parent, const char *iname, const char *clock_name)
+      : ASIM_MODULE_CLASS(parent, iname),
+        calls(0)
+    {
+        RegisterClock(clock_name, newCallback(this, &COUNTER_MODULE_CLASS::Tick));
+    }
+
+    void Tick(UINT64 cycle)
+    {
+        calls++;
+    }
+};
+
+class ProfileTestSuite : public CxxTest::TestSuite
+{
+    ASIM_CLOCK_SERVER cs;  // the clock server
+    static bool first;     // the clock server is statically allocated,
+                           // so its domains are only created once
+
+    // Run a module for a number of cycles with one out of every
+    // period callbacks timed, and check the number of samples.
+    void RunSampled(UINT32 period)
+    {
+        COUNTER_MODULE_CLASS runner(NULL, "runner", "CLOCK");
+        cs->SetDumpProfile(period);
+        TS_ASSERT_THROWS_NOTHING(cs->InitClockServer());
+        for (int i = 0; i < 1000; i++)
+        {
+            cs->Clock();
+        }
+
+        UINT64 calls = runner.calls;
+        UINT64 samples = runner.GetNumInvocations();
+        TS_ASSERT_EQUALS(calls, UINT64(1000));
+        if (period == 0)
+        {
+            TS_ASSERT_EQUALS(samples, UINT64(0));
+        }
+        else
+        {
+            // the first call is timed, then one out of every period
+            TS_ASSERT_EQUALS(samples, (calls + period - 1) / period);
+            TS_ASSERT_LESS_THAN_EQUALS(calls, samples * period);
+            TS_ASSERT_LESS_THAN(samples * period, calls + period);
+        }
+
+        cs->StopClockServer();
+        cs->UnregisterAll();
+        cs->SetDumpProfile(0);
+    }
+
+public:
+    void setUp() {
+        cs = ASIM_CLOCKABLE_CLASS::GetClockServer();
+        if (first) {
+            first = false;
+            ASIM_SMP_CLASS::Init(1,1);
+            list<float> freqs; freqs.push_back(1.0);
+            cs->NewClockDomain("CLOCK", freqs);
+        }
+    }
+
+    // profiling off: no callback is timed
+    void testProfileOff() {
+        RunSampled(0);
+    }
+
+    // every callback is timed
+    void testProfileEveryCall() {
+        RunSampled(1);
+    }
+
+    // the number of samples scales with the sampling rate
+    void testProfileSampled() {
+        RunSampled(4);
+        RunSampled(16);
+        RunSampled(7);
+    }
+};
+
+// first-time-through flag
+bool ProfileTestSuite::first = true;
+
+#endif // __PROFILE_TEST_H__
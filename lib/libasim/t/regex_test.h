@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ *
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ * 
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright 
+ *   notice, this list of conditions and the following disclaimer in the 
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the Intel Corporation nor the names of its 
+ *   contributors may be used to endorse or promote products derived from 
+ *   this software without specific prior written permission.
+ *  
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __REGEX_TEST_H__
+#define __REGEX_TEST_H__
+
+#include <cxxtest/FTestSuite.h>
+
+#include "asim/syntax.h"
+#include "asim/module.h"
+#include "asim/regexobj.h"
+#include "asim/trace.h"
+
+using namespace std;
+
+
+// A module to serve as the top of the module hierarchy
+class ASIM_SYSTEM_CLASS  : public ASIM_MODULE_CLASS {
+public:
+    ASIM_SYSTEM_CLASS() 
+    : ASIM_MODULE_CLASS(NULL, "system") {};
+} *asimSystem = NULL;
+
+
+class RegexTestSuite : public CxxTest::TestSuite
+{
+  public:
+
+    // Test a case-sensitive regex
+    void testCaseSensitive() {
+        Regex r("^cpu0/alu$");
+
+        TS_ASSERT (r.ok());
+        TS_ASSERT (r.isCaseSensitive());
+        TS_ASSERT (r.match("cpu0/alu"));
+        TS_ASSERT (!r.match("CPU0/ALU"));
+    }
+
+
+    // Test a case-insensitive regex, given to the constructor and to assign
+    void testCaseInsensitive() {
+        Regex r1("^cpu0/alu$", false);
+
+        TS_ASSERT (r1.ok());
+        TS_ASSERT (!r1.isCaseSensitive());
+        TS_ASSERT (r1.match("cpu0/alu"));
+        TS_ASSERT (r1.match("CPU0/Alu"));
+        TS_ASSERT (!r1.match("cpu1/alu"));
+
+        Regex r2;
+        TS_ASSERT (r2.assign("ports", false));
+        TS_ASSERT (!r2.isCaseSensitive());
+        TS_ASSERT (r2.match("cpu0/PORTS"));
+    }
+
+
+    // Test that the trace matcher gives the same answer as the
+    // regexes themselves, for literal and generic patterns
+    void testTraceMatcher() {
+        Regex lit("^cpu0/", false);
+        Regex gen("alu[0-9]$", false);
+        Regex cs("Fetch", true);
+
+        TRACE_REGEX_MATCHER_CLASS matcher;
+        matcher.Add(&lit, 1);
+        matcher.Add(&gen, 2);
+        matcher.Add(&cs, 3);
+        matcher.Build();
+
+        const char *names[] = {
+            "cpu0/alu", "CPU0/ALU", "cpu1/alu3", "CPU1/ALU3", "cpu0/ALU3",
+            "cpu1/Fetch", "cpu1/fetch", "CPU0/FETCH", "mem", ""
+        };
+        Regex *regexes[] = { &lit, &gen, &cs };
+
+        for (unsigned i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+        {
+            int expected = -1;
+            for (int j = 0; j < 3; j++)
+            {
+                if (regexes[j]->match(names[i]))
+                {
+                    expected = j;
+                }
+            }
+            TS_ASSERT_EQUALS (matcher.Match(names[i]), expected);
+        }
+
+        TS_ASSERT_EQUALS (matcher.Match("CPU0/x"), 0);
+        TS_ASSERT_EQUALS (matcher.GetLevel(matcher.Match("cpu1/ALU7")), 2);
+        TS_ASSERT_EQUALS (matcher.Match("cpu1/fetch"), -1);
+    }
+};
+
+#endif // __REGEX_TEST_H__
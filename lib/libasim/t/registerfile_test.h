@@ -0,0 +1,277 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ *
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ * 
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright 
+ *   notice, this list of conditions and the following disclaimer in the 
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the Intel Corporation nor the names of its 
+ *   contributors may be used to endorse or promote products derived from 
+ *   this software without specific prior written permission.
+ *  
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __REGISTERFILE_TEST_H__
+#define __REGISTERFILE_TEST_H__
+
+#include <stdlib.h>
+#include <vector>
+#include <cxxtest/FTestSuite.h>
+
+#define MAX_PTHREADS 1
+
+#include "asim/syntax.h"
+#include "asim/module.h"
+#include "asim/registerfile.h"
+
+using namespace std;
+
+INIT_REGISTER_FILE
+
+// A module to serve as the top of the module hierarchy
+class ASIM_SYSTEM_CLASS  : public ASIM_MODULE_CLASS {
+public:
+    ASIM_SYSTEM_CLASS() 
+    : ASIM_MODULE_CLASS(NULL, "system") {};
+} *asimSystem = NULL;
+
+//
+// Reference table, kept row-major like the RegisterFile used to be, with
+// the CAM done as a plain scan from the start point.
+//
+class RF_REFERENCE_CLASS
+{
+    struct ROW
+    {
+        UINT64 value[3];
+    };
+
+    vector<ROW> rows;
+
+  public:
+    RF_REFERENCE_CLASS(UINT32 capacity) : rows(capacity)
+    {
+        for (UINT32 i = 0; i < capacity; i++)
+        {
+            rows[i].value[0] = rows[i].value[1] = rows[i].value[2] = 0;
+        }
+    }
+
+    void Write(UINT32 fld, UINT32 idx, UINT64 val) { rows[idx].value[fld] = val; }
+    UINT64 Read(UINT32 fld, UINT32 idx) const { return rows[idx].value[fld]; }
+
+    // matching entries in CAM order; start/end as in FieldCAMRange
+    void CAM(UINT32 fld, UINT64 val, UINT32 start, UINT32 end, UINT32 port,
+             INT32 disablefld, bool firstOnly, vector<UINT32> &matches) const
+    {
+        UINT32 capacity = rows.size();
+        UINT32 trip;
+        if (start == (UINT32)-1)
+        {
+            start = 0;
+            trip = capacity;
+        }
+        else if (end == (UINT32)-1)
+        {
+            trip = capacity;
+        }
+        else
+        {
+            trip = (start <= end) ? end - start : capacity - (start - end);
+            trip = (trip == 0) ? capacity : trip;
+        }
+
+        for (UINT32 i = start, j = 0; j < trip; j++, i = (i + 1) % capacity)
+        {
+            if (disablefld >= 0 && rows[i].value[disablefld] != port &&
+                rows[i].value[disablefld] != ANY_PORT)
+            {
+                continue;
+            }
+            if (rows[i].value[fld] == val)
+            {
+                matches.push_back(i);
+                if (firstOnly)
+                {
+                    break;
+                }
+            }
+        }
+    }
+};
+
+class RegisterFileTestSuite : public CxxTest::TestSuite
+{
+    typedef RegisterFile<UINT64> RF;
+
+    // the CAMs, with no disable field when dis < 0
+    RF::FieldIterator CAMRange(RF &rf, UINT32 fld, UINT64 val, UINT32 start,
+                               UINT32 end, UINT32 port, INT32 dis)
+    {
+        return (dis < 0) ? rf.FieldCAMRange(fld, val, start, end, port)
+                         : rf.FieldCAMRange(fld, val, start, end, port, dis);
+    }
+
+    RF::MatchIterator CAMMatchRange(RF &rf, UINT32 fld, UINT64 val, UINT32 start,
+                                    UINT32 end, UINT32 port, INT32 dis)
+    {
+        return (dis < 0) ? rf.FieldCAMMatchRange(fld, val, start, end, port)
+                         : rf.FieldCAMMatchRange(fld, val, start, end, port, dis);
+    }
+
+    // Random writes and CAMs on a table and on the reference: the latched
+    // (FieldCAM) and the bitmask (FieldCAMMatch) results must both be the
+    // ones of the row-major scan, and so must a multi-write through either.
+    void CompareCAMs(UINT32 capacity, UINT32 iters)
+    {
+        char name[] = "rf";
+        char nameA[] = "a";
+        char nameB[] = "b";
+        char nameD[] = "d";
+        RF rf(name, capacity, NULL);
+        RF_REFERENCE_CLASS ref(capacity);
+
+        // two CAM fields, one per policy, and a disable field
+        const UINT32 a = rf.NewField(nameA, 1, 2, 2, 3, 0, MATCH_ALL);
+        const UINT32 b = rf.NewField(nameB, 1, 2, 2, 3, 0, MATCH_FIRST_ONLY);
+        const UINT32 d = rf.NewField(nameD, 1, 2, 2, 5, 0, MATCH_ALL);
+        const UINT64 mask[3] = { 7, 7, 31 };
+        for (UINT32 f = 0; f < 3; f++)
+        {
+            for (UINT32 i = 0; i < capacity; i++)
+            {
+                rf.FieldWrite(f, i, 0);
+            }
+        }
+        const bool useMatch = capacity <= MAX_MATCH_ENTRIES;
+
+        for (UINT32 it = 0; it < iters; it++)
+        {
+            PHASE phase;
+            rf.Clock(phase);
+
+            for (UINT32 k = 0; k < 4; k++)
+            {
+                UINT32 f = rand() % 3;
+                UINT32 i = rand() % capacity;
+                UINT64 v = (f == d && rand() % 4 == 0) ? ANY_PORT : rand() % 9;
+                rf.FieldWrite(f, i, v);
+                ref.Write(f, i, v & mask[f]);
+            }
+
+            UINT32 fld = (rand() & 1) ? a : b;
+            UINT64 val = rand() % 8;
+            UINT32 port = (rand() % 3 == 0) ? BACKDOOR_PORT : rand() % 2;
+            INT32 dis = (rand() & 1) ? d : -1;
+            UINT32 start = rand() % capacity;
+            UINT32 end = rand() % capacity;
+            switch (rand() % 3)
+            {
+              case 0: start = (UINT32)-1; end = (UINT32)-1; break;
+              case 1: end = (UINT32)-1; break;
+            }
+
+            vector<UINT32> expected;
+            ref.CAM(fld, val, start, end, port, dis, fld == b, expected);
+
+            RF::FieldIterator latched = CAMRange(rf, fld, val, start, end, port, dis);
+            UINT32 n = 0;
+            for ( ; latched.more(); ++latched, n++)
+            {
+                if (n >= expected.size() || UINT32(latched.index()) != expected[n] ||
+                    *latched != val)
+                {
+                    TS_FAIL("FieldCAMRange differs from the row-major scan");
+                    return;
+                }
+            }
+            TS_ASSERT_EQUALS(n, expected.size());
+
+            if (useMatch)
+            {
+                rf.Clock(phase);
+                RF::MatchIterator m = CAMMatchRange(rf, fld, val, start, end, port, dis);
+                TS_ASSERT_EQUALS(m.count(), expected.size());
+                for (n = 0; m.more(); ++m, n++)
+                {
+                    if (n >= expected.size() || UINT32(m.index()) != expected[n] ||
+                        *m != val)
+                    {
+                        TS_FAIL("FieldCAMMatchRange differs from the row-major scan");
+                        return;
+                    }
+                }
+                TS_ASSERT_EQUALS(n, expected.size());
+            }
+
+            // multi-write the disable field of the matches, through either
+            // iterator, and check every entry of the table
+            rf.Clock(phase);
+            UINT64 w = rand() % 32;
+            if (useMatch && (rand() & 1))
+            {
+                rf.FieldWrite(d, CAMMatchRange(rf, fld, val, start, end, port, dis), w);
+            }
+            else
+            {
+                RF::FieldIterator again = CAMRange(rf, fld, val, start, end, port, dis);
+                rf.FieldWrite(d, again, w);
+            }
+            for (UINT32 i = 0; i < expected.size(); i++)
+            {
+                ref.Write(d, expected[i], w);
+            }
+            for (UINT32 f = 0; f < 3; f++)
+            {
+                for (UINT32 i = 0; i < capacity; i++)
+                {
+                    if (rf.FieldRead(f, i) != ref.Read(f, i))
+                    {
+                        TS_FAIL("table contents differ after a multi-write");
+                        return;
+                    }
+                }
+            }
+        }
+    }
+
+public:
+    void setUp() {
+        srand(11);
+    }
+
+    void testCAMSmall() {
+        CompareCAMs(1, 500);
+        CompareCAMs(5, 2000);
+        CompareCAMs(63, 2000);
+        CompareCAMs(64, 2000);
+        CompareCAMs(65, 2000);
+    }
+
+    void testCAMLarge() {
+        CompareCAMs(130, 1000);
+        CompareCAMs(256, 1000);
+        CompareCAMs(1000, 300);
+        // too large for the MatchIterator: FieldCAM only
+        CompareCAMs(1100, 300);
+    }
+};
+
+#endif // __REGISTERFILE_TEST_H__
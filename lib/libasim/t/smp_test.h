@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ *
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ * 
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright 
+ *   notice, this list of conditions and the following disclaimer in the 
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the Intel Corporation nor the names of its 
+ *   contributors may be used to endorse or promote products derived from 
+ *   this software without specific prior written permission.
+ *  
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __SMP_TEST_H__
+#define __SMP_TEST_H__
+
+#include <cxxtest/FTestSuite.h>
+
+#include <sstream>
+#include <vector>
+
+#define MAX_PTHREADS 1
+
+#include "asim/syntax.h"
+#include "asim/module.h"
+#include "asim/smp.h"
+
+using namespace std;
+
+
+// A module to serve as the top of the module hierarchy
+class ASIM_SYSTEM_CLASS  : public ASIM_MODULE_CLASS {
+public:
+    ASIM_SYSTEM_CLASS() 
+    : ASIM_MODULE_CLASS(NULL, "system") {};
+} *asimSystem = NULL;
+
+
+class SmpTestSuite : public CxxTest::TestSuite
+{
+    vector<ASIM_SMP_CPU> cpus;
+
+    // CPU order of 'policy' as a CPU list
+    string Order(const string &policy)
+    {
+        vector<INT32> order;
+        TS_ASSERT(ASIM_SMP_CLASS::CpuOrder(policy, cpus, order));
+        ostringstream os;
+        for (UINT32 i = 0; i < order.size(); i++)
+        {
+            os << (i ? "," : "") << order[i];
+        }
+        return os.str();
+    }
+
+  public:
+    // Two nodes of two cores with two hardware threads each.  As on most
+    // hosts, the second hardware threads are numbered after all the
+    // first ones: node 0 has CPUs 0,1,4,5 and node 1 CPUs 2,3,6,7.
+    void setUp() {
+        cpus.clear();
+        for (INT32 cpu = 7; cpu >= 0; cpu--)
+        {
+            ASIM_SMP_CPU c;
+            c.node = (cpu / 2) % 2;
+            c.package = c.node;
+            c.core = cpu % 4;
+            c.sibling = -1;
+            c.cpu = cpu;
+            cpus.push_back(c);
+        }
+    }
+
+    // fill the cores of a node, then the next node
+    void testCompact() {
+        TS_ASSERT_EQUALS(Order("compact"), "0,4,1,5,2,6,3,7");
+    }
+
+    // alternate the nodes, one hardware thread of every core first
+    void testScatter() {
+        TS_ASSERT_EQUALS(Order("scatter"), "0,2,1,3,4,6,5,7");
+    }
+
+    // an explicit list is used as is
+    void testExplicit() {
+        TS_ASSERT_EQUALS(Order("5,0-2,  7"), "5,0,1,2,7");
+        TS_ASSERT_EQUALS(Order("6"), "6");
+        TS_ASSERT_EQUALS(Order(""), "");
+        TS_ASSERT_EQUALS(Order("none"), "");
+    }
+
+    // malformed CPU lists
+    void testMalformed() {
+        vector<INT32> order;
+        TS_ASSERT(!ASIM_SMP_CLASS::CpuOrder("3-1", cpus, order));
+        TS_ASSERT(!ASIM_SMP_CLASS::CpuOrder("a", cpus, order));
+        TS_ASSERT(!ASIM_SMP_CLASS::CpuOrder("1,2-", cpus, order));
+        TS_ASSERT(!ASIM_SMP_CLASS::CpuOrder("1:3", cpus, order));
+
+        vector<INT32> list;
+        TS_ASSERT(ASIM_SMP_CLASS::ParseCpuList("0-1,3\n", list));
+        TS_ASSERT_EQUALS(list.size(), 3U);
+        TS_ASSERT(!ASIM_SMP_CLASS::ParseCpuList("3-1", list));
+        TS_ASSERT(!ASIM_SMP_CLASS::ParseCpuList("a", list));
+    }
+};
+
+#endif // __SMP_TEST_H__
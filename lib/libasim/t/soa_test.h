@@ -0,0 +1,319 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ *
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ * 
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright 
+ *   notice, this list of conditions and the following disclaimer in the 
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the Intel Corporation nor the names of its 
+ *   contributors may be used to endorse or promote products derived from 
+ *   this software without specific prior written permission.
+ *  
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __SOA_TEST_H__
+#define __SOA_TEST_H__
+
+#include <stdlib.h>
+#include <vector>
+#include <cxxtest/FTestSuite.h>
+
+#include "asim/syntax.h"
+#include "asim/module.h"
+#include "asim/agequeue.h"
+#include "asim/agequeue_soa.h"
+#include "asim/damqueue.h"
+#include "asim/damqueue_soa.h"
+#include "asim/orderedDAMQueue.h"
+#include "asim/orderedDAMQueue_soa.h"
+
+using namespace std;
+
+//
+// Every test drives one of the struct-of-arrays containers and the
+// container it mirrors with the same random sequence of operations, and
+// checks that they return the same results after every operation.  The
+// checks stop at the first difference, to keep the report short.
+//
+
+// A module to serve as the top of the module hierarchy
+class ASIM_SYSTEM_CLASS  : public ASIM_MODULE_CLASS {
+public:
+    ASIM_SYSTEM_CLASS() 
+    : ASIM_MODULE_CLASS(NULL, "system") {};
+} *asimSystem = NULL;
+
+#define SOA_CHECK(c) \
+    if (!(c)) { TS_FAIL(#c); return; }
+
+class SoaTestSuite : public CxxTest::TestSuite
+{
+    // agequeue_soa<T,N> against agequeue<T,N>
+    template <UINT32 N>
+    void AgeQueue(UINT32 iters)
+    {
+        agequeue<long, N> a;
+        agequeue_soa<long, N> b;
+        long next = 1;
+
+        for (UINT32 it = 0; it < iters; it++)
+        {
+            SOA_CHECK(a.GetOccupancy() == b.GetOccupancy());
+            SOA_CHECK(a.GetFreeSpace() == b.GetFreeSpace());
+            SOA_CHECK(a.Oldest() == b.Oldest());
+            SOA_CHECK(a.Youngest() == b.Youngest());
+            SOA_CHECK(a.OldestReady() == b.OldestReady());
+
+            vector<int> live;
+            for (int i = a.Oldest(); i != -1; i = a.Next(i))
+            {
+                SOA_CHECK(a.Next(i) == b.Next(i));
+                SOA_CHECK(a.Previous(i) == b.Previous(i));
+                SOA_CHECK(a.NextReady(i) == b.NextReady(i));
+                SOA_CHECK(a.PreviousReady(i) == b.PreviousReady(i));
+                SOA_CHECK(a.GetObjectState(i) == b.GetObjectState(i));
+                SOA_CHECK(a.GetObject(i) == b.GetObject(i));
+                live.push_back(i);
+            }
+
+            int op = rand() % 8;
+            if (op <= 1)
+            {
+                if (a.GetFreeSpace())
+                {
+                    long x = next++;
+                    SOA_CHECK(a.Enter(x) == b.Enter(x));
+                }
+                continue;
+            }
+            if (live.empty())
+            {
+                continue;
+            }
+
+            UINT32 k = live[rand() % live.size()];
+            EntryState s = a.GetObjectState(k);
+            if (op == 2 && s == ENTRY_READY_TO_LAUNCH)
+            {
+                a.Launch(k);
+                b.Launch(k);
+            }
+            else if (op == 3 && s == ENTRY_LAUNCHED)
+            {
+                a.Remove(k);
+                b.Remove(k);
+            }
+            else if (op == 4 && s == ENTRY_LAUNCHED)
+            {
+                a.Rearm(k);
+                b.Rearm(k);
+            }
+            else if (op == 5 && s == ENTRY_READY_TO_LAUNCH)
+            {
+                a.Suspend(k);
+                b.Suspend(k);
+            }
+            else if (op == 6 && s == ENTRY_SUSPENDED)
+            {
+                a.UnSuspend(k);
+                b.UnSuspend(k);
+            }
+            else if (op == 7)
+            {
+                long x = a.GetObject(k);
+                SOA_CHECK(a.Find(x) == b.Find(x));
+                int r = a.OldestReady();
+                if (r != -1)
+                {
+                    a.Launch(UINT32(r));
+                    b.Launch(UINT32(r));
+                }
+            }
+        }
+    }
+
+    // DAMQueueSoA<T> against DAMQueue<T>, NULL entries included
+    void DAMQueues(UINT16 n, UINT32 iters, bool nulls)
+    {
+        DAMQueue<long *> a;
+        DAMQueueSoA<long *> b;
+        a.Init(n);
+        b.Init(n);
+        long pool[1000];
+
+        for (UINT32 it = 0; it < iters; it++)
+        {
+            SOA_CHECK(a.GetOccupancy() == b.GetOccupancy());
+            SOA_CHECK(a.IsEmpty() == b.IsEmpty());
+            SOA_CHECK(a.IsFull() == b.IsFull());
+
+            int op = rand() % 6;
+            if (op <= 1 && !a.IsFull())
+            {
+                long *p = (nulls && rand() % 8 == 0) ? NULL : &pool[rand() % 1000];
+                a.Store(p);
+                b.Store(p);
+            }
+            else if (op == 2)
+            {
+                a.ResetSearchPtr();
+                b.ResetSearchPtr();
+            }
+            else if (op == 3)
+            {
+                SOA_CHECK(a.GetNextEntryNum() == b.GetNextEntryNum());
+                SOA_CHECK(a.GetCurrentEntryNum() == b.GetCurrentEntryNum());
+            }
+            else if (op == 4)
+            {
+                SOA_CHECK(a.GetNextEntry() == b.GetNextEntry());
+            }
+            else if (op == 5)
+            {
+                // delete a random entry, found by walking both queues from
+                // the head (which may hold a NULL entry, when allowed)
+                a.ResetSearchPtr();
+                b.ResetSearchPtr();
+                vector<int> live;
+                int head = a.GetCurrentEntryNum();
+                SOA_CHECK(head == b.GetCurrentEntryNum());
+                if (head != -1 && !nulls)
+                {
+                    live.push_back(head);
+                }
+                int x;
+                while ((x = a.GetNextEntryNum()) != -1)
+                {
+                    SOA_CHECK(x == b.GetNextEntryNum());
+                    live.push_back(x);
+                }
+                SOA_CHECK(b.GetNextEntryNum() == -1);
+                if (!live.empty())
+                {
+                    int d = live[rand() % live.size()];
+                    SOA_CHECK(a.GetEntry(d) == b.GetEntry(d));
+                    a.DelEntry(d);
+                    b.DelEntry(d);
+                }
+            }
+        }
+    }
+
+    // OrderedDAMQueueSoA<T> against OrderedDAMQueue<T>.  Keys are unique,
+    // since the two classes walk equal keys in different orders.
+    void OrderedDAMQueues(UINT16 n, UINT32 iters)
+    {
+        OrderedDAMQueue<long *> a;
+        OrderedDAMQueueSoA<long *> b;
+        a.Init(n);
+        b.Init(n);
+        long pool[1000];
+
+        for (UINT32 it = 0; it < iters; it++)
+        {
+            SOA_CHECK(a.GetOccupancy() == b.GetOccupancy());
+            SOA_CHECK(a.IsFull() == b.IsFull());
+
+            int op = rand() % 3;
+            if (op <= 1 && !a.IsFull())
+            {
+                long *p = &pool[rand() % 1000];
+                UINT64 key = (UINT64(rand() % 4096) << 20) | it;
+                a.Store(p, key);
+                b.Store(p, key);
+            }
+            else if (!a.IsEmpty())
+            {
+                // walk both in key order, and delete a random entry
+                a.ResetSearchPtr();
+                b.ResetSearchPtr();
+                vector<int> wa, wb;
+                wa.push_back(a.GetCurrentEntryNum());
+                wb.push_back(b.GetCurrentEntryNum());
+                SOA_CHECK(a.GetCurrentEntry() == b.GetCurrentEntry());
+                while (a.GetNextEntry() != NULL)
+                {
+                    wa.push_back(a.GetCurrentEntryNum());
+                }
+                while (b.GetNextEntry() != NULL)
+                {
+                    wb.push_back(b.GetCurrentEntryNum());
+                }
+                SOA_CHECK(wa.size() == wb.size());
+                SOA_CHECK(wa.size() == a.GetOccupancy());
+                for (UINT32 i = 0; i < wa.size(); i++)
+                {
+                    SOA_CHECK(a.GetEntry(wa[i]) == b.GetEntry(wb[i]));
+                }
+
+                UINT32 d = rand() % wa.size();
+                a.DelEntry(wa[d]);
+                b.DelEntry(wb[d]);
+            }
+        }
+    }
+
+public:
+    void setUp() {
+        srand(7);
+    }
+
+    void testAgeQueue() {
+        AgeQueue<1>(20000);
+        AgeQueue<3>(20000);
+        AgeQueue<32>(50000);
+        AgeQueue<64>(50000);
+        AgeQueue<100>(50000);
+        AgeQueue<256>(50000);
+    }
+
+    void testDAMQueue() {
+        for (UINT16 n = 1; n <= 130; n += 7)
+        {
+            DAMQueues(n, 20000, false);
+        }
+        DAMQueues(256, 20000, false);
+    }
+
+    // DAMQueue accepts NULL entries, which count in the occupancy but
+    // leave their slot free
+    void testDAMQueueNull() {
+        DAMQueueSoA<long *> b;
+        long x;
+        b.Init(4);
+        b.Store(NULL);
+        b.Store(&x);
+        TS_ASSERT_EQUALS(b.GetOccupancy(), 2);
+
+        for (UINT16 n = 1; n <= 64; n += 9)
+        {
+            DAMQueues(n, 20000, true);
+        }
+    }
+
+    void testOrderedDAMQueue() {
+        for (UINT16 n = 1; n <= 130; n += 7)
+        {
+            OrderedDAMQueues(n, 10000);
+        }
+    }
+};
+
+#endif // __SOA_TEST_H__
@@ -34,11 +34,18 @@
 
 #include <cxxtest/FTestSuite.h>
 
+#include <unistd.h>
+#include <sys/stat.h>
+#include <fstream>
+#include <sstream>
+
 #include "asim/syntax.h"
 #include "asim/module.h"
 #include "asim/clockserver.h"
 #include "asim/registry.h"
 #include "asim/state.h"
+#include "asim/stateout.h"
+#include "asim/checkpoint.h"
 
 using namespace std;
 
@@ -279,6 +286,164 @@ class StatTestSuite : public CxxTest::TestSuite
     }
 
 
+    // Test a large histogram: sparse first, dense once enough cells are used
+    void testSparseHisto() {
+        X_MODULE_CLASS sm (asimSystem, "stat_module"); 
+
+        HISTOGRAM_TEMPLATE<true> hStat (100000, 2); // 200000 cells
+        sm.RegisterState (&hStat, "Hstat", "Histo stat");
+        TS_ASSERT (hStat.IsSparse());
+
+        hStat.AddEvent(99999, 1, 7);
+        hStat.AddEvent(5);
+        hStat.AddEvent(5);
+        TS_ASSERT (hStat.IsSparse());
+        TS_ASSERT_EQUALS (hStat.GetValue(99999, 1), 7U);
+        TS_ASSERT_EQUALS (hStat.GetValue(5), 2U);
+        TS_ASSERT_EQUALS (hStat.GetValue(6), 0U);
+
+        HISTOGRAM_TEMPLATE<true> copy;
+        copy = hStat;
+        TS_ASSERT_EQUALS (copy.GetValue(99999, 1), 7U);
+        copy.PrepareSaveDelete();
+
+        // the hash grows past 1/8 of the cells
+        for (UINT32 i = 0; i < 40000; i++) {
+            hStat.AddEvent(i * 2, i & 1);
+        }
+        TS_ASSERT (! hStat.IsSparse());
+        TS_ASSERT_EQUALS (hStat.GetValue(99999, 1), 7U);
+        TS_ASSERT_EQUALS (hStat.GetValue(4, 0), 1U);
+        TS_ASSERT_EQUALS (hStat.GetValue(4, 1), 0U);
+        TS_ASSERT_EQUALS (hStat.GetValue(5), 2U);
+
+        // copying the old counters back brings back the sparse storage
+        hStat = copy;
+        TS_ASSERT (hStat.IsSparse());
+        TS_ASSERT_EQUALS (hStat.GetValue(4, 0), 0U);
+        TS_ASSERT_EQUALS (hStat.GetValue(5), 2U);
+    }
+
+    // Dump of a histogram, as written to a stats file
+    template <class H>
+    string DumpHisto(H &h) {
+        const char *file = "stat_test_histo.xml";
+        STATE_OUT so = new STATE_OUT_CLASS(file);
+        h.Dump(so);
+        delete so;
+
+        ifstream in(file);
+        TS_ASSERT (in.good());
+        ostringstream os;
+        os << in.rdbuf();
+        unlink(file);
+        return os.str();
+    }
+
+    // The same counters dump the same in sparse and dense storage, also
+    // once the sparse histogram has moved to the dense matrix.  With
+    // skip_trailing_empty_rows, the rows past the last one used are not
+    // dumped, so a histogram with fewer rows (dense from the start)
+    // gives the same output.
+    void testSparseHistoDump() {
+        X_MODULE_CLASS sm (asimSystem, "stat_module"); 
+
+        HISTOGRAM_TEMPLATE<true> sparse (100000, 2, 1, false, 1, false, true); // 200000 cells
+        HISTOGRAM_TEMPLATE<true> dense (20000, 2, 1, false, 1, false, true);   // 40000 cells
+        sm.RegisterState (&sparse, "Sparse", "Sparse histo stat");
+        sm.RegisterState (&dense, "Dense", "Dense histo stat");
+        TS_ASSERT (sparse.IsSparse());
+        TS_ASSERT (! dense.IsSparse());
+
+        for (UINT32 i = 0; i < 1000; i++) {
+            UINT32 row = (i * 7919) % 20000;
+            sparse.AddEvent(row, i & 1, i + 1);
+            dense.AddEvent(row, i & 1, i + 1);
+        }
+        sparse.AddEvent(19999, 1, 3);
+        dense.AddEvent(19999, 1, 3);
+        TS_ASSERT (sparse.IsSparse());
+        string sparseDump = DumpHisto(sparse);
+        TS_ASSERT (sparseDump.find("19999") != string::npos);
+        TS_ASSERT_EQUALS (sparseDump, DumpHisto(dense));
+
+        // the hash grows past 1/8 of the cells
+        for (UINT32 i = 0; i < 40000; i++) {
+            sparse.AddEvent(i >> 1, i & 1);
+            dense.AddEvent(i >> 1, i & 1);
+        }
+        TS_ASSERT (! sparse.IsSparse());
+        string denseDump = DumpHisto(sparse);
+        TS_ASSERT (denseDump != sparseDump);
+        TS_ASSERT_EQUALS (denseDump, DumpHisto(dense));
+    }
+
+    // A sparse histogram is saved in a checkpoint as its nonzero cells,
+    // and restored into the sparse storage, also inside a 3D histogram.
+    // One saved dense is restored into the dense matrix.
+    void testSparseHistoCheckpoint() {
+        const char *file = "stat_test_histo.ckpt";
+        X_MODULE_CLASS sm (asimSystem, "stat_module"); 
+
+        HISTOGRAM_TEMPLATE<true> sparse (100000, 2); // 200000 cells
+        HISTOGRAM_TEMPLATE<true> dense (100000, 2);
+        THREE_DIM_HISTOGRAM_TEMPLATE<true> sparse3d (3, 100000, 2);
+        sm.RegisterState (&sparse, "Sparse", "Sparse histo stat");
+        sm.RegisterState (&dense, "Dense", "Dense histo stat");
+        for (UINT32 i = 0; i < 1000; i++) {
+            UINT32 row = (i * 7919) % 100000;
+            sparse.AddEvent(row, i & 1, i + 1);
+            dense.AddEvent(row, i & 1, i + 1);
+            sparse3d.AddEvent(i % 3, row, i & 1, i + 1);
+        }
+        for (UINT32 i = 0; i < 40000; i++) {
+            dense.AddEvent(i >> 1, i & 1);
+        }
+        TS_ASSERT (sparse.IsSparse());
+        TS_ASSERT (! dense.IsSparse());
+
+        ASIM_CHECKPOINT ckpt = new ASIM_CHECKPOINT_CLASS(file, ASIM_CHECKPOINT_CLASS::CKPT_SAVE);
+        sparse.SaveCheckpoint(ckpt);
+        sparse3d.SaveCheckpoint(ckpt);
+        sparse.SaveCheckpoint(ckpt);
+        dense.SaveCheckpoint(ckpt);
+        delete ckpt;
+
+        // the dense matrix of 1.6MB, and the sparse histograms of 1000
+        // cells at most as (cell, value) pairs
+        struct stat st;
+        TS_ASSERT_EQUALS (stat(file, &st), 0);
+        TS_ASSERT (st.st_size < 200000 * 8 + 3 * 1000 * 16 + 4096);
+
+        HISTOGRAM_TEMPLATE<true> sparseBack (100000, 2);
+        THREE_DIM_HISTOGRAM_TEMPLATE<true> sparse3dBack (3, 100000, 2);
+        HISTOGRAM_TEMPLATE<true> denseBack (100000, 2);
+        HISTOGRAM_TEMPLATE<true> toDense (100000, 2);
+        sm.RegisterState (&sparseBack, "SparseBack", "Sparse histo stat");
+        sm.RegisterState (&denseBack, "DenseBack", "Dense histo stat");
+        sm.RegisterState (&toDense, "ToDense", "Dense histo stat");
+        toDense.AddEvent(6, 1, 5);
+        toDense.UseDenseStorage();
+
+        ckpt = new ASIM_CHECKPOINT_CLASS(file, ASIM_CHECKPOINT_CLASS::CKPT_RESTORE);
+        sparseBack.RestoreCheckpoint(ckpt);
+        sparse3dBack.RestoreCheckpoint(ckpt);
+        toDense.RestoreCheckpoint(ckpt);
+        denseBack.RestoreCheckpoint(ckpt);
+        delete ckpt;
+        unlink(file);
+
+        TS_ASSERT (sparseBack.IsSparse());
+        TS_ASSERT_EQUALS (DumpHisto(sparseBack), DumpHisto(sparse));
+        TS_ASSERT_EQUALS (DumpHisto(sparse3dBack), DumpHisto(sparse3d));
+        TS_ASSERT (! toDense.IsSparse());
+        TS_ASSERT_EQUALS (toDense.GetValue(6, 1), 0U);
+        TS_ASSERT_EQUALS (DumpHisto(toDense), DumpHisto(sparse));
+        TS_ASSERT (! denseBack.IsSparse());
+        TS_ASSERT_EQUALS (DumpHisto(denseBack), DumpHisto(dense));
+    }
+
+
     // The AddEventWideBins() function gets tested in the row_size/col_size tests
  
     // Test the row_flex_cap field for histograms
@@ -406,6 +571,53 @@ class StatTestSuite : public CxxTest::TestSuite
         TS_ASSERT_EQUALS (as3->StrValue(), "\0");
         TS_ASSERT_EQUALS (sm.histoStat.GetValue(0), 0U);
     }
+
+
+    // Test that a non-resettable stat keeps its value across ClearStats
+    void testClearStatsNotResettable() {
+        X_MODULE_CLASS sm (asimSystem, "stat_module");
+        ASIM_STATE as1, as2;
+
+        as1 = sm.RegisterState (&sm.uintStat, "Uintstat", "Uint stat");
+        as2 = sm.RegisterState (&sm.doubleStat, "Doublestat", "Double stat");
+        as1->SetResettable(false);
+
+        sm.uintStat = 7;
+        sm.doubleStat = 2.3;
+
+        sm.ClearModuleStats();
+        TS_ASSERT_EQUALS (as1->IntValue(), (UINT64) 7);
+        TS_ASSERT_EQUALS (as2->FpValue(), 0);
+    }
+
+
+    // Test a sharded counter registered as a uint stat
+    void testShardedCounter() {
+        X_MODULE_CLASS sm (asimSystem, "stat_module"); 
+        ASIM_SHARDED_COUNTER_CLASS counter;
+        ASIM_STATE as;
+
+        as = sm.RegisterState (&counter, "Shardedstat", "Sharded stat");
+        TS_ASSERT_EQUALS (as->Type(), STATE_UINT);
+        TS_ASSERT_EQUALS (as->Size(), 1U);
+
+        // stats are registered suspended
+        as->Unsuspend();
+        counter += 5;
+        TS_ASSERT_EQUALS (as->IntValue(), (UINT64) 5);
+
+        // updates while suspended are discarded
+        as->Suspend();
+        counter++;
+        as->Unsuspend();
+        TS_ASSERT_EQUALS (as->IntValue(), (UINT64) 5);
+        TS_ASSERT_EQUALS (counter.Value(), (UINT64) 5);
+
+        sm.ClearModuleStats();
+        TS_ASSERT_EQUALS (as->IntValue(), (UINT64) 0);
+        counter++;
+        TS_ASSERT_EQUALS (as->IntValue(), (UINT64) 1);
+    }
 };
 
 #endif // __STAT_TEST_H__
@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ *
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ * 
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright 
+ *   notice, this list of conditions and the following disclaimer in the 
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the Intel Corporation nor the names of its 
+ *   contributors may be used to endorse or promote products derived from 
+ *   this software without specific prior written permission.
+ *  
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __STATE_SAMPLER_TEST_H__
+#define __STATE_SAMPLER_TEST_H__
+
+#include <cxxtest/FTestSuite.h>
+
+#include <pthread.h>
+#include <vector>
+
+#include "asim/syntax.h"
+#include "asim/module.h"
+#include "asim/state.h"
+#include "asim/state_sampler.h"
+
+using namespace std;
+
+
+// A module to serve as the top of the module hierarchy
+class ASIM_SYSTEM_CLASS  : public ASIM_MODULE_CLASS {
+public:
+    ASIM_SYSTEM_CLASS() 
+    : ASIM_MODULE_CLASS(NULL, "system") {};
+} *asimSystem = NULL;
+
+
+// A module with a stat of every type the sampler looks at.  Count(c)
+// sets all the counters to c, the way a simulation thread would.
+class SAMPLED_MODULE_CLASS : public ASIM_MODULE_CLASS {
+  public:
+    UINT64 hits;
+    UINT64 misses[3];
+    double ratio;
+    string label;
+    vector<ASIM_STATE> states;
+
+    SAMPLED_MODULE_CLASS(ASIM_MODULE parent, const char *iname)
+      : ASIM_MODULE_CLASS(parent, iname), hits(0), ratio(0)
+    {
+        misses[0] = misses[1] = misses[2] = 0;
+        states.push_back(RegisterState(&label, "Label", "not sampled"));
+        states.push_back(RegisterState(&hits, "Hits", "hits"));
+        states.push_back(RegisterState(misses, 3, "Misses", "misses"));
+        states.push_back(RegisterState(&ratio, "Ratio", "ratio"));
+    }
+
+    void Count(UINT64 c)
+    {
+        hits = c;
+        misses[0] = misses[1] = misses[2] = c;
+        ratio = c / 4.0;
+    }
+};
+
+
+class StateSamplerTestSuite : public CxxTest::TestSuite
+{
+    // Simulation thread: count and sample up to cycle 'end'
+    struct SIM_ARGS {
+        SAMPLED_MODULE_CLASS *module;
+        STATE_SAMPLER sampler;
+        UINT64 end;
+        volatile bool done;
+    };
+
+    static void *Simulate(void *arg)
+    {
+        SIM_ARGS *a = (SIM_ARGS *) arg;
+        for (UINT64 c = 1; c <= a->end; c++) {
+            a->module->Count(c);
+            a->sampler->Take(c);
+        }
+        a->done = true;
+        return NULL;
+    }
+
+  public:
+    void setUp() {
+        asimSystem = new ASIM_SYSTEM_CLASS();
+    }
+    void tearDown() {
+        delete asimSystem;
+    }
+
+    // keys are case insensitive, and keep their ids in order
+    void testIndex() {
+        STATE_INDEX_CLASS index;
+        index.Init(3);
+        index.Add("/system/Core0", 2);
+        index.Add("/system/core0", 5);
+        index.Add("/system/core1", 7);
+
+        const vector<UINT32> *ids = index.Find("/SYSTEM/CORE0");
+        TS_ASSERT(ids != NULL);
+        if (ids != NULL) {
+            TS_ASSERT_EQUALS(ids->size(), 2U);
+            TS_ASSERT_EQUALS((*ids)[0], 2U);
+            TS_ASSERT_EQUALS((*ids)[1], 5U);
+        }
+        ids = index.Find("/system/Core1");
+        TS_ASSERT(ids != NULL && ids->size() == 1 && (*ids)[0] == 7);
+        TS_ASSERT(index.Find("/system/core2") == NULL);
+        TS_ASSERT(index.Find("/system") == NULL);
+    }
+
+    // handles of the UINT and FP states, in any case; -1 for the others
+    void testLookup() {
+        SAMPLED_MODULE_CLASS m(asimSystem, "cache");
+        STATE_SAMPLER_CLASS sampler(m.states);
+
+        TS_ASSERT_EQUALS(sampler.NumHandles(), 3U);
+        TS_ASSERT_EQUALS(sampler.Lookup("/system/cache/Hits"), 0);
+        TS_ASSERT_EQUALS(sampler.Lookup("/SYSTEM/Cache/hits"), 0);
+        TS_ASSERT_EQUALS(sampler.Lookup("/system/cache/misses"), 1);
+        TS_ASSERT_EQUALS(sampler.Lookup("/system/cache/RATIO"), 2);
+        TS_ASSERT_EQUALS(sampler.GetState(1), m.states[2]);
+
+        TS_ASSERT_EQUALS(sampler.Lookup("/system/cache/Label"), -1);
+        TS_ASSERT_EQUALS(sampler.Lookup("/system/cache/Bogus"), -1);
+        TS_ASSERT_EQUALS(sampler.Lookup("Hits"), -1);
+        TS_ASSERT_EQUALS(sampler.Lookup(""), -1);
+    }
+
+    // reads see the last sample, not the live counters
+    void testRead() {
+        SAMPLED_MODULE_CLASS m(asimSystem, "cache");
+        STATE_SAMPLER_CLASS sampler(m.states);
+        vector<INT32> handles;
+        handles.push_back(2);
+        handles.push_back(0);
+        handles.push_back(1);
+        vector< vector<double> > values;
+
+        m.Count(8);
+        TS_ASSERT_EQUALS(sampler.Read(handles, values), 0U);
+        TS_ASSERT_EQUALS(values.size(), 3U);
+        TS_ASSERT_EQUALS(values[0][0], 0.0);
+
+        sampler.Take(100);
+        m.Count(9);
+        TS_ASSERT_EQUALS(sampler.Read(handles, values), 100U);
+        TS_ASSERT_EQUALS(values.size(), 3U);
+        TS_ASSERT_EQUALS(values[0].size(), 1U);
+        TS_ASSERT_EQUALS(values[0][0], 2.0);
+        TS_ASSERT_EQUALS(values[1].size(), 1U);
+        TS_ASSERT_EQUALS(values[1][0], 8.0);
+        TS_ASSERT_EQUALS(values[2].size(), 3U);
+        TS_ASSERT_EQUALS(values[2][2], 8.0);
+    }
+
+    // a read from another thread gets the values of a single cycle while
+    // the simulation thread keeps sampling
+    void testConsistentRead() {
+        SAMPLED_MODULE_CLASS m(asimSystem, "cache");
+        STATE_SAMPLER_CLASS sampler(m.states);
+        vector<INT32> handles;
+        handles.push_back(0);
+        handles.push_back(1);
+        handles.push_back(2);
+        vector< vector<double> > values;
+
+        SIM_ARGS args;
+        args.module = &m;
+        args.sampler = &sampler;
+        args.end = 200000;
+        args.done = false;
+        pthread_t sim;
+        TS_ASSERT_EQUALS(pthread_create(&sim, NULL, Simulate, &args), 0);
+
+        UINT64 reads = 0;
+        UINT64 torn = 0;
+        UINT64 last = 0;
+        UINT64 backwards = 0;
+        while (!args.done || reads == 0) {
+            UINT64 cycle = sampler.Read(handles, values);
+            double c = cycle;
+            if (values[0][0] != c || values[1][0] != c ||
+                values[1][1] != c || values[1][2] != c ||
+                values[2][0] != c / 4.0)
+            {
+                torn++;
+            }
+            if (cycle < last) {
+                backwards++;
+            }
+            last = cycle;
+            reads++;
+        }
+        pthread_join(sim, NULL);
+
+        TS_ASSERT(reads > 0);
+        TS_ASSERT_EQUALS(torn, 0U);
+        TS_ASSERT_EQUALS(backwards, 0U);
+        TS_ASSERT_EQUALS(sampler.Read(handles, values), 200000U);
+        TS_ASSERT_EQUALS(values[1][2], 200000.0);
+    }
+};
+
+#endif // __STATE_SAMPLER_TEST_H__
@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ *
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ * 
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright 
+ *   notice, this list of conditions and the following disclaimer in the 
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the Intel Corporation nor the names of its 
+ *   contributors may be used to endorse or promote products derived from 
+ *   this software without specific prior written permission.
+ *  
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __STATEOUT_TEST_H__
+#define __STATEOUT_TEST_H__
+
+#include <cxxtest/FTestSuite.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "asim/syntax.h"
+#include "asim/stateout.h"
+#include "asim/mesg.h"
+
+using namespace std;
+
+
+// A value type that STATE_SNAPSHOT_CLASS formats while recording
+struct STATEOUT_TEST_PAIR
+{
+    int first;
+    int second;
+};
+
+inline ostream &
+operator<<(ostream &os, const STATEOUT_TEST_PAIR &p)
+{
+    return os << p.first << ":" << p.second;
+}
+
+
+class StateOutTestSuite : public CxxTest::TestSuite
+{
+    static const UINT64 DEFAULT_BUDGET = 256 * 1024 * 1024;
+
+    // Write a stats tree with every kind of element and value type the
+    // snapshot records differently, with values that depend on seed.
+    void Emit(STATE_OUT so, int seed)
+    {
+        UINT64 uints[16];
+        double doubles[8];
+        for (int i = 0; i < 16; i++)
+        {
+            uints[i] = (i + seed) * 0x123456789ULL;
+        }
+        for (int i = 0; i < 8; i++)
+        {
+            doubles[i] = (i - seed) / 7.0;
+        }
+        STATEOUT_TEST_PAIR pair = { seed, -seed };
+
+        so->AddCompound("module", "top", "top <module> & friends");
+        so->AddScalar("uint", "cycles", "simulated cycles", UINT64(1000 + seed));
+        so->AddScalar("int", "delta", NULL, -seed - 1);
+        so->AddScalar("bool", "flag", "", (seed & 1) != 0);
+        so->AddScalar("double", "ratio", "a ratio", 1.0 / (seed + 3));
+        so->AddScalar("double", "huge", NULL, 1e300 * (seed + 1));
+        so->AddScalar("float", "single", NULL, float(seed) / 3);
+        so->AddScalar("char", "letter", NULL, char('a' + seed % 26));
+        so->AddScalar("string", "name", NULL, string("core<") + char('0' + seed % 10) + ">");
+        so->AddScalar("string", "cname", "a C string", "x&y");
+        so->AddScalar("pair", "pair", NULL, pair);
+        for (int m = 0; m < 3; m++)
+        {
+            so->AddCompound("module", "sub");
+            so->AddVector("uint", "hist", "a histogram", uints, uints + 16);
+            so->AddVector("double", "avg", NULL, doubles, doubles + 8);
+            so->AddVector("uint", "empty", NULL, uints, uints);
+            so->CloseCompound();
+        }
+        so->AddText("free <text> & more");
+        so->CloseCompound();
+    }
+
+    string Contents(const char *file)
+    {
+        ifstream in(file);
+        TS_ASSERT(in.good());
+        ostringstream os;
+        os << in.rdbuf();
+        return os.str();
+    }
+
+    void CheckSame(const char *direct, const char *background)
+    {
+        string d = Contents(direct);
+        TS_ASSERT(!d.empty());
+        TS_ASSERT(d == Contents(background));
+    }
+
+    void Dump(const char *file, bool background, int seed)
+    {
+        STATE_OUT so = new STATE_OUT_CLASS(file, background);
+        Emit(so, seed);
+        delete so;
+    }
+
+public:
+    void tearDown()
+    {
+        STATE_OUT_CLASS::WaitBackgroundDumps();
+        STATE_OUT_CLASS::SetBackgroundBudget(DEFAULT_BUDGET);
+    }
+
+    // The background writer formats the values exactly as the direct
+    // output does.
+    void testSameOutput()
+    {
+        Dump("stateout_direct.xml", false, 0);
+        Dump("stateout_bg.xml", true, 0);
+        STATE_OUT_CLASS::WaitBackgroundDumps();
+        CheckSame("stateout_direct.xml", "stateout_bg.xml");
+    }
+
+    // Several dumps in flight, each new one waiting for room in a
+    // budget smaller than one dump. Every file holds the values of
+    // its own dump point.
+    void testQueuedDumps()
+    {
+        STATE_OUT_CLASS::SetBackgroundBudget(1);
+        char direct[32], bg[32];
+        for (int seed = 1; seed <= 4; seed++)
+        {
+            sprintf(direct, "stateout_direct_%d.xml", seed);
+            sprintf(bg, "stateout_bg_%d.xml", seed);
+            Dump(bg, true, seed);
+            Dump(direct, false, seed);
+        }
+        STATE_OUT_CLASS::WaitBackgroundDumps();
+        for (int seed = 1; seed <= 4; seed++)
+        {
+            sprintf(direct, "stateout_direct_%d.xml", seed);
+            sprintf(bg, "stateout_bg_%d.xml", seed);
+            CheckSame(direct, bg);
+        }
+        // dumps with other values differ
+        TS_ASSERT(Contents("stateout_direct_1.xml") !=
+                  Contents("stateout_direct_2.xml"));
+    }
+
+    // With no budget a background dump writes its file directly.
+    void testNoBudget()
+    {
+        STATE_OUT_CLASS::SetBackgroundBudget(0);
+        Dump("stateout_direct.xml", false, 5);
+        Dump("stateout_nobudget.xml", true, 5);
+        CheckSame("stateout_direct.xml", "stateout_nobudget.xml");
+    }
+
+    // Queue dumps in a child that exits without waiting for them, with
+    // exit() or on an error. Returns the exit status of the child.
+    int ExitWithDumps(bool error)
+    {
+        pid_t child = fork();
+        TS_ASSERT(child >= 0);
+        if (child == 0)
+        {
+            char bg[32];
+            for (int seed = 1; seed <= 4; seed++)
+            {
+                sprintf(bg, "stateout_exit_%d.xml", seed);
+                Dump(bg, true, seed);
+            }
+            if (error)
+            {
+                ASIMERROR("stateout_test: exiting on an error" << endl);
+            }
+            exit(0);
+        }
+        int status;
+        TS_ASSERT_EQUALS(waitpid(child, &status, 0), child);
+        TS_ASSERT(WIFEXITED(status));
+        return WEXITSTATUS(status);
+    }
+
+    void CheckExitDumps()
+    {
+        char direct[32], bg[32];
+        for (int seed = 1; seed <= 4; seed++)
+        {
+            sprintf(direct, "stateout_direct_%d.xml", seed);
+            sprintf(bg, "stateout_exit_%d.xml", seed);
+            Dump(direct, false, seed);
+            CheckSame(direct, bg);
+            unlink(bg);
+        }
+    }
+
+    // The queued dumps are written when the simulator exits, also
+    // when it did not wait for them or it stops on an error.
+    void testExitWritesQueuedDumps()
+    {
+        TS_ASSERT_EQUALS(ExitWithDumps(false), 0);
+        CheckExitDumps();
+        TS_ASSERT_EQUALS(ExitWithDumps(true), 1);
+        CheckExitDumps();
+    }
+};
+
+#endif // __STATEOUT_TEST_H__
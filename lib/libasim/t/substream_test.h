@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ *
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ * 
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright 
+ *   notice, this list of conditions and the following disclaimer in the 
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the Intel Corporation nor the names of its 
+ *   contributors may be used to endorse or promote products derived from 
+ *   this software without specific prior written permission.
+ *  
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __SUBSTREAM_TEST_H__
+#define __SUBSTREAM_TEST_H__
+
+#include <cxxtest/FTestSuite.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#include "asim/syntax.h"
+#include "asim/dralServer.h"
+
+#include "dral_trace.h"
+
+using namespace std;
+
+
+class SubstreamTestSuite : public CxxTest::TestSuite
+{
+    static const UINT32 WORKERS = 2;  // threads sending events
+    static const UINT32 EVENTS = 2;   // clock events of every point
+    static const UINT64 POINTS = 2000;
+    static const UINT64 AHEAD = 4;    // points the workers may run ahead
+
+    struct WORKER
+    {
+        SubstreamTestSuite *suite;
+        UINT32 id;
+    };
+
+    DRAL_SERVER_CLASS *server;
+    UINT16 nodes[WORKERS];
+    UINT16 edges[WORKERS];
+    UINT16 clocks[EVENTS];
+    DRAL_SUBSTREAM substreams[WORKERS];
+    UINT32 live[WORKERS][EVENTS];   // item of every worker in every slot
+    UINT32 firstItem[WORKERS];
+    volatile UINT64 done[WORKERS];  // points sent by every worker
+    volatile UINT64 merged;         // points merged
+
+    // The events of worker w in clock event k of point t.  Some items
+    // are moved and deleted in the same cycle, so their delete is held
+    // behind the move, and some points send nothing.
+    void Work(UINT32 w, UINT64 t, UINT32 k)
+    {
+        if ((t + w + k) % 5 == 0)
+        {
+            return;
+        }
+        UINT32 pos[1] = { k };
+        UINT32 old = live[w][k];
+        if (old != 0)
+        {
+            server->ExitNode(nodes[w], old, 1, pos);
+            if (t % 3 == 0)
+            {
+                server->QueueMoveItem(edges[w], old);
+            }
+            server->DeleteItem(old);
+        }
+        UINT32 item = server->AllocItemId();
+        if (firstItem[w] == 0)
+        {
+            firstItem[w] = item;
+        }
+        server->NewItem(item);
+        server->SetItemTag(item, "point", t);
+        char str[32];
+        sprintf(str, "w%u_%llu", w, (unsigned long long)(t % 7));
+        server->SetItemTag(item, "name", str);
+        server->EnterNode(nodes[w], item, 1, pos);
+        server->QueueMoveItem(edges[w], item);
+        server->QueueMoveItem(edges[w], item);
+        live[w][k] = item;
+    }
+
+    static void *WorkerThread(void *arg)
+    {
+        WORKER *worker = (WORKER *)arg;
+        SubstreamTestSuite *suite = worker->suite;
+        UINT32 w = worker->id;
+        DRAL_SERVER_CLASS::AttachSubstream(suite->substreams[w]);
+        for (UINT64 t = 0; t < POINTS; t++)
+        {
+            while (suite->merged + AHEAD < t)
+                ;
+            for (UINT32 k = 0; k < EVENTS; k++)
+            {
+                suite->server->BeginChunk(t, k);
+                suite->Work(w, t, k);
+                suite->server->EndChunk();
+            }
+            __sync_synchronize();
+            suite->done[w] = t + 1;
+        }
+        DRAL_SERVER_CLASS::AttachSubstream(NULL);
+        return NULL;
+    }
+
+    // Send the events of the workers from this thread, in order, or from
+    // a thread per worker through substreams.
+    void Generate(const char *name, bool threaded)
+    {
+        server = new DRAL_SERVER_CLASS(name, 4096, false, true, false);
+        UINT32 capacity[1] = { EVENTS };
+        for (UINT32 w = 0; w < WORKERS; w++)
+        {
+            char nodeName[16];
+            sprintf(nodeName, "worker%u", w);
+            nodes[w] = server->NewNode(nodeName, 0);
+            server->SetNodeLayout(nodes[w], 1, capacity);
+            firstItem[w] = 0;
+            done[w] = 0;
+            for (UINT32 k = 0; k < EVENTS; k++)
+            {
+                live[w][k] = 0;
+            }
+        }
+        for (UINT32 w = 0; w < WORKERS; w++)
+        {
+            edges[w] = server->NewEdge(nodes[w], nodes[(w + 1) % WORKERS],
+                                       1, 1, "out");
+        }
+        for (UINT32 k = 0; k < EVENTS; k++)
+        {
+            char clockName[16];
+            sprintf(clockName, "clock%u", k);
+            clocks[k] = server->NewClock(1000 * (k + 1), 0, 1, clockName);
+        }
+        if (threaded)
+        {
+            for (UINT32 w = 0; w < WORKERS; w++)
+            {
+                substreams[w] = server->NewSubstream();
+                TS_ASSERT(substreams[w] != NULL);
+            }
+        }
+        server->TurnOn();
+
+        if (threaded)
+        {
+            merged = 0;
+            pthread_t threads[WORKERS];
+            WORKER workers[WORKERS];
+            for (UINT32 w = 0; w < WORKERS; w++)
+            {
+                workers[w].suite = this;
+                workers[w].id = w;
+                pthread_create(&threads[w], NULL, WorkerThread, &workers[w]);
+            }
+            for (UINT64 t = 0; t < POINTS; t++)
+            {
+                for (UINT32 w = 0; w < WORKERS; w++)
+                {
+                    while (done[w] <= t)
+                        ;
+                }
+                __sync_synchronize();
+                for (UINT32 k = 0; k < EVENTS; k++)
+                {
+                    server->Cycle(clocks[k], t, 0);
+                    server->MergeSubstreams(t, k);
+                }
+                merged = t + 1;
+            }
+            for (UINT32 w = 0; w < WORKERS; w++)
+            {
+                pthread_join(threads[w], NULL);
+            }
+        }
+        else
+        {
+            for (UINT64 t = 0; t < POINTS; t++)
+            {
+                for (UINT32 k = 0; k < EVENTS; k++)
+                {
+                    server->Cycle(clocks[k], t, 0);
+                    for (UINT32 w = 0; w < WORKERS; w++)
+                    {
+                        Work(w, t, k);
+                    }
+                }
+            }
+        }
+        delete server;
+        server = NULL;
+    }
+
+    void CheckEqual(const vector<string> &a, const vector<string> &b)
+    {
+        TS_ASSERT_EQUALS(a.size(), b.size());
+        for (UINT32 i = 0; i < a.size() && i < b.size(); i++)
+        {
+            if (a[i] != b[i])
+            {
+                TS_ASSERT_EQUALS(a[i], b[i]);
+                break;
+            }
+        }
+    }
+
+public:
+    // The merged trace is the serial trace, but for the item ids, and the
+    // same every time.
+    void testThreadedMatchesSerial()
+    {
+        Generate("substream_serial", false);
+        Generate("substream_threaded", true);
+        for (UINT32 w = 0; w < WORKERS; w++)
+        {
+            // item ids carry the substream in the high bits
+            TS_ASSERT_EQUALS(firstItem[w] >> 30, w + 1);
+        }
+        Generate("substream_threaded2", true);
+
+        DRAL_TRACE_LISTENER_CLASS serial(true), threaded(true);
+        TS_ASSERT(serial.Read("substream_serial.drl.gz"));
+        TS_ASSERT(threaded.Read("substream_threaded.drl.gz"));
+        TS_ASSERT(serial.events.size() > POINTS * EVENTS * WORKERS);
+        CheckEqual(serial.events, threaded.events);
+
+        DRAL_TRACE_LISTENER_CLASS first, second;
+        TS_ASSERT(first.Read("substream_threaded.drl.gz"));
+        TS_ASSERT(second.Read("substream_threaded2.drl.gz"));
+        CheckEqual(first.events, second.events);
+    }
+};
+
+#endif // __SUBSTREAM_TEST_H__
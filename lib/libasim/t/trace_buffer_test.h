@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ *
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ * 
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright 
+ *   notice, this list of conditions and the following disclaimer in the 
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the Intel Corporation nor the names of its 
+ *   contributors may be used to endorse or promote products derived from 
+ *   this software without specific prior written permission.
+ *  
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __TRACE_BUFFER_TEST_H__
+#define __TRACE_BUFFER_TEST_H__
+
+#include <cxxtest/FTestSuite.h>
+#include <sstream>
+#include <pthread.h>
+
+#include "asim/syntax.h"
+#include "asim/trace_buffer.h"
+
+using namespace std;
+
+
+class TraceBufferTestSuite : public CxxTest::TestSuite
+{
+    static const UINT32 THREADS = 3;
+    static const UINT64 POINTS = 2000;
+    static const UINT32 EVENTS = 3;
+    static const UINT32 MODULES = 7;
+
+    TRACE_BUFFER buffers[THREADS];
+    volatile UINT64 done[THREADS];
+    volatile UINT64 merged;
+    ostringstream out;
+
+    struct WORKER
+    {
+        TraceBufferTestSuite *suite;
+        UINT32 id;
+    };
+
+    // Does module i of event e write records at time point t?
+    static bool Writes(UINT64 t, UINT32 e, UINT32 i)
+    {
+        return (t + i) % 4 != 0;
+    }
+
+    // Records of the modules clocked by one thread: module i of event e
+    // belongs to thread (e * MODULES + i + t) % THREADS.
+    static void *WorkerThread(void *arg)
+    {
+        WORKER *worker = (WORKER *)arg;
+        TraceBufferTestSuite *suite = worker->suite;
+        TRACE_BUFFER buffer = suite->buffers[worker->id];
+        threadTraceBuffer = buffer;
+        for (UINT64 t = 0; t < POINTS; t++)
+        {
+            while (suite->merged + 3 < t)
+                ;
+            for (UINT32 e = 0; e < EVENTS; e++)
+            {
+                for (UINT32 i = 0; i < MODULES; i++)
+                {
+                    if ((e * MODULES + i + t) % THREADS == worker->id &&
+                        Writes(t, e, i))
+                    {
+                        buffer->SetKey(t, e, i);
+                        for (UINT32 r = 0; r <= i % 3; r++)
+                        {
+                            TRACE_BUFFER_RECORD(&suite->out,
+                                "t" << t << " e" << e << " m" << i << " r" << r, );
+                        }
+                    }
+                }
+            }
+            buffer->ClearKey();
+            __sync_synchronize();
+            suite->done[worker->id] = t + 1;
+        }
+        threadTraceBuffer = NULL;
+        return NULL;
+    }
+
+public:
+    // Records are merged in key order, whatever the buffer they are in,
+    // and only up to the time point asked for.
+    void testMergeOrder()
+    {
+        ostringstream a, b;
+        TRACE_BUFFER first = new TRACE_BUFFER_CLASS();
+        TRACE_BUFFER second = new TRACE_BUFFER_CLASS();
+        vector<TRACE_BUFFER> all;
+        all.push_back(first);
+        all.push_back(second);
+
+        first->SetKey(0, 1, 0);
+        first->Append(&a, "0.1.0");
+        first->SetKey(0, 1, 2);
+        first->Append(&a, "0.1.2 a");
+        first->Append(&b, "0.1.2 b");
+        first->SetKey(1, 0, 0);
+        first->Append(&a, "1.0.0");
+        first->SetKey(1, 1, 0);
+        first->Append(&a, "1.1.0 first");
+        first->ClearKey();
+
+        second->SetKey(0, 0, 3);
+        second->Append(&a, "0.0.3");
+        second->SetKey(0, 1, 1);
+        second->Append(&a, "0.1.1");
+        second->SetKey(0, 2, 0);
+        second->Append(&a, "0.2.0");
+        second->SetKey(1, 1, 0);
+        second->Append(&a, "1.1.0 second");
+        second->SetKey(2, 0, 0);
+        second->Append(&a, "2.0.0");
+        second->ClearKey();
+
+        TRACE_BUFFER_CLASS::Merge(all, 0);
+        TS_ASSERT_EQUALS(a.str(), string("0.0.3\n0.1.0\n0.1.1\n0.1.2 a\n0.2.0\n"));
+        TS_ASSERT_EQUALS(b.str(), string("0.1.2 b\n"));
+
+        // the same key in both buffers goes in buffer order
+        a.str("");
+        TRACE_BUFFER_CLASS::Merge(all, 1);
+        TS_ASSERT_EQUALS(a.str(), string("1.0.0\n1.1.0 first\n1.1.0 second\n"));
+
+        a.str("");
+        TRACE_BUFFER_CLASS::Merge(all, 5);
+        TS_ASSERT_EQUALS(a.str(), string("2.0.0\n"));
+        TRACE_BUFFER_CLASS::Merge(all, 5);
+        TS_ASSERT_EQUALS(a.str(), string("2.0.0\n"));
+
+        delete first;
+        delete second;
+    }
+
+    // Threads running ahead of the merge write the records of the serial
+    // order, reusing the chunks already merged.
+    void testThreadedMerge()
+    {
+        ostringstream serial;
+        for (UINT64 t = 0; t < POINTS; t++)
+        {
+            for (UINT32 e = 0; e < EVENTS; e++)
+            {
+                for (UINT32 i = 0; i < MODULES; i++)
+                {
+                    for (UINT32 r = 0; Writes(t, e, i) && r <= i % 3; r++)
+                    {
+                        serial << "t" << t << " e" << e << " m" << i
+                               << " r" << r << endl;
+                    }
+                }
+            }
+        }
+
+        out.str("");
+        merged = 0;
+        vector<TRACE_BUFFER> all;
+        pthread_t threads[THREADS];
+        WORKER workers[THREADS];
+        for (UINT32 w = 0; w < THREADS; w++)
+        {
+            buffers[w] = new TRACE_BUFFER_CLASS();
+            all.push_back(buffers[w]);
+            done[w] = 0;
+        }
+        for (UINT32 w = 0; w < THREADS; w++)
+        {
+            workers[w].suite = this;
+            workers[w].id = w;
+            pthread_create(&threads[w], NULL, WorkerThread, &workers[w]);
+        }
+        for (UINT64 t = 0; t < POINTS; t++)
+        {
+            for (UINT32 w = 0; w < THREADS; w++)
+            {
+                while (done[w] <= t)
+                    ;
+            }
+            TRACE_BUFFER_CLASS::Merge(all, t);
+            merged = t + 1;
+        }
+        for (UINT32 w = 0; w < THREADS; w++)
+        {
+            pthread_join(threads[w], NULL);
+            delete buffers[w];
+        }
+        TS_ASSERT(out.str() == serial.str());
+    }
+};
+
+#endif // __TRACE_BUFFER_TEST_H__
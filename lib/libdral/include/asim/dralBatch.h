@@ -0,0 +1,193 @@
+/**************************************************************************
+ * Copyright (c) 2014, Intel Corporation
+ *
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ * 
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright 
+ *   notice, this list of conditions and the following disclaimer in the 
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the Intel Corporation nor the names of its 
+ *   contributors may be used to endorse or promote products derived from 
+ *   this software without specific prior written permission.
+ *  
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file dralBatch.h
+ * @author Pau Cabre 
+ * @brief per cycle batch of DRAL events
+ */
+
+
+#ifndef DRAL_BATCH_H
+#define DRAL_BATCH_H
+
+#include <string.h>
+#include <vector>
+using namespace std;
+
+#include "asim/dral_syntax.h"
+#include "asim/dralServerDefines.h"
+
+/*
+ * A batch of the most frequent per cycle events (MoveItems, EnterNode
+ * and SetItemTag with a single value). A module records a whole cycle
+ * worth of events in it and commits it with DRAL_SERVER_CLASS::Commit,
+ * which encodes all of them in one pass and writes them with a single
+ * call. Committing produces exactly the same trace as issuing the events
+ * one by one in the same order.
+ *
+ * The storage is reused from one cycle to the next, so once it has
+ * grown to the size of a cycle recording does not allocate memory.
+ * Tag names are kept by pointer: they must live until the commit.
+ */
+class DRAL_EVENT_BATCH_CLASS
+{
+  public:
+
+    enum EVENT_TYPE
+    {
+        MOVEITEMS,
+        ENTERNODE,
+        SETITEMTAG
+    };
+
+    struct EVENT
+    {
+        UINT8 type;
+        UINT8 len;        // items moved, dimensions or tag name length
+        UINT16 id;        // edge or node
+        UINT32 item;      // item, or first item of a MoveItems in values
+        UINT32 pos;       // first position in values (NO_POSITION if none)
+        const char * tag;
+        UINT64 value;
+    };
+
+    static const UINT32 NO_POSITION = 0xffffffff;
+
+    DRAL_EVENT_BATCH_CLASS (UINT32 events = 256)
+    {
+        eventList.reserve(events);
+        values.reserve(events * 2);
+    }
+
+    inline void MoveItems (
+        UINT16 edgeId, UINT32 n, UINT32 itemId[], UINT32 position[] = NULL);
+
+    inline void EnterNode (
+        UINT16 nodeId, UINT32 itemId, UINT16 dim, UINT32 position[]);
+
+    inline void EnterNode (UINT16 nodeId, UINT32 itemId, UINT32 slot)
+    {
+        EnterNode(nodeId, itemId, 1, &slot);
+    }
+
+    inline void SetItemTag (UINT32 itemId, const char tag_name[], UINT64 value);
+
+    /*
+     * Forget the recorded events but keep the memory
+     */
+    void Clear (void)
+    {
+        eventList.clear();
+        values.clear();
+    }
+
+    bool Empty (void) const { return eventList.empty(); }
+    UINT32 Size (void) const { return eventList.size(); }
+
+    const EVENT & GetEvent (UINT32 i) const { return eventList[i]; }
+
+    /*
+     * Item ids and positions of the events
+     */
+    UINT32 * GetValues (UINT32 first) { return &values[first]; }
+
+  private:
+
+    vector<EVENT> eventList;
+    vector<UINT32> values;
+
+    UINT32 AddValues (UINT32 n, UINT32 v[])
+    {
+        UINT32 first = values.size();
+        values.insert(values.end(), v, v + n);
+        return first;
+    }
+};
+typedef DRAL_EVENT_BATCH_CLASS * DRAL_EVENT_BATCH;
+
+void
+DRAL_EVENT_BATCH_CLASS::MoveItems (
+    UINT16 edgeId, UINT32 n, UINT32 itemId[], UINT32 position[])
+{
+    DRAL_ASSERT(n<32,"Parameter n has to be fewer than 31");
+    if (n == 0)
+    {
+        return;
+    }
+    EVENT e;
+    e.type = MOVEITEMS;
+    e.len = n;
+    e.id = edgeId;
+    e.item = AddValues(n, itemId);
+    e.pos = (position != NULL ? AddValues(n, position) : UINT32(NO_POSITION));
+    e.tag = NULL;
+    e.value = 0;
+    eventList.push_back(e);
+}
+
+void
+DRAL_EVENT_BATCH_CLASS::EnterNode (
+    UINT16 nodeId, UINT32 itemId, UINT16 dim, UINT32 position[])
+{
+    DRAL_ASSERT(dim!=0 && position!=NULL,
+        "Number of dimensions == 0 or position list == NULL");
+    DRAL_ASSERT(dim < 16, "Number of dimensions must be lower than 16");
+    EVENT e;
+    e.type = ENTERNODE;
+    e.len = dim;
+    e.id = nodeId;
+    e.item = itemId;
+    e.pos = AddValues(dim, position);
+    e.tag = NULL;
+    e.value = 0;
+    eventList.push_back(e);
+}
+
+void
+DRAL_EVENT_BATCH_CLASS::SetItemTag (
+    UINT32 itemId, const char tag_name[], UINT64 value)
+{
+    DRAL_ASSERT(tag_name!=NULL,"No tag name provided");
+    UINT16 tag_name_len = strlen(tag_name)+1;
+    DRAL_ASSERT(tag_name_len < 256,
+        "Parameter tag_name " << tag_name << " is too long");
+    EVENT e;
+    e.type = SETITEMTAG;
+    e.len = tag_name_len;
+    e.id = 0;
+    e.item = itemId;
+    e.pos = NO_POSITION;
+    e.tag = tag_name;
+    e.value = value;
+    eventList.push_back(e);
+}
+
+#endif /* DRAL_BATCH_H */
@@ -0,0 +1,148 @@
+/**************************************************************************
+ * Copyright (c) 2014, Intel Corporation
+ *
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ * 
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright 
+ *   notice, this list of conditions and the following disclaimer in the 
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the Intel Corporation nor the names of its 
+ *   contributors may be used to endorse or promote products derived from 
+ *   this software without specific prior written permission.
+ *  
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file dralChunkList.h
+ * @author Pau Cabre 
+ * @brief chunks handed over from one thread to another without locks
+ */
+
+
+#ifndef DRAL_CHUNK_LIST_H
+#define DRAL_CHUNK_LIST_H
+
+#include "asim/dral_syntax.h"
+
+/*
+ * A list of chunks with a single producer thread and a single consumer
+ * thread, without locks. It carries the chunks of a DRAL_SUBSTREAM_CLASS
+ * and those of the trace buffers of the threaded clock server
+ * (TRACE_BUFFER_CLASS).
+ *
+ * The producer fills a chunk taken with Alloc and appends it with Push.
+ * The consumer looks at the oldest chunk appended with Front and is done
+ * with it with Pop. Alloc reuses the chunks the consumer is done with,
+ * with their memory, so once the list has grown to the chunks in flight
+ * it does not allocate memory.
+ *
+ * CHUNK must have a 'CHUNK * volatile next' member.
+ */
+template <class CHUNK>
+class DRAL_CHUNK_LIST_CLASS
+{
+  public:
+
+    DRAL_CHUNK_LIST_CLASS (void)
+    {
+        // the list always has a chunk: the last one the consumer is done with
+        head = new CHUNK;
+        head->next = NULL;
+        tail = head;
+        first = head;
+        headCopy = head;
+    }
+
+    ~DRAL_CHUNK_LIST_CLASS (void)
+    {
+        while (first != NULL)
+        {
+            CHUNK * c = first;
+            first = first->next;
+            delete c;
+        }
+    }
+
+    /*
+     * Producer side: a chunk the consumer is done with, or a new one.
+     */
+    CHUNK * Alloc (void)
+    {
+        CHUNK * c;
+        if (first == headCopy)
+        {
+            __sync_synchronize();
+            headCopy = head;
+        }
+        if (first != headCopy)
+        {
+            c = first;
+            first = first->next;
+        }
+        else
+        {
+            c = new CHUNK;
+        }
+        c->next = NULL;
+        return c;
+    }
+
+    /*
+     * Producer side: appends a chunk, already filled.
+     */
+    void Push (CHUNK * c)
+    {
+        // the chunk must be complete before the consumer can see it
+        __sync_synchronize();
+        tail->next = c;
+        tail = c;
+    }
+
+    /*
+     * Consumer side: the oldest chunk appended, NULL if there is none.
+     */
+    CHUNK * Front (void) const
+    {
+        CHUNK * c = head->next;
+        __sync_synchronize();
+        return c;
+    }
+
+    /*
+     * Consumer side: done with the chunk returned by Front, the producer
+     * can reuse it.
+     */
+    void Pop (void)
+    {
+        __sync_synchronize();
+        head = head->next;
+    }
+
+  private:
+
+    // producer
+    CHUNK * tail;      ///< Last chunk in the list.
+    CHUNK * first;     ///< Oldest chunk that may be reused.
+    CHUNK * headCopy;  ///< Last value of head seen by the producer.
+
+    // consumer
+    CHUNK * volatile head; ///< Last chunk the consumer is done with.
+};
+
+#endif /* DRAL_CHUNK_LIST_H */
@@ -50,9 +50,10 @@
 #include "asim/dralClientBinary_v2.h"
 #include "asim/dralClientBinary_v3.h"
 #include "asim/dralClientBinary_v4.h"
+#include "asim/dralClientBinary_v5.h"
 
 
-#define DRAL_CLIENT_VERSION_MAJOR 4 ///< Interface version
+#define DRAL_CLIENT_VERSION_MAJOR 5 ///< Interface version
 #define DRAL_CLIENT_ASCII_VERSION_MAJOR 1 ///< DEPRECATED
                                            // It used to be the supported
                                            // ascii inteface
@@ -118,6 +119,44 @@ class DRAL_CLIENT_CLASS
      */
     inline INT32 ProcessNextEvent (bool blocking, UINT16 num_events);
 
+    /**
+     * @brief Number of independently decodable blocks of the trace
+     *
+     * Traces written with \c DRAL_SERVER_CLASS::SetBlockCycles() are split
+     * in blocks that can be decoded without decoding the previous ones.
+     * Several threads can decode disjoint ranges of blocks in parallel,
+     * each one with its own client (and file descriptor).
+     * @return The number of blocks, 0 if the trace has no block index
+     */
+    inline UINT32 GetNumBlocks(void);
+
+    /**
+     * @brief First cycle of a block
+     * @param block The block number
+     * @return The first cycle of the block
+     */
+    inline UINT64 GetBlockCycle(UINT32 block);
+
+    /**
+     * @brief Continue processing events at the beginning of a block
+     *
+     * The events before the first block (graph definition...) are
+     * processed first if they have not been processed yet.
+     * @param block The block number
+     * @return false if the trace has no such block or is not seekable
+     */
+    inline bool SeekToBlock(UINT32 block);
+
+    /**
+     * @brief Continue processing events at the block holding a cycle
+     *
+     * The events are processed from the beginning of the block, so some
+     * events of cycles before \c cycle may still be received.
+     * @param cycle The cycle to go to
+     * @return false if the trace has no block index or is not seekable
+     */
+    inline bool SeekToCycle(UINT64 cycle);
+
   private:
 
     /**
@@ -192,4 +231,57 @@ DRAL_CLIENT_CLASS::GetNumBytesRead(void)
 }
 
 
+UINT32
+DRAL_CLIENT_CLASS::GetNumBlocks(void)
+{
+    if (!error)
+    {
+        return implementation->GetNumBlocks();
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+UINT64
+DRAL_CLIENT_CLASS::GetBlockCycle(UINT32 block)
+{
+    if (!error)
+    {
+        return implementation->GetBlockCycle(block);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+bool
+DRAL_CLIENT_CLASS::SeekToBlock(UINT32 block)
+{
+    if (!error)
+    {
+        return implementation->SeekToBlock(block);
+    }
+    else
+    {
+        return false;
+    }
+}
+
+bool
+DRAL_CLIENT_CLASS::SeekToCycle(UINT64 cycle)
+{
+    if (!error)
+    {
+        return implementation->SeekToCycle(cycle);
+    }
+    else
+    {
+        return false;
+    }
+}
+
+
 #endif /* _DRALCLIENT_H */
@@ -77,7 +77,11 @@ enum DRAL3_COMMANDS
     DRAL3_SETCYCLETAG_STRING,
     DRAL3_SETCYCLETAG_SET,
     DRAL3_NEWTAG,
-    DRAL3_NEWSTRINGVALUE
+    DRAL3_NEWSTRINGVALUE,
+    DRAL3_BLOCK,            ///< Version 5: start of an independent block
+    DRAL3_BLOCKINDEX,       ///< Version 5: cycle -> offset of every block
+    DRAL3_INDEXLOCATOR,     ///< Version 5: offset of the block index
+    DRAL3_SUBSTREAM         ///< Version 5: commands of another encoder follow
 } ;
 
 enum DRAL3_VALUE_SIZE
@@ -123,6 +127,11 @@ class DRAL_CLIENT_BINARY_3_IMPLEMENTATION_CLASS
      */
     bool Error ();
 
+    /**
+     * Commands added by later versions. None in this version.
+     */
+    virtual bool OtherCommand (UINT8 command);
+
     bool Cycle ();
     bool StartActivity ();
     bool NewNode ();
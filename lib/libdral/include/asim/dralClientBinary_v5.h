@@ -0,0 +1,94 @@
+/**************************************************************************
+ * Copyright (c) 2014, Intel Corporation
+ *
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ * 
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright 
+ *   notice, this list of conditions and the following disclaimer in the 
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the Intel Corporation nor the names of its 
+ *   contributors may be used to endorse or promote products derived from 
+ *   this software without specific prior written permission.
+ *  
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file dralClientBinary_v5.h
+ * @author Pau Cabre
+ * @brief dral client binary defines for dral version 5, this is like version 4 with the trace split in blocks that can be decoded independently
+ */
+
+#ifndef DRAL_CLIENT_BINARY_V5_H
+#define DRAL_CLIENT_BINARY_V5_H
+
+#include <vector>
+#include <utility>
+
+#include "asim/dralClientBinary_v4.h"
+
+/**
+ * BINARY client version 5 implementation class
+ *
+ * Version 5 traces are made of blocks. The delta encoding state is reset
+ * at the beginning of every block and, in compressed traces, every block
+ * is a gzip member of its own, so decoding can start at any block once the
+ * commands before the first one (version, graph...) have been processed.
+ * The index with the first cycle and the file offset of every block is
+ * found through a locator at the very end of the file.
+ *
+ * The events sent in parallel by several threads are merged in chunks
+ * encoded by each thread, each one starting with a substream command that
+ * resets the delta encoding state as well.
+ */
+class DRAL_CLIENT_BINARY_5_IMPLEMENTATION_CLASS
+    : public DRAL_CLIENT_BINARY_4_IMPLEMENTATION_CLASS
+{
+  public:
+
+    DRAL_CLIENT_BINARY_5_IMPLEMENTATION_CLASS (
+        DRAL_BUFFERED_READ dral_read, DRAL_LISTENER dralListener);
+    
+    virtual ~DRAL_CLIENT_BINARY_5_IMPLEMENTATION_CLASS ();
+
+    UINT32 GetNumBlocks(void);
+    UINT64 GetBlockCycle(UINT32 block);
+    bool SeekToBlock(UINT32 block);
+    bool SeekToCycle(UINT64 cycle);
+
+  protected:
+
+    bool OtherCommand (UINT8 command);
+
+    bool Block ();
+    bool Substream ();
+    bool BlockIndex ();
+    bool IndexLocator ();
+
+  private:
+
+    bool LoadIndex ();
+
+    bool firstBlockFound; ///< The commands before the first block are done.
+    bool indexLoaded;     ///< The index has already been looked for.
+
+    /// First cycle and file offset of every block.
+    vector<pair<UINT64, UINT64> > blocks;
+};
+
+#endif /* DRAL_CLIENT_BINARY_V5_H */
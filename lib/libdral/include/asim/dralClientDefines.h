@@ -85,6 +85,10 @@
 #define DRAL_ERROR                      11
 #endif
 
+#ifndef DRAL_BINARY_5
+#define DRAL_BINARY_5                   12
+#endif
+
 #ifndef DRAL_VERSION
 #define DRAL_VERSION                    13
 #endif
@@ -64,6 +64,15 @@ class DRAL_CLIENT_IMPLEMENTATION_CLASS
     
     UINT64 GetNumBytesRead(void);
 
+    /*
+     * Random access to traces split in blocks. The versions without
+     * blocks have no block at all.
+     */
+    virtual UINT32 GetNumBlocks(void);
+    virtual UINT64 GetBlockCycle(UINT32 block);
+    virtual bool SeekToBlock(UINT32 block);
+    virtual bool SeekToCycle(UINT64 cycle);
+
   protected:
 
     /*
@@ -47,5 +47,10 @@
 #define TAR_FILE_MAGICNUM ('T'+'A'+'R')
 #endif
 
+// Last 8 bytes of a trace with a block index
+#ifndef DRAL_INDEX_MAGICNUM
+#define DRAL_INDEX_MAGICNUM 0x5845444e494c5244ULL   // "DRLINDEX"
+#endif
+
 #endif /* DRAL_DEFINES_H */
 
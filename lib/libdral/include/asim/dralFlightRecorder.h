@@ -0,0 +1,150 @@
+/**************************************************************************
+ * Copyright (c) 2014, Intel Corporation
+ *
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ * 
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright 
+ *   notice, this list of conditions and the following disclaimer in the 
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the Intel Corporation nor the names of its 
+ *   contributors may be used to endorse or promote products derived from 
+ *   this software without specific prior written permission.
+ *  
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file dralFlightRecorder.h
+ * @author Pau Cabre 
+ * @brief in memory ring of the last blocks of a DRAL trace
+ */
+
+
+#ifndef DRAL_FLIGHT_RECORDER_H
+#define DRAL_FLIGHT_RECORDER_H
+
+#include <vector>
+#include <utility>
+using namespace std;
+
+#include "asim/dral_syntax.h"
+
+class DRAL_BUFFERED_WRITE_CLASS;
+
+/*
+ * Keeps the encoding of a trace split in blocks (see
+ * DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS::SetBlockCycles) in memory:
+ * only the last 'blocks' blocks are kept and the memory of the oldest
+ * one is reused for the next one, so once the ring has been filled
+ * recording does not allocate memory.
+ *
+ * The commands written before the first block, and the ones that
+ * describe the graph whenever they are written (see BeginDictionary),
+ * are kept apart in the dictionary, which is never dropped. Dump writes
+ * the dictionary followed by the blocks, from the oldest one, which is a
+ * trace that can be decoded on its own.
+ */
+class DRAL_FLIGHT_RECORDER_CLASS
+{
+  public:
+
+    DRAL_FLIGHT_RECORDER_CLASS (UINT32 blocks);
+
+    void Write (const void * buf, UINT32 n)
+    {
+        const char * p = (const char *) buf;
+        current->insert(current->end(), p, p + n);
+    }
+
+    /*
+     * The following block starts with the cycle command of cycle 'n'
+     */
+    void NewBlock (UINT64 n);
+
+    /*
+     * Everything written between BeginDictionary and EndDictionary goes
+     * to the dictionary instead of the current block
+     */
+    void BeginDictionary (void)
+    {
+        saved = current;
+        current = &dictionary;
+    }
+
+    void EndDictionary (void)
+    {
+        current = saved;
+    }
+
+    /*
+     * Write the dictionary and the blocks to 'out'. The first cycle and
+     * the offset of every block are appended to 'index' (nothing is
+     * appended if 'out' is not seekable).
+     */
+    void Dump (
+        DRAL_BUFFERED_WRITE_CLASS * out,
+        vector<pair<UINT64, UINT64> > & index) const;
+
+    UINT32 NumBlocks (void) const { return used; }
+
+  private:
+
+    struct BLOCK
+    {
+        UINT64 cycle;
+        vector<char> data;
+    };
+
+    vector<char> dictionary;
+    vector<BLOCK> ring;
+    UINT32 newest;  // slot of the current block
+    UINT32 used;    // slots holding a block
+
+    vector<char> * current;
+    vector<char> * saved;
+};
+typedef DRAL_FLIGHT_RECORDER_CLASS * DRAL_FLIGHT_RECORDER;
+
+/*
+ * Sends whatever is written while it is in scope to the dictionary of
+ * 'recorder' (if any)
+ */
+class DRAL_DICTIONARY_SCOPE_CLASS
+{
+  public:
+    DRAL_DICTIONARY_SCOPE_CLASS (DRAL_FLIGHT_RECORDER r) : recorder(r)
+    {
+        if (recorder != NULL)
+        {
+            recorder->BeginDictionary();
+        }
+    }
+
+    ~DRAL_DICTIONARY_SCOPE_CLASS ()
+    {
+        if (recorder != NULL)
+        {
+            recorder->EndDictionary();
+        }
+    }
+
+  private:
+    DRAL_FLIGHT_RECORDER recorder;
+};
+
+#endif /* DRAL_FLIGHT_RECORDER_H */
@@ -44,7 +44,15 @@
 #include "asim/dralListener.h"
 
 /**
- * This class performs the buffered read to the dral client
+ * This class performs the buffered read to the dral client.
+ *
+ * There are three ways of getting the bytes:
+ *  - uncompressed regular files are mapped in memory and Read() returns
+ *    pointers straight into the mapping (no copies at all);
+ *  - compressed regular files are decompressed in big chunks by a
+ *    read-ahead thread, so inflating overlaps with the event decoding;
+ *  - anything else (pipes, sockets...) goes through gzread in the
+ *    calling thread, as the data may be arriving while we read it.
  */
 class DRAL_BUFFERED_READ_CLASS
 {
@@ -70,9 +78,25 @@ class DRAL_BUFFERED_READ_CLASS
      * to comunicate the error.
      * The parameter num_bytes should be != 0 (if it is 0, a NULL pointer will
      * be returned)
+     * A file that ends in the middle of the bytes asked for is reported as
+     * an unexpected end of file. An uncompressed regular file is mapped in
+     * memory; if it ends in the middle of the bytes asked for, the reader
+     * waits for the file to grow (it may still be being written) and only
+     * gives up when it has not grown for FOLLOW_TIMEOUT_US microseconds.
+     * It also waits when the file ends right at the bytes asked for but
+     * the client is in the middle of an event (see InEvent) or the file has
+     * already been seen growing; otherwise that is a clean end of file.
      */
     void * Read (UINT32 num_bytes, INT64 * r);
 
+    /**
+     * Public method used by the clients that read an event with several
+     * Read() calls to tell whether the next reads belong to an event
+     * already started, so the end of a mapped file there is not taken for
+     * the end of the trace.
+     */
+    void InEvent (bool in_event) { inEvent = in_event; }
+
     /**
      * Public method used to know the size of the file associated to the file
      * descriptor.
@@ -91,6 +115,31 @@ class DRAL_BUFFERED_READ_CLASS
      */
     UINT32 AvailableBytes(void);
 
+    /**
+     * Public method used to continue reading at byte 'offset' of the file
+     * (an offset of the file itself, i.e. of the compressed data if the file
+     * is compressed; it must be the start of a gzip member in that case).
+     * It returns false if the file descriptor is not seekable. The pointers
+     * returned by previous reads are no longer valid.
+     */
+    bool Seek (UINT64 offset);
+
+    /**
+     * Public method used to get the last 'num_bytes' bytes of the file as
+     * they are stored (without decompressing them). It does not modify the
+     * reading position. It returns the file offset of those bytes or -1 if
+     * they cannot be read.
+     */
+    INT64 ReadTail (void * buf, UINT32 num_bytes);
+
+    /**
+     * Public method used to get the data stored between the file offsets
+     * 'begin' and 'end', decompressed if it is a gzip member. It does not
+     * modify the reading position. It returns a buffer to be freed with
+     * delete [] and its size in 'len', or NULL if it cannot be read.
+     */
+    char * ReadRange (UINT64 begin, UINT64 end, UINT64 * len);
+
   private:
 
     /**
@@ -99,6 +148,67 @@ class DRAL_BUFFERED_READ_CLASS
      */
     INT64 ReadFD (void * buf, UINT32 num_bytes);
 
+    /**
+     * Try to map the file in memory. Returns false if the file descriptor
+     * is not an uncompressed regular file (or the mapping fails).
+     */
+    bool MapFile (void);
+
+    /**
+     * Map the file again if it has grown (it is still being written).
+     * Returns false if it has not grown or the new mapping fails.
+     */
+    bool RemapFile (void);
+
+    /**
+     * Wait until there are 'num_bytes' unread bytes in the mapping,
+     * remapping the file while it grows, or until the file has not grown
+     * for FOLLOW_TIMEOUT_US microseconds.
+     */
+    void WaitForGrowth (UINT32 num_bytes);
+
+    /**
+     * Read-ahead pipeline for compressed regular files.
+     */
+    void StartReadAhead (void);
+    void StopReadAhead (void);
+    INT64 ReadAheadFD (void * buf, UINT32 num_bytes);
+    static void * ReadAheadThread (void * arg);
+    void ReadAheadLoop (void);
+
+    /*
+     * Memory mapped file
+     */
+    static const UINT32 FOLLOW_TIMEOUT_US = 500000;
+    static const UINT32 FOLLOW_POLL_US = 1000;
+    const char * mapBase;
+    UINT64 mapSize;
+    UINT64 mapPos;
+    bool mapGrew;         // the file has grown since it was mapped
+    bool inEvent;         // the client is in the middle of an event
+
+    /*
+     * Read-ahead state. The thread fills the chunks in order and the
+     * reader consumes them in the same order; chunkLen[i] is the number
+     * of valid bytes of chunk i, 0 at end of file and -1 on error.
+     */
+    static const UINT32 READ_AHEAD_CHUNKS = 4;
+    static const UINT32 READ_AHEAD_CHUNK_SIZE = 1 << 20;
+    bool readAhead;
+    pthread_t readAheadTid;
+    pthread_mutex_t readAheadLock;
+    pthread_cond_t chunkFilled;
+    pthread_cond_t chunkFreed;
+    char * chunk [READ_AHEAD_CHUNKS];
+    INT64 chunkLen [READ_AHEAD_CHUNKS];
+    UINT32 filledChunks;
+    UINT32 fillIdx;       // next chunk filled by the thread
+    UINT32 consumeIdx;    // chunk being consumed by the reader
+    UINT32 consumePos;    // bytes already consumed of chunk[consumeIdx]
+    bool readAheadStop;
+    bool readAheadDone;   // the reader has seen the end of file/error
+    char readAheadError [256];
+
     /*
      * Private variables
      */
@@ -49,9 +49,12 @@
 
 // for var args
 #include <stdarg.h>
+#include <signal.h>
+#include <pthread.h>
 
 #include "asim/dral_syntax.h"
 #include "asim/dralServerImplementation.h"
+#include "asim/dralSubstream.h"
 #include "asim/dralStorage.h"
 #include "asim/dralServerDefines.h"
 #include "asim/dralCommonDefines.h"
@@ -63,14 +66,6 @@ class DRAL_ITEM_DESC_CLASS;
 class DRAL_DATA_DESC_CLASS;
 class DRAL_EVENT_DESC_CLASS;
 
-/*
- * Autocompress stuff, Federico Ardanaz @ BSSAD, November 2004.
- *
- */
-typedef map <UINT16, UINT64> Nodetagcache_tag_map; 
-typedef map <string, Nodetagcache_tag_map*> Nodetagcache_map;
-
-
 /*
  * liveItems typedefs
  */
@@ -106,12 +101,13 @@ class DRAL_SERVER_CLASS
      * output file until \c TurnOn() method is called.
      * @brief Constructor 
      * @param fileName String holding the name of the file that will be used to write the events
-     * @param bufferSize size of the internal buffer. (Dral server is always buffered) 
+     * @param bufferSize size of the internal buffer. (Dral server is always buffered, compressed
+     * output is gathered in blocks of at least DRAL_COMPRESS_BLOCK_SIZE bytes) 
      * @param avoidRep if true then dral server accepts nodes with the same name and instance number.
      */
      DRAL_SERVER_CLASS (
         const char * fileName,           // the file name
-        UINT16 bufferSize = 4096,  // buffer size
+        UINT32 bufferSize = 4096,  // buffer size
         bool avoidRep = false,     // shall the dral server specify different
                                    // instance numbers for nodes with the same name
         bool compression = true,   // compress the output
@@ -124,12 +120,13 @@ class DRAL_SERVER_CLASS
      * @note The file descriptor will not be closed
      * @brief Constructor 
      * @param fd file descriptor that will be used to write the events
-     * @param bufferSize size of the internal buffer. (Dral server is always buffered) 
+     * @param bufferSize size of the internal buffer. (Dral server is always buffered, compressed
+     * output is gathered in blocks of at least DRAL_COMPRESS_BLOCK_SIZE bytes) 
      * @param avoidRep if true then dral server accepts nodes with the same name and instance number.
      */
     DRAL_SERVER_CLASS (
         int fd,                    // the file descriptor
-        UINT16 bufferSize = 4096,  // buffer size
+        UINT32 bufferSize = 4096,  // buffer size
         bool avoidRep = false,     // shall the dral server specify different
                                    // instance numbers for nodes with the same name
         bool compression = true,   // compress the output
@@ -291,6 +288,22 @@ class DRAL_SERVER_CLASS
     */
     void NewItem (UINT32 itemId, bool persistent=false);
 
+    /**
+    * Takes a new item identifier from the same counter \c NewItem(bool) uses, but
+    * does not send the NewItem command: the caller sends it, with \c NewItem(UINT32),
+    * the first time the item shows up in the trace. It can be called from any thread.
+    * Identifiers go from 1 to UINT32_MAX-1 and then wrap around to 1, so they
+    * are only unique among the last UINT32_MAX-1 items allocated. Once there
+    * are substreams (see \c NewSubstream()) the high bits of the identifier
+    * hold the substream of the calling thread (0 for the thread that calls
+    * \c Cycle() and threads without a substream) and every substream counts
+    * its own identifiers in the low bits, so the identifiers a thread takes
+    * do not depend on the timing of the other threads.
+    * @brief Allocates an item identifier without creating the item.
+    * @return Returns the item identifier.
+    */
+    UINT32 AllocItemId (void);
+
     /**
     * Items are the dynamic pieces of the DRAL world. Every item need an unique identifier within whole simulation,
     * even after it is deleted.
@@ -316,6 +329,38 @@ class DRAL_SERVER_CLASS
     void MoveItems (
         UINT16 edgeId, UINT32 n, UINT32 itemId[], UINT32 position [] = NULL, bool persistent=false);
 
+    /**
+    * Sends all the events recorded in a batch (see DRAL_EVENT_BATCH_CLASS), in
+    * the order they were recorded, and clears it. The trace is the same one that
+    * issuing the events one by one produces, but a turned on binary server encodes
+    * the whole batch in one pass and writes it at once.
+    * @brief Sends a batch of events. 
+    * @param batch The events of the current cycle. 
+    * @param persistent Tells if these commands should be remembered when the dral server is turned off.
+    */
+    void Commit (DRAL_EVENT_BATCH batch, bool persistent=false);
+
+    /**
+    * Same as MoveItem, but the move is held until the next \c Cycle (or
+    * \c FlushQueuedMoves) and then sent together with the rest of the items
+    * queued for the same edge in a single MoveItems command. An item queued
+    * twice for the same edge in the same cycle is moved only once. A
+    * DeleteItem of an item with a queued move is held too and sent right
+    * after the moves. The rest of the item and node events are written when
+    * they are sent, so in the trace the moves queued in a cycle come after
+    * every NewItem, EnterNode, ExitNode and SetItemTag of that cycle,
+    * whatever the order of the calls.
+    * @brief Queues the move of an item through an edge for the end of the cycle.
+    * @param edgeId Unique identifier of the edge 
+    * @param itemId unique identifier for the item that is moving. 
+    */
+    void QueueMoveItem (UINT16 edgeId, UINT32 itemId);
+
+    /**
+    * @brief Sends the moves queued with \c QueueMoveItem and the deletes held behind them.
+    */
+    void FlushQueuedMoves (void);
+
     /**
     * Move an item through an edge. With the \p position is possible to specify 
     * the exact position of the edge where such item is moving.
@@ -1100,6 +1145,108 @@ class DRAL_SERVER_CLASS
     */
     void ChangeFileName(const char * fileName);
 
+    /**
+    * Splits the trace in blocks of \c cycles cycles that can be decoded
+    * independently, and writes an index of the blocks at the end of the
+    * file, so a client can jump to any cycle with
+    * \c DRAL_CLIENT_CLASS::SeekToCycle() instead of decoding the whole
+    * trace. The output must be seekable. The same can be requested with
+    * the environment variable DRAL_BLOCK_CYCLES.
+    * It can only be used before the output file is opened (i.e. on a
+    * server created with a file name and before it is turned on).
+    * @brief Enables the block index of the trace.
+    * @param cycles Cycles per block (0 disables the blocks)
+    */
+    void SetBlockCycles(UINT64 cycles);
+
+    /**
+    * Keeps the trace in memory instead of writing it to the output file.
+    * The trace is split in blocks of \p cycles cycles (as with
+    * \c SetBlockCycles()) and only the last \p blocks blocks are kept:
+    * the memory of the oldest block is reused for the next one. The
+    * nodes, edges and clocks are kept apart, so \c DumpFlightRecorder()
+    * can write a complete trace of the last cycles at any time. The same
+    * can be requested with the environment variable DRAL_FLIGHT_RECORDER
+    * set to the number of blocks (DRAL_BLOCK_CYCLES gives the cycles per
+    * block, 1000 by default).
+    * It can only be used before the output file is opened.
+    * @brief Records the last cycles of the trace in memory.
+    * @param cycles Cycles per block
+    * @param blocks Number of blocks kept
+    */
+    void SetFlightRecorder(UINT64 cycles, UINT32 blocks);
+
+    bool IsFlightRecorder(void) const;
+
+    /**
+    * Writes the blocks kept by the flight recorder, with the graph needed
+    * to decode them, as a regular trace with a block index. The recording
+    * goes on. Without a file name the trace goes to the output file name
+    * of the server with a "_flight" suffix ("dral_flight" for servers
+    * created with a file descriptor).
+    * @brief Writes the last cycles of the trace.
+    * @param fileName Name of the trace, without the .drl.gz extension
+    * @return false if there is no flight recorder or the file cannot be created
+    */
+    bool DumpFlightRecorder(const char * fileName = NULL);
+
+    /**
+    * Same as \c DumpFlightRecorder(), but the trace is written at the
+    * beginning of the next cycle. It can be called from a signal handler.
+    * @brief Writes the last cycles of the trace at the next cycle.
+    */
+    void DumpFlightRecorderAtNextCycle(void) { flightRecorderDump = 1; }
+
+    /**
+    * Creates a substream for a thread that sends events in parallel with
+    * other threads (see DRAL_SUBSTREAM_CLASS). Once the thread attaches it
+    * with \c AttachSubstream(), its item, tag, enter/exit node and comment
+    * events are encoded by the thread itself, without locks, in chunks
+    * delimited with \c BeginChunk() and \c EndChunk(). The thread that
+    * calls \c Cycle() merges the chunks into the trace with
+    * \c MergeSubstreams(), in order of (time, seq) and, for the same point,
+    * of substream creation. The moves queued in a chunk, and the deletes
+    * held behind them, are queued again by the merging thread and sent at
+    * its next \c Cycle(), and the item ids are counted by substream (see
+    * \c AllocItemId()). So the trace does not depend on the timing of the
+    * threads, and it is the trace of sending the events from a single
+    * thread in merging order, with other item ids. A delete is only held
+    * behind the moves queued by its own thread.
+    * The events of a node must come from a single thread, and persistent
+    * events and the graph (nodes, edges, clocks) from the thread that
+    * calls \c Cycle(). Substreams must be created before the output file
+    * is opened (they need a version 5 trace).
+    * @brief Creates the event substream of a thread.
+    * @return The substream, or NULL if the server cannot take them.
+    */
+    DRAL_SUBSTREAM NewSubstream(void);
+
+    /**
+    * Sends the events of the calling thread to \p substream (NULL sends
+    * them to the server again). A thread can only use the substreams of a
+    * single server.
+    * @brief Attaches the calling thread to a substream.
+    */
+    static void AttachSubstream(DRAL_SUBSTREAM substream);
+
+    /**
+    * @brief Starts a chunk of events of the calling thread for point (\p time, \p seq).
+    */
+    void BeginChunk(UINT64 time, UINT32 seq);
+
+    /**
+    * @brief Ends the chunk of events of the calling thread, handing its queued moves to the merge.
+    */
+    void EndChunk(void);
+
+    /**
+    * Writes the chunks of every substream up to point (\p time, \p seq),
+    * from the thread that calls \c Cycle(), and queues their moves for its
+    * next \c Cycle(). The chunks are dropped if the server is turned off.
+    * @brief Merges the events sent in parallel into the trace.
+    */
+    void MergeSubstreams(UINT64 time, UINT32 seq);
+
     /**
     * Defines the total incoming bandwith of a node. It can be calculated by
     * adding the bandwidth of all the edges whose destination is the node.
@@ -1280,7 +1427,7 @@ class DRAL_SERVER_CLASS
 
 private:
 
-    void Init(UINT16 buffer_size, bool avoid_rep, bool compression);
+    void Init(UINT32 buffer_size, bool avoid_rep, bool compression);
     void DralEnterNode (UINT16 nodeId, UINT32 itemId, UINT16 dim,
          UINT32 position [], bool persistent);
     void DralExitNode (UINT16 nodeId, UINT32 itemId, UINT16 dim,
@@ -1303,18 +1450,18 @@ private:
     static UINT32 CvtStlListDralToPackedListPtv(PTV_DATA_TYPE_CLASS **dst_pdpp, void *p, DRAL_DATA_LIST_T & dl);
 
     /*
-     * Private counters. They are used when creating new items, new nodes,
-     * new edges and new clock domains. The value of the counter is returned
-     * and incremented.
+     * Private counters. They are used when creating new nodes, new edges
+     * and new clock domains. The value of the counter is returned and
+     * incremented. Item ids are counted by each thread state, with the
+     * substream id in the high bits (see AllocItemId).
      */
-    UINT32 item_id;
+    UINT32 substreamIdBits; // high bits of the item ids with the substream id
     UINT16 node_id;
     UINT16 edge_id;
     UINT16 clock_id;
 
 
     bool nodetagAutocompress;
-    Nodetagcache_map nodetagcache;
 
     /*
      * AutoFlush implementation, Julio Gago @ BSSAD, June 2004.
@@ -1373,6 +1520,44 @@ private:
      */
     liveItemsList liveItems;
 
+    /*
+     * Taken to update liveItems from threads with a substream
+     */
+    pthread_mutex_t liveItemsLock;
+
+    /*
+     * State of the events of the thread that calls Cycle()
+     */
+    DRAL_THREAD_STATE_CLASS ownState;
+
+    /*
+     * Substreams, in merging order, and the one of the calling thread
+     */
+    vector<DRAL_SUBSTREAM> substreams;
+    static __thread DRAL_SUBSTREAM threadSubstream;
+
+    /*
+     * Where the events of the calling thread are encoded, and the state
+     * that follows them
+     */
+    inline DRAL_SERVER_IMPLEMENTATION Encoder(bool persistent)
+    {
+        if (threadSubstream == NULL)
+        {
+            return implementation;
+        }
+        DRAL_ASSERT(!persistent,
+            "Persistent events cannot be sent from a thread with a substream");
+        DRAL_ASSERT(threadSubstream->InChunk(),
+            "Events sent from a thread with a substream out of a chunk");
+        return threadSubstream->GetEncoder();
+    }
+
+    inline DRAL_THREAD_STATE_CLASS & ThreadState(void)
+    {
+        return (threadSubstream == NULL ? ownState : threadSubstream->state);
+    }
+
     /*
      * A pointer to the implementation class
      */
@@ -1400,7 +1585,7 @@ private:
     /*
      * The size of the write buffer
      */
-    UINT16 buff_size;
+    UINT32 buff_size;
 
     /*
      * boolean used to know if the output file has been created
@@ -1417,6 +1602,17 @@ private:
 
     bool openedWithFileName;
 
+    /*
+     * The flight recorder has got the version and the stored commands
+     * (it takes them instead of the output file)
+     */
+    bool recorderStarted;
+
+    /*
+     * Set when a dump of the flight recorder is due at the next cycle
+     */
+    volatile sig_atomic_t flightRecorderDump;
+
     /*
      * This boolean makes the ascii server change the instance number of a
      * node if its name has been already used
@@ -52,7 +52,7 @@ class DRAL_SERVER_ASCII_IMPLEMENTATION_CLASS
   public:
 
     DRAL_SERVER_ASCII_IMPLEMENTATION_CLASS(
-        UINT16 buffer_size, bool compression);
+        UINT32 buffer_size, bool compression);
 
     void NewNode (UINT16 node_id, const char name[], UINT16 name_len,
         UINT16 parent_id, UINT16 instance);
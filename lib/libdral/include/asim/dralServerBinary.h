@@ -31,6 +31,10 @@
 #include "asim/dralStringMapping.h"
 #include "asim/dralServerBinaryDefines.h"
 #include "asim/dralClientBinary_v3.h"
+#include "asim/dralFlightRecorder.h"
+
+#include <vector>
+#include <utility>
 
 // Stats macros
 #ifdef DRAL_STATS
@@ -49,7 +53,7 @@ class DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS : public DRAL_SERVER_IMPLEMENTATIO
   public:
 
     DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS(
-        UINT16 buffer_size, bool compression);
+        UINT32 buffer_size, bool compression);
 
     ~DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS();
 
@@ -131,9 +135,25 @@ class DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS : public DRAL_SERVER_IMPLEMENTATIO
     const char name [], UINT16 nameLen);
 
     void Cycle (UINT16 clockId, UINT64 n, UINT16 phase);
+
+    void Batch (DRAL_EVENT_BATCH batch);
     
     void Version (void);
 
+    void SetBlockCycles (UINT64 cycles);
+
+    void FinishFile (void);
+
+    void SetFlightRecorder (UINT64 cycles, UINT32 blocks);
+
+    bool IsFlightRecorder (void) const { return recorder != NULL; }
+
+    bool DumpFlightRecorder (int fd);
+
+    DRAL_SERVER_IMPLEMENTATION NewEncoder (void);
+
+    void Substream (UINT16 stream);
+
   private:
     DRAL_STRING_MAPPING_CLASS tag_map;     ///< Mapping of tags.
     DRAL_STRING_MAPPING_CLASS str_val_map; ///< Mapping of strings values.
@@ -146,6 +166,8 @@ class DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS : public DRAL_SERVER_IMPLEMENTATIO
 
     DRAL3_VALUE_SIZE getMaxBitsVector(UINT32 n, UINT32 * values, INT32 last_value);
 
+    vector<char> batchBuffer; ///< Encoding of the last batch of events.
+
     INT32 last_item; ///< Contains the last item id.
     INT32 last_node; ///< Contains the last node id.
     INT32 last_edge; ///< Contains the last edge id.
@@ -154,6 +176,28 @@ class DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS : public DRAL_SERVER_IMPLEMENTATIO
     UINT16 lastPhase;   ///< Phase of the lasat cycle command.
     UINT64 lastCycle;   ///< Cycle of the lasat cycle command.
 
+    UINT64 blockCycles;    ///< Cycles per block (0 if not split in blocks).
+    UINT64 nextBlockCycle; ///< First cycle of the next block.
+    vector<pair<UINT64, UINT64> > blockIndex; ///< First cycle and offset of each block.
+    bool hasSubstreams;    ///< Encoders for other threads created (needs version 5).
+
+    void CheckNewBlock(UINT64 n);
+
+    /*
+     * Forget the delta encoding state and the tag and string mappings
+     */
+    void ResetEncoding(void);
+
+    /*
+     * Write the block index and its locator at the end of a file
+     */
+    static void WriteBlockIndex(
+        DRAL_BUFFERED_WRITE out, const vector<pair<UINT64, UINT64> > & index);
+
+    DRAL_FLIGHT_RECORDER recorder; ///< Ring of the last blocks (if any).
+    UINT32 bufferSize;             ///< Write buffer size (for the dumps).
+    bool compress;                 ///< Compress the dumps.
+
     STATS
     (
         void clearMoveItems();
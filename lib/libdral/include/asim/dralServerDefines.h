@@ -40,6 +40,7 @@
 
 #define DRAL_SERVER_VERSION_MAJOR 4    /**< Interface version */
 #define DRAL_SERVER_VERSION_MINOR 0    /**< Interface implementation version */
+#define DRAL_SERVER_BLOCKS_VERSION_MAJOR 5 /**< Version of the traces split in blocks */
 
 #include <iostream>
 using namespace std;
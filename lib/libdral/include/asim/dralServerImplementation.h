@@ -33,6 +33,7 @@
 #define __dralServerImplementation_h
 
 #include "asim/dralWrite.h"
+#include "asim/dralBatch.h"
 
 /*
  * Interface of the dral server implementation
@@ -41,7 +42,7 @@ class DRAL_SERVER_IMPLEMENTATION_CLASS
 {
   public:
 
-    DRAL_SERVER_IMPLEMENTATION_CLASS(UINT16 buffer_size, bool compression);
+    DRAL_SERVER_IMPLEMENTATION_CLASS(UINT32 buffer_size, bool compression);
     
     void SetFileDescriptor (int fd);
 
@@ -132,6 +133,12 @@ class DRAL_SERVER_IMPLEMENTATION_CLASS
 
     virtual void Cycle (UINT16 clockId, UINT64 n, UINT16 phase)=0;
 
+    /*
+     * Public method used to send a batch of events. The default sends
+     * them one by one.
+     */
+    virtual void Batch (DRAL_EVENT_BATCH batch);
+
     /*
      * Public method used to send the version
      * The version will be sent to the file descriptor when the implementation
@@ -146,6 +153,62 @@ class DRAL_SERVER_IMPLEMENTATION_CLASS
      */
     void Flush (void);
 
+    /*
+     * Public method used to split the trace in independently decodable
+     * blocks of 'cycles' cycles. Must be set before the version is sent.
+     * Implementations without blocks ignore it.
+     */
+    virtual void SetBlockCycles (UINT64 cycles);
+
+    /*
+     * Public method used to complete the current file before it is
+     * replaced or closed (e.g. to write the block index).
+     */
+    virtual void FinishFile (void);
+
+    /*
+     * Public method used to keep the trace in memory instead of writing
+     * it: the trace is split in blocks of 'cycles' cycles and only the
+     * last 'blocks' blocks are kept (see DRAL_FLIGHT_RECORDER_CLASS).
+     * Must be set before the version is sent. Implementations without
+     * blocks ignore it.
+     */
+    virtual void SetFlightRecorder (UINT64 cycles, UINT32 blocks);
+
+    virtual bool IsFlightRecorder (void) const;
+
+    /*
+     * Public method used to write what the flight recorder holds to 'fd'
+     * as a complete trace. Returns false if there is no flight recorder.
+     */
+    virtual bool DumpFlightRecorder (int fd);
+
+    /*
+     * Public method used to create another encoder of the same kind for
+     * a thread that sends events in parallel (see DRAL_SUBSTREAM_CLASS).
+     * It writes to memory (see SetMemory). Returns NULL if this
+     * implementation cannot encode substreams.
+     */
+    virtual DRAL_SERVER_IMPLEMENTATION_CLASS * NewEncoder (void);
+
+    /*
+     * Public method used to reset the encoding state and tell the client
+     * that the following commands come from substream 'stream' (0 is the
+     * server's own stream)
+     */
+    virtual void Substream (UINT16 stream);
+
+    /*
+     * Public method used to write commands encoded by another encoder
+     */
+    void WriteEncoded (const void * buf, UINT32 len);
+
+    /*
+     * Public method used to append the encoded commands to 'm' instead of
+     * writing them (NULL goes back to the file descriptor)
+     */
+    void SetMemory (vector<char> * m);
+
   protected:
 
     /*
@@ -37,15 +37,28 @@
 #include <string.h>
 #include <stdlib.h>
 #include <list>
+#include <vector>
 using namespace std;
 
 #include "asim/dralServerImplementation.h"
 
+class DRAL_STORAGE_CLASS;
+typedef DRAL_STORAGE_CLASS * DRAL_STORAGE;
+
 class DRAL_COMMAND_STORAGE_CLASS
 {
   public:
     virtual void Notify (DRAL_SERVER_IMPLEMENTATION implementation)=0;
     virtual ~DRAL_COMMAND_STORAGE_CLASS(void) {};
+
+    /*
+     * Commands live in the arena of the storage that keeps them:
+     * new (storage) DRAL_XXX_STORAGE_CLASS(...). Deleting a command only
+     * runs its destructor, the memory goes away with the storage.
+     */
+    static inline void * operator new (size_t size, DRAL_STORAGE storage);
+    static void operator delete (void * p, DRAL_STORAGE storage) {}
+    static void operator delete (void * p) {}
 };
 typedef DRAL_COMMAND_STORAGE_CLASS * DRAL_COMMAND_STORAGE;
 
@@ -109,15 +122,48 @@ class DRAL_STORAGE_CLASS
     DRAL_STORAGE_CLASS(DRAL_SERVER_IMPLEMENTATION impl);
     ~DRAL_STORAGE_CLASS(void);
 
+    /*
+     * Memory for the stored commands and their arguments. It is only
+     * released when the storage is destroyed.
+     */
+    inline void * Alloc (size_t size);
+
   private:
   
     DRAL_SERVER_IMPLEMENTATION implementation;
-    list<DRAL_COMMAND_STORAGE> allCommandsList;
-    list<DRAL_COMMAND_STORAGE> partialCommandList;
+    vector<DRAL_COMMAND_STORAGE> allCommandsList;
+    vector<DRAL_COMMAND_STORAGE> partialCommandList;
     list<DRAL_NEWNODE_STORAGE> numInstanceList;
 
+    // Commands are stored (one per event) while the server is off, so
+    // they are carved from large chunks instead of one new per command
+    static const size_t ARENA_CHUNK_SIZE = 64 * 1024;
+    vector<char *> arenaChunks;
+    char * arenaPos;
+    size_t arenaLeft;
+
+    void * AllocChunk (size_t size);
 };
-typedef DRAL_STORAGE_CLASS * DRAL_STORAGE;
+
+void *
+DRAL_STORAGE_CLASS::Alloc (size_t size)
+{
+    size = (size + 15) & ~size_t(15);
+    if (size > arenaLeft)
+    {
+        return AllocChunk(size);
+    }
+    void * p = arenaPos;
+    arenaPos += size;
+    arenaLeft -= size;
+    return p;
+}
+
+void *
+DRAL_COMMAND_STORAGE_CLASS::operator new (size_t size, DRAL_STORAGE storage)
+{
+    return storage->Alloc(size);
+}
 
 
 class DRAL_NEWEDGE_STORAGE_CLASS : public DRAL_COMMAND_STORAGE_CLASS
@@ -467,15 +513,15 @@ class DRAL_ENTERNODE_STORAGE_CLASS : public DRAL_COMMAND_STORAGE_CLASS
   public:
 
     DRAL_ENTERNODE_STORAGE_CLASS (
-        UINT16 node_id, UINT32 item_id, UINT16 dimensions, UINT32 position[])
+        DRAL_STORAGE storage, UINT16 node_id, UINT32 item_id,
+        UINT16 dimensions, UINT32 position[])
     {
         nodeId=node_id;
         itemId=item_id;
         dim=dimensions;
         if (dim)
         {
-            pos = new UINT32 [dim];
-            assert(pos);
+            pos = (UINT32 *)storage->Alloc(sizeof(*pos)*dim);
             memcpy(pos,position,sizeof(*pos)*dim);
         }
         else
@@ -488,14 +534,6 @@ class DRAL_ENTERNODE_STORAGE_CLASS : public DRAL_COMMAND_STORAGE_CLASS
     {
         implementation->EnterNode(nodeId,itemId,dim,pos);
     }
-    
-    ~DRAL_ENTERNODE_STORAGE_CLASS(void)
-    {
-        if (pos)
-        {
-            delete [] pos;
-        }
-    }
 };
 typedef DRAL_ENTERNODE_STORAGE_CLASS * DRAL_ENTERNODE_STORAGE;
 
@@ -511,15 +549,15 @@ class DRAL_EXITNODE_STORAGE_CLASS : public DRAL_COMMAND_STORAGE_CLASS
   public:
 
     DRAL_EXITNODE_STORAGE_CLASS (
-        UINT16 node_id, UINT32 item_id, UINT16 dimensions, UINT32 position[])
+        DRAL_STORAGE storage, UINT16 node_id, UINT32 item_id,
+        UINT16 dimensions, UINT32 position[])
     {
         nodeId=node_id;
         itemId=item_id;
         dim=dimensions;
         if (dim)
         {
-            pos = new UINT32 [dim];
-            assert(pos);
+            pos = (UINT32 *)storage->Alloc(sizeof(*pos)*dim);
             memcpy(pos,position,sizeof(*pos)*dim);
         }
         else
@@ -532,14 +570,6 @@ class DRAL_EXITNODE_STORAGE_CLASS : public DRAL_COMMAND_STORAGE_CLASS
     {
         implementation->ExitNode(nodeId,itemId,dim,pos);
     }
-    
-    ~DRAL_EXITNODE_STORAGE_CLASS(void)
-    {
-        if (pos)
-        {
-            delete [] pos;
-        }
-    }
 };
 typedef DRAL_EXITNODE_STORAGE_CLASS * DRAL_EXITNODE_STORAGE;
 
@@ -657,17 +687,16 @@ class DRAL_MOVEITEMS_STORAGE_CLASS : public DRAL_COMMAND_STORAGE_CLASS
   public:
 
     DRAL_MOVEITEMS_STORAGE_CLASS (
-        UINT16 edge_id, UINT32 n, UINT32 item_id[], UINT32 position [])
+        DRAL_STORAGE storage, UINT16 edge_id, UINT32 n,
+        UINT32 item_id[], UINT32 position [])
     {
         edgeId=edge_id;
         numItems=n;
-        itemIds = new UINT32 [numItems];
-        assert(itemIds);
+        itemIds = (UINT32 *)storage->Alloc(numItems*sizeof(*item_id));
         memcpy(itemIds,item_id,numItems*sizeof(*item_id));
         if (position)
         {
-            poss = new UINT32 [numItems];
-            assert(poss);
+            poss = (UINT32 *)storage->Alloc(numItems*sizeof(*item_id));
             memcpy(poss,position,numItems*sizeof(*item_id));
         }
         else
@@ -680,15 +709,6 @@ class DRAL_MOVEITEMS_STORAGE_CLASS : public DRAL_COMMAND_STORAGE_CLASS
     {
         implementation->MoveItems(edgeId,numItems,itemIds,poss);
     }
-
-    ~DRAL_MOVEITEMS_STORAGE_CLASS(void)
-    {
-        delete [] itemIds;
-        if (poss)
-        {
-            delete [] poss;
-        }
-    }
 };
 typedef DRAL_MOVEITEMS_STORAGE_CLASS * DRAL_MOVEITEMS_STORAGE;
 
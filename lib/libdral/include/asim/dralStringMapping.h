@@ -87,6 +87,12 @@ class DRAL_STRING_MAPPING_CLASS
       */
     bool getMapping(const char * str, UINT16 strlen, UINT32 * index);
 
+    /**
+      * @brief Forgets all the mappings, so every string will be
+      *        reported as new again.
+      */
+    void reset();
+
   private:
     /**
      * Structs used to implement the LRU policy using stl lists.
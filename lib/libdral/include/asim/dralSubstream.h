@@ -0,0 +1,163 @@
+/**************************************************************************
+ * Copyright (c) 2014, Intel Corporation
+ *
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ * 
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright 
+ *   notice, this list of conditions and the following disclaimer in the 
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the Intel Corporation nor the names of its 
+ *   contributors may be used to endorse or promote products derived from 
+ *   this software without specific prior written permission.
+ *  
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file dralSubstream.h
+ * @author Pau Cabre 
+ * @brief events encoded by a thread in parallel with others
+ */
+
+
+#ifndef DRAL_SUBSTREAM_H
+#define DRAL_SUBSTREAM_H
+
+#include <vector>
+#include <map>
+#include <string>
+using namespace std;
+
+#include "asim/dral_syntax.h"
+#include "asim/dralServerImplementation.h"
+#include "asim/dralChunkList.h"
+
+/*
+ * Autocompress stuff, Federico Ardanaz @ BSSAD, November 2004.
+ *
+ */
+typedef map <UINT16, UINT64> Nodetagcache_tag_map; 
+typedef map <string, Nodetagcache_tag_map*> Nodetagcache_map;
+
+/*
+ * Server state that follows the events of a thread: the moves queued for
+ * the end of the cycle, by edge, the edges with queued moves in the order
+ * they were first used, the deletes held until the moves are sent, the
+ * item ids allocated (see DRAL_SERVER_CLASS::AllocItemId) and the last
+ * value sent of every node tag (see
+ * DRAL_SERVER_CLASS::setNoteTagAutocompress).
+ */
+struct DRAL_THREAD_STATE_CLASS
+{
+    DRAL_THREAD_STATE_CLASS (void) : itemCount(0) {}
+    ~DRAL_THREAD_STATE_CLASS (void);
+
+    /*
+     * Queues the move of an item through an edge, unless it is already
+     * queued for the same edge.
+     */
+    void QueueMove (UINT16 edgeId, UINT32 itemId);
+
+    /*
+     * True if the item has a queued move.
+     */
+    bool IsQueued (UINT32 itemId) const;
+
+    vector< vector<UINT32> > queuedMoves;
+    vector<UINT16> queuedEdges;
+    vector<UINT32> queuedDeletes;
+    volatile UINT64 itemCount; ///< Ids allocated, counting wrap-arounds.
+    Nodetagcache_map nodetagcache;
+};
+
+/*
+ * Events of a thread that sends them in parallel with other threads (see
+ * DRAL_SERVER_CLASS::NewSubstream).
+ *
+ * The thread encodes its events with an encoder of its own, in chunks: a
+ * chunk has the events of one point of the simulation, identified by a
+ * time and a sequence number within the time, and it can be decoded
+ * wherever it ends up in the trace (see
+ * DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS::Substream). The thread that
+ * writes the trace takes the finished chunks in order with Merge.
+ *
+ * The chunks are handed over through a DRAL_CHUNK_LIST_CLASS, with the
+ * thread of the substream as the producer and the merging thread as the
+ * consumer, so once the list has grown to the chunks in flight recording
+ * does not allocate memory.
+ *
+ * The substream also keeps the server state of its thread. The moves the
+ * thread queues in a chunk, and the deletes held behind them, go with
+ * the chunk, and Merge queues them again in the state of the merging
+ * thread, so they are sent at its next cycle, as if the events had been
+ * sent by the merging thread itself.
+ */
+class DRAL_SUBSTREAM_CLASS
+{
+  public:
+
+    DRAL_SUBSTREAM_CLASS (UINT16 id, DRAL_SERVER_IMPLEMENTATION encoder);
+
+    ~DRAL_SUBSTREAM_CLASS (void);
+
+    UINT16 GetId (void) const { return id; }
+
+    /*
+     * Producer side: the events of the thread go to the encoder between
+     * BeginChunk and EndChunk. Chunks must be started in increasing
+     * (time, seq) order. Empty chunks are dropped.
+     */
+    void BeginChunk (UINT64 time, UINT32 seq);
+    void EndChunk (void);
+    bool InChunk (void) const { return current != NULL; }
+    DRAL_SERVER_IMPLEMENTATION GetEncoder (void) const { return encoder; }
+
+    /*
+     * Consumer side: write the finished chunks up to (time, seq) with
+     * 'out', or drop them if it is NULL, and move their queued moves and
+     * held deletes to 'queue'. Returns true if anything was written.
+     */
+    bool Merge (
+        UINT64 time, UINT32 seq, DRAL_SERVER_IMPLEMENTATION out,
+        DRAL_THREAD_STATE_CLASS * queue);
+
+    DRAL_THREAD_STATE_CLASS state;
+
+  private:
+
+    struct CHUNK
+    {
+        CHUNK * volatile next;
+        UINT64 time;
+        UINT32 seq;
+        vector<char> data;
+        vector<UINT32> moves;   ///< Queued moves, as (edge, item) pairs.
+        vector<UINT32> deletes; ///< Deletes held behind the moves.
+    };
+
+    UINT16 id;
+    DRAL_SERVER_IMPLEMENTATION encoder;
+    UINT32 headerSize; ///< Bytes of a chunk without events.
+
+    DRAL_CHUNK_LIST_CLASS<CHUNK> chunks;
+    CHUNK * current;   ///< Chunk being filled (NULL out of chunks).
+    CHUNK * spare;     ///< Empty chunk dropped, for the next one.
+};
+typedef DRAL_SUBSTREAM_CLASS * DRAL_SUBSTREAM;
+
+#endif /* DRAL_SUBSTREAM_H */
@@ -40,18 +40,42 @@
 
 #include <zlib.h>
 #include <stdio.h>
+#include <pthread.h>
+#include <vector>
 
 #include "asim/dral_syntax.h"
 
+class DRAL_FLIGHT_RECORDER_CLASS;
+
+/*
+ * Size of the blocks handed to the compression threads. Every block
+ * becomes an independent gzip member, so it has to be large enough not
+ * to hurt the compression ratio.
+ */
+#define DRAL_COMPRESS_BLOCK_SIZE (1024 * 1024)
+
+/*
+ * Maximum number of compression threads (see DRAL_COMPRESS_THREADS)
+ */
+#define DRAL_COMPRESS_MAX_THREADS 16
+
 /*
- * This class performs the buffered writing to the file descriptor
+ * This class performs the buffered writing to the file descriptor.
+ *
+ * When compressing, the data is gathered in large blocks that a pool of
+ * threads compresses into independent gzip members. The members are
+ * written in order, so the output is a regular multi-member gzip file
+ * that any gzip reader (and DRAL_READ_CLASS) decodes. The simulation
+ * thread only copies the data into the current block. The number of
+ * threads is taken from the DRAL_COMPRESS_THREADS environment variable
+ * (0 compresses the blocks in the calling thread).
  */
 class DRAL_BUFFERED_WRITE_CLASS
 {
 
   public:
 
-    DRAL_BUFFERED_WRITE_CLASS (UINT16 buffer_size, bool compression);
+    DRAL_BUFFERED_WRITE_CLASS (UINT32 buffer_size, bool compression);
     
     void SetFileDescriptor (int fd);
     
@@ -61,17 +85,46 @@ class DRAL_BUFFERED_WRITE_CLASS
     
     void Flush (void);
 
+    /*
+     * Start a new block that can be decoded without reading the previous
+     * ones: the buffer is flushed and, when compressing, the current gzip
+     * member is finished and all the pending ones are written (a sequence
+     * of gzip members is still a valid gzip file). Returns the file offset
+     * where the block starts, or -1 if the file descriptor is not
+     * seekable.
+     */
+    INT64 NewBlock (void);
+
+    /*
+     * Write the very last bytes of the file as they are, after the last
+     * gzip member (gzip readers ignore trailing data). Nothing can be
+     * written after the trailer.
+     */
+    void WriteTrailer (const void * buf, UINT32 num_bytes);
+
+    /*
+     * Send everything written from now on to a flight recorder instead
+     * of the file descriptor
+     */
+    void SetRecorder (DRAL_FLIGHT_RECORDER_CLASS * r) { recorder = r; }
+
+    /*
+     * Append everything written from now on to 'm' instead of writing it
+     * to the file descriptor (NULL goes back to the file descriptor)
+     */
+    void SetMemory (std::vector<char> * m) { memory = m; }
+
   private:
 
-    UINT16 buf_size;  // the buffer size
+    UINT32 buf_size;  // the buffer size
     
     char * buffer;
     
     bool buffered;
     
-    UINT16 available;  // available bytes in the buffer
+    UINT32 available;  // available bytes in the buffer
     
-    UINT16 pos;  // position of the begining of the free area in the buffer
+    UINT32 pos;  // position of the begining of the free area in the buffer
     
     /*
      * Private method that performs the writing of the buffer to the file
@@ -80,11 +133,70 @@ class DRAL_BUFFERED_WRITE_CLASS
     void WriteFD (const void * buf, UINT32 num_bytes);
 
     char zeros [8];
+
+    DRAL_FLIGHT_RECORDER_CLASS * recorder;
+
+    std::vector<char> * memory;
     
-    gzFile file;
+    int fd;  // our own dup of the file descriptor we are writing to
+
     FILE * uncompressed_file;
 
     bool compress;
+
+    /*
+     * Compression pipeline. Block number 'seq' is gathered in
+     * slots[seq % num_slots]. The blocks below 'submitted' have been
+     * handed to the threads, the ones below 'taken' are being (or have
+     * been) compressed and the ones below 'written' are already in the
+     * file. A slot can be refilled once its previous block is written.
+     */
+    struct COMPRESS_SLOT
+    {
+        char * in;
+        UINT32 in_len;
+        char * out;
+        UINT32 out_size;
+        UINT32 out_len;
+    };
+
+    COMPRESS_SLOT * slots;
+    UINT32 num_slots;
+    UINT32 num_threads;
+    pthread_t threads [DRAL_COMPRESS_MAX_THREADS];
+    bool threads_running;
+    bool stopping;
+
+    UINT64 submitted;
+    UINT64 taken;
+    UINT64 written;
+
+    pthread_mutex_t lock;
+    pthread_cond_t block_submitted;  // signaled to the threads
+    pthread_cond_t block_written;  // signaled to everybody
+
+    z_stream stream;  // used when there are no compression threads
+
+    /*
+     * Hand the current block to the compression threads and start
+     * filling the next free slot
+     */
+    void SubmitBlock (void);
+
+    /*
+     * Wait until all the submitted blocks are in the file
+     */
+    void Drain (void);
+
+    void StartThreads (void);
+    void StopThreads (void);
+    static void * CompressThread (void * arg);
+    void CompressLoop (void);
+
+    /*
+     * Compress a slot into a complete gzip member and write it in order
+     */
+    void CompressBlock (z_stream * strm, COMPRESS_SLOT * slot);
 };
 typedef DRAL_BUFFERED_WRITE_CLASS * DRAL_BUFFERED_WRITE;
 
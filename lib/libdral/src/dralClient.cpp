@@ -91,6 +91,11 @@ DRAL_CLIENT_CLASS::DRAL_CLIENT_CLASS (
             dralRead,listener);
         listener->Version(4);
         break;
+      case DRAL_BINARY_5:
+        implementation = new DRAL_CLIENT_BINARY_5_IMPLEMENTATION_CLASS (
+            dralRead,listener);
+        listener->Version(5);
+        break;
       case DRAL_ASCII_0_1:
         implementation = new DRAL_CLIENT_ASCII_IMPLEMENTATION_CLASS (
             dralRead,listener);
@@ -246,6 +251,9 @@ DRAL_CLIENT_CLASS::CheckFileType (UINT16 * ver)
           case 4:
             return DRAL_BINARY_4;
             break;
+          case 5:
+            return DRAL_BINARY_5;
+            break;
           default:
             *ver=command->major_version;
             return DRAL_UNSUPORTED_VERSION;
@@ -218,6 +218,7 @@ DRAL_CLIENT_BINARY_3_IMPLEMENTATION_CLASS::ProcessNextEvent (
 
     for (n_events=0;n_events<num_events;n_events++)
     {
+        dralRead->InEvent(false);
         buffer = ReadBytes(1);
 
         if(EOS)
@@ -226,6 +227,7 @@ DRAL_CLIENT_BINARY_3_IMPLEMENTATION_CLASS::ProcessNextEvent (
             errorFound = true;
             break;
         }
+        dralRead->InEvent(true);
 
         command = * (dralCommand *) buffer;
 
@@ -329,7 +331,7 @@ DRAL_CLIENT_BINARY_3_IMPLEMENTATION_CLASS::ProcessNextEvent (
             r=NewStringValue();
             break;
           default:
-            r=Error();
+            r=OtherCommand(command.command);
             break;
         }
 
@@ -357,6 +359,12 @@ DRAL_CLIENT_BINARY_3_IMPLEMENTATION_CLASS::Error()
     return false;
 }
 
+bool
+DRAL_CLIENT_BINARY_3_IMPLEMENTATION_CLASS::OtherCommand(UINT8)
+{
+    return Error();
+}
+
 bool
 DRAL_CLIENT_BINARY_3_IMPLEMENTATION_CLASS::Cycle()
 {
@@ -0,0 +1,314 @@
+/**************************************************************************
+ * Copyright (c) 2014, Intel Corporation
+ *
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ * 
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright 
+ *   notice, this list of conditions and the following disclaimer in the 
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the Intel Corporation nor the names of its 
+ *   contributors may be used to endorse or promote products derived from 
+ *   this software without specific prior written permission.
+ *  
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file dralClientBinary_v5.cpp
+ * @author Pau Cabre
+ * @brief dral client binary version 5 implementation
+ */
+
+#include <algorithm>
+
+#include "asim/dralClientBinary_v5.h"
+#include "asim/dralCommonDefines.h"
+
+/*
+ * Layout of the version 5 commands (see dralServerBinary.cpp)
+ */
+struct blockFormat
+{
+    UINT64 commandCode  : 6;
+    UINT64 n            : 58;
+};
+
+struct substreamFormat
+{
+    UINT32 commandCode  : 6;
+    UINT32 reserved     : 10;
+    UINT32 stream       : 16;
+};
+
+struct blockIndexFormat
+{
+    UINT64 commandCode  : 6;
+    UINT64 reserved     : 26;
+    UINT64 numBlocks    : 32;
+};
+
+struct indexLocatorFormat
+{
+    UINT64 commandCode  : 6;
+    UINT64 reserved     : 58;
+    UINT64 offset;
+    UINT64 magic;
+};
+
+DRAL_CLIENT_BINARY_5_IMPLEMENTATION_CLASS::DRAL_CLIENT_BINARY_5_IMPLEMENTATION_CLASS(
+    DRAL_BUFFERED_READ dral_read,
+    DRAL_LISTENER listener)
+    : DRAL_CLIENT_BINARY_4_IMPLEMENTATION_CLASS (dral_read,listener)
+{
+    firstBlockFound = false;
+    indexLoaded = false;
+}
+
+DRAL_CLIENT_BINARY_5_IMPLEMENTATION_CLASS::~DRAL_CLIENT_BINARY_5_IMPLEMENTATION_CLASS()
+{
+}
+
+bool
+DRAL_CLIENT_BINARY_5_IMPLEMENTATION_CLASS::OtherCommand(UINT8 command)
+{
+    switch (command)
+    {
+      case DRAL3_BLOCK:
+        return Block();
+      case DRAL3_BLOCKINDEX:
+        return BlockIndex();
+      case DRAL3_INDEXLOCATOR:
+        return IndexLocator();
+      case DRAL3_SUBSTREAM:
+        return Substream();
+      default:
+        return Error();
+    }
+}
+
+/*
+ * Beginning of a block: the server has reset its delta encoding state
+ */
+bool
+DRAL_CLIENT_BINARY_5_IMPLEMENTATION_CLASS::Block()
+{
+    ReadBytes(sizeof(blockFormat) - 1);
+
+    if(EOS)
+    {
+        return false;
+    }
+
+    last_item = 0;
+    last_node = 0;
+    last_edge = 0;
+    firstBlockFound = true;
+
+    return true;
+}
+
+/*
+ * The following commands come from another encoder (a thread that sent its
+ * events in parallel): it starts from a reset delta encoding state. Tags and
+ * strings are defined again by the encoder before it uses them.
+ */
+bool
+DRAL_CLIENT_BINARY_5_IMPLEMENTATION_CLASS::Substream()
+{
+    ReadBytes(sizeof(substreamFormat) - 1);
+
+    if(EOS)
+    {
+        return false;
+    }
+
+    last_item = 0;
+    last_node = 0;
+    last_edge = 0;
+
+    return true;
+}
+
+/*
+ * The block index is only used through LoadIndex(), skip it
+ */
+bool
+DRAL_CLIENT_BINARY_5_IMPLEMENTATION_CLASS::BlockIndex()
+{
+    blockIndexFormat * command;
+
+    command = (blockIndexFormat *) ((char *) ReadBytes(sizeof(blockIndexFormat) - 1) - 1);
+
+    if(EOS)
+    {
+        return false;
+    }
+
+    if (command->numBlocks)
+    {
+        ReadBytes(command->numBlocks * 2 * sizeof(UINT64));
+        if(EOS)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Only found in uncompressed traces (in compressed ones it follows the last
+ * gzip member), skip it
+ */
+bool
+DRAL_CLIENT_BINARY_5_IMPLEMENTATION_CLASS::IndexLocator()
+{
+    ReadBytes(sizeof(indexLocatorFormat) - 1);
+
+    if(EOS)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Read the block index without modifying the reading position. It is only
+ * looked for once.
+ */
+bool
+DRAL_CLIENT_BINARY_5_IMPLEMENTATION_CLASS::LoadIndex()
+{
+    indexLocatorFormat locator;
+    blockIndexFormat command;
+    INT64 tail;
+    UINT64 len;
+    char * data;
+
+    if (indexLoaded)
+    {
+        return !blocks.empty();
+    }
+    indexLoaded = true;
+
+    tail = dralRead->ReadTail(&locator, sizeof(locator));
+    if (tail == -1 ||
+        locator.commandCode != DRAL3_INDEXLOCATOR ||
+        locator.magic != DRAL_INDEX_MAGICNUM)
+    {
+        dralListener->NonCriticalError(
+            "The dral trace has no block index (it may be incomplete)");
+        return false;
+    }
+
+    data = dralRead->ReadRange(locator.offset, tail, &len);
+    if (data == NULL || len < sizeof(command))
+    {
+        delete [] data;
+        dralListener->NonCriticalError("Error reading the dral block index");
+        return false;
+    }
+
+    memcpy(&command, data, sizeof(command));
+    if (command.commandCode != DRAL3_BLOCKINDEX ||
+        len < sizeof(command) + command.numBlocks * 2 * sizeof(UINT64))
+    {
+        delete [] data;
+        dralListener->NonCriticalError("Error reading the dral block index");
+        return false;
+    }
+
+    UINT64 * entry = (UINT64 *) (data + sizeof(command));
+    for (UINT32 i = 0; i < command.numBlocks; i++)
+    {
+        blocks.push_back(make_pair(entry[2 * i], entry[2 * i + 1]));
+    }
+    delete [] data;
+
+    return !blocks.empty();
+}
+
+UINT32
+DRAL_CLIENT_BINARY_5_IMPLEMENTATION_CLASS::GetNumBlocks()
+{
+    return (LoadIndex() ? blocks.size() : 0);
+}
+
+UINT64
+DRAL_CLIENT_BINARY_5_IMPLEMENTATION_CLASS::GetBlockCycle(UINT32 block)
+{
+    if (!LoadIndex() || block >= blocks.size())
+    {
+        return 0;
+    }
+    return blocks[block].first;
+}
+
+/*
+ * The commands before the first block (the graph, clocks, tag
+ * descriptions...) are needed to decode any block, so they are processed
+ * first if they have not been already.
+ */
+bool
+DRAL_CLIENT_BINARY_5_IMPLEMENTATION_CLASS::SeekToBlock(UINT32 block)
+{
+    if (errorFound || !LoadIndex() || block >= blocks.size())
+    {
+        return false;
+    }
+
+    while (!firstBlockFound && !errorFound)
+    {
+        ProcessNextEvent(true, 1);
+    }
+    if (errorFound)
+    {
+        return false;
+    }
+
+    if (!dralRead->Seek(blocks[block].second))
+    {
+        dralListener->NonCriticalError("The dral trace is not seekable");
+        return false;
+    }
+    EOS = false;
+    return true;
+}
+
+/*
+ * Go to the beginning of the block holding 'cycle'
+ */
+bool
+DRAL_CLIENT_BINARY_5_IMPLEMENTATION_CLASS::SeekToCycle(UINT64 cycle)
+{
+    if (!LoadIndex())
+    {
+        return false;
+    }
+
+    vector<pair<UINT64, UINT64> >::iterator it = upper_bound(
+        blocks.begin(), blocks.end(), make_pair(cycle, (UINT64) -1));
+    UINT32 block = 0;
+    if (it != blocks.begin())
+    {
+        block = (it - blocks.begin()) - 1;
+    }
+    return SeekToBlock(block);
+}
@@ -68,6 +68,34 @@ DRAL_CLIENT_IMPLEMENTATION_CLASS::GetNumBytesRead(void)
     return dralRead->GetNumBytesRead();
 }
 
+UINT32
+DRAL_CLIENT_IMPLEMENTATION_CLASS::GetNumBlocks(void)
+{
+    return 0;
+}
+
+UINT64
+DRAL_CLIENT_IMPLEMENTATION_CLASS::GetBlockCycle(UINT32)
+{
+    return 0;
+}
+
+bool
+DRAL_CLIENT_IMPLEMENTATION_CLASS::SeekToBlock(UINT32)
+{
+    dralListener->NonCriticalError(
+        "This dral trace version does not support random access");
+    return false;
+}
+
+bool
+DRAL_CLIENT_IMPLEMENTATION_CLASS::SeekToCycle(UINT64)
+{
+    dralListener->NonCriticalError(
+        "This dral trace version does not support random access");
+    return false;
+}
+
 UINT32
 DRAL_CLIENT_IMPLEMENTATION_CLASS::getTagIndex(const char * tag, UINT16 tag_len)
 {
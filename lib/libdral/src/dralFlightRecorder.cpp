@@ -0,0 +1,101 @@
+/**************************************************************************
+ * Copyright (c) 2014, Intel Corporation
+ *
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ * 
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright 
+ *   notice, this list of conditions and the following disclaimer in the 
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the Intel Corporation nor the names of its 
+ *   contributors may be used to endorse or promote products derived from 
+ *   this software without specific prior written permission.
+ *  
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file dralFlightRecorder.cpp
+ * @author Pau Cabre 
+ * @brief in memory ring of the last blocks of a DRAL trace
+ */
+
+
+#include "asim/dralFlightRecorder.h"
+#include "asim/dralWrite.h"
+#include "asim/dralServerDefines.h"
+
+DRAL_FLIGHT_RECORDER_CLASS::DRAL_FLIGHT_RECORDER_CLASS (UINT32 blocks)
+{
+    DRAL_ASSERT(blocks > 0, "The flight recorder needs at least one block");
+    ring.resize(blocks);
+    newest = blocks - 1;
+    used = 0;
+
+    // everything before the first block goes to the dictionary
+    current = &dictionary;
+    saved = &dictionary;
+}
+
+void
+DRAL_FLIGHT_RECORDER_CLASS::NewBlock (UINT64 n)
+{
+    newest = (newest + 1) % ring.size();
+    if (used < ring.size())
+    {
+        used++;
+    }
+
+    // drop the oldest block but keep its memory
+    ring[newest].cycle = n;
+    ring[newest].data.clear();
+    current = &ring[newest].data;
+}
+
+void
+DRAL_FLIGHT_RECORDER_CLASS::Dump (
+    DRAL_BUFFERED_WRITE_CLASS * out,
+    vector<pair<UINT64, UINT64> > & index) const
+{
+    bool seekable = true;
+
+    if (!dictionary.empty())
+    {
+        out->Write(&dictionary[0], dictionary.size());
+    }
+    for (UINT32 i = 0; i < used; i++)
+    {
+        const BLOCK & b = ring[(newest + ring.size() - used + 1 + i) % ring.size()];
+        INT64 offset = out->NewBlock();
+        if (offset == -1)
+        {
+            seekable = false;
+        }
+        else if (seekable)
+        {
+            index.push_back(make_pair(b.cycle, (UINT64) offset));
+        }
+        if (!b.data.empty())
+        {
+            out->Write(&b.data[0], b.data.size());
+        }
+    }
+    if (!seekable)
+    {
+        index.clear();
+    }
+}
@@ -39,12 +39,18 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <errno.h>
+#include <sys/mman.h>
 #include "asim/dralRead.h"
 
 #include <stdio.h>
 #include <iostream>
 using namespace std;
 
+static const char * const unexpectedEOF =
+    "Unexpected end of file\n"
+    "Please report this bug to dral@bssad.intel.com attaching "
+    "input files (if any)";
+
 DRAL_BUFFERED_READ_CLASS::DRAL_BUFFERED_READ_CLASS (
     int file_descriptor, DRAL_LISTENER dral_listener, UINT32 buffer_size)
 {
@@ -53,6 +59,20 @@ DRAL_BUFFERED_READ_CLASS::DRAL_BUFFERED_READ_CLASS (
     bufferSize=buffer_size;
     dralListener=dral_listener;
     errorFound=false;
+    buffer=NULL;
+    file=NULL;
+    mapBase=NULL;
+    mapSize=0;
+    mapPos=0;
+    mapGrew=false;
+    inEvent=false;
+    readAhead=false;
+
+    if (bufferSize != 0 && MapFile())
+    {
+        // Uncompressed regular file: Read() works directly on the mapping
+        return;
+    }
 
     if (bufferSize != 0)
     {
@@ -74,6 +94,10 @@ DRAL_BUFFERED_READ_CLASS::DRAL_BUFFERED_READ_CLASS (
                 dralListener->EndSimulation();
                 errorFound=true;
             }
+            else
+            {
+                StartReadAhead();
+            }
         }
         buffer = (void *) (((char *) buffer) + 1);
     }
@@ -88,6 +112,16 @@ DRAL_BUFFERED_READ_CLASS::DRAL_BUFFERED_READ_CLASS (
 
 DRAL_BUFFERED_READ_CLASS::~DRAL_BUFFERED_READ_CLASS ()
 {
+    if (mapBase != NULL)
+    {
+        munmap((void *) mapBase, mapSize);
+    }
+
+    if (readAhead)
+    {
+        StopReadAhead();
+    }
+
     if (buffer != NULL)
     {
         buffer = (void *) (((char *) buffer) - 1);
@@ -101,11 +135,289 @@ DRAL_BUFFERED_READ_CLASS::~DRAL_BUFFERED_READ_CLASS ()
 }
 
 
+/*
+ * Map the whole file. The reading position is kept apart (mapPos), so the
+ * file descriptor offset is not modified.
+ */
+bool DRAL_BUFFERED_READ_CLASS::MapFile(void)
+{
+    struct stat s;
+    unsigned char begining [2];
+    off_t start;
+    void * base;
+
+    if (fstat(fd,&s) || !S_ISREG(s.st_mode) || s.st_size == 0)
+    {
+        return false;
+    }
+
+    start = lseek(fd,0,SEEK_CUR);
+    if (start == -1 || start > s.st_size)
+    {
+        return false;
+    }
+
+    if (pread(fd,begining,2,0) != 2 ||
+        ((begining[0] == 0x1f) && (begining[1] == 0x8b)))
+    {
+        // compressed: it must be inflated anyway
+        return false;
+    }
+
+    // Private writable mapping: the clients get 'void *' pointers, so any
+    // in-place modification ends up in a private copy of the page
+    base = mmap(NULL,s.st_size,PROT_READ | PROT_WRITE,MAP_PRIVATE,fd,0);
+    if (base == MAP_FAILED)
+    {
+        return false;
+    }
+    madvise(base,s.st_size,MADV_SEQUENTIAL);
+
+    mapBase = (const char *) base;
+    mapSize = s.st_size;
+    mapPos = start;
+    return true;
+}
+
+/*
+ * The file may still be being written: map it again if it has grown since
+ * it was mapped. It returns false if it has not.
+ */
+bool DRAL_BUFFERED_READ_CLASS::RemapFile(void)
+{
+    struct stat s;
+    void * base;
+
+    if (fstat(fd,&s) || (UINT64) s.st_size <= mapSize)
+    {
+        return false;
+    }
+
+    base = mmap(NULL,s.st_size,PROT_READ | PROT_WRITE,MAP_PRIVATE,fd,0);
+    if (base == MAP_FAILED)
+    {
+        return false;
+    }
+    madvise(base,s.st_size,MADV_SEQUENTIAL);
+
+    munmap((void *) mapBase,mapSize);
+    mapBase = (const char *) base;
+    mapSize = s.st_size;
+    mapGrew = true;
+    return true;
+}
+
+/*
+ * The reader may have caught up with the writer: poll the file size until
+ * the bytes asked for are there. A truncated file never grows, so we give
+ * up after some time without any growth.
+ */
+void DRAL_BUFFERED_READ_CLASS::WaitForGrowth(UINT32 n)
+{
+    UINT32 idle = 0;
+
+    while (n > mapSize - mapPos && idle < FOLLOW_TIMEOUT_US)
+    {
+        if (RemapFile())
+        {
+            idle = 0;
+        }
+        else
+        {
+            usleep(FOLLOW_POLL_US);
+            idle += FOLLOW_POLL_US;
+        }
+    }
+}
+
+/*
+ * Start the read-ahead thread. Only regular files are read ahead: on a pipe
+ * or a socket the thread would wait for a whole chunk before handing any
+ * event to the client. If the thread cannot be created we just keep on
+ * reading synchronously.
+ */
+void DRAL_BUFFERED_READ_CLASS::StartReadAhead(void)
+{
+    struct stat s;
+    UINT32 i;
+
+    if (fstat(fd,&s) || !S_ISREG(s.st_mode))
+    {
+        return;
+    }
+
+    for (i = 0; i < READ_AHEAD_CHUNKS; i++)
+    {
+        chunk[i] = new char [READ_AHEAD_CHUNK_SIZE];
+        chunkLen[i] = 0;
+    }
+    filledChunks = 0;
+    fillIdx = 0;
+    consumeIdx = 0;
+    consumePos = 0;
+    readAheadStop = false;
+    readAheadDone = false;
+    readAheadError[0] = '\0';
+
+    pthread_mutex_init(&readAheadLock,NULL);
+    pthread_cond_init(&chunkFilled,NULL);
+    pthread_cond_init(&chunkFreed,NULL);
+
+    if (pthread_create(&readAheadTid,NULL,ReadAheadThread,this))
+    {
+        pthread_cond_destroy(&chunkFreed);
+        pthread_cond_destroy(&chunkFilled);
+        pthread_mutex_destroy(&readAheadLock);
+        for (i = 0; i < READ_AHEAD_CHUNKS; i++)
+        {
+            delete [] chunk[i];
+        }
+        return;
+    }
+    readAhead = true;
+}
+
+void DRAL_BUFFERED_READ_CLASS::StopReadAhead(void)
+{
+    pthread_mutex_lock(&readAheadLock);
+    readAheadStop = true;
+    pthread_cond_signal(&chunkFreed);
+    pthread_mutex_unlock(&readAheadLock);
+
+    pthread_join(readAheadTid,NULL);
+
+    pthread_cond_destroy(&chunkFreed);
+    pthread_cond_destroy(&chunkFilled);
+    pthread_mutex_destroy(&readAheadLock);
+    for (UINT32 i = 0; i < READ_AHEAD_CHUNKS; i++)
+    {
+        delete [] chunk[i];
+    }
+    readAhead = false;
+}
+
+void * DRAL_BUFFERED_READ_CLASS::ReadAheadThread(void * arg)
+{
+    ((DRAL_BUFFERED_READ) arg)->ReadAheadLoop();
+    return NULL;
+}
+
+/*
+ * Read-ahead thread body. It inflates chunk after chunk until the end of
+ * file (or an error), waiting whenever all the chunks are full. The dral
+ * listener is not thread safe, so errors are only recorded here and
+ * reported by the reader when it gets to them.
+ */
+void DRAL_BUFFERED_READ_CLASS::ReadAheadLoop(void)
+{
+    while (true)
+    {
+        pthread_mutex_lock(&readAheadLock);
+        while (filledChunks == READ_AHEAD_CHUNKS && !readAheadStop)
+        {
+            pthread_cond_wait(&chunkFreed,&readAheadLock);
+        }
+        if (readAheadStop)
+        {
+            pthread_mutex_unlock(&readAheadLock);
+            return;
+        }
+        UINT32 idx = fillIdx;
+        pthread_mutex_unlock(&readAheadLock);
+
+        // gzread only returns less than asked for at the end of file
+        INT64 len = gzread(file,chunk[idx],READ_AHEAD_CHUNK_SIZE);
+        if (len == -1)
+        {
+            int err;
+            const char * msg = gzerror(file,&err);
+            if (err == Z_ERRNO)
+            {
+                msg = strerror(errno);
+            }
+            strncpy(readAheadError,msg,sizeof(readAheadError) - 1);
+            readAheadError[sizeof(readAheadError) - 1] = '\0';
+        }
+
+        pthread_mutex_lock(&readAheadLock);
+        chunkLen[idx] = len;
+        fillIdx = (idx + 1) % READ_AHEAD_CHUNKS;
+        filledChunks++;
+        pthread_cond_signal(&chunkFilled);
+        pthread_mutex_unlock(&readAheadLock);
+
+        if (len <= 0)
+        {
+            return;
+        }
+    }
+}
+
+/*
+ * ReadFD() counterpart when the read-ahead thread is running: copy the
+ * bytes out of the inflated chunks.
+ */
+INT64 DRAL_BUFFERED_READ_CLASS::ReadAheadFD(void * buf, UINT32 n)
+{
+    UINT32 i=0;
+
+    while (i < n && !readAheadDone)
+    {
+        pthread_mutex_lock(&readAheadLock);
+        while (filledChunks == 0)
+        {
+            pthread_cond_wait(&chunkFilled,&readAheadLock);
+        }
+        INT64 len = chunkLen[consumeIdx];
+        pthread_mutex_unlock(&readAheadLock);
+
+        if (len <= 0)
+        {
+            readAheadDone=true;
+            if (len == -1)
+            {
+                dralListener->Error(readAheadError);
+            }
+            break;
+        }
+
+        UINT32 c = len - consumePos;
+        if (c > n - i)
+        {
+            c = n - i;
+        }
+        memcpy((char *)buf+i,chunk[consumeIdx]+consumePos,c);
+        i+=c;
+        consumePos+=c;
+
+        if (consumePos == len)
+        {
+            pthread_mutex_lock(&readAheadLock);
+            consumeIdx = (consumeIdx + 1) % READ_AHEAD_CHUNKS;
+            consumePos = 0;
+            filledChunks--;
+            pthread_cond_signal(&chunkFreed);
+            pthread_mutex_unlock(&readAheadLock);
+        }
+    }
+
+    if (i == 0 && readAheadError[0] != '\0')
+    {
+        return -1;
+    }
+    return i;
+}
+
 INT64 DRAL_BUFFERED_READ_CLASS::ReadFD(void * buf, UINT32 n)
 {
     UINT32 i=0;
     INT64 r=0;
 
+    if (readAhead)
+    {
+        return ReadAheadFD(buf,n);
+    }
+
     while (r <= (n-i))
     {
         r=gzread(file,(char *)buf+i,n-i);
@@ -145,6 +457,35 @@ void * DRAL_BUFFERED_READ_CLASS::Read(UINT32 n, INT64 * r)
         return NULL;
     }
 
+    if (mapBase != NULL)
+    {
+        // No copies: the data is already in memory
+        if (n > mapSize - mapPos)
+        {
+            // the trace may still be being written
+            RemapFile();
+        }
+        if (n > mapSize - mapPos && (mapPos != mapSize || inEvent || mapGrew))
+        {
+            // we are in the middle of the writer's last event (or may be)
+            WaitForGrowth(n);
+        }
+        if (n > mapSize - mapPos)
+        {
+            *r=0;
+            if (mapPos != mapSize)  // we wanted more bytes than the file has
+            {
+                dralListener->Error(unexpectedEOF);
+                errorFound=true;
+            }
+            return NULL;
+        }
+        mapPos+=n;
+        *r=(INT64)n;
+        numBytesRead+=n;
+        return (void *) (mapBase + mapPos - n);
+    }
+
     if (n > bufferSize)
     {
         //We want more bytes than the buffer size. That's not possible with
@@ -177,9 +518,9 @@ void * DRAL_BUFFERED_READ_CLASS::Read(UINT32 n, INT64 * r)
     }
     else
     {
-        memcpy((char *) buffer - 1,(char *) buffer + pos - 1, available + 1);
+        memmove((char *) buffer - 1,(char *) buffer + pos - 1, available + 1);
         tmp=ReadFD((void *)((char *)buffer+available),bufferSize-available);
-        if (tmp == -1 || tmp == 0)
+        if (tmp == -1 || (tmp == 0 && available == 0))
         {
             *r=tmp;
             return NULL;
@@ -188,11 +529,7 @@ void * DRAL_BUFFERED_READ_CLASS::Read(UINT32 n, INT64 * r)
         if ((available+tmp) < n)  // we wanted more bytes than the file has
         {
             *r=0;
-            dralListener->Error(
-                "Unexpected end of file\n"
-                "Please report this bug to dral@bssad.intel.com attaching "
-                "input files (if any)"
-                );
+            dralListener->Error(unexpectedEOF);
             errorFound=true;
             return NULL;
         }
@@ -291,5 +628,145 @@ UINT64 DRAL_BUFFERED_READ_CLASS::GetNumBytesRead (void)
 
 UINT32 DRAL_BUFFERED_READ_CLASS::AvailableBytes (void)
 {
+    if (mapBase != NULL)
+    {
+        // Nothing is ever moved: every unread byte of the file is available
+        UINT64 left = mapSize - mapPos;
+        return (left > 0xffffffffULL ? 0xffffffffU : (UINT32) left);
+    }
     return available;
 }
+
+bool DRAL_BUFFERED_READ_CLASS::Seek (UINT64 offset)
+{
+    if (errorFound)
+    {
+        return false;
+    }
+
+    if (mapBase != NULL)
+    {
+        if (offset > mapSize)
+        {
+            RemapFile();
+        }
+        if (offset > mapSize)
+        {
+            return false;
+        }
+        mapPos = offset;
+        return true;
+    }
+
+    if (lseek(fd,0,SEEK_CUR) == -1)
+    {
+        // pipes, sockets...
+        return false;
+    }
+
+    if (readAhead)
+    {
+        StopReadAhead();
+    }
+    gzclose(file);
+    file = NULL;
+
+    if (lseek(fd,offset,SEEK_SET) == -1)
+    {
+        dralListener->Error(strerror(errno));
+        dralListener->EndSimulation();
+        errorFound=true;
+        return false;
+    }
+
+    // A new gzip stream starting at the offset
+    file=gzdopen(dup(fd),"r");
+    if (file == NULL)
+    {
+        dralListener->Error(strerror(errno));
+        dralListener->EndSimulation();
+        errorFound=true;
+        return false;
+    }
+    available = 0;
+    pos = 0;
+    StartReadAhead();
+    return true;
+}
+
+INT64 DRAL_BUFFERED_READ_CLASS::ReadTail (void * buf, UINT32 n)
+{
+    struct stat s;
+
+    if (fstat(fd,&s) || !S_ISREG(s.st_mode) || s.st_size < (off_t) n)
+    {
+        return -1;
+    }
+    if (pread(fd,buf,n,s.st_size - n) != (ssize_t) n)
+    {
+        return -1;
+    }
+    return s.st_size - n;
+}
+
+char * DRAL_BUFFERED_READ_CLASS::ReadRange (UINT64 begin, UINT64 end, UINT64 * len)
+{
+    if (end <= begin)
+    {
+        return NULL;
+    }
+
+    UINT64 size = end - begin;
+    unsigned char * raw = new unsigned char [size];
+    if (pread(fd,raw,size,begin) != (ssize_t) size)
+    {
+        delete [] raw;
+        return NULL;
+    }
+
+    if (size < 2 || raw[0] != 0x1f || raw[1] != 0x8b)
+    {
+        *len = size;
+        return (char *) raw;
+    }
+
+    // A gzip member: inflate it whole
+    z_stream z;
+    memset(&z,0,sizeof(z));
+    if (inflateInit2(&z,16 + MAX_WBITS) != Z_OK)
+    {
+        delete [] raw;
+        return NULL;
+    }
+
+    UINT64 outSize = size * 4;
+    char * out = new char [outSize];
+    int ret = Z_OK;
+    z.next_in = raw;
+    z.avail_in = size;
+    z.next_out = (Bytef *) out;
+    z.avail_out = outSize;
+    while ((ret = inflate(&z,Z_NO_FLUSH)) == Z_OK)
+    {
+        if (z.avail_out == 0)
+        {
+            char * bigger = new char [outSize * 2];
+            memcpy(bigger,out,outSize);
+            delete [] out;
+            out = bigger;
+            z.next_out = (Bytef *) (out + outSize);
+            z.avail_out = outSize;
+            outSize *= 2;
+        }
+    }
+    *len = z.total_out;
+    inflateEnd(&z);
+    delete [] raw;
+
+    if (ret != Z_STREAM_END)
+    {
+        delete [] out;
+        return NULL;
+    }
+    return out;
+}
@@ -80,13 +80,15 @@ union VA_LIST_TYPE
 
 typedef VA_LIST_TYPE VA_LIST_T;
 
+__thread DRAL_SUBSTREAM DRAL_SERVER_CLASS::threadSubstream = NULL;
+
 
 /*
  * constructor with the name of the file that will be used
  * to write the events and the size of the write buffer
  */
 DRAL_SERVER_CLASS::DRAL_SERVER_CLASS(
-    const char * fileName, UINT16 buffer_size, bool avoid_rep,
+    const char * fileName, UINT32 buffer_size, bool avoid_rep,
     bool compression, bool embededTarFile)
 {
     Init(buffer_size,avoid_rep,compression);
@@ -104,7 +106,7 @@ DRAL_SERVER_CLASS::DRAL_SERVER_CLASS(
  * Note: The file descriptor will not be closed
  */
 DRAL_SERVER_CLASS::DRAL_SERVER_CLASS(
-    int fd, UINT16 buffer_size, bool avoid_rep,
+    int fd, UINT32 buffer_size, bool avoid_rep,
     bool compression, bool embededTarFile)
 {
     Init(buffer_size,avoid_rep,compression);
@@ -117,7 +119,7 @@ DRAL_SERVER_CLASS::DRAL_SERVER_CLASS(
 }
 
 void
-DRAL_SERVER_CLASS::Init(UINT16 buffer_size, bool avoid_rep, bool compression)
+DRAL_SERVER_CLASS::Init(UINT32 buffer_size, bool avoid_rep, bool compression)
 {
     implementation= new DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS(
         buffer_size,compression);
@@ -125,10 +127,13 @@ DRAL_SERVER_CLASS::Init(UINT16 buffer_size, bool avoid_rep, bool compression)
     turnedOn=false;
     buff_size=buffer_size;
     avoid_node_reps=avoid_rep;
-    item_id=1; // itemId 0 is reserved (used as 'invalid' itemId value)
+    substreamIdBits=0;
     node_id=0;
     edge_id=0;
     clock_id=0;
+    recorderStarted=false;
+    flightRecorderDump=0;
+    pthread_mutex_init(&liveItemsLock, NULL);
 
     // FEDE: for convenience, make autocompress for node tags on by default
     nodetagAutocompress = true;
@@ -140,6 +145,19 @@ DRAL_SERVER_CLASS::Init(UINT16 buffer_size, bool avoid_rep, bool compression)
         nodetagAutocompress = (!strcasecmp(compress,"true"));
         cout << "autocompress set to " << nodetagAutocompress << endl;
     }
+
+    char* blockCycles = getenv("DRAL_BLOCK_CYCLES");
+    char* flightBlocks = getenv("DRAL_FLIGHT_RECORDER");
+    if (flightBlocks!=NULL)
+    {
+        implementation->SetFlightRecorder(
+            (blockCycles!=NULL ? strtoull(blockCycles,NULL,0) : 1000),
+            strtoul(flightBlocks,NULL,0));
+    }
+    else if (blockCycles!=NULL)
+    {
+        implementation->SetBlockCycles(strtoull(blockCycles,NULL,0));
+    }
 }
 
 
@@ -148,6 +166,13 @@ DRAL_SERVER_CLASS::Init(UINT16 buffer_size, bool avoid_rep, bool compression)
  */
 DRAL_SERVER_CLASS::~DRAL_SERVER_CLASS()
 {
+    MergeSubstreams(UINT64_MAX, UINT32_MAX);
+    FlushQueuedMoves();
+    for (UINT32 i = 0; i < substreams.size(); i++)
+    {
+        delete substreams[i];
+    }
+    pthread_mutex_destroy(&liveItemsLock);
     delete implementation; // this will flush the buffer
     delete dralStorage; // this will free the memory
     if (openedWithFileName && fileOpened)
@@ -180,7 +205,15 @@ DRAL_SERVER_CLASS::~DRAL_SERVER_CLASS()
 void
 DRAL_SERVER_CLASS::TurnOn()
 {
-    if (openedWithFileName && !fileOpened)
+    if (openedWithFileName && !recorderStarted &&
+        implementation->IsFlightRecorder())
+    {
+        // no output file: everything stays in the flight recorder
+        implementation->Version();
+        dralStorage->DumpAllCommandsList();
+        recorderStarted=true;
+    }
+    else if (openedWithFileName && !fileOpened && !recorderStarted)
     {
         std::string dral_file_name = file_name;
         std::string ptv_file_name = file_name;
@@ -216,6 +249,8 @@ DRAL_SERVER_CLASS::TurnOn()
     }
     else
     {
+        // moves queued while off only update the off-state bookkeeping
+        FlushQueuedMoves();
         dralStorage->DumpPartialList();
         DumpLiveItemIds();
     }
@@ -228,6 +263,7 @@ DRAL_SERVER_CLASS::TurnOff (void)
 {
     if (turnedOn)
     {
+        FlushQueuedMoves();
         turnedOn=false;
         implementation->Flush();
     }
@@ -245,6 +281,7 @@ DRAL_SERVER_CLASS::ChangeFileName(const char * fileName)
     {
         if (fileOpened)
         {
+            implementation->FinishFile();
             close(file_descriptor);
         }
         fileOpened=false;
@@ -258,6 +295,149 @@ DRAL_SERVER_CLASS::ChangeFileName(const char * fileName)
     }
 }
 
+void
+DRAL_SERVER_CLASS::SetFlightRecorder(UINT64 cycles, UINT32 blocks)
+{
+    if (openedWithFileName && !fileOpened && !recorderStarted)
+    {
+        implementation->SetFlightRecorder(cycles, blocks);
+    }
+    else
+    {
+        DRAL_WARNING(
+            "The dral flight recorder can only be set "
+            "before the output file is opened.");
+    }
+}
+
+bool
+DRAL_SERVER_CLASS::IsFlightRecorder(void) const
+{
+    return implementation->IsFlightRecorder();
+}
+
+bool
+DRAL_SERVER_CLASS::DumpFlightRecorder(const char * fileName)
+{
+    flightRecorderDump=0;
+    if (!implementation->IsFlightRecorder())
+    {
+        return false;
+    }
+
+    std::string dump_file_name;
+    if (fileName != NULL)
+    {
+        dump_file_name = fileName;
+    }
+    else if (openedWithFileName)
+    {
+        dump_file_name = file_name + "_flight";
+    }
+    else
+    {
+        dump_file_name = "dral_flight";
+    }
+    dump_file_name += ".drl.gz";
+
+    FlushQueuedMoves();
+
+    int fd=open(
+        dump_file_name.c_str(),O_CREAT|O_WRONLY|O_TRUNC|O_LARGEFILE,00660);
+    if (fd == -1)
+    {
+        DRAL_WARNING("Error opening the file " << dump_file_name << ": "
+                     << strerror(errno));
+        return false;
+    }
+    bool ok = implementation->DumpFlightRecorder(fd);
+    close(fd);
+    return ok;
+}
+
+void
+DRAL_SERVER_CLASS::SetBlockCycles(UINT64 cycles)
+{
+    if (openedWithFileName && !fileOpened)
+    {
+        implementation->SetBlockCycles(cycles);
+    }
+    else
+    {
+        DRAL_WARNING(
+            "The dral trace can only be split in blocks "
+            "before the output file is opened.");
+    }
+}
+
+DRAL_SUBSTREAM
+DRAL_SERVER_CLASS::NewSubstream(void)
+{
+    DRAL_ASSERT(!com_edge_bw,
+        "The edge bandwidth cannot be computed with events sent in parallel");
+    DRAL_ASSERT(substreams.size() < 65535, "Too many substreams");
+    if (!openedWithFileName || fileOpened || recorderStarted)
+    {
+        DRAL_WARNING(
+            "The dral trace can only take events in parallel "
+            "if they are enabled before the output file is opened.");
+        return NULL;
+    }
+    DRAL_SERVER_IMPLEMENTATION encoder = implementation->NewEncoder();
+    if (encoder == NULL)
+    {
+        DRAL_WARNING("This dral server cannot take events in parallel");
+        return NULL;
+    }
+    DRAL_SUBSTREAM s = new DRAL_SUBSTREAM_CLASS(substreams.size() + 1, encoder);
+    substreams.push_back(s);
+
+    // make room for the new substream id in the high bits of the item ids
+    while ((UINT32(1) << substreamIdBits) <= substreams.size())
+    {
+        substreamIdBits++;
+    }
+    DRAL_ASSERT(ownState.itemCount < (UINT64(1) << (32 - substreamIdBits)) - 2,
+        "Too many items allocated before the substreams were created");
+    return s;
+}
+
+void
+DRAL_SERVER_CLASS::AttachSubstream(DRAL_SUBSTREAM substream)
+{
+    threadSubstream = substream;
+}
+
+void
+DRAL_SERVER_CLASS::BeginChunk(UINT64 time, UINT32 seq)
+{
+    DRAL_ASSERT(threadSubstream != NULL, "The thread has no substream");
+    threadSubstream->BeginChunk(time, seq);
+}
+
+void
+DRAL_SERVER_CLASS::EndChunk(void)
+{
+    DRAL_ASSERT(threadSubstream != NULL, "The thread has no substream");
+    threadSubstream->EndChunk();
+}
+
+void
+DRAL_SERVER_CLASS::MergeSubstreams(UINT64 time, UINT32 seq)
+{
+    DRAL_SERVER_IMPLEMENTATION out = (turnedOn ? implementation : NULL);
+    bool merged = false;
+    for (UINT32 i = 0; i < substreams.size(); i++)
+    {
+        merged |= substreams[i]->Merge(time, seq, out, &ownState);
+    }
+    if (merged)
+    {
+        // back to the encoding of our own stream
+        implementation->Substream(0);
+    }
+}
+
 /*
  * public methods to write events to the file descriptor
  */
@@ -266,6 +446,12 @@ DRAL_SERVER_CLASS::Cycle (UINT64 n, bool persistent)
 {
     DRAL_ASSERT(!(n >> 58),"Parameter n is too large");
 
+    FlushQueuedMoves();
+    if (flightRecorderDump)
+    {
+        DumpFlightRecorder();
+    }
+
     if(com_edge_bw)
     {
         UpdateEdgeMaxBandwidth();
@@ -279,7 +465,7 @@ DRAL_SERVER_CLASS::Cycle (UINT64 n, bool persistent)
     }
     if (persistent)
     {
-        DRAL_CYCLE_STORAGE c = new DRAL_CYCLE_STORAGE_CLASS(n);
+        DRAL_CYCLE_STORAGE c = new (dralStorage) DRAL_CYCLE_STORAGE_CLASS(n);
         dralStorage->Store(c,!turnedOn);
     }
 }
@@ -332,15 +518,24 @@ DRAL_SERVER_CLASS::NewItem (UINT32 itemId, bool persistent)
     DRAL_ASSERT(itemId != 0, "Sorry, itemId 0 is reserved and cannot be used");
     if (turnedOn)
     {
-        implementation->NewItem(itemId);
+        Encoder(persistent)->NewItem(itemId);
     }
     else if (!persistent)
     {
-        liveItems.insert(itemId);
+        if (threadSubstream != NULL)
+        {
+            pthread_mutex_lock(&liveItemsLock);
+            liveItems.insert(itemId);
+            pthread_mutex_unlock(&liveItemsLock);
+        }
+        else
+        {
+            liveItems.insert(itemId);
+        }
     }
     if (persistent)
     {
-        DRAL_NEWITEM_STORAGE ni = new DRAL_NEWITEM_STORAGE_CLASS(itemId);
+        DRAL_NEWITEM_STORAGE ni = new (dralStorage) DRAL_NEWITEM_STORAGE_CLASS(itemId);
         dralStorage->Store(ni,!turnedOn);
     }
 }
@@ -349,14 +544,30 @@ DRAL_SERVER_CLASS::NewItem (UINT32 itemId, bool persistent)
 UINT32
 DRAL_SERVER_CLASS::NewItem (bool persistent)
 {
-    NewItem(item_id,persistent);
-    item_id++;
-    if (item_id == UINT32_MAX)
-    {
-        cout<<"We have reached the limit here.."<<endl;
-        item_id = 1;
-    }
-    return (item_id-1);
+    UINT32 itemId = AllocItemId();
+    NewItem(itemId,persistent);
+    return itemId;
+}
+
+UINT32
+DRAL_SERVER_CLASS::AllocItemId (void)
+{
+    // Every substream has a counter of its own, and its id in the high
+    // bits, so the ids a thread takes do not depend on the other threads.
+    // In the low bits 0 is reserved (used as 'invalid' itemId value) and
+    // all ones is avoided (UINT32_MAX is DRAL_ANY).
+    const UINT32 lowBits = 32 - substreamIdBits;
+    const UINT64 numIds = (UINT64(1) << lowBits) - 2;
+    UINT64 substreamId = (threadSubstream == NULL ? 0 : threadSubstream->GetId());
+
+    UINT64 n = __sync_fetch_and_add(&ThreadState().itemCount, 1);
+    UINT64 low = n % numIds + 1;
+    if (low == 1 && n != 0)
+    {
+        DRAL_WARNING("Item ids of substream " << substreamId
+            << " wrapped around after " << n << " items");
+    }
+    return UINT32((substreamId << lowBits) | low);
 }
 
 
@@ -373,12 +584,12 @@ DRAL_SERVER_CLASS::SetItemTag (
         "Parameter tag_name " << tag_name << " is too long");
     if (turnedOn)
     {
-        implementation->SetItemTag(itemId,tag_name,tag_name_len,value);
+        Encoder(persistent)->SetItemTag(itemId,tag_name,tag_name_len,value);
     }
     if (persistent)
     {
         DRAL_SETITEMTAG_STORAGE sitsv =
-            new DRAL_SETITEMTAG_STORAGE_CLASS(itemId,tag_name,value);
+            new (dralStorage) DRAL_SETITEMTAG_STORAGE_CLASS(itemId,tag_name,value);
         dralStorage->Store(sitsv,!turnedOn);
     }
 }
@@ -400,13 +611,13 @@ DRAL_SERVER_CLASS::SetItemTag (
     DRAL_ASSERT(str_len < 65536 && str_len != 0,"Wrong string length");
     if (turnedOn)
     {
-        implementation->SetItemTag(
+        Encoder(persistent)->SetItemTag(
             itemId,tag_name,tag_name_len,str,str_len);
     }
     if (persistent)
     {
         DRAL_SETITEMTAGSTRING_STORAGE sitstring =
-            new DRAL_SETITEMTAGSTRING_STORAGE_CLASS(itemId,tag_name,str);
+            new (dralStorage) DRAL_SETITEMTAGSTRING_STORAGE_CLASS(itemId,tag_name,str);
         dralStorage->Store(sitstring,!turnedOn);
     }
 }
@@ -428,12 +639,12 @@ DRAL_SERVER_CLASS::SetItemTag (
         "The set size is not valid");
     if (turnedOn)
     {
-        implementation->SetItemTag(itemId,tag_name,tag_name_len,nval,value);
+        Encoder(persistent)->SetItemTag(itemId,tag_name,tag_name_len,nval,value);
     }
     if (persistent)
     {
         DRAL_SETITEMTAGSET_STORAGE sitset =
-            new DRAL_SETITEMTAGSET_STORAGE_CLASS(itemId,tag_name,nval,value);
+            new (dralStorage) DRAL_SETITEMTAGSET_STORAGE_CLASS(itemId,tag_name,nval,value);
         dralStorage->Store(sitset,!turnedOn);
     }
 }
@@ -458,16 +669,109 @@ DRAL_SERVER_CLASS::MoveItems (
     }
     if (turnedOn && n!=0) // we do not want an error if n == 0, just ignore it
     {
-        implementation->MoveItems(edgeId,n,itemId,position);
+        Encoder(persistent)->MoveItems(edgeId,n,itemId,position);
     }
     if (persistent && n!=0)
     {
-        DRAL_MOVEITEMS_STORAGE mi = new DRAL_MOVEITEMS_STORAGE_CLASS (
-            edgeId,n,itemId,position);
+        DRAL_MOVEITEMS_STORAGE mi = new (dralStorage) DRAL_MOVEITEMS_STORAGE_CLASS (
+            dralStorage,edgeId,n,itemId,position);
         dralStorage->Store(mi,!turnedOn);
     }
 }
 
+void
+DRAL_SERVER_CLASS::QueueMoveItem (UINT16 edgeId, UINT32 itemId)
+{
+    ThreadState().QueueMove(edgeId, itemId);
+}
+
+void
+DRAL_SERVER_CLASS::FlushQueuedMoves (void)
+{
+    DRAL_THREAD_STATE_CLASS & state = ThreadState();
+    if (state.queuedEdges.empty())
+    {
+        return;
+    }
+    for (UINT32 i = 0; i < state.queuedEdges.size(); i++)
+    {
+        vector<UINT32> & items = state.queuedMoves[state.queuedEdges[i]];
+        for (UINT32 first = 0; first < items.size(); first += 31)
+        {
+            UINT32 n = items.size() - first;
+            MoveItems(state.queuedEdges[i], (n < 31 ? n : 31), &items[first]);
+        }
+        items.clear();
+    }
+    state.queuedEdges.clear();
+
+    for (UINT32 i = 0; i < state.queuedDeletes.size(); i++)
+    {
+        DeleteItem(state.queuedDeletes[i]);
+    }
+    state.queuedDeletes.clear();
+}
+
+void
+DRAL_SERVER_CLASS::Commit (DRAL_EVENT_BATCH batch, bool persistent)
+{
+    bool replay = !turnedOn || persistent;
+    for (UINT32 i = 0; i < batch->Size() && !replay; i++)
+    {
+        const DRAL_EVENT_BATCH_CLASS::EVENT & e = batch->GetEvent(i);
+        if (e.type == DRAL_EVENT_BATCH_CLASS::ENTERNODE &&
+            e.id < auto_flush.size() && auto_flush[e.id])
+        {
+            // auto-flush nodes need the EnterNode bookkeeping
+            replay = true;
+        }
+    }
+
+    if (replay)
+    {
+        for (UINT32 i = 0; i < batch->Size(); i++)
+        {
+            const DRAL_EVENT_BATCH_CLASS::EVENT & e = batch->GetEvent(i);
+            switch (e.type)
+            {
+                case DRAL_EVENT_BATCH_CLASS::MOVEITEMS:
+                    MoveItems(e.id, e.len, batch->GetValues(e.item),
+                        (e.pos == DRAL_EVENT_BATCH_CLASS::NO_POSITION ?
+                         NULL : batch->GetValues(e.pos)), persistent);
+                    break;
+
+                case DRAL_EVENT_BATCH_CLASS::ENTERNODE:
+                    EnterNode(e.id, e.item, e.len, batch->GetValues(e.pos),
+                        persistent);
+                    break;
+
+                case DRAL_EVENT_BATCH_CLASS::SETITEMTAG:
+                    SetItemTag(e.item, e.tag, e.value, persistent);
+                    break;
+            }
+        }
+    }
+    else
+    {
+        if (com_edge_bw)
+        {
+            for (UINT32 i = 0; i < batch->Size(); i++)
+            {
+                const DRAL_EVENT_BATCH_CLASS::EVENT & e = batch->GetEvent(i);
+                if (e.type == DRAL_EVENT_BATCH_CLASS::MOVEITEMS)
+                {
+                    edge_bw[e.id] += e.len;
+                }
+            }
+        }
+        if (!batch->Empty())
+        {
+            Encoder(false)->Batch(batch);
+        }
+    }
+    batch->Clear();
+}
+
 void
 DRAL_SERVER_CLASS::EnterNode (
     UINT16 nodeId, UINT32 itemId, UINT16 dim,
@@ -605,12 +909,12 @@ DRAL_SERVER_CLASS::DralEnterNode (
     DRAL_ASSERT(dim < 16, "Number of dimensions must be lower than 16");
     if (turnedOn)
     {
-        implementation->EnterNode(nodeId,itemId,dim,position);
+        Encoder(persistent)->EnterNode(nodeId,itemId,dim,position);
     }
     if (persistent)
     {
-        DRAL_ENTERNODE_STORAGE en = new DRAL_ENTERNODE_STORAGE_CLASS (
-            nodeId,itemId,dim,position);
+        DRAL_ENTERNODE_STORAGE en = new (dralStorage) DRAL_ENTERNODE_STORAGE_CLASS (
+            dralStorage,nodeId,itemId,dim,position);
         dralStorage->Store(en,!turnedOn);
     }
 }    
@@ -625,12 +929,12 @@ DRAL_SERVER_CLASS::DralExitNode (
     DRAL_ASSERT(dim < 16, "Number of dimensions must be lower than 16");
     if (turnedOn)
     {
-        implementation->ExitNode(nodeId,itemId,dim,position);
+        Encoder(persistent)->ExitNode(nodeId,itemId,dim,position);
     }
     if (persistent)
     {
-        DRAL_EXITNODE_STORAGE en = new DRAL_EXITNODE_STORAGE_CLASS (
-            nodeId,itemId,dim,position);
+        DRAL_EXITNODE_STORAGE en = new (dralStorage) DRAL_EXITNODE_STORAGE_CLASS (
+            dralStorage,nodeId,itemId,dim,position);
         dralStorage->Store(en,!turnedOn);
     }
 }
@@ -638,21 +942,36 @@ DRAL_SERVER_CLASS::DralExitNode (
 void
 DRAL_SERVER_CLASS::DeleteItem (UINT32 itemId, bool persistent)
 {
+    DRAL_THREAD_STATE_CLASS & state = ThreadState();
+    if (!persistent && state.IsQueued(itemId))
+    {
+        // it must go after the queued move
+        state.queuedDeletes.push_back(itemId);
+        return;
+    }
     if (turnedOn)
     {
-        implementation->DeleteItem(itemId);
+        Encoder(persistent)->DeleteItem(itemId);
     }
     else if (!persistent)
     {
+        if (threadSubstream != NULL)
+        {
+            pthread_mutex_lock(&liveItemsLock);
+        }
         liveItemsList::iterator it = liveItems.find(itemId);
         if (it != liveItems.end())
         {
             liveItems.erase(it);
         }
+        if (threadSubstream != NULL)
+        {
+            pthread_mutex_unlock(&liveItemsLock);
+        }
     }
     if (persistent)
     {
-        DRAL_DELETEITEM_STORAGE di = new DRAL_DELETEITEM_STORAGE_CLASS (itemId);
+        DRAL_DELETEITEM_STORAGE di = new (dralStorage) DRAL_DELETEITEM_STORAGE_CLASS (itemId);
         dralStorage->Store(di,!turnedOn);
     }
 }
@@ -674,7 +993,7 @@ DRAL_SERVER_CLASS::NewNode (
     }
     if (persistent)
     {
-        DRAL_NEWNODE_STORAGE nn = new DRAL_NEWNODE_STORAGE_CLASS (
+        DRAL_NEWNODE_STORAGE nn = new (dralStorage) DRAL_NEWNODE_STORAGE_CLASS (
             nodeId,name,parent_id,instance_temp);
         dralStorage->Store(nn,!turnedOn);
     }
@@ -741,7 +1060,7 @@ DRAL_SERVER_CLASS::NewEdge (
     }
     if (persistent)
     {
-        DRAL_NEWEDGE_STORAGE ne = new DRAL_NEWEDGE_STORAGE_CLASS (
+        DRAL_NEWEDGE_STORAGE ne = new (dralStorage) DRAL_NEWEDGE_STORAGE_CLASS (
             edgeId,source_node,destination_node,bandwidth,latency,name);
         dralStorage->Store(ne,!turnedOn);
     }
@@ -771,7 +1090,7 @@ DRAL_SERVER_CLASS::SetNodeLayout (
     }
     if (persistent)
     {
-        DRAL_SETNODELAYOUT_STORAGE sl = new DRAL_SETNODELAYOUT_STORAGE_CLASS (
+        DRAL_SETNODELAYOUT_STORAGE sl = new (dralStorage) DRAL_SETNODELAYOUT_STORAGE_CLASS (
             nodeId,dimensions,capacity);
         dralStorage->Store(sl,!turnedOn);
     }
@@ -808,11 +1127,11 @@ DRAL_SERVER_CLASS::Comment(
         "Comment == NULL or wrong comment length");
     if (turnedOn)
     {
-        implementation->Comment(magic_num,comment,comment_len);
+        Encoder(persistent)->Comment(magic_num,comment,comment_len);
     }
     if (persistent)
     {
-        DRAL_COMMENT_STORAGE c = new DRAL_COMMENT_STORAGE_CLASS (
+        DRAL_COMMENT_STORAGE c = new (dralStorage) DRAL_COMMENT_STORAGE_CLASS (
             magic_num,comment);
         dralStorage->Store(c,!turnedOn);
     }
@@ -825,11 +1144,11 @@ DRAL_SERVER_CLASS::CommentBin(
     DRAL_ASSERT(length != 0, "Binary content with length 0 bytes");
     if (turnedOn)
     {
-        implementation->CommentBin(magic_num,contents,length);
+        Encoder(persistent)->CommentBin(magic_num,contents,length);
     }
     if (persistent)
     {
-        DRAL_COMMENTBIN_STORAGE cb = new DRAL_COMMENTBIN_STORAGE_CLASS (
+        DRAL_COMMENTBIN_STORAGE cb = new (dralStorage) DRAL_COMMENTBIN_STORAGE_CLASS (
             magic_num,contents,length);
         dralStorage->Store(cb,!turnedOn);
     }
@@ -840,6 +1159,7 @@ DRAL_SERVER_CLASS::getNodeTagMap(const char tag_name[])
 {
     Nodetagcache_tag_map* result=NULL;
     
+    Nodetagcache_map & nodetagcache = ThreadState().nodetagcache;
     Nodetagcache_map::iterator it = nodetagcache.find(tag_name);
     if (it != nodetagcache.end())
     {
@@ -889,7 +1209,7 @@ DRAL_SERVER_CLASS::SetNodeTag(
 
         if (doCmd) 
         {
-            implementation->SetNodeTag(node_id,tag_name,tag_name_len,value,level,list);
+            Encoder(persistent)->SetNodeTag(node_id,tag_name,tag_name_len,value,level,list);
             
             // update compression struct if needed
             if (nodetagAutocompress && !level)
@@ -906,7 +1226,7 @@ DRAL_SERVER_CLASS::SetNodeTag(
     if (persistent && doCmd)
     {
         DRAL_SETNODETAG_STORAGE sntsv = 
-            new DRAL_SETNODETAG_STORAGE_CLASS (
+            new (dralStorage) DRAL_SETNODETAG_STORAGE_CLASS (
                 node_id,tag_name,value,level,list);
         dralStorage->Store(sntsv,!turnedOn);
     }
@@ -926,13 +1246,13 @@ DRAL_SERVER_CLASS::SetNodeTag(
     DRAL_ASSERT(str_len < 65536 && str_len != 0,"Wrong string length");
     if (turnedOn)
     {
-        implementation->SetNodeTag(
+        Encoder(persistent)->SetNodeTag(
             node_id,tag_name,tag_name_len,str,str_len,level,list);
     }
     if (persistent)
     {
         DRAL_SETNODETAGSTRING_STORAGE sntstr = 
-            new DRAL_SETNODETAGSTRING_STORAGE_CLASS (
+            new (dralStorage) DRAL_SETNODETAGSTRING_STORAGE_CLASS (
                 node_id,tag_name,str,level,list);
         dralStorage->Store(sntstr,!turnedOn);
     }    
@@ -951,13 +1271,13 @@ DRAL_SERVER_CLASS::SetNodeTag(
         "The set size is not valid");
     if (turnedOn)
     {
-        implementation->SetNodeTag(
+        Encoder(persistent)->SetNodeTag(
             node_id,tag_name,tag_name_len,nval,set,level,list);
     }
     if (persistent)
     {
         DRAL_SETNODETAGSET_STORAGE sntset = 
-            new DRAL_SETNODETAGSET_STORAGE_CLASS (
+            new (dralStorage) DRAL_SETNODETAGSET_STORAGE_CLASS (
                 node_id,tag_name,nval,set,level,list);
         dralStorage->Store(sntset,!turnedOn);
     }
@@ -974,12 +1294,12 @@ DRAL_SERVER_CLASS::SetCycleTag (
         "Parameter tag_name " << tag_name << " is too long");
     if (turnedOn)
     {
-        implementation->SetCycleTag(tag_name,tag_name_len,value);
+        Encoder(persistent)->SetCycleTag(tag_name,tag_name_len,value);
     }
     if (persistent)
     {
         DRAL_SETCYCLETAG_STORAGE sctsv =
-            new DRAL_SETCYCLETAG_STORAGE_CLASS(tag_name,value);
+            new (dralStorage) DRAL_SETCYCLETAG_STORAGE_CLASS(tag_name,value);
         dralStorage->Store(sctsv,!turnedOn);
     }
 }
@@ -998,12 +1318,12 @@ DRAL_SERVER_CLASS::SetCycleTag (
     DRAL_ASSERT(str_len < 65536 && str_len != 0,"Wrong string length");
     if (turnedOn)
     {
-        implementation->SetCycleTag(tag_name,tag_name_len,str,str_len);
+        Encoder(persistent)->SetCycleTag(tag_name,tag_name_len,str,str_len);
     }
     if (persistent)
     {
         DRAL_SETCYCLETAGSTRING_STORAGE sctstring =
-            new DRAL_SETCYCLETAGSTRING_STORAGE_CLASS(tag_name,str);
+            new (dralStorage) DRAL_SETCYCLETAGSTRING_STORAGE_CLASS(tag_name,str);
         dralStorage->Store(sctstring,!turnedOn);
     }
 }
@@ -1022,12 +1342,12 @@ DRAL_SERVER_CLASS::SetCycleTag (
         "The set size is not valid");
     if (turnedOn)
     {
-        implementation->SetCycleTag(tag_name,tag_name_len,nval,value);
+        Encoder(persistent)->SetCycleTag(tag_name,tag_name_len,nval,value);
     }
     if (persistent)
     {
         DRAL_SETCYCLETAGSET_STORAGE sctset =
-            new DRAL_SETCYCLETAGSET_STORAGE_CLASS(tag_name,nval,value);
+            new (dralStorage) DRAL_SETCYCLETAGSET_STORAGE_CLASS(tag_name,nval,value);
         dralStorage->Store(sctset,!turnedOn);
     }
 }
@@ -1065,7 +1385,7 @@ DRAL_SERVER_CLASS::SetNodeInputBandwidth(
     if (persistent)
     {
         DRAL_SETNODEINPUTBANDWIDTH_STORAGE snib =
-            new DRAL_SETNODEINPUTBANDWIDTH_STORAGE_CLASS (nodeId,bandwidth);
+            new (dralStorage) DRAL_SETNODEINPUTBANDWIDTH_STORAGE_CLASS (nodeId,bandwidth);
         dralStorage->Store(snib,!turnedOn);
     }
 }
@@ -1081,7 +1401,7 @@ DRAL_SERVER_CLASS::SetNodeOutputBandwidth(
     if (persistent)
     {
         DRAL_SETNODEOUTPUTBANDWIDTH_STORAGE snob =
-            new DRAL_SETNODEOUTPUTBANDWIDTH_STORAGE_CLASS (nodeId,bandwidth);
+            new (dralStorage) DRAL_SETNODEOUTPUTBANDWIDTH_STORAGE_CLASS (nodeId,bandwidth);
         dralStorage->Store(snob,!turnedOn);
     }
 }
@@ -1117,7 +1437,7 @@ DRAL_SERVER_CLASS::SetTagDescription(
     if (persistent)
     {
         DRAL_SETTAGDESCRIPTION_STORAGE stdc =
-            new DRAL_SETTAGDESCRIPTION_STORAGE_CLASS (
+            new (dralStorage) DRAL_SETTAGDESCRIPTION_STORAGE_CLASS (
                 tag,description);
         dralStorage->Store(stdc,!turnedOn);
     }
@@ -1134,7 +1454,7 @@ DRAL_SERVER_CLASS::SetNodeClock(
     if (persistent)
     {
         DRAL_SETNODECLOCK_STORAGE snc =
-            new DRAL_SETNODECLOCK_STORAGE_CLASS(nodeId, clockId);
+            new (dralStorage) DRAL_SETNODECLOCK_STORAGE_CLASS(nodeId, clockId);
         dralStorage->Store(snc,!turnedOn);
     }
 }
@@ -1163,7 +1483,7 @@ DRAL_SERVER_CLASS::NewClock(
     if (persistent)
     {
         DRAL_NEWCLOCK_STORAGE nc =
-            new DRAL_NEWCLOCK_STORAGE_CLASS(clockId,freq,skew,divisions,name);
+            new (dralStorage) DRAL_NEWCLOCK_STORAGE_CLASS(clockId,freq,skew,divisions,name);
         dralStorage->Store(nc,!turnedOn);
     }
 }
@@ -1172,7 +1492,13 @@ void
 DRAL_SERVER_CLASS::Cycle (UINT16 clockId, UINT64 n, UINT16 phase, bool persistent)
 {
     DRAL_ASSERT(!(n >> 42),"Parameter n is too large");
- 
+
+    FlushQueuedMoves();
+    if (flightRecorderDump)
+    {
+        DumpFlightRecorder();
+    }
+
     if(com_edge_bw)
     {
         UpdateEdgeMaxBandwidth();
@@ -1188,7 +1514,7 @@ DRAL_SERVER_CLASS::Cycle (UINT16 clockId, UINT64 n, UINT16 phase, bool persisten
     if (persistent)
     {
         DRAL_CYCLEWITHCLOCK_STORAGE c =
-            new DRAL_CYCLEWITHCLOCK_STORAGE_CLASS(clockId,n,phase);
+            new (dralStorage) DRAL_CYCLEWITHCLOCK_STORAGE_CLASS(clockId,n,phase);
         dralStorage->Store(c,!turnedOn);
     }
 }
@@ -1196,6 +1522,7 @@ DRAL_SERVER_CLASS::Cycle (UINT16 clockId, UINT64 n, UINT16 phase, bool persisten
 void
 DRAL_SERVER_CLASS::DumpLiveItemIds()
 {
+    pthread_mutex_lock(&liveItemsLock);
     liveItemsList::iterator it = liveItems.begin();
     while (it != liveItems.end())
     {
@@ -1203,11 +1530,14 @@ DRAL_SERVER_CLASS::DumpLiveItemIds()
         ++it;
     }
     liveItems.clear();
+    pthread_mutex_unlock(&liveItemsLock);
 }
 
 void
 DRAL_SERVER_CLASS::ComputeEdgeMaxBandwidth()
 {
+    DRAL_ASSERT(substreams.empty(),
+        "The edge bandwidth cannot be computed with events sent in parallel");
     com_edge_bw=true;
     max_edge_bw=new UINT32[65536];
 }
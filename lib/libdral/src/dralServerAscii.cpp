@@ -45,7 +45,7 @@ using namespace std;
 
 DRAL_SERVER_ASCII_IMPLEMENTATION_CLASS::
     DRAL_SERVER_ASCII_IMPLEMENTATION_CLASS(
-        UINT16 buffer_size, bool compression) :
+        UINT32 buffer_size, bool compression) :
     DRAL_SERVER_IMPLEMENTATION_CLASS(buffer_size,compression) {}
 
 /*
@@ -38,13 +38,21 @@
 #include "asim/dralServerBinaryDefines.h"
 #include "asim/dralServerBinary.h"
 
-DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS::DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS(UINT16 buffer_size, bool compression)
+DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS::DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS(UINT32 buffer_size, bool compression)
     : DRAL_SERVER_IMPLEMENTATION_CLASS(buffer_size,compression), tag_map(256), str_val_map(65536)
 {
     lastClockId = (UINT16) -1;
     lastCycle = (UINT64) -1;
     lastPhase = (UINT16) -1;
 
+    blockCycles = 0;
+    nextBlockCycle = 0;
+    hasSubstreams = false;
+
+    recorder = NULL;
+    bufferSize = buffer_size;
+    compress = compression;
+
     STATS
     (
         printf("DralServer stats enabled...\n");
@@ -118,10 +126,18 @@ DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS::DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS
 
 DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS::~DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS()
 {
+    FinishFile();
+
     STATS
     (
         dumpStats();
     )
+
+    if (recorder != NULL)
+    {
+        dralWrite->SetRecorder(NULL);
+        delete recorder;
+    }
 }
 
 void
@@ -134,6 +150,8 @@ DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS::Cycle (
         UINT64 n            : 58;
     } command;
 
+    CheckNewBlock(n);
+
     command.commandCode=DRAL3_CYCLE;
     command.n=n;
 
@@ -152,6 +170,8 @@ void
 DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS::StartActivity (
     UINT64 firstActCycle)
 {
+    DRAL_DICTIONARY_SCOPE_CLASS dictionary(recorder);
+
     struct startActivityFormat
     {
         UINT64 commandCode      : 6;
@@ -174,6 +194,8 @@ void
 DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS::NewNode (
     UINT16 node_id, const char name[], UINT16 name_len, UINT16 parent_id, UINT16 instance)
 {
+    DRAL_DICTIONARY_SCOPE_CLASS dictionary(recorder);
+
     struct newNodeFormat
     {
         UINT64 commandCode  : 6;
@@ -210,6 +232,8 @@ void
 DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS::NewEdge(
     UINT16 edge_id, UINT16 source_node, UINT16 destination_node, UINT32 bandwidth, UINT32 latency, const char name[], UINT16 name_len)
 {
+    DRAL_DICTIONARY_SCOPE_CLASS dictionary(recorder);
+
     struct newEdgeFormat
     {
         UINT64 commandCode  : 6;
@@ -255,6 +279,8 @@ void
 DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS::SetNodeLayout (
     UINT16 node_id, UINT16 dimensions, const UINT32 capacity [])
 {
+    DRAL_DICTIONARY_SCOPE_CLASS dictionary(recorder);
+
     struct setNodeLayoutFormat
     {
         UINT8 commandCode  : 6;
@@ -288,6 +314,8 @@ void
 DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS::SetNodeInputBandwidth (
     UINT16 nodeId, UINT32 bandwidth)
 {
+    DRAL_DICTIONARY_SCOPE_CLASS dictionary(recorder);
+
     struct setNodeInputBandwidthFormat
     {
         UINT8 commandCode  : 6;
@@ -319,6 +347,8 @@ void
 DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS::SetNodeOutputBandwidth (
     UINT16 nodeId, UINT32 bandwidth)
 {
+    DRAL_DICTIONARY_SCOPE_CLASS dictionary(recorder);
+
     struct setNodeOutputBandwidthFormat
     {
         UINT8 commandCode  : 6;
@@ -403,6 +433,8 @@ void
 DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS::SetNodeClock(
     UINT16 nodeId, UINT16 clockId)
 {
+    DRAL_DICTIONARY_SCOPE_CLASS dictionary(recorder);
+
     struct setNodeClockFormat
     {
         UINT8 commandCode  : 6;
@@ -435,6 +467,8 @@ DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS::NewClock(
     UINT16 clockId, UINT64 freq, UINT16 skew, UINT16 divisions,
     const char name [], UINT16 nameLen)
 {
+    DRAL_DICTIONARY_SCOPE_CLASS dictionary(recorder);
+
     struct newClockFormat
     {
         UINT8 commandCode  : 6;
@@ -474,6 +508,8 @@ DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS::Cycle (
         return;
     }
 
+    CheckNewBlock(n);
+
     lastClockId = clockId;
     lastCycle = n;
     lastPhase = phase;
@@ -532,6 +568,8 @@ DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS::SetTagDescription(
 void
 DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS::Version (void)
 {
+    DRAL_DICTIONARY_SCOPE_CLASS dictionary(recorder);
+
     struct versionFormat
     {
         UINT64 commandCode      : 6;
@@ -542,7 +580,8 @@ DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS::Version (void)
 
     command.commandCode = DRAL_VERSION;
     command.reserved = 0;
-    command.major_version = DRAL_SERVER_VERSION_MAJOR;
+    command.major_version = ((blockCycles || hasSubstreams) ?
+        DRAL_SERVER_BLOCKS_VERSION_MAJOR : DRAL_SERVER_VERSION_MAJOR);
     command.minor_version = DRAL_SERVER_VERSION_MINOR;
 
     dralWrite->Write(&command,sizeof(command));
@@ -554,6 +593,225 @@ DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS::Version (void)
     )
 }
 
+/*
+ * Traces split in blocks (version 5).
+ *
+ * A new block is started with the first cycle command of every
+ * 'blockCycles' cycles. All the state the encoding depends on (delta ids,
+ * tag and string mappings, last cycle) is reset at the beginning of a
+ * block, and when compressing every block is a gzip member of its own, so
+ * a block can be decoded starting at its file offset once the commands
+ * before the first block (version, graph...) have been read.
+ *
+ * When the file is finished, the index with the first cycle and the offset
+ * of each block is written in a block of its own, followed by a locator
+ * with the offset of the index and a magic number at the very end of the
+ * file. The locator is not compressed, so a client finds the index
+ * reading the last bytes of the file.
+ */
+void
+DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS::SetBlockCycles (UINT64 cycles)
+{
+    blockCycles = cycles;
+    nextBlockCycle = 0;
+    blockIndex.clear();
+}
+
+void
+DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS::CheckNewBlock (UINT64 n)
+{
+    if (blockCycles == 0 || n < nextBlockCycle)
+    {
+        return;
+    }
+
+    if (recorder != NULL)
+    {
+        // the flight recorder keeps the index of its own blocks
+        recorder->NewBlock(n);
+    }
+    else
+    {
+        INT64 offset = dralWrite->NewBlock();
+        if (offset == -1)
+        {
+            DRAL_WARNING("The dral trace cannot be split in blocks: "
+                         "the output is not seekable");
+            blockCycles = 0;
+            return;
+        }
+        blockIndex.push_back(make_pair(n, (UINT64) offset));
+    }
+    nextBlockCycle = n - (n % blockCycles) + blockCycles;
+
+    ResetEncoding();
+
+    struct blockFormat
+    {
+        UINT64 commandCode  : 6;
+        UINT64 n            : 58;
+    } command;
+
+    command.commandCode = DRAL3_BLOCK;
+    command.n = n;
+
+    dralWrite->Write(&command, sizeof(command));
+}
+
+void
+DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS::ResetEncoding (void)
+{
+    last_item = 0;
+    last_node = 0;
+    last_edge = 0;
+    lastClockId = (UINT16) -1;
+    lastCycle = (UINT64) -1;
+    lastPhase = (UINT16) -1;
+    tag_map.reset();
+    str_val_map.reset();
+}
+
+void
+DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS::FinishFile (void)
+{
+    if (blockIndex.empty())
+    {
+        return;
+    }
+
+    WriteBlockIndex(dralWrite, blockIndex);
+
+    blockIndex.clear();
+    nextBlockCycle = 0;
+}
+
+void
+DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS::WriteBlockIndex (
+    DRAL_BUFFERED_WRITE out, const vector<pair<UINT64, UINT64> > & index)
+{
+    struct blockIndexFormat
+    {
+        UINT64 commandCode  : 6;
+        UINT64 reserved     : 26;
+        UINT64 numBlocks    : 32;
+    } command;
+
+    struct indexLocatorFormat
+    {
+        UINT64 commandCode  : 6;
+        UINT64 reserved     : 58;
+        UINT64 offset;
+        UINT64 magic;
+    } locator;
+
+    INT64 offset = out->NewBlock();
+
+    command.commandCode = DRAL3_BLOCKINDEX;
+    command.reserved = 0;
+    command.numBlocks = index.size();
+    out->Write(&command, sizeof(command));
+    for (UINT32 i = 0; i < index.size(); i++)
+    {
+        out->Write(&index[i].first, sizeof(UINT64));
+        out->Write(&index[i].second, sizeof(UINT64));
+    }
+
+    locator.commandCode = DRAL3_INDEXLOCATOR;
+    locator.reserved = 0;
+    locator.offset = offset;
+    locator.magic = DRAL_INDEX_MAGICNUM;
+    out->WriteTrailer(&locator, sizeof(locator));
+}
+
+/*
+ * Flight recorder.
+ *
+ * The trace is split in blocks as above, but the encoding goes to a ring
+ * of blocks in memory instead of the file. The version and the commands
+ * that describe the graph go to the dictionary of the recorder wherever
+ * they are issued, so a dump always has them: they do not depend on the
+ * state of the encoding (delta ids, tag mappings) that a block resets.
+ */
+void
+DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS::SetFlightRecorder (
+    UINT64 cycles, UINT32 blocks)
+{
+    DRAL_ASSERT(cycles > 0 && blocks > 0,
+        "The flight recorder needs some cycles and blocks");
+    if (recorder != NULL)
+    {
+        DRAL_WARNING("The flight recorder is already set");
+        return;
+    }
+    SetBlockCycles(cycles);
+    recorder = new DRAL_FLIGHT_RECORDER_CLASS(blocks);
+    dralWrite->SetRecorder(recorder);
+}
+
+bool
+DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS::DumpFlightRecorder (int fd)
+{
+    if (recorder == NULL)
+    {
+        return false;
+    }
+
+    DRAL_BUFFERED_WRITE_CLASS out(bufferSize, compress);
+    out.SetFileDescriptor(fd);
+
+    vector<pair<UINT64, UINT64> > index;
+    recorder->Dump(&out, index);
+    if (!index.empty())
+    {
+        WriteBlockIndex(&out, index);
+    }
+    else
+    {
+        out.Flush();
+    }
+    return true;
+}
+
+/*
+ * Substreams.
+ *
+ * A thread sending events in parallel with others encodes them with an
+ * encoder of its own, in chunks that get merged into the trace later (see
+ * DRAL_SUBSTREAM_CLASS). Every chunk starts with a substream command that
+ * resets the delta encoding state in the client, and the encoder forgets
+ * its own state and tag and string mappings, so the chunk decodes the
+ * same wherever it is merged. The server's own stream does the same after
+ * the chunks, going back to substream 0.
+ */
+DRAL_SERVER_IMPLEMENTATION
+DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS::NewEncoder (void)
+{
+    // the substream commands need a version 5 client
+    hasSubstreams = true;
+
+    // unbuffered: it only writes to memory
+    return new DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS(0, false);
+}
+
+void
+DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS::Substream (UINT16 stream)
+{
+    ResetEncoding();
+
+    struct substreamFormat
+    {
+        UINT32 commandCode  : 6;
+        UINT32 reserved     : 10;
+        UINT32 stream       : 16;
+    } command;
+
+    command.commandCode = DRAL3_SUBSTREAM;
+    command.reserved = 0;
+    command.stream = stream;
+
+    dralWrite->Write(&command, sizeof(command));
+}
+
 void
 DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS::NewItem (
     UINT32 item_id)
@@ -1830,28 +2088,241 @@ DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS::SetCycleTag (
     )
 }
 
-DRAL3_VALUE_SIZE
-DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS::getMaxBitsVector(UINT32 n, UINT32 * values, INT32 last_value)
+/*
+ * Appends the low 'size' bytes of a value to a batch encoding
+ */
+static inline void
+putBatchValue(char * & p, UINT64 value, DRAL3_VALUE_SIZE size)
 {
-    DRAL3_VALUE_SIZE max_bits;
-    DRAL3_VALUE_SIZE temp_max_bits;
-    INT32 delta;
+    UINT32 bytes = 1 << size;
+    memcpy(p, &value, bytes);
+    p += bytes;
+}
+
+void
+DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS::Batch (DRAL_EVENT_BATCH batch)
+{
+    struct moveItemsFormat
+    {
+        UINT8 commandCode      : 6;
+        UINT8 item_size        : 2;
+        UINT8 edge_size        : 2;
+        UINT8 positionsPresent : 1;
+        UINT8 n                : 5;
+    } move;
+
+    struct enterNodeFormat
+    {
+        UINT8 commandCode  : 6;
+        UINT8 item_size    : 2;
+        UINT8 node_size    : 2;
+        UINT8 dim_size     : 2;
+        UINT8 dimensions   : 4;
+    } enter;
+
+    struct setItemTagFormat
+    {
+        UINT8 commandCode  : 6;
+        UINT8 val_size     : 2;
+        UINT8 tag_idx;
+    } tag;
+
+    struct newTagEntryFormat
+    {
+        UINT8 commandCode : 6;
+        UINT8 reserved    : 2;
+        UINT8 tag_id;
+        UINT8 tag_len;
+    } tagEntry;
+
+    // Worst case size of the encoding
+    UINT32 size = 0;
+    for (UINT32 i = 0; i < batch->Size(); i++)
+    {
+        const DRAL_EVENT_BATCH_CLASS::EVENT & e = batch->GetEvent(i);
+        switch (e.type)
+        {
+            case DRAL_EVENT_BATCH_CLASS::MOVEITEMS:
+                size += sizeof(move) + sizeof(INT16) + e.len * 2 * sizeof(UINT32);
+                break;
 
-    max_bits = VALUE_8_BITS;
+            case DRAL_EVENT_BATCH_CLASS::ENTERNODE:
+                size += sizeof(enter) + sizeof(INT32) + sizeof(INT16) +
+                    e.len * sizeof(INT32);
+                break;
 
-    // Gets the maximum number of bits needed to represent the deltas.
-    for(UINT32 i = 0; i < n; i++)
+            case DRAL_EVENT_BATCH_CLASS::SETITEMTAG:
+                size += sizeof(tagEntry) + e.len + sizeof(tag) +
+                    sizeof(INT32) + sizeof(UINT64);
+                break;
+        }
+    }
+    if (batchBuffer.size() < size)
     {
-        delta = values[i] - last_value;
-        temp_max_bits = getRangeSize(delta);
-        if(temp_max_bits > max_bits)
+        batchBuffer.resize(size);
+    }
+
+    // The commands are encoded exactly as the single event methods do,
+    // but into one buffer that is written at once
+    char * p = &batchBuffer[0];
+    char * start;     // beginning of the command (for the stats)
+    INT32 delta;
+    for (UINT32 i = 0; i < batch->Size(); i++)
+    {
+        const DRAL_EVENT_BATCH_CLASS::EVENT & e = batch->GetEvent(i);
+        start = p;
+        switch (e.type)
         {
-            max_bits = temp_max_bits;
+            case DRAL_EVENT_BATCH_CLASS::MOVEITEMS:
+            {
+                UINT32 * items = batch->GetValues(e.item);
+                bool positionsPresent =
+                    (e.pos != DRAL_EVENT_BATCH_CLASS::NO_POSITION);
+
+                delta = e.id - last_edge;
+                last_edge = e.id;
+                move.commandCode = DRAL3_MOVEITEMS;
+                move.item_size = getMaxBitsVector(e.len, items, last_item);
+                move.edge_size = getRangeSize(delta);
+                move.positionsPresent = positionsPresent;
+                move.n = e.len;
+                assert(move.edge_size < VALUE_32_BITS);
+
+                memcpy(p, &move, sizeof(move));
+                p += sizeof(move);
+                putBatchValue(p, delta, (DRAL3_VALUE_SIZE)move.edge_size);
+                for (UINT32 j = 0; j < e.len; j++)
+                {
+                    delta = items[j] - last_item;
+                    last_item = items[j];
+                    putBatchValue(p, delta, (DRAL3_VALUE_SIZE)move.item_size);
+                }
+                if (positionsPresent)
+                {
+                    memcpy(p, batch->GetValues(e.pos), e.len * sizeof(UINT32));
+                    p += e.len * sizeof(UINT32);
+                }
+
+                STATS
+                (
+                    moveItem++;
+                    moveItemSize += p - start;
+                    move_item_edges[e.id] += e.len;
+                )
+                break;
+            }
+
+            case DRAL_EVENT_BATCH_CLASS::ENTERNODE:
+            {
+                UINT32 * position = batch->GetValues(e.pos);
+                INT32 item_delta = e.item - last_item;
+                INT32 node_delta = e.id - last_node;
+                last_item = e.item;
+                last_node = e.id;
+
+                enter.commandCode = DRAL3_ENTERNODE;
+                enter.item_size = getRangeSize(item_delta);
+                enter.node_size = getRangeSize(node_delta);
+                enter.dim_size = getMaxBitsVector(e.len, position, 0);
+                enter.dimensions = e.len;
+                assert(enter.node_size < VALUE_32_BITS);
+
+                memcpy(p, &enter, sizeof(enter));
+                p += sizeof(enter);
+                putBatchValue(p, item_delta, (DRAL3_VALUE_SIZE)enter.item_size);
+                putBatchValue(p, node_delta, (DRAL3_VALUE_SIZE)enter.node_size);
+                INT32 last_dim = 0;
+                for (UINT32 j = 0; j < e.len; j++)
+                {
+                    delta = position[j] - last_dim;
+                    last_dim = position[j];
+                    putBatchValue(p, delta, (DRAL3_VALUE_SIZE)enter.dim_size);
+                }
+
+                STATS
+                (
+                    enterNode++;
+                    enterNodeSize += p - start;
+                )
+                break;
+            }
+
+            case DRAL_EVENT_BATCH_CLASS::SETITEMTAG:
+            {
+                delta = e.item - last_item;
+                DRAL3_VALUE_SIZE item_size = getRangeSize(delta);
+                last_item = e.item;
+
+                // Same as getTagIndex, but the new tag goes to the batch
+                UINT32 index;
+                if (tag_map.getMapping(e.tag, e.len, &index))
+                {
+                    tagEntry.commandCode = DRAL3_NEWTAG;
+                    tagEntry.reserved = 0;
+                    tagEntry.tag_id = index;
+                    tagEntry.tag_len = e.len;
+                    memcpy(p, &tagEntry, sizeof(tagEntry));
+                    p += sizeof(tagEntry);
+                    memcpy(p, e.tag, e.len);
+                    p += e.len;
+                    start = p;
+                }
+
+                tag.commandCode = DRAL3_SETITEMTAG_VALUE_8_BITS + item_size;
+                tag.val_size = getValSize(e.value);
+                tag.tag_idx = index;
+                assert(item_size < VALUE_64_BITS);
+
+                memcpy(p, &tag, sizeof(tag));
+                p += sizeof(tag);
+                putBatchValue(p, delta, item_size);
+                putBatchValue(p, e.value, (DRAL3_VALUE_SIZE)tag.val_size);
+
+                STATS
+                (
+                    setItemTagVal++;
+                    setItemTagValSize += p - start;
+                )
+                break;
+            }
         }
-        last_value = values[i];
     }
 
-    return max_bits;
+    dralWrite->Write(&batchBuffer[0], p - &batchBuffer[0]);
+}
+
+DRAL3_VALUE_SIZE
+DRAL_SERVER_BINARY_IMPLEMENTATION_CLASS::getMaxBitsVector(UINT32 n, UINT32 * values, INT32 last_value)
+{
+    if(n == 0)
+    {
+        return VALUE_8_BITS;
+    }
+
+    // A delta fits in 8 (16) bits when (delta ^ sign) is below 2^7 (2^15),
+    // so the width of the largest delta is the width of the OR of all of
+    // them. The loop has no branches nor loop carried dependencies and
+    // the compiler vectorizes it.
+    INT32 delta = values[0] - last_value;
+    UINT32 bits = delta ^ (delta >> 31);
+    for(UINT32 i = 1; i < n; i++)
+    {
+        delta = values[i] - values[i - 1];
+        bits |= delta ^ (delta >> 31);
+    }
+
+    if(bits < 128)
+    {
+        return VALUE_8_BITS;
+    }
+    else if(bits < 32768)
+    {
+        return VALUE_16_BITS;
+    }
+    else
+    {
+        return VALUE_32_BITS;
+    }
 }
 
 STATS
@@ -32,7 +32,7 @@
 #include "asim/dralServerImplementation.h"
 
 DRAL_SERVER_IMPLEMENTATION_CLASS::
-    DRAL_SERVER_IMPLEMENTATION_CLASS(UINT16 buffer_size, bool compression)
+    DRAL_SERVER_IMPLEMENTATION_CLASS(UINT32 buffer_size, bool compression)
 {
     dralWrite = new DRAL_BUFFERED_WRITE_CLASS (buffer_size,compression);
 }
@@ -57,3 +57,79 @@ DRAL_SERVER_IMPLEMENTATION_CLASS::SetFileDescriptor (int fd)
 {
     dralWrite->SetFileDescriptor(fd);
 }
+
+void
+DRAL_SERVER_IMPLEMENTATION_CLASS::Batch (DRAL_EVENT_BATCH batch)
+{
+    for (UINT32 i = 0; i < batch->Size(); i++)
+    {
+        const DRAL_EVENT_BATCH_CLASS::EVENT & e = batch->GetEvent(i);
+        switch (e.type)
+        {
+            case DRAL_EVENT_BATCH_CLASS::MOVEITEMS:
+                MoveItems(e.id, e.len, batch->GetValues(e.item),
+                    (e.pos == DRAL_EVENT_BATCH_CLASS::NO_POSITION ?
+                     NULL : batch->GetValues(e.pos)));
+                break;
+
+            case DRAL_EVENT_BATCH_CLASS::ENTERNODE:
+                EnterNode(e.id, e.item, e.len, batch->GetValues(e.pos));
+                break;
+
+            case DRAL_EVENT_BATCH_CLASS::SETITEMTAG:
+                SetItemTag(e.item, e.tag, e.len, e.value);
+                break;
+        }
+    }
+}
+
+void
+DRAL_SERVER_IMPLEMENTATION_CLASS::SetBlockCycles (UINT64)
+{
+}
+
+void
+DRAL_SERVER_IMPLEMENTATION_CLASS::FinishFile (void)
+{
+}
+
+void
+DRAL_SERVER_IMPLEMENTATION_CLASS::SetFlightRecorder (UINT64, UINT32)
+{
+    DRAL_WARNING("This dral server implementation has no flight recorder");
+}
+
+bool
+DRAL_SERVER_IMPLEMENTATION_CLASS::IsFlightRecorder (void) const
+{
+    return false;
+}
+
+bool
+DRAL_SERVER_IMPLEMENTATION_CLASS::DumpFlightRecorder (int)
+{
+    return false;
+}
+
+DRAL_SERVER_IMPLEMENTATION_CLASS *
+DRAL_SERVER_IMPLEMENTATION_CLASS::NewEncoder (void)
+{
+    return NULL;
+}
+
+void
+DRAL_SERVER_IMPLEMENTATION_CLASS::Substream (UINT16)
+{
+}
+
+void
+DRAL_SERVER_IMPLEMENTATION_CLASS::WriteEncoded (const void * buf, UINT32 len)
+{
+    dralWrite->Write(buf,len);
+}
+
+void
+DRAL_SERVER_IMPLEMENTATION_CLASS::SetMemory (vector<char> * m)
+{
+    dralWrite->SetMemory(m);
+}
@@ -39,12 +39,14 @@ void DRAL_STORAGE_CLASS::ChangeImplementation(DRAL_SERVER_IMPLEMENTATION impl)
 DRAL_STORAGE_CLASS::DRAL_STORAGE_CLASS(DRAL_SERVER_IMPLEMENTATION impl)
 {
     implementation=impl;
+    arenaPos=NULL;
+    arenaLeft=0;
 }
 
 DRAL_STORAGE_CLASS::~DRAL_STORAGE_CLASS(void)
 {
     for(
-        list<DRAL_COMMAND_STORAGE>::const_iterator i=allCommandsList.begin();
+        vector<DRAL_COMMAND_STORAGE>::const_iterator i=allCommandsList.begin();
         i != allCommandsList.end();
         ++i)
     {
@@ -53,6 +55,26 @@ DRAL_STORAGE_CLASS::~DRAL_STORAGE_CLASS(void)
     allCommandsList.clear();
     numInstanceList.clear();
     partialCommandList.clear();
+
+    for(UINT32 i = 0; i < arenaChunks.size(); i++)
+    {
+        delete [] arenaChunks[i];
+    }
+}
+
+void * DRAL_STORAGE_CLASS::AllocChunk(size_t size)
+{
+    if (size > ARENA_CHUNK_SIZE / 4)
+    {
+        // Too big to waste the rest of a chunk: it gets its own one
+        char * p = new char [size];
+        arenaChunks.push_back(p);
+        return p;
+    }
+    arenaPos = new char [ARENA_CHUNK_SIZE];
+    arenaChunks.push_back(arenaPos);
+    arenaLeft = ARENA_CHUNK_SIZE;
+    return Alloc(size);
 }
 
 void DRAL_STORAGE_CLASS::ResetPartialList(void)
@@ -79,7 +101,7 @@ void DRAL_STORAGE_CLASS::Store(
 void DRAL_STORAGE_CLASS::DumpPartialList(void)
 {
     for(
-        list<DRAL_COMMAND_STORAGE>::const_iterator i=partialCommandList.begin();
+        vector<DRAL_COMMAND_STORAGE>::const_iterator i=partialCommandList.begin();
         i != partialCommandList.end();
         ++i)
     {
@@ -90,7 +112,7 @@ void DRAL_STORAGE_CLASS::DumpPartialList(void)
 void DRAL_STORAGE_CLASS::DumpAllCommandsList(void)
 {
     for(
-        list<DRAL_COMMAND_STORAGE>::const_iterator i=allCommandsList.begin();
+        vector<DRAL_COMMAND_STORAGE>::const_iterator i=allCommandsList.begin();
         i != allCommandsList.end();
         ++i)
     {
@@ -52,6 +52,13 @@ DRAL_STRING_MAPPING_CLASS::~DRAL_STRING_MAPPING_CLASS()
 {
 }
 
+void
+DRAL_STRING_MAPPING_CLASS::reset()
+{
+    mapping.clear();
+    lru.clear();
+}
+
 bool
 DRAL_STRING_MAPPING_CLASS::getMapping(const char * str, UINT16 strlen, UINT32 * index)
 {
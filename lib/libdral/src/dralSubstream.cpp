@@ -0,0 +1,195 @@
+/**************************************************************************
+ * Copyright (c) 2014, Intel Corporation
+ *
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are 
+ * met:
+ * 
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright 
+ *   notice, this list of conditions and the following disclaimer in the 
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the Intel Corporation nor the names of its 
+ *   contributors may be used to endorse or promote products derived from 
+ *   this software without specific prior written permission.
+ *  
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file dralSubstream.cpp
+ * @author Pau Cabre 
+ * @brief events encoded by a thread in parallel with others
+ */
+
+
+#include "asim/dralSubstream.h"
+#include "asim/dralServerDefines.h"
+
+DRAL_THREAD_STATE_CLASS::~DRAL_THREAD_STATE_CLASS (void)
+{
+    for (Nodetagcache_map::iterator it = nodetagcache.begin();
+         it != nodetagcache.end(); ++it)
+    {
+        delete it->second;
+    }
+}
+
+void
+DRAL_THREAD_STATE_CLASS::QueueMove (UINT16 edgeId, UINT32 itemId)
+{
+    if (edgeId >= queuedMoves.size())
+    {
+        queuedMoves.resize(edgeId + 1);
+    }
+    vector<UINT32> & items = queuedMoves[edgeId];
+    for (UINT32 i = 0; i < items.size(); i++)
+    {
+        if (items[i] == itemId)
+        {
+            // already moved through this edge in this cycle
+            return;
+        }
+    }
+    if (items.empty())
+    {
+        queuedEdges.push_back(edgeId);
+    }
+    items.push_back(itemId);
+}
+
+bool
+DRAL_THREAD_STATE_CLASS::IsQueued (UINT32 itemId) const
+{
+    // there are only the moves of a cycle, so a scan is cheap enough
+    for (UINT32 i = 0; i < queuedEdges.size(); i++)
+    {
+        const vector<UINT32> & items = queuedMoves[queuedEdges[i]];
+        for (UINT32 j = 0; j < items.size(); j++)
+        {
+            if (items[j] == itemId)
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+DRAL_SUBSTREAM_CLASS::DRAL_SUBSTREAM_CLASS (
+    UINT16 i, DRAL_SERVER_IMPLEMENTATION e)
+{
+    id = i;
+    encoder = e;
+    current = NULL;
+    spare = NULL;
+
+    // size of the substream command
+    vector<char> header;
+    encoder->SetMemory(&header);
+    encoder->Substream(id);
+    encoder->SetMemory(NULL);
+    headerSize = header.size();
+}
+
+DRAL_SUBSTREAM_CLASS::~DRAL_SUBSTREAM_CLASS (void)
+{
+    delete current;
+    delete spare;
+    delete encoder;
+}
+
+void
+DRAL_SUBSTREAM_CLASS::BeginChunk (UINT64 time, UINT32 seq)
+{
+    DRAL_ASSERT(current == NULL, "The previous chunk has not been ended");
+    if (spare != NULL)
+    {
+        current = spare;
+        spare = NULL;
+    }
+    else
+    {
+        current = chunks.Alloc();
+    }
+    current->time = time;
+    current->seq = seq;
+    current->data.clear();
+    current->moves.clear();
+    current->deletes.clear();
+    encoder->SetMemory(&current->data);
+    encoder->Substream(id);
+}
+
+void
+DRAL_SUBSTREAM_CLASS::EndChunk (void)
+{
+    DRAL_ASSERT(current != NULL, "There is no chunk to end");
+    encoder->SetMemory(NULL);
+
+    // the queued moves are sent by the merging thread
+    for (UINT32 i = 0; i < state.queuedEdges.size(); i++)
+    {
+        vector<UINT32> & items = state.queuedMoves[state.queuedEdges[i]];
+        for (UINT32 j = 0; j < items.size(); j++)
+        {
+            current->moves.push_back(state.queuedEdges[i]);
+            current->moves.push_back(items[j]);
+        }
+        items.clear();
+    }
+    state.queuedEdges.clear();
+    current->deletes.swap(state.queuedDeletes);
+
+    if (current->data.size() == headerSize &&
+        current->moves.empty() && current->deletes.empty())
+    {
+        spare = current;
+    }
+    else
+    {
+        chunks.Push(current);
+    }
+    current = NULL;
+}
+
+bool
+DRAL_SUBSTREAM_CLASS::Merge (
+    UINT64 time, UINT32 seq, DRAL_SERVER_IMPLEMENTATION out,
+    DRAL_THREAD_STATE_CLASS * queue)
+{
+    bool merged = false;
+    for (;;)
+    {
+        CHUNK * c = chunks.Front();
+        if (c == NULL || c->time > time || (c->time == time && c->seq > seq))
+        {
+            break;
+        }
+        if (out != NULL)
+        {
+            out->WriteEncoded(&c->data[0], c->data.size());
+            merged = true;
+        }
+        for (UINT32 i = 0; i < c->moves.size(); i += 2)
+        {
+            queue->QueueMove(c->moves[i], c->moves[i + 1]);
+        }
+        queue->queuedDeletes.insert(
+            queue->queuedDeletes.end(), c->deletes.begin(), c->deletes.end());
+        chunks.Pop();
+    }
+    return merged;
+}
@@ -43,12 +43,27 @@
 using namespace std;
 
 #include "asim/dralWrite.h"
+#include "asim/dralFlightRecorder.h"
 #include "asim/dralServerDefines.h"
 
 DRAL_BUFFERED_WRITE_CLASS::DRAL_BUFFERED_WRITE_CLASS (
-    UINT16 buffer_size, bool compression)
+    UINT32 buffer_size, bool compression)
 {
-    if (buffer_size != 0)
+    compress = compression;
+    buffer = NULL;
+    if (compress)
+    {
+        // The blocks are allocated when the file descriptor is set
+        buf_size = buffer_size;
+        if (buf_size < DRAL_COMPRESS_BLOCK_SIZE)
+        {
+            buf_size = DRAL_COMPRESS_BLOCK_SIZE;
+        }
+        pos = 0;
+        available = 0;
+        buffered = true;
+    }
+    else if (buffer_size != 0)
     {
         buf_size=buffer_size;
         buffer = new char [buf_size];
@@ -62,39 +77,75 @@ DRAL_BUFFERED_WRITE_CLASS::DRAL_BUFFERED_WRITE_CLASS (
         buffered = false;
     }
     memset((void *)zeros,0,8);
-    file = NULL;
+    fd = -1;
     uncompressed_file = NULL;
-    compress = compression;
+    recorder = NULL;
+    memory = NULL;
+
+    slots = NULL;
+    num_slots = 0;
+    num_threads = 0;
+    threads_running = false;
+    stopping = false;
+    submitted = 0;
+    taken = 0;
+    written = 0;
 }
 
 DRAL_BUFFERED_WRITE_CLASS::~DRAL_BUFFERED_WRITE_CLASS ()
 {
-    if (compress && (file != NULL))
+    if (compress && (fd != -1))
     {
-        gzclose(file);
+        // Pending data not flushed by the owner is written anyway
+        Flush();
     }
 
+    StopThreads();
+
     if (!compress && (uncompressed_file != NULL))
     {
         fclose(uncompressed_file);
     }
 
-    if (buffered)
+    if (fd != -1)
+    {
+        close(fd);
+    }
+
+    if (slots != NULL)
+    {
+        for (UINT32 i = 0; i < num_slots; i++)
+        {
+            delete [] slots[i].in;
+            delete [] slots[i].out;
+        }
+        delete [] slots;
+        deflateEnd(&stream);
+    }
+    else if (buffered && !compress)
     {
         delete [] buffer;
     }
 }
 
-void DRAL_BUFFERED_WRITE_CLASS::SetFileDescriptor (int fd)
+void DRAL_BUFFERED_WRITE_CLASS::SetFileDescriptor (int file_descriptor)
 {
-    if (compress)
+    // Keep our own descriptor: the caller may close its own before we
+    // are done (see DRAL_SERVER_CLASS::ChangeFileName)
+    if (fd != -1)
     {
-        if (file != NULL)
+        if (compress)
         {
-            gzclose(file);
+            // the blocks of the previous file go to the previous file
+            Flush();
         }
-        file = gzdopen(dup(fd),"wb");
-        DRAL_ASSERT(file!=NULL, "Error opening the file descriptor");
+        close(fd);
+    }
+    fd = dup(file_descriptor);
+    DRAL_ASSERT(fd!=-1, "Error opening the file descriptor");
+    if (compress)
+    {
+        StartThreads();
     }
     else
     {
@@ -115,7 +166,34 @@ void DRAL_BUFFERED_WRITE_CLASS::Write (const void * buf, UINT32 n)
         /* Zlib produce errors if one tries to write 0 bytes */
         return;
     }
-    if (buffered)
+    if (recorder != NULL)
+    {
+        recorder->Write(buf,n);
+        return;
+    }
+    if (memory != NULL)
+    {
+        memory->insert(memory->end(),(const char *)buf,(const char *)buf+n);
+        return;
+    }
+    if (compress)
+    {
+        DRAL_ASSERT(buffer!=NULL,"The file descriptor has not been set");
+        const char * p = (const char *)buf;
+        while (n > available)
+        {
+            memcpy(buffer+pos,p,available);
+            p+=available;
+            n-=available;
+            pos+=available;
+            available=0;
+            SubmitBlock();
+        }
+        memcpy(buffer+pos,p,n);
+        pos+=n;
+        available-=n;
+    }
+    else if (buffered)
     {
         if (available >= n)
         {
@@ -149,22 +227,41 @@ void DRAL_BUFFERED_WRITE_CLASS::WriteFD (const void * buf, UINT32 n)
     INT32 k;
     if (compress)
     {
-        DRAL_ASSERT(file!=NULL,"The file descriptor has not been set");
-        k=gzwrite(file,(void *)buf,n);
-    }
-    else
-    {
-        DRAL_ASSERT(
-            uncompressed_file!=NULL,"The file descriptor has not been set");
-         k=fwrite((void *)buf,1,n,uncompressed_file);
+        // Already compressed data: straight to the file descriptor
+        DRAL_ASSERT(fd!=-1,"The file descriptor has not been set");
+        const char * p = (const char *)buf;
+        while (n > 0)
+        {
+            k=write(fd,p,n);
+            if (k < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            DRAL_ASSERT(k > 0,
+                "Error writing to the file descriptor: " << strerror(errno));
+            p+=k;
+            n-=k;
+        }
+        return;
     }
+    DRAL_ASSERT(
+        uncompressed_file!=NULL,"The file descriptor has not been set");
+    k=fwrite((void *)buf,1,n,uncompressed_file);
     DRAL_ASSERT(
         UINT32(k)==n,"Error writing to the file descriptor: " << strerror(errno));
 }
 
 void DRAL_BUFFERED_WRITE_CLASS::Flush (void)
 {
-    if ((file != NULL || uncompressed_file != NULL) && buffered)
+    if (compress)
+    {
+        if (fd != -1)
+        {
+            SubmitBlock();
+            Drain();
+        }
+    }
+    else if (uncompressed_file != NULL && buffered)
                                    //this method is invoked when destroying
                                    //the DRAL_SERVER, so we have to check
                                    //whether the file descriptor is open or
@@ -175,3 +272,241 @@ void DRAL_BUFFERED_WRITE_CLASS::Flush (void)
         pos=0;
     }
 }
+
+INT64 DRAL_BUFFERED_WRITE_CLASS::NewBlock (void)
+{
+    DRAL_ASSERT(fd!=-1 && (compress || uncompressed_file!=NULL),
+        "The file descriptor has not been set");
+
+    // When compressing every submitted block is already a gzip member on
+    // its own, so writing all of them is enough
+    Flush();
+    if (!compress)
+    {
+        DRAL_ASSERT(fflush(uncompressed_file)==0,
+            "Error writing to the file descriptor: " << strerror(errno));
+    }
+    return lseek(fd,0,SEEK_CUR);
+}
+
+void DRAL_BUFFERED_WRITE_CLASS::WriteTrailer (const void * buf, UINT32 n)
+{
+    DRAL_ASSERT(fd!=-1 && (compress || uncompressed_file!=NULL),
+        "The file descriptor has not been set");
+
+    Flush();
+    WriteFD(buf,n);
+    if (compress)
+    {
+        close(fd);
+        fd = -1;
+    }
+    else
+    {
+        fclose(uncompressed_file);
+        uncompressed_file = NULL;
+    }
+}
+
+/*
+ * Compression pipeline
+ */
+
+void DRAL_BUFFERED_WRITE_CLASS::SubmitBlock (void)
+{
+    DRAL_ASSERT(fd!=-1,"The file descriptor has not been set");
+    if (pos == 0)
+    {
+        return;
+    }
+
+    COMPRESS_SLOT * slot = &slots[submitted % num_slots];
+    slot->in_len = pos;
+    if (num_threads == 0)
+    {
+        CompressBlock(&stream,slot);
+        WriteFD(slot->out,slot->out_len);
+        submitted++;
+        taken++;
+        written++;
+    }
+    else
+    {
+        pthread_mutex_lock(&lock);
+        submitted++;
+        pthread_cond_signal(&block_submitted);
+        // The next slot is free once its previous block is in the file
+        while (submitted - written >= num_slots)
+        {
+            pthread_cond_wait(&block_written,&lock);
+        }
+        pthread_mutex_unlock(&lock);
+    }
+
+    buffer = slots[submitted % num_slots].in;
+    pos = 0;
+    available = buf_size;
+}
+
+void DRAL_BUFFERED_WRITE_CLASS::Drain (void)
+{
+    if (num_threads == 0)
+    {
+        return;
+    }
+    pthread_mutex_lock(&lock);
+    while (written != submitted)
+    {
+        pthread_cond_wait(&block_written,&lock);
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+void DRAL_BUFFERED_WRITE_CLASS::StartThreads (void)
+{
+    if (slots != NULL)
+    {
+        return;
+    }
+
+    // Leave a processor for the simulator
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    num_threads = (cpus > 5 ? 4 : (cpus > 2 ? cpus - 1 : 1));
+    const char * env = getenv("DRAL_COMPRESS_THREADS");
+    if (env != NULL)
+    {
+        num_threads = atoi(env);
+        if (num_threads > DRAL_COMPRESS_MAX_THREADS)
+        {
+            num_threads = DRAL_COMPRESS_MAX_THREADS;
+        }
+    }
+
+    memset(&stream,0,sizeof(stream));
+    DRAL_ASSERT(deflateInit2(&stream,Z_DEFAULT_COMPRESSION,Z_DEFLATED,
+        MAX_WBITS+16,8,Z_DEFAULT_STRATEGY)==Z_OK,
+        "Error initializing zlib");
+
+    // One block being filled, one per thread and one waiting to be
+    // written while the threads go on with the next ones
+    num_slots = (num_threads == 0 ? 1 : num_threads + 2);
+    slots = new COMPRESS_SLOT [num_slots];
+    DRAL_ASSERT(slots!=NULL,"Not enought memory to allocate the buffer");
+    for (UINT32 i = 0; i < num_slots; i++)
+    {
+        slots[i].in = new char [buf_size];
+        slots[i].in_len = 0;
+        slots[i].out_size = deflateBound(&stream,buf_size);
+        slots[i].out = new char [slots[i].out_size];
+        slots[i].out_len = 0;
+        DRAL_ASSERT(slots[i].in!=NULL && slots[i].out!=NULL,
+            "Not enought memory to allocate the buffer");
+    }
+    buffer = slots[0].in;
+    pos = 0;
+    available = buf_size;
+
+    if (num_threads == 0)
+    {
+        return;
+    }
+
+    pthread_mutex_init(&lock,NULL);
+    pthread_cond_init(&block_submitted,NULL);
+    pthread_cond_init(&block_written,NULL);
+    for (UINT32 i = 0; i < num_threads; i++)
+    {
+        DRAL_ASSERT(
+            pthread_create(&threads[i],NULL,CompressThread,this)==0,
+            "Error creating the compression threads");
+    }
+    threads_running = true;
+}
+
+void DRAL_BUFFERED_WRITE_CLASS::StopThreads (void)
+{
+    if (!threads_running)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&lock);
+    stopping = true;
+    pthread_cond_broadcast(&block_submitted);
+    pthread_mutex_unlock(&lock);
+    for (UINT32 i = 0; i < num_threads; i++)
+    {
+        pthread_join(threads[i],NULL);
+    }
+    threads_running = false;
+
+    pthread_cond_destroy(&block_written);
+    pthread_cond_destroy(&block_submitted);
+    pthread_mutex_destroy(&lock);
+}
+
+void * DRAL_BUFFERED_WRITE_CLASS::CompressThread (void * arg)
+{
+    ((DRAL_BUFFERED_WRITE)arg)->CompressLoop();
+    return NULL;
+}
+
+void DRAL_BUFFERED_WRITE_CLASS::CompressLoop (void)
+{
+    z_stream strm;
+    memset(&strm,0,sizeof(strm));
+    DRAL_ASSERT(deflateInit2(&strm,Z_DEFAULT_COMPRESSION,Z_DEFLATED,
+        MAX_WBITS+16,8,Z_DEFAULT_STRATEGY)==Z_OK,
+        "Error initializing zlib");
+
+    pthread_mutex_lock(&lock);
+    while (true)
+    {
+        while (taken == submitted && !stopping)
+        {
+            pthread_cond_wait(&block_submitted,&lock);
+        }
+        if (taken == submitted)
+        {
+            break;
+        }
+        UINT64 seq = taken++;
+        COMPRESS_SLOT * slot = &slots[seq % num_slots];
+        pthread_mutex_unlock(&lock);
+
+        CompressBlock(&strm,slot);
+
+        // The members must be written in order: only the thread that
+        // holds the oldest block can be writing
+        pthread_mutex_lock(&lock);
+        while (written != seq)
+        {
+            pthread_cond_wait(&block_written,&lock);
+        }
+        pthread_mutex_unlock(&lock);
+
+        WriteFD(slot->out,slot->out_len);
+
+        pthread_mutex_lock(&lock);
+        written++;
+        pthread_cond_broadcast(&block_written);
+    }
+    pthread_mutex_unlock(&lock);
+
+    deflateEnd(&strm);
+}
+
+void DRAL_BUFFERED_WRITE_CLASS::CompressBlock (
+    z_stream * strm, COMPRESS_SLOT * slot)
+{
+    // Each block is a complete gzip member (header and trailer included)
+    DRAL_ASSERT(deflateReset(strm)==Z_OK,"Error initializing zlib");
+    strm->next_in = (Bytef *)slot->in;
+    strm->avail_in = slot->in_len;
+    strm->next_out = (Bytef *)slot->out;
+    strm->avail_out = slot->out_size;
+    int ret = deflate(strm,Z_FINISH);
+    DRAL_ASSERT(ret==Z_STREAM_END,"Error compressing the block: "
+        << (strm->msg != NULL ? strm->msg : "output buffer too small"));
+    slot->out_len = slot->out_size - strm->avail_out;
+}
@@ -622,6 +622,13 @@ CONTROLLER_CLASS::ParseVariables(char **argv, UINT32 argc)
         strcpy(StatsFileName, argv[incr+1]); 
         ++incr;
     }
+    // -sbg <mb>    memory budget of the intermediate stats files written
+    //              in the background (0 writes them directly)
+    else if ((strcmp(argv[0], "-sbg") == 0))
+    {
+        STATE_OUT_CLASS::SetBackgroundBudget(
+            atoi_general_unsigned(argv[++incr]) << 20);
+    }
     // debug on
     else if ((strcmp(argv[0], "-d") == 0))
     {
@@ -1354,6 +1361,46 @@ CONTROLLER_CLASS::ParseOneEvent (INT32 argc, char *argv[], INT32 &i)
                                                  0,
                                                  argv[++i]);
         }
+        //--------------------------------------------------------------------
+        // timing checkpoints
+        //--------------------------------------------------------------------
+        // -ckptc <n>       save a timing checkpoint every <n> cycles
+        //
+        else if ((strcmp(argv[i], "-ckptc") == 0) && (argc > (i+1))) 
+        {
+            theController.CMD_SaveTimingState(ACTION_CYCLE_PERIOD, atoi_general(argv[++i]));
+        }
+        //
+        // -ckpti <n>       save a timing checkpoint every <n> instructions
+        //
+        else if ((strcmp(argv[i], "-ckpti") == 0) && (argc > (i+1))) 
+        {
+            theController.CMD_SaveTimingState(ACTION_INST_PERIOD, atoi_general(argv[++i]));
+        }
+        //
+        // -ckptrestore <filename>  restore a timing checkpoint before the
+        //                          performance model starts
+        //
+        else if ((strcmp(argv[i], "-ckptrestore") == 0) && (argc > (i+1))) 
+        {
+            theController.CMD_RestoreTimingState(argv[++i]);
+        }
+        //--------------------------------------------------------------------
+        // DRAL flight recorder
+        //--------------------------------------------------------------------
+        // -frdumpc <n>     dump the flight recorder at cycle <n>
+        //
+        else if ((strcmp(argv[i], "-frdumpc") == 0) && (argc > (i+1))) 
+        {
+            theController.CMD_DumpFlightRecorder(ACTION_CYCLE_ONCE, atoi_general(argv[++i]));
+        }
+        //
+        // -frdumpi <n>     dump the flight recorder at instruction <n>
+        //
+        else if ((strcmp(argv[i], "-frdumpi") == 0) && (argc > (i+1))) 
+        {
+            theController.CMD_DumpFlightRecorder(ACTION_INST_ONCE, atoi_general(argv[++i]));
+        }
         // -vsm <n>       start Vtune Thread Profiler after <n> macro instructions
         //
         else if ((strcmp(argv[i], "-vsm") == 0) && (argc > (i+1))) 
@@ -1477,6 +1524,7 @@ CONTROLLER_CLASS::Usage (char *exec, FILE *file)
        << "\t-si <n>\t\t\tEmit stats file every <n> instructions\n"
        << "\t-sm <n>\t\t\tEmit stats file every <n> macro instructions\n"
        << "\t-sS <m>:<n>\t\tEmit stats file every <n>th occurrence of SSC mark <m>\n"
+       << "\t-sbg <mb>\t\tMemory for the stats files written in the background (default 256, 0 = none)\n"
        << "\n"
        << "\t-rsc <n>\t\t\tReset stats on cycle <n>\n"
        << "\t-rsi <n>\t\t\tReset stats on instruction <n>\n"
@@ -1490,6 +1538,13 @@ CONTROLLER_CLASS::Usage (char *exec, FILE *file)
        << "\n"
        << "\t-restore <filename>\t\t\tRestore functional state from <filename>\n"
        << "\n"
+       << "\t-ckptc <n>\t\t\tSave a timing checkpoint every <n> cycles\n"
+       << "\t-ckpti <n>\t\t\tSave a timing checkpoint every <n> instructions\n"
+       << "\t-ckptrestore <filename>\t\tRestore a timing checkpoint from <filename>\n"
+       << "\n"
+       << "\t-frdumpc <n>\t\t\tDump the DRAL flight recorder at cycle <n>\n"
+       << "\t-frdumpi <n>\t\t\tDump the DRAL flight recorder at instruction <n>\n"
+       << "\n"
        << "\t-param <name>=<value>\tdefine dynamic parameter <name> = <value>\n"
        << "\t-listparams\t\tlist all registered dynamic parameters\n"
        << "\t-listmasks\t\tlist the possible mask strings\n"
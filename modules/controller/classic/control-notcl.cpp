@@ -31,6 +31,8 @@
 #include "asim/mesg.h"
 #include "asim/trace.h"
 #include "asim/profile.h"
+#include "asim/checkpoint.h"
+#include "asim/event.h"
 
 // ASIM public modules
 #include "asim/provides/instfeeder_interface.h"
@@ -649,6 +651,51 @@ CONTROLLER_BASE_EXTERNAL_FUNCTION(
     // Dummy function
 }
 
+CONTROLLER_BASE_EXTERNAL_FUNCTION( 
+  void, CMD_SaveTimingState,
+  (CMD_ACTIONTRIGGER trigger, UINT64 n),
+  (                  trigger,        n)
+)
+/*
+ * Create an action to save a timing checkpoint.
+ */
+{
+    XMSG("CMD_SaveTimingState... trigger " << trigger << " n=" << n);
+
+    ctrlWorkList->Add(new CMD_SAVETIMINGSTATE_CLASS(trigger, n)); 
+    asimSystem->SYS_Break();       
+}
+
+CONTROLLER_BASE_EXTERNAL_FUNCTION( 
+  void, CMD_RestoreTimingState,
+  (const char *fileName, CMD_ACTIONTRIGGER trigger, UINT64 n),
+  (            fileName,                   trigger,        n)
+)
+/*
+ * Create an action to restore a timing checkpoint.
+ */
+{
+    XMSG("CMD_RestoreTimingState... " << fileName);
+
+    ctrlWorkList->Add(new CMD_RESTORETIMINGSTATE_CLASS(trigger, n, fileName)); 
+    asimSystem->SYS_Break();       
+}
+
+CONTROLLER_BASE_EXTERNAL_FUNCTION( 
+  void, CMD_DumpFlightRecorder,
+  (CMD_ACTIONTRIGGER trigger, UINT64 n),
+  (                  trigger,        n)
+)
+/*
+ * Create an action to dump the DRAL flight recorder.
+ */
+{
+    XMSG("CMD_DumpFlightRecorder... trigger " << trigger << " n=" << n);
+
+    ctrlWorkList->Add(new CMD_DUMPFLIGHTRECORDER_CLASS(trigger, n)); 
+    asimSystem->SYS_Break();       
+}
+
 
 /**********************************************************************/
 
@@ -810,6 +857,9 @@ CONTROLLER_BASE_EXTERNAL_FUNCTION(
     // Stop the awb workbench
     AWB_Exit();
 
+    // finish the intermediate stats files
+    STATE_OUT_CLASS::WaitBackgroundDumps();
+
     // print "AtExit" stats
     if (StatsFileName)
     {
@@ -907,7 +957,8 @@ CMD_EMITSTATS_CLASS::CmdAction (void)
 
     XMSG("CMD_EMITSTATS emitting intermediate stats: " << statsFileName.str());
 
-    STATE_OUT stateOut = new STATE_OUT_CLASS(statsFileName.str().c_str());
+    // written in the background while the simulation goes on
+    STATE_OUT stateOut = new STATE_OUT_CLASS(statsFileName.str().c_str(), true);
     if (! stateOut) 
     {
         ASIMERROR("Unable to create stats output file \"" <<
@@ -921,6 +972,39 @@ CMD_EMITSTATS_CLASS::CmdAction (void)
 }
 
 
+void
+CMD_SAVETIMINGSTATE_CLASS::CmdAction (void)
+{
+    ostringstream ckptFileName;
+    ckptFileName << "cycle_" << asimSystem->SYS_Cycle() << ".ckpt";
+
+    XMSG("CMD_SAVETIMINGSTATE saving timing checkpoint: " << ckptFileName.str());
+    cout << "Saving timing checkpoint " << ckptFileName.str() << endl;
+
+    ASIM_CHECKPOINT_CLASS::SaveTimingState(ckptFileName.str().c_str(), asimSystem);
+}
+
+void
+CMD_RESTORETIMINGSTATE_CLASS::CmdAction (void)
+{
+    XMSG("CMD_RESTORETIMINGSTATE restoring timing checkpoint: " << fileName);
+    cout << "Restoring timing checkpoint " << fileName << endl;
+
+    ASIM_CHECKPOINT_CLASS::RestoreTimingState(fileName.c_str(), asimSystem);
+}
+
+void
+CMD_DUMPFLIGHTRECORDER_CLASS::CmdAction (void)
+{
+    XMSG("CMD_DUMPFLIGHTRECORDER at cycle " << asimSystem->SYS_Cycle());
+
+    if (!ASIM_DRAL_EVENT_CLASS::DumpFlightRecorder())
+    {
+        cerr << "No DRAL flight recorder to dump (see DRAL_FLIGHT_RECORDER)" << endl;
+    }
+}
+
+
 void
 CMD_RESETSTATS_CLASS::CmdAction (void)
 {
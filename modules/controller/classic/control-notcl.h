@@ -196,6 +196,21 @@ extern void CMD_SaveFuncState (CMD_ACTIONTRIGGER trigger =ACTION_NOW, UINT64 n =
  */
 extern void CMD_RestoreFuncState (CMD_ACTIONTRIGGER trigger =ACTION_NOW, UINT64 n =0, char *fileName ="dummy_restore");
 
+/*
+ * Save a timing checkpoint
+ */
+extern void CMD_SaveTimingState (CMD_ACTIONTRIGGER trigger =ACTION_NOW, UINT64 n =0);
+
+/*
+ * Restore a timing checkpoint
+ */
+extern void CMD_RestoreTimingState (const char *fileName, CMD_ACTIONTRIGGER trigger =ACTION_NOW, UINT64 n =0);
+
+/*
+ * Dump the events kept by the DRAL flight recorder
+ */
+extern void CMD_DumpFlightRecorder (CMD_ACTIONTRIGGER trigger =ACTION_NOW, UINT64 n =0);
+
 
 /********************************************************************
  *
@@ -978,6 +993,54 @@ class CMD_SAVEFUNCSTATE_CLASS : public CMD_WORKITEM_CLASS
         void CmdAction (void);
 };
 
+/*
+ * CMD_SAVETIMINGSTATE
+ *
+ * Save a timing checkpoint (ports, clock server and module stats)
+ */
+typedef class CMD_SAVETIMINGSTATE_CLASS *CMD_SAVETIMINGSTATE;
+class CMD_SAVETIMINGSTATE_CLASS : public CMD_WORKITEM_CLASS
+{
+    public:
+        CMD_SAVETIMINGSTATE_CLASS (CMD_ACTIONTRIGGER t, UINT64 c) :
+            CMD_WORKITEM_CLASS("SAVETIMINGSTATE", t, c) { }
+
+        void CmdAction (void);
+};
+
+/*
+ * CMD_RESTORETIMINGSTATE
+ *
+ * Restore a timing checkpoint saved by CMD_SAVETIMINGSTATE
+ */
+typedef class CMD_RESTORETIMINGSTATE_CLASS *CMD_RESTORETIMINGSTATE;
+class CMD_RESTORETIMINGSTATE_CLASS : public CMD_WORKITEM_CLASS
+{
+    private:
+        const string fileName;
+
+    public:
+        CMD_RESTORETIMINGSTATE_CLASS (CMD_ACTIONTRIGGER t, UINT64 c, const char *f) :
+            CMD_WORKITEM_CLASS("RESTORETIMINGSTATE", t, c), fileName(f) { }
+
+        void CmdAction (void);
+};
+
+/*
+ * CMD_DUMPFLIGHTRECORDER
+ *
+ * Write the last cycles of events kept by the DRAL flight recorder
+ */
+typedef class CMD_DUMPFLIGHTRECORDER_CLASS *CMD_DUMPFLIGHTRECORDER;
+class CMD_DUMPFLIGHTRECORDER_CLASS : public CMD_WORKITEM_CLASS
+{
+    public:
+        CMD_DUMPFLIGHTRECORDER_CLASS (CMD_ACTIONTRIGGER t, UINT64 c) :
+            CMD_WORKITEM_CLASS("DUMPFLIGHTRECORDER", t, c) { }
+
+        void CmdAction (void);
+};
+
 /*
  * CMD_RESTOREFUNCSTATE
  *
@@ -1208,6 +1271,9 @@ class CONTROLLER_CLASS {
     
     void CMD_SaveFuncState (CMD_ACTIONTRIGGER trigger =ACTION_NOW, UINT64 n =0);
     void CMD_RestoreFuncState (CMD_ACTIONTRIGGER trigger =ACTION_NOW, UINT64 n =0, char *fileName ="dummy_restore");
+    void CMD_SaveTimingState (CMD_ACTIONTRIGGER trigger =ACTION_NOW, UINT64 n =0);
+    void CMD_RestoreTimingState (const char *fileName, CMD_ACTIONTRIGGER trigger =ACTION_NOW, UINT64 n =0);
+    void CMD_DumpFlightRecorder (CMD_ACTIONTRIGGER trigger =ACTION_NOW, UINT64 n =0);
     
     void CMD_StartThreadProfiler (CMD_ACTIONTRIGGER trigger =ACTION_NOW, UINT64 n =0);
     void CMD_StopThreadProfiler (CMD_ACTIONTRIGGER trigger =ACTION_NOW, UINT64 n =0);
@@ -531,7 +531,8 @@ ASIM_APE_CLASS::SYS_Execute (
     statCycles++;
     SYS_Cycle()++;
 
-    // check for work in Tarati server
+    // snapshot the stats and check for work in Tarati server
+    asimTaratiSystem->Sample(SYS_Cycle());
     asimTaratiSystem->Work();
   }
 
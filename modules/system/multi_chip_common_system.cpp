@@ -34,6 +34,7 @@
 #include "asim/ioformat.h"
 #include "asim/event.h"
 #include "asim/port.h"
+#include "asim/partition.h"
 
 // ASIM public modules
 #include "asim/provides/instfeeder_interface.h"
@@ -64,6 +65,15 @@ ASIM_MULTI_CHIP_SYSTEM_CLASS::ASIM_MULTI_CHIP_SYSTEM_CLASS(
     RegisterState(&statCycles, "cycles_stats_gathered", "Number of cycles simulated with stats on (@ reference frequency)");
     RegisterState(&statBaseCycles, "base_cycles_stats_gathered", "number of base cycles simulated with stats on (@ clockserver frequency)");
 
+    RegisterState(&BasePort::ConnectAllUsecs, "port_connect_usecs", "Time spent connecting the ports (microseconds)")->SetResettable(false);
+    RegisterState(&BasePort::ConnectAllPorts, "ports_connected", "Number of ports connected")->SetResettable(false);
+
+    // Join the model partition clocked by this process.  The board has
+    // assigned its modules to partitions, and the ports crossing them
+    // are set up in shared memory while connecting.
+    ASIM_PARTITION_CLASS::Init(NUM_PARTITIONS, PARTITION_ID,
+                               string(PARTITION_JOB).c_str());
+
     // connect all buffers together
     ConfigPort::ConnectAll();
 
@@ -77,6 +87,7 @@ ASIM_MULTI_CHIP_SYSTEM_CLASS::ASIM_MULTI_CHIP_SYSTEM_CLASS(
     clock -> SetThreadedClocking  ( THREADED_CLOCKING == 1       ,
                                     CLOCKSERVER_THREAD_LOOKAHEAD ,
                                     CLOCKSERVER_THREAD_DELAY     );
+    clock -> SetThreadedTracing   ( THREADED_TRACING == 1        );
 }
 
 
@@ -88,6 +99,9 @@ ASIM_MULTI_CHIP_SYSTEM_CLASS::~ASIM_MULTI_CHIP_SYSTEM_CLASS()
     // stop the clock server (stop threads, in the case of the threaded clockserver)
     clock->StopClockServer();
 
+    // let the other model partitions run without us
+    ASIM_PARTITION_CLASS::Shutdown();
+
     delete config;
 }
 
@@ -408,6 +422,7 @@ SYS_Init(
     }
 
     ASIM_SMP_CLASS::Init(MAX_PTHREADS, LIMIT_PTHREADS);
+    ASIM_SMP_CLASS::SetAffinity(CLOCKSERVER_THREAD_AFFINITY);
 
     common_system = new ASIM_MULTI_CHIP_SYSTEM_CLASS("COMMON_SYSTEM",
                                                      reference_domain,
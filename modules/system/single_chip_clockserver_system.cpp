@@ -60,6 +60,9 @@ ASIM_COMMON_SYSTEM_CLASS::ASIM_COMMON_SYSTEM_CLASS(
 
     RegisterState(&statClocks, "Clocks", "Number of calls to clockserver's Clock");
 
+    RegisterState(&BasePort::ConnectAllUsecs, "port_connect_usecs", "Time spent connecting the ports (microseconds)")->SetResettable(false);
+    RegisterState(&BasePort::ConnectAllPorts, "ports_connected", "Number of ports connected")->SetResettable(false);
+
     // connect all buffers together
     ConfigPort::ConnectAll();
 
@@ -73,6 +76,7 @@ ASIM_COMMON_SYSTEM_CLASS::ASIM_COMMON_SYSTEM_CLASS(
     clock -> SetThreadedClocking  ( THREADED_CLOCKING == 1       ,
                                     CLOCKSERVER_THREAD_LOOKAHEAD ,
                                     CLOCKSERVER_THREAD_DELAY     );
+    clock -> SetThreadedTracing   ( THREADED_TRACING == 1        );
 
     // Initialize single instance of thermal model
     myThermalModel = THERMAL_MODEL_CLASS::Instance();
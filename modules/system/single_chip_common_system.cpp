@@ -57,6 +57,9 @@ ASIM_COMMON_SYSTEM_CLASS::ASIM_COMMON_SYSTEM_CLASS(
 
     RegisterState(&statCycles, "Cycles", "Simulation cycles completed");
 
+    RegisterState(&BasePort::ConnectAllUsecs, "port_connect_usecs", "Time spent connecting the ports (microseconds)")->SetResettable(false);
+    RegisterState(&BasePort::ConnectAllPorts, "ports_connected", "Number of ports connected")->SetResettable(false);
+
     // connect all buffers together
     ConfigPort::ConnectAll();
 
@@ -54,6 +54,9 @@ ASIM_SYSTEM_CLASS::ASIM_SYSTEM_CLASS(
 
     RegisterState(&statCycles, "Cycles", "Simulation cycles completed");
 
+    RegisterState(&BasePort::ConnectAllUsecs, "port_connect_usecs", "Time spent connecting the ports (microseconds)")->SetResettable(false);
+    RegisterState(&BasePort::ConnectAllPorts, "ports_connected", "Number of ports connected")->SetResettable(false);
+
     // connect all buffers together
     ConfigPort::ConnectAll();
 
@@ -24,6 +24,12 @@
 
 // generic
 
+// ASIM core
+#include "asim/mesg.h"
+
+// ASIM public modules
+#include "asim/provides/tarati_stats.h"
+
 // ASIM local modules
 #include "taratiStats.h"
 
@@ -50,9 +56,23 @@ Stats::Stats(
     // create a linked list of all state of the PM
     STATE_ITERATOR_CLASS iter(system, true);
     ASIM_STATE state;
+    UINT32 nStates = 0;
     while ((state = iter.Next()) != NULL) {
         pmState = new ASIM_STATELINK_CLASS(state, pmState, false);
+        nStates++;
+    }
+
+    // index it, and lay out the snapshot, in list order
+    pathIndex.Init(nStates);
+    nameIndex.Init(nStates);
+    for (ASIM_STATELINK scan = pmState; scan != NULL; scan = scan->next) {
+        state = scan->state;
+        pathIndex.Add(state->Path(), allStates.size());
+        nameIndex.Add(state->Name(), allStates.size());
+        allStates.push_back(state);
     }
+    snapshot = new STATE_SAMPLER_CLASS(allStates);
+    nextSample = TARATI_STATS_SNAPSHOT_CYCLES;
 
     // instantiate and register methods
     method.states = new States(this);
@@ -61,6 +81,26 @@ Stats::Stats(
     method.name = new Name(this);
     method.desc = new Desc(this);
     method.value = new Value(this);
+    method.lookup = new Lookup(this);
+    method.read = new Read(this);
+
+    // serve Lookup and Read on a port of their own
+    rpcServer = NULL;
+    forwardLookup = NULL;
+    forwardRead = NULL;
+    rpcStop = false;
+    if (TARATI_STATS_PORT != 0) {
+        rpcServer = new XmlRpcServer;
+        if ( ! rpcServer->bindAndListen(TARATI_STATS_PORT)) {
+            ASIMERROR("could not bind socket to Tarati Stats port "
+                      << TARATI_STATS_PORT << endl);
+        }
+        forwardLookup = new Forward(method.lookup, rpcServer);
+        forwardRead = new Forward(method.read, rpcServer);
+        if (pthread_create(&rpcThread, NULL, RpcLoop, this) != 0) {
+            ASIMERROR("could not create the Tarati Stats thread" << endl);
+        }
+    }
 }
 
 /**
@@ -69,6 +109,17 @@ Stats::Stats(
  */
 Stats::~Stats()
 {
+    // stop serving the snapshot
+    if (rpcServer != NULL) {
+        rpcStop = true;
+        pthread_join(rpcThread, NULL);
+        rpcServer->shutdown();
+        delete forwardLookup;
+        delete forwardRead;
+        delete rpcServer;
+    }
+    delete snapshot;
+
     // delete methods
     delete method.states;
     delete method.find;
@@ -76,6 +127,8 @@ Stats::~Stats()
     delete method.name;
     delete method.desc;
     delete method.value;
+    delete method.lookup;
+    delete method.read;
 
     // forget what we know about PM
     pmSystem = NULL;
@@ -88,6 +141,20 @@ Stats::~Stats()
     }
 }
 
+/**
+ * Stats RPC thread: serve the Stats port until the service goes away.
+ */
+void *
+Stats::RpcLoop(
+    void * arg)
+{
+    Stats * stats = (Stats *) arg;
+    while ( ! stats->rpcStop) {
+        stats->rpcServer->work(0.2);
+    }
+    return NULL;
+}
+
 //----------------------------------------------------------------------------
 // Methods
 //----------------------------------------------------------------------------
@@ -97,36 +164,33 @@ Stats::States::execute(
     XmlRpcValue & params,
     XmlRpcValue & result)
 {
-    const char * path;
     int results = 0;
 
     // get params
     if (params.getType() == XmlRpcValue::TypeInvalid) {
-        path = NULL;
-    } else {
-        ASSERTX(params.getType() == XmlRpcValue::TypeArray);
-        if (params.size() != 1) {
-            throw XmlRpcException("wrong number of arguments in method call");
+        // all states
+        ASIM_STATELINK scan = stats->pmState;
+        while (scan != NULL) {
+            result[results] = (int) scan->state;
+            results++;
+            scan = scan->next;
         }
-        path = ((string) params[0]).c_str();
+        return;
     }
 
-    ASIM_STATELINK scan = stats->pmState;
-    while (scan != NULL) {
-        ASIM_STATE state = scan->state;
+    ASSERTX(params.getType() == XmlRpcValue::TypeArray);
+    if (params.size() != 1) {
+        throw XmlRpcException("wrong number of arguments in method call");
+    }
+    string path = params[0];
 
-        if ((path == NULL) ||
-            (strcasecmp(state->Path(), path) == 0))
-        {
-            // If 'path' equals 'state's path, then return 'state's descriptor.
-            result[results] = (int) state;
-            // result[results]["path"] = state->Path();
-            // result[results]["name"] = state->Name();
-            // result[results]["desc"] = state->Description();
+    // If 'path' equals 'state's path, then return 'state's descriptor.
+    const vector<UINT32> * ids = stats->pathIndex.Find(path.c_str());
+    if (ids != NULL) {
+        for (UINT32 i = 0; i < ids->size(); i++) {
+            result[results] = (int) stats->allStates[(*ids)[i]];
             results++;
         }
-
-        scan = scan->next;
     }
 }
 
@@ -136,27 +200,77 @@ Stats::Find::execute(
     XmlRpcValue & params,
     XmlRpcValue & result)
 {
-    const char * name;
-
     // get params
     if (params.getType() != XmlRpcValue::TypeArray ||
         params.size() != 1)
     {
         throw XmlRpcException("wrong number of arguments in method call");
     }
-    name = ((string) params[0]).c_str();
+    string name = params[0];
 
-    ASIM_STATELINK scan = stats->pmState;
-    while (scan != NULL) {
-        ASIM_STATE state = scan->state;
+    const vector<UINT32> * ids = stats->nameIndex.Find(name.c_str());
+    if (ids != NULL) {
+        result[0] = (int) stats->allStates[ids->front()];
+    }
+}
 
-        if (strcasecmp(state->Name(), name) == 0) {
-            result[0] = (int) state;
-            return;
+//----- Lookup -----
+void
+Stats::Lookup::execute(
+    XmlRpcValue & params,
+    XmlRpcValue & result)
+{
+    // get params
+    if (params.getType() != XmlRpcValue::TypeArray ||
+        params.size() != 1 ||
+        params[0].getType() != XmlRpcValue::TypeArray)
+    {
+        throw XmlRpcException("wrong arguments in method call");
+    }
+
+    result.setSize(params[0].size());
+    for (int i = 0; i < params[0].size(); i++) {
+        string fullName = params[0][i];
+        result[i] = stats->snapshot->Lookup(fullName.c_str());
+    }
+}
+
+//----- Read -----
+void
+Stats::Read::execute(
+    XmlRpcValue & params,
+    XmlRpcValue & result)
+{
+    // get params
+    if (params.getType() != XmlRpcValue::TypeArray ||
+        params.size() != 1 ||
+        params[0].getType() != XmlRpcValue::TypeArray)
+    {
+        throw XmlRpcException("wrong arguments in method call");
+    }
+    XmlRpcValue & handles = params[0];
+    vector<INT32> h(handles.size());
+    for (int i = 0; i < handles.size(); i++) {
+        h[i] = handles[i];
+        if (h[i] < 0 || h[i] >= (INT32) stats->snapshot->NumHandles()) {
+            throw XmlRpcException("invalid stats handle");
         }
+    }
 
-        scan = scan->next;
+    // all the values come from the same snapshot
+    vector< vector<double> > v;
+    UINT64 cycle = stats->snapshot->Read(h, v);
+    XmlRpcValue values;
+    values.setSize(v.size());
+    for (UINT32 i = 0; i < v.size(); i++) {
+        XmlRpcValue & stateValues = values[i];
+        stateValues.setSize(v[i].size());
+        for (UINT32 j = 0; j < v[i].size(); j++) {
+            stateValues[j] = v[i][j];
+        }
     }
+    result["cycle"] = (double) cycle;
+    result["values"] = values;
 }
 
 static inline
@@ -25,8 +25,14 @@
 #ifndef _TARATI_STATS_
 #define _TARATI_STATS_
 
+// generic
+#include <pthread.h>
+#include <string>
+#include <vector>
+
 // ASIM core
 #include "asim/state.h"
+#include "asim/state_sampler.h"
 
 // ASIM public modules
 #include "asim/provides/system.h"
@@ -146,6 +152,49 @@ class Stats
         void execute(XmlRpcValue& params, XmlRpcValue& result);
     };
 
+    /**
+     * @brief Tarati Method: Lookup([path/name, ...])
+     *
+     * Snapshot handle of each state, -1 if it is not a UINT or FP state.
+     */
+    class Lookup
+      : public Method
+    {
+      private:
+        Stats * stats;
+
+      public:
+        Lookup(Stats * _stats)
+          : Method(_stats, "Lookup"),
+            stats(_stats) {};
+
+        /// RPC call method
+        void execute(XmlRpcValue& params, XmlRpcValue& result);
+    };
+    friend class Lookup;
+
+    /**
+     * @brief Tarati Method: Read([handle, ...])
+     *
+     * Values of the states in the last snapshot, as doubles since XML-RPC
+     * integers are only 32 bits.
+     */
+    class Read
+      : public Method
+    {
+      private:
+        Stats * stats;
+
+      public:
+        Read(Stats * _stats)
+          : Method(_stats, "Read"),
+            stats(_stats) {};
+
+        /// RPC call method
+        void execute(XmlRpcValue& params, XmlRpcValue& result);
+    };
+    friend class Read;
+
     struct _method {
         States * states;
         Find * find;
@@ -153,8 +202,60 @@ class Stats
         Name * name;
         Desc * desc;
         Value * value;
+        Lookup * lookup;
+        Read * read;
     } method;
 
+    //------------------------------------------------------------------------
+    // Index
+    //------------------------------------------------------------------------
+    vector<ASIM_STATE> allStates;  ///< pmState as a vector
+    STATE_INDEX_CLASS pathIndex;   ///< allStates by Path()
+    STATE_INDEX_CLASS nameIndex;   ///< allStates by Name()
+
+    //------------------------------------------------------------------------
+    // Snapshot
+    //------------------------------------------------------------------------
+    // UINT and FP states, sampled every TARATI_STATS_SNAPSHOT_CYCLES cycles
+    // by the simulation thread. Lookup and Read serve the last sample.
+    STATE_SAMPLER snapshot;
+    UINT64 nextSample;
+
+    //------------------------------------------------------------------------
+    // Stats RPC thread
+    //------------------------------------------------------------------------
+    /**
+     * @brief Calls a Stats method from the server of the stats thread
+     */
+    class Forward
+      : public XmlRpcServerMethod
+    {
+      private:
+        Method * target;
+
+      public:
+        Forward(Method * _target, XmlRpcServer * server)
+          : XmlRpcServerMethod(_target->GetXmlName(), server),
+            target(_target) {};
+
+        /// RPC call method
+        void execute(XmlRpcValue& params, XmlRpcValue& result)
+        {
+            target->execute(params, result);
+        }
+    };
+
+    // Lookup and Read only touch the index and the snapshot, so they are
+    // also served on TARATI_STATS_PORT by a thread of their own, and polling
+    // clients do not wait for the simulator to check the Tarati server.
+    XmlRpcServer * rpcServer;
+    Forward * forwardLookup;
+    Forward * forwardRead;
+    pthread_t rpcThread;
+    volatile bool rpcStop;
+
+    static void * RpcLoop(void * arg);
+
     //------------------------------------------------------------------------
     // Service
     //------------------------------------------------------------------------
@@ -164,6 +265,16 @@ class Stats
   public:
     Stats(Server * server, ASIM_SYSTEM system);
     ~Stats();
+
+    /// Take a snapshot of the stats if it is time to (simulation thread)
+    void Sample(UINT64 cycle)
+    {
+        if (cycle >= nextSample)
+        {
+            snapshot->Take(cycle);
+            nextSample = cycle + TARATI_STATS_SNAPSHOT_CYCLES;
+        }
+    }
 };
 
 } // namespace AsimTarati
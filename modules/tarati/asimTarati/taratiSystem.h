@@ -62,6 +62,7 @@ class System
     Server * GetServer(void) const { return server; }
     int GetPort(void) const { return server->GetPort(); }
     void Work(double timeout = 0.0) const { server->Work(timeout); }
+    void Sample(UINT64 cycle) const { service.stats->Sample(cycle); }
     void Wait(void) const { server->Wait(); }
 };
 
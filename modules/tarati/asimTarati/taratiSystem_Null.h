@@ -40,6 +40,7 @@ class System
     System(ASIM_SYSTEM system) { /* nada */ };
     ~System() { /* nada */ };
     void Work(void) const { /* nada */ }
+    void Sample(UINT64 cycle) const { /* nada */ }
     int GetPort(void) const { return -1; }
 };
 
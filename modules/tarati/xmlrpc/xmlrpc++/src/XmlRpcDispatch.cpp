@@ -18,8 +18,14 @@
 # endif
 #else
 # include <sys/time.h>
+# include <unistd.h>
 #endif  // _WINDOWS
 
+#if defined(__linux__)
+# define USE_EPOLL
+# include <sys/epoll.h>
+#endif
+
 
 using namespace XmlRpc;
 
@@ -29,11 +35,21 @@ XmlRpcDispatch::XmlRpcDispatch()
   _endTime = -1.0;
   _doClear = false;
   _inWork = false;
+  _epollFd = -1;
+#if defined(USE_EPOLL)
+  _epollFd = epoll_create(64);    // the size is only a hint
+  if (_epollFd < 0)
+    XmlRpcUtil::error("XmlRpcDispatch: epoll_create failed, using select.");
+#endif
 }
 
 
 XmlRpcDispatch::~XmlRpcDispatch()
 {
+#if defined(USE_EPOLL)
+  if (_epollFd >= 0)
+    ::close(_epollFd);
+#endif
 }
 
 // Monitor this source for the specified events and call its event handler
@@ -41,7 +57,8 @@ XmlRpcDispatch::~XmlRpcDispatch()
 void
 XmlRpcDispatch::addSource(XmlRpcSource* source, unsigned mask)
 {
-  _sources.push_back(MonitoredSource(source, mask));
+  _sources.push_back(MonitoredSource(source, mask, source->getfd()));
+  epollAdd(--_sources.end());
 }
 
 // Stop monitoring this source. Does not close the source.
@@ -51,6 +68,7 @@ XmlRpcDispatch::removeSource(XmlRpcSource* source)
   for (SourceList::iterator it=_sources.begin(); it!=_sources.end(); ++it)
     if (it->getSource() == source)
     {
+      epollRemove(it);
       _sources.erase(it);
       break;
     }
@@ -65,11 +83,60 @@ XmlRpcDispatch::setSourceEvents(XmlRpcSource* source, unsigned eventMask)
     if (it->getSource() == source)
     {
       it->getMask() = eventMask;
+      epollModify(it);
       break;
     }
 }
 
 
+// Add a source to the epoll set. Sources that do not wait for any event
+// are left out: epoll would keep reporting their hangups.
+void
+XmlRpcDispatch::epollAdd(SourceList::iterator it)
+{
+#if defined(USE_EPOLL)
+  if (_epollFd < 0 || it->getFd() < 0)
+    return;
+  _fdSources[it->getFd()] = it;
+  if ( ! it->getMask())
+    return;
+
+  struct epoll_event ev;
+  ev.events = 0;
+  if (it->getMask() & ReadableEvent) ev.events |= EPOLLIN;
+  if (it->getMask() & WritableEvent) ev.events |= EPOLLOUT;
+  if (it->getMask() & Exception)     ev.events |= EPOLLPRI;
+  ev.data.u64 = 0;
+  ev.data.fd = it->getFd();
+  if (epoll_ctl(_epollFd, EPOLL_CTL_ADD, it->getFd(), &ev) != 0)
+    XmlRpcUtil::error("XmlRpcDispatch: could not add fd %d to epoll (%d).", it->getFd(), errno);
+#endif
+}
+
+// Remove a source from the epoll set. The descriptor may be closed
+// already, which removed it.
+void
+XmlRpcDispatch::epollRemove(SourceList::iterator it)
+{
+#if defined(USE_EPOLL)
+  if (_epollFd < 0 || it->getFd() < 0)
+    return;
+  std::map<int, SourceList::iterator>::iterator fit = _fdSources.find(it->getFd());
+  if (fit != _fdSources.end() && fit->second == it)
+    _fdSources.erase(fit);
+  struct epoll_event ev;    // ignored, but must not be NULL before 2.6.9
+  epoll_ctl(_epollFd, EPOLL_CTL_DEL, it->getFd(), &ev);
+#endif
+}
+
+void
+XmlRpcDispatch::epollModify(SourceList::iterator it)
+{
+  epollRemove(it);
+  epollAdd(it);
+}
+
+
 // Modify the async I/O notification for all watched sources
 void 
 XmlRpcDispatch::setAsyncIo(int signal)
@@ -90,6 +157,13 @@ XmlRpcDispatch::work(double timeout)
   _doClear = false;
   _inWork = true;
 
+  if (_epollFd >= 0)
+  {
+    workEpoll(timeout);
+    _inWork = false;
+    return;
+  }
+
   // Only work while there is something to monitor
   while (_sources.size() > 0) {
 
@@ -176,6 +250,88 @@ XmlRpcDispatch::work(double timeout)
 }
 
 
+// Same as the select loop of work(), waiting with epoll
+void
+XmlRpcDispatch::workEpoll(double timeout)
+{
+#if defined(USE_EPOLL)
+  const int maxEvents = 64;
+  struct epoll_event events[maxEvents];
+
+  // Only work while there is something to monitor
+  while (_sources.size() > 0) {
+
+    int nEvents = epoll_wait(_epollFd, events, maxEvents,
+                             (timeout < 0.0) ? -1 : (int)floor(1000.0 * timeout));
+
+    if (nEvents < 0 && errno != EINTR)
+    {
+      XmlRpcUtil::error("Error in XmlRpcDispatch::work: error in epoll_wait (%d).", errno);
+      return;
+    }
+
+    // Process events
+    for (int i = 0; i < nEvents; ++i)
+    {
+      // An earlier handler may have removed the source
+      int fd = events[i].data.fd;
+      std::map<int, SourceList::iterator>::iterator fit = _fdSources.find(fd);
+      if (fit == _fdSources.end())
+        continue;
+      SourceList::iterator thisIt = fit->second;
+      XmlRpcSource* src = thisIt->getSource();
+      unsigned mask = thisIt->getMask();
+
+      // Like select, errors and hangups make the descriptor ready
+      unsigned ev = events[i].events;
+      bool ready = (ev & (EPOLLERR | EPOLLHUP)) != 0;
+      unsigned newMask = (unsigned) -1;
+      if ((mask & ReadableEvent) && (ready || (ev & EPOLLIN)))
+        newMask &= src->handleEvent(ReadableEvent);
+      if ((mask & WritableEvent) && (ready || (ev & EPOLLOUT)))
+        newMask &= src->handleEvent(WritableEvent);
+      if ((mask & Exception) && (ev & EPOLLPRI))
+        newMask &= src->handleEvent(Exception);
+
+      // The handler may have removed the source itself
+      fit = _fdSources.find(fd);
+      if (fit == _fdSources.end() || fit->second->getSource() != src)
+        continue;
+
+      if ( ! newMask) {
+        epollRemove(thisIt);
+        _sources.erase(thisIt);  // Stop monitoring this one
+        if ( ! src->getKeepOpen())
+          src->close();
+      } else if (newMask != (unsigned) -1 && newMask != mask) {
+        thisIt->getMask() = newMask;
+        epollModify(thisIt);
+      }
+    }
+
+    // Check whether to clear all sources
+    if (_doClear)
+    {
+      SourceList closeList = _sources;
+      for (SourceList::iterator it=_sources.begin(); it!=_sources.end(); ++it)
+        epollRemove(it);
+      _sources.clear();
+      for (SourceList::iterator it=closeList.begin(); it!=closeList.end(); ++it) {
+        XmlRpcSource *src = it->getSource();
+        src->close();
+      }
+
+      _doClear = false;
+    }
+
+    // Check whether end time has passed
+    if (0 <= _endTime && getTime() > _endTime)
+      break;
+  }
+#endif
+}
+
+
 // Exit from work routine. Presumably this will be called from
 // one of the source event handlers.
 void
@@ -193,6 +349,8 @@ XmlRpcDispatch::clear()
   else
   {
     SourceList closeList = _sources;
+    for (SourceList::iterator it=_sources.begin(); it!=_sources.end(); ++it)
+      epollRemove(it);
     _sources.clear();
     for (SourceList::iterator it=closeList.begin(); it!=closeList.end(); ++it)
       it->getSource()->close();
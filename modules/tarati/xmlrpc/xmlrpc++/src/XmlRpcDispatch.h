@@ -10,6 +10,7 @@
 
 #ifndef MAKEDEPEND
 # include <list>
+# include <map>
 #endif
 
 namespace XmlRpc {
@@ -18,7 +19,9 @@ namespace XmlRpc {
   class XmlRpcSource;
 
   //! An object which monitors file descriptors for events and performs
-  //! callbacks when interesting events happen.
+  //! callbacks when interesting events happen. On Linux it uses epoll, so
+  //! there is no limit on the descriptor numbers and the cost of waiting
+  //! does not grow with the number of sources; elsewhere it uses select.
   class XmlRpcDispatch {
   public:
     //! Constructor
@@ -66,11 +69,13 @@ namespace XmlRpc {
 
     // A source to monitor and what to monitor it for
     struct MonitoredSource {
-      MonitoredSource(XmlRpcSource* src, unsigned mask) : _src(src), _mask(mask) {}
+      MonitoredSource(XmlRpcSource* src, unsigned mask, int fd) : _src(src), _mask(mask), _fd(fd) {}
       XmlRpcSource* getSource() const { return _src; }
       unsigned& getMask() { return _mask; }
+      int getFd() const { return _fd; }
       XmlRpcSource* _src;
       unsigned _mask;
+      int _fd;          // descriptor when it was added
     };
 
     // A list of sources to monitor
@@ -79,6 +84,17 @@ namespace XmlRpc {
     // Sources being monitored
     SourceList _sources;
 
+    // epoll descriptor (-1 if select is used) and the source of each
+    // descriptor in it
+    int _epollFd;
+    std::map<int, SourceList::iterator> _fdSources;
+
+    // helpers for the epoll set
+    void epollAdd(SourceList::iterator it);
+    void epollRemove(SourceList::iterator it);
+    void epollModify(SourceList::iterator it);
+    void workEpoll(double timeout);
+
     // When work should stop (-1 implies wait forever, or until exit is called)
     double _endTime;
 